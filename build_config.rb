@@ -19,13 +19,18 @@ Project::Build.new("demo") { |conf|
   toolchain toolchain_using
   conf.outname = 'demo.exe'
  }
+# TEST
+Project::Build.new("test") { |conf| 
+  toolchain toolchain_using
+  conf.outname = 'test.exe'
+ }
 # EACH
 Project.each_target  { |conf|
   # obj extx
   conf.object_extx = '.o'
 
-  # demo did not include ogg-headers
-  next if conf == Project.targets["demo"]
+  # demo and test did not include ogg-headers
+  next if conf == Project.targets["demo"] || conf == Project.targets["test"]
   [conf.cxx, conf.cc].each do |cc|
     # ogg
     cc.include_paths << "#{PROJECT_ROOT}/3rdparty/libogg/include/"
@@ -44,21 +44,10 @@ namespace WrapAL {
     class CALAudioSourceGroup;
     // impl for engine
     struct engine_impl;
-    // API level
-    enum class APILevel : size_t {
-        // NO API
-        Level_Unknown = 0,
-        // XAudio ver2.7, user need install DirectX Runtime
-        Level_XAudio2_7,
-        // XAudio ver2.8, system component in Windows 8
-        Level_XAudio2_8,
-        // XAudio ver2.9, system component in Windows 10
-        Level_XAudio2_9,
-        // [invalid yet]Open Audio Lib, user need install openal-runtime
-        Level_OpenAL,
-        // [invalid yet]Direct Sound in early sdk
-        Level_DirectSound,
-    };
+    // decode pool
+    class CALDecodePool;
+    // voice pool
+    class CALPooledVoice;
     // get api level string
     auto GetApiLevelString(APILevel) noexcept -> const char*;
 #ifdef WRAPAL_INCLUDE_DEFAULT_AUDIO_STREAM
@@ -73,6 +62,10 @@ namespace WrapAL {
         friend class CALAudioSourceClip;
         // friend class
         friend class CALDefConfigure;
+        // friend class
+        friend class CALAudioSourceClipImpl;
+        // friend function
+        friend void TerminateClipAnyway(ALHandle clip_id) noexcept;
     public:
         // get version
         auto GetVersion() const noexcept -> const char* { return "0.3.0"; }
@@ -104,14 +97,24 @@ namespace WrapAL {
         APILevel                    m_lvAPI = APILevel::Level_Unknown;
     public: // Audio Clip
         // create new clip with audio stream
-        auto CreateClip(XALAudioStream*, AudioClipFlag, const char* group_name) noexcept ->ALHandle;
+        auto CreateClip(XALAudioStream*, AudioClipFlag, const CALAudioSourceGroup& group) noexcept ->ALHandle;
         // create new clip with file stream
-        auto CreateClip(EncodingFormat, IALFileStream*, AudioClipFlag, const char* group_name) noexcept ->ALHandle;
+        auto CreateClip(EncodingFormat, IALFileStream*, AudioClipFlag, const CALAudioSourceGroup& group) noexcept ->ALHandle;
         // create new clip with file name
-        auto CreateClip(EncodingFormat, const wchar_t*, AudioClipFlag, const char* group_name) noexcept ->ALHandle;
+        auto CreateClip(EncodingFormat, const wchar_t*, AudioClipFlag, const CALAudioSourceGroup& group) noexcept ->ALHandle;
         // create new clip in memory
-        auto CreateClip(const AudioFormat&, const uint8_t*, size_t, AudioClipFlag, const char* group_name) noexcept ->ALHandle;
+        auto CreateClip(const AudioFormat&, const uint8_t*, size_t, AudioClipFlag, const CALAudioSourceGroup& group) noexcept ->ALHandle;
         // create new clip in memory
+        auto CreateClip(const AudioFormat&, uint8_t*&&, size_t, AudioClipFlag, const CALAudioSourceGroup& group) noexcept ->ALHandle;
+        // create new clip with audio stream, top-level group created by name if not found
+        auto CreateClip(XALAudioStream*, AudioClipFlag, const char* group_name) noexcept ->ALHandle;
+        // create new clip with file stream, top-level group created by name if not found
+        auto CreateClip(EncodingFormat, IALFileStream*, AudioClipFlag, const char* group_name) noexcept ->ALHandle;
+        // create new clip with file name, top-level group created by name if not found
+        auto CreateClip(EncodingFormat, const wchar_t*, AudioClipFlag, const char* group_name) noexcept ->ALHandle;
+        // create new clip in memory, top-level group created by name if not found
+        auto CreateClip(const AudioFormat&, const uint8_t*, size_t, AudioClipFlag, const char* group_name) noexcept ->ALHandle;
+        // create new clip in memory, top-level group created by name if not found
         auto CreateClip(const AudioFormat&, uint8_t*&&, size_t, AudioClipFlag, const char* group_name) noexcept ->ALHandle;
     private: // Audio Clip
 #ifdef WRAPAL_IN_PLAN
@@ -136,6 +139,10 @@ namespace WrapAL {
         bool ac_pause(ALHandle clip_id) noexcept;
         // stop the clip
         bool ac_stop(ALHandle clip_id) noexcept { this->ac_pause(clip_id); return this->ac_seek(clip_id, 0.0f); }
+        // play the clip on sample time of engine clock
+        bool ac_play_at(ALHandle clip_id, uint64_t time) noexcept;
+        // stop and rewind the clip on sample time of engine clock
+        bool ac_stop_at(ALHandle clip_id, uint64_t time) noexcept;
         // seek the clip with time in sec.
         bool ac_seek(ALHandle clip_id, float) noexcept;
         // tell the postion of clip in sec.
@@ -146,25 +153,122 @@ namespace WrapAL {
         auto ac_volume(ALHandle clip_id, float = -1.f) noexcept ->float;
         // set or get ratio of clip
         auto ac_ratio(ALHandle clip_id, float ratio) noexcept -> float;
+        // set size/count of streaming buffer for streaming clip
+        bool ac_streaming(ALHandle clip_id, uint32_t size, uint32_t count) noexcept;
+        // fade volume of clip to target in sec., advanced in Update
+        bool ac_fade(ALHandle clip_id, float volume, float time) noexcept;
+        // get group of clip
+        auto ac_group(ALHandle clip_id) noexcept ->ALHandle;
+        // set or get priority of clip, 0~255, higher is more important
+        auto ac_priority(ALHandle clip_id, int32_t priority = -1) noexcept ->int32_t;
+        // set or get attenuation(distance gain) of clip for voice budget
+        auto ac_attenuation(ALHandle clip_id, float attenuation = -1.f) noexcept ->float;
+        // is the clip virtual(voice released)
+        bool ac_virtual(ALHandle clip_id) noexcept;
+        // get count of streaming buffer underruns of clip
+        auto ac_underruns(ALHandle clip_id) noexcept ->uint32_t;
     public: // Master
         // set or get master volume
         auto Volume(float volume=-1.f) noexcept -> float;
+        // get format of master mix, always IEEE float
+        auto GetOutputFormat() noexcept ->AudioFormat;
+        // get sample time of engine clock: frames of master mix at start of current pass
+        auto GetSampleTime() const noexcept ->uint64_t;
+        // get performance data, counters cumulative since Initialize, lock-free
+        void GetPerformanceData(AudioPerformanceData& data) noexcept;
+    public: // Batch
+        // begin batch in this thread, nestable: control of clips/groups is collected until CommitBatch
+        void BeginBatch() noexcept;
+        // commit batch in this thread, changes of it run in the same processing pass, false if some ran out of batch for OOM
+        bool CommitBatch() noexcept;
+    public: // Voice Pool
+        // create source voices of format in advance, recycled voices of it kept up to count, Flag_3D voices differ
+        auto PrewarmVoices(const AudioFormat& format, uint32_t count, AudioClipFlag flags = Flag_None) noexcept ->ECode;
+    public: // 3D
+        // set single listener of 3D audio, Flag_3D clips output to their groups
+        void SetListener(const AudioListener3D& listener) noexcept;
+        // set listeners(up to Listener3DMaxCount) of 3D audio, each panned to own output group, single listener if null outputs
+        auto SetListeners(const AudioListener3D listeners[], const CALAudioSourceGroup outputs[], uint32_t count) noexcept ->ECode;
+        // set settings of 3D audio, curves and cones copied, E_INVALIDARG for bad curve
+        auto Set3DSettings(const Audio3DSettings& settings) noexcept ->ECode;
+        // set group that 3D clips send reverb to, top-level for none
+        void Set3DReverbGroup(const CALAudioSourceGroup& group) noexcept;
+        // calculate emitters in SoA and apply to Flag_3D clips of them, return count applied
+        auto Update3D(const AudioEmitters3D& emitters) noexcept ->uint32_t;
+        // render Flag_3D clips binaurally with HRTF set file, up to "sources" clips, speaker panning if 0 sources
+        auto SetHRTF(const wchar_t* file_name, uint32_t sources) noexcept ->ECode;
+        // render Flag_3D clips binaurally with HRTF set stream(not released), speaker panning if null or 0 sources
+        auto SetHRTF(IALStream* stream, uint32_t sources) noexcept ->ECode;
+        // mix Flag_3D clips in ambisonic bus of order(1-3), decoded once to speakers or binaurally if HRTF set, panning each if 0
+        auto SetAmbisonic(uint32_t order) noexcept ->ECode;
+        // premix Flag_3D clips at "distance" or farther into "count" clusters by direction, spatialise clusters only, none if 0
+        auto Set3DClusters(uint32_t count, float distance) noexcept ->ECode;
+    public: // Offline
+        // render interleaved frames of master mix as fast as possible, Level_Offline only
+        auto RenderOffline(float* data, uint32_t frames) noexcept ->ECode;
+        // render frames of master mix to file, WAV(IEEE float) or raw float, Level_Offline only
+        auto RenderOffline(const wchar_t* file_name, uint32_t frames, bool wav = true) noexcept ->ECode;
     public: // Group
-        // find group by group name
+        // find group by group name, top-level if not found
         auto GetGroup(const char* name) noexcept ->CALAudioSourceGroup;
+        // create top-level group, output to master; the existing one if name used, top-level if used by a child group
+        auto CreateGroup(const char* name) noexcept ->CALAudioSourceGroup;
+        // create group output to parent group; the existing one if name used, top-level if failed or used under other parent
+        auto CreateGroup(const char* name, const CALAudioSourceGroup& parent) noexcept ->CALAudioSourceGroup;
+        // create group with own channels and sample rate(0 for parent's), mixed at the rate then converted to parent;
+        // the existing one if name used with same parent and format, top-level if not
+        auto CreateGroup(const char* name, const CALAudioSourceGroup& parent, uint32_t channels, uint32_t rate) noexcept ->CALAudioSourceGroup;
     private:
         // get group name
         auto ag_name(ALHandle group_id) const noexcept -> const char*;
+        // get parent group, ALInvalidHandle for master
+        auto ag_parent(ALHandle group_id) const noexcept ->ALHandle;
+        // pause playing clips of group and children in one command, all clips if top-level
+        void ag_pause_all(ALHandle group_id) noexcept;
+        // play clips paused by ag_pause_all in one command
+        void ag_resume_all(ALHandle group_id) noexcept;
+        // stop and rewind clips of group and children in one command
+        void ag_stop_all(ALHandle group_id) noexcept;
+        // call with handle of each clip of group and children in caller thread, return count
+        auto ag_foreach(ALHandle group_id, void(*call)(ALHandle, void*), void* data) noexcept ->uint32_t;
         // get/set group volume
         auto ag_volume(ALHandle group_id, float volume = -1.f) noexcept -> float;
+        // set/get max count of real voices of group, 0 for no limit; engine's if top-level
+        auto ag_budget(ALHandle group_id, int32_t budget = -1) noexcept -> int32_t;
+        // set chain of built-in effects of group, master's if top-level, count 0 to remove
+        auto ag_effect_chain(ALHandle group_id, const EffectType list[], uint32_t count) noexcept ->ECode;
+        // publish parameters of effect in chain, audio thread never blocked
+        bool ag_effect_set(ALHandle group_id, uint32_t index, EffectType type, const void* param) noexcept;
+        // enable or bypass effect in chain, audio thread never blocked
+        bool ag_effect_enable(ALHandle group_id, uint32_t index, bool enable) noexcept;
     private:
         // find group by group name
         auto find_group(const char* name) noexcept ->AudioSourceGroupImpl*;
-        // set clip group
-        auto set_clip_group(CALAudioSourceClipImpl& clip, const char* group) noexcept ->ECode;
+        // find group by name for clips, or create top-level one
+        auto clip_group(const char* name) noexcept ->CALAudioSourceGroup;
+        // create group with name under parent, null parent for master, existing one returned if name used with same parent and format
+        auto create_group(const char* name, AudioSourceGroupImpl* parent, uint32_t channels = 0, uint32_t rate = 0) noexcept ->AudioSourceGroupImpl*;
+        // set clip group, null for top-level
+        auto set_clip_group(CALAudioSourceClipImpl& clip, AudioSourceGroupImpl* group) noexcept ->ECode;
     private: 
         // create source void
-        auto create_source_voice(CALAudioSourceClipImpl& clip, const char* group_name) noexcept ->ECode;
+        auto create_source_voice(CALAudioSourceClipImpl& clip, AudioSourceGroupImpl* group) noexcept ->ECode;
+        // get decode pool for streaming
+        auto decode_pool() noexcept ->CALDecodePool&;
+        // clip played to the end, in audio thread
+        void end_clip(CALAudioSourceClipImpl& clip) noexcept;
+        // find clip by handle and add ref-count, null if handle is stale or released by user
+        auto acquire_clip(ALHandle clip_id) const noexcept ->CALAudioSourceClipImpl*;
+        // get engine clock in sec., virtual clips advance by it
+        auto clock_sec() const noexcept ->double;
+        // register clip into handle table, set clip.handle
+        auto register_clip(CALAudioSourceClipImpl& clip) noexcept ->ALHandle;
+        // unregister clip from handle table
+        void unregister_clip(CALAudioSourceClipImpl& clip) noexcept;
+        // recycle voice of clip to voice pool
+        void recycle_voice(CALPooledVoice& voice) noexcept;
+        // retire memory read by flushed buffers of recycled voice(null for voice recycled before)
+        void retire_memory(CALPooledVoice* voice, void* data) noexcept;
     public:
         // now config
         IALConfigure*   const   configure = nullptr;
@@ -184,6 +288,8 @@ namespace WrapAL {
         static void FormatErrorFoF(wchar_t err_buf[], const char* func_name, const wchar_t* file_name) noexcept;
         // format error with out of memory
         static void FormatErrorOOM(wchar_t err_buf[], const char* func_name) noexcept;
+        // format error of group with name
+        static void FormatErrorGroup(wchar_t err_buf[], const char* func_name, RuntimeMessage msg, const char* name) noexcept;
     public: // output helper
         // output error with hr code
         inline auto OutputErrorHR(const char* func_name, ECode hr) noexcept {
@@ -203,6 +309,12 @@ namespace WrapAL {
             this->FormatErrorOOM(err_buf,func_name); 
             this->configure->OutputError(err_buf);
         }
+        // output error of group with name
+        inline auto OutputErrorGroup(const char* func_name, RuntimeMessage msg, const char* name) noexcept {
+            wchar_t err_buf[ErrorInfoLength];
+            this->FormatErrorGroup(err_buf, func_name, msg, name);
+            this->configure->OutputError(err_buf);
+        }
         // output last error
         void OutputErrorLast(const char* func_name) noexcept;
     public:
@@ -40,6 +40,8 @@ namespace WrapAL {
 #define CheckHandle assert(m_handle != ALInvalidHandle && "this clip m_handle had been failed")
     // Audio Group Handle Class, managed by engine, don't care about the releasing
     class CALAudioSourceGroup {
+        // friend class
+        friend class CALAudioEngine;
     public:
         // ctor
         CALAudioSourceGroup(ALHandle data) noexcept : m_handle(data) {};
@@ -58,12 +60,58 @@ namespace WrapAL {
         auto Name() const noexcept { return WrapALAudioEngine.ag_name(m_handle); }
         // get/set group volume
         auto Volume(float volume = -1.f) const noexcept { return WrapALAudioEngine.ag_volume(m_handle, volume); }
+        // get/set max count of real voices, 0 for no limit
+        auto VoiceBudget(int32_t budget = -1) const noexcept { return WrapALAudioEngine.ag_budget(m_handle, budget); }
+        // get parent group, top-level for master
+        auto Parent() const noexcept { return CALAudioSourceGroup(WrapALAudioEngine.ag_parent(m_handle)); }
+        // pause playing clips of this and children, all clips if top-level, as one command
+        void PauseAll() const noexcept { WrapALAudioEngine.ag_pause_all(m_handle); }
+        // play clips paused by PauseAll, as one command
+        void ResumeAll() const noexcept { WrapALAudioEngine.ag_resume_all(m_handle); }
+        // stop and rewind clips of this and children, as one command
+        void StopAll() const noexcept { WrapALAudioEngine.ag_stop_all(m_handle); }
+        // call(CALAudioSourceClip&) for each clip of this and children in this thread, return count
+        template<typename T> auto ForEach(T call) const noexcept ->uint32_t;
+        // set chain of built-in effects, master's if top-level, count 0 to remove
+        auto SetEffectChain(const EffectType list[], uint32_t count) const noexcept { return WrapALAudioEngine.ag_effect_chain(m_handle, list, count); }
+        // set chain of built-in effects, master's if top-level
+        template<uint32_t N> auto SetEffectChain(const EffectType (&list)[N]) const noexcept { return this->SetEffectChain(list, N); }
+        // set parameters of EQ at index of chain, false if type differs
+        auto SetEffect(uint32_t index, const EffectEQ& p) const noexcept { return WrapALAudioEngine.ag_effect_set(m_handle, index, EffectType::Effect_EQ, &p); }
+        // set parameters of compressor at index of chain, false if type differs
+        auto SetEffect(uint32_t index, const EffectCompressor& p) const noexcept { return WrapALAudioEngine.ag_effect_set(m_handle, index, EffectType::Effect_Compressor, &p); }
+        // set parameters of limiter at index of chain, false if type differs
+        auto SetEffect(uint32_t index, const EffectLimiter& p) const noexcept { return WrapALAudioEngine.ag_effect_set(m_handle, index, EffectType::Effect_Limiter, &p); }
+        // set parameters of reverb at index of chain, false if type differs
+        auto SetEffect(uint32_t index, const EffectReverb& p) const noexcept { return WrapALAudioEngine.ag_effect_set(m_handle, index, EffectType::Effect_Reverb, &p); }
+        // enable or bypass effect at index of chain
+        auto EnableEffect(uint32_t index, bool enable = true) const noexcept { return WrapALAudioEngine.ag_effect_enable(m_handle, index, enable); }
         // ----------------------------------------------------------------------------
 #ifdef WRAPAL_HADNLE_CLASS_WITH_LOWERCASE_METHOD
         // get group name
         auto name() const noexcept { return WrapALAudioEngine.ag_name(m_handle); }
         // get/set group volume
         auto volume(float volume = -1.f) const noexcept { return WrapALAudioEngine.ag_volume(m_handle, volume); }
+        // get/set max count of real voices, 0 for no limit
+        auto voice_budget(int32_t budget = -1) const noexcept { return WrapALAudioEngine.ag_budget(m_handle, budget); }
+        // get parent group, top-level for master
+        auto parent() const noexcept { return CALAudioSourceGroup(WrapALAudioEngine.ag_parent(m_handle)); }
+        // pause playing clips of this and children, all clips if top-level, as one command
+        void pause_all() const noexcept { WrapALAudioEngine.ag_pause_all(m_handle); }
+        // play clips paused by pause_all, as one command
+        void resume_all() const noexcept { WrapALAudioEngine.ag_resume_all(m_handle); }
+        // stop and rewind clips of this and children, as one command
+        void stop_all() const noexcept { WrapALAudioEngine.ag_stop_all(m_handle); }
+        // call(CALAudioSourceClip&) for each clip of this and children in this thread, return count
+        template<typename T> auto for_each(T call) const noexcept { return this->ForEach(call); }
+        // set chain of built-in effects, master's if top-level, count 0 to remove
+        auto set_effect_chain(const EffectType list[], uint32_t count) const noexcept { return this->SetEffectChain(list, count); }
+        // set chain of built-in effects, master's if top-level
+        template<uint32_t N> auto set_effect_chain(const EffectType (&list)[N]) const noexcept { return this->SetEffectChain(list, N); }
+        // set parameters of effect at index of chain, false if type differs
+        template<typename T> auto set_effect(uint32_t index, const T& param) const noexcept { return this->SetEffect(index, param); }
+        // enable or bypass effect at index of chain
+        auto enable_effect(uint32_t index, bool enable = true) const noexcept { return this->EnableEffect(index, enable); }
 #endif
     private:
         // m_handle for this
@@ -75,8 +123,6 @@ namespace WrapAL {
         void safe_release() noexcept { if (*this) WrapALAudioEngine.ac_release(m_handle); }
         // safe add ref
         void safe_addref() noexcept { if (*this) WrapALAudioEngine.ac_addref(m_handle); }
-        // operatr ->
-        auto operator ->() const noexcept { CheckHandle; return reinterpret_cast<const CALAudioSourceClipImpl*>(m_handle); }
     public:
         // copy ctor
         CALAudioSourceClip(const CALAudioSourceClip& clip) noexcept : m_handle(clip.m_handle) { 
@@ -120,6 +166,10 @@ namespace WrapAL {
         auto Stop() const noexcept { CheckHandle; return WrapALAudioEngine.ac_stop(m_handle); }
         // Pause this clip
         auto Pause() const noexcept { CheckHandle; return WrapALAudioEngine.ac_pause(m_handle); }
+        // play this clip on sample time of engine clock, sample-accurate
+        auto PlayAt(uint64_t time) const noexcept { CheckHandle; return WrapALAudioEngine.ac_play_at(m_handle, time); }
+        // stop and rewind this clip on sample time of engine clock, sample-accurate
+        auto StopAt(uint64_t time) const noexcept { CheckHandle; return WrapALAudioEngine.ac_stop_at(m_handle, time); }
         // tell this clip in sec.
         auto Tell() const noexcept { CheckHandle; return WrapALAudioEngine.ac_tell(m_handle); }
         // get the duration in sec.
@@ -130,10 +180,22 @@ namespace WrapAL {
         auto Ratio(float ratio = -1.f) const noexcept { CheckHandle; return WrapALAudioEngine.ac_ratio(m_handle, ratio); }
         // Seek this clip in sec.
         auto Seek(float time) const noexcept { CheckHandle; return WrapALAudioEngine.ac_seek(m_handle, time); }
+        // set size(in byte)/count of streaming buffer, streaming clip only
+        auto SetStreamingBuffer(uint32_t size, uint32_t count) const noexcept { CheckHandle; return WrapALAudioEngine.ac_streaming(m_handle, size, count); }
+        // fade volume to target in sec., need CALAudioEngine::Update
+        auto FadeTo(float volume, float time) const noexcept { CheckHandle; return WrapALAudioEngine.ac_fade(m_handle, volume, time); }
+        // set/get priority for voice budget, 0~255, higher is more important
+        auto Priority(int32_t priority = -1) const noexcept { CheckHandle; return WrapALAudioEngine.ac_priority(m_handle, priority); }
+        // set/get attenuation(distance gain) for voice budget
+        auto Attenuation(float attenuation = -1.f) const noexcept { CheckHandle; return WrapALAudioEngine.ac_attenuation(m_handle, attenuation); }
+        // is virtual(voice released, position still advancing)
+        auto IsVirtual() const noexcept { CheckHandle; return WrapALAudioEngine.ac_virtual(m_handle); }
+        // count of streaming buffer underruns, 0 if not streaming
+        auto Underruns() const noexcept { CheckHandle; return WrapALAudioEngine.ac_underruns(m_handle); }
         // ----------------------------------------------------------------------------
 #ifdef WRAPAL_HADNLE_CLASS_WITH_LOWERCASE_METHOD
         // get group
-        auto group() const noexcept { return CALAudioSourceGroup(m_handle ? reinterpret_cast<ALHandle>((*this)->group) : ALInvalidHandle); }
+        auto group() const noexcept { return CALAudioSourceGroup(WrapALAudioEngine.ac_group(m_handle)); }
         // destroy this clip, free the memory in engine
         auto destroy() noexcept { CheckHandle; WrapALAudioEngine.ac_destroy(m_handle);  (m_handle) = ALInvalidHandle; }
         // play this clip
@@ -142,6 +204,10 @@ namespace WrapAL {
         auto stop() const noexcept { CheckHandle; return WrapALAudioEngine.ac_stop(m_handle); }
         // Pause this clip
         auto pause() const noexcept { CheckHandle; return WrapALAudioEngine.ac_pause(m_handle); }
+        // play this clip on sample time of engine clock, sample-accurate
+        auto play_at(uint64_t time) const noexcept { CheckHandle; return WrapALAudioEngine.ac_play_at(m_handle, time); }
+        // stop and rewind this clip on sample time of engine clock, sample-accurate
+        auto stop_at(uint64_t time) const noexcept { CheckHandle; return WrapALAudioEngine.ac_stop_at(m_handle, time); }
         // tell this clip in sec.
         auto tell() const noexcept { CheckHandle; return WrapALAudioEngine.ac_tell(m_handle); }
         // get the duration in sec.
@@ -152,11 +218,32 @@ namespace WrapAL {
         auto ratio(float ratio = -1.f) const noexcept { CheckHandle; return WrapALAudioEngine.ac_ratio(m_handle, ratio); }
         // Seek this clip in sec.
         auto seek(float time) const noexcept { CheckHandle; return WrapALAudioEngine.ac_seek(m_handle, time); }
+        // set size(in byte)/count of streaming buffer, streaming clip only
+        auto set_streaming_buffer(uint32_t size, uint32_t count) const noexcept { CheckHandle; return WrapALAudioEngine.ac_streaming(m_handle, size, count); }
+        // fade volume to target in sec., need CALAudioEngine::Update
+        auto fade_to(float volume, float time) const noexcept { CheckHandle; return WrapALAudioEngine.ac_fade(m_handle, volume, time); }
+        // set/get priority for voice budget, 0~255, higher is more important
+        auto priority(int32_t priority = -1) const noexcept { CheckHandle; return WrapALAudioEngine.ac_priority(m_handle, priority); }
+        // set/get attenuation(distance gain) for voice budget
+        auto attenuation(float attenuation = -1.f) const noexcept { CheckHandle; return WrapALAudioEngine.ac_attenuation(m_handle, attenuation); }
+        // is virtual(voice released, position still advancing)
+        auto is_virtual() const noexcept { CheckHandle; return WrapALAudioEngine.ac_virtual(m_handle); }
+        // count of streaming buffer underruns, 0 if not streaming
+        auto underruns() const noexcept { CheckHandle; return WrapALAudioEngine.ac_underruns(m_handle); }
 #endif
     private:
         // m_handle for this
         ALHandle                m_handle;
     };
+    // call(CALAudioSourceClip&) for each clip of this and children in this thread, return count
+    template<typename T> inline auto CALAudioSourceGroup::ForEach(T call) const noexcept -> uint32_t {
+        return WrapALAudioEngine.ag_foreach(m_handle, [](ALHandle id, void* data) noexcept {
+            // 过期句柄
+            if (!WrapALAudioEngine.ac_addref(id)) return;
+            CALAudioSourceClip clip(id);
+            (*reinterpret_cast<T*>(data))(clip);
+        }, &call);
+    }
     // create new clip with audio stream wrapped function
     // if using streaming audio, do not release the stream, this clip will do it
     inline auto CreateAudioClip(XALAudioStream* stream, AudioClipFlag flags = Flag_None, const char* group = "BGM") noexcept {
@@ -186,4 +273,22 @@ namespace WrapAL {
         }
         return (CALAudioSourceClip(clip));
     }
+    // create new clip with audio stream in group wrapped function
+    // if using streaming audio, do not release the stream, this clip will do it
+    inline auto CreateAudioClip(XALAudioStream* stream, AudioClipFlag flags, const CALAudioSourceGroup& group) noexcept {
+        return (CALAudioSourceClip(WrapALAudioEngine.CreateClip(stream, flags, group)));
+    }
+    // create new clip with file name in group wrapped function
+    inline auto CreateAudioClip(EncodingFormat format, const wchar_t* name, AudioClipFlag flags, const CALAudioSourceGroup& group) noexcept {
+        return (CALAudioSourceClip(WrapALAudioEngine.CreateClip(format, name, flags, group)));
+    }
+    // create new clip with file stream in group wrapped function
+    inline auto CreateAudioClip(EncodingFormat format, IALFileStream* stream, AudioClipFlag flags, const CALAudioSourceGroup& group) noexcept {
+        return (CALAudioSourceClip(WrapALAudioEngine.CreateClip(format, stream, flags, group)));
+    }
+    // create new clip in memory in group wrapped function
+    // for this, can't be in streaming mode
+    inline auto CreateAudioClip(const AudioFormat& format, const uint8_t* src, size_t size, AudioClipFlag flags, const CALAudioSourceGroup& group) noexcept {
+        return (CALAudioSourceClip(WrapALAudioEngine.CreateClip(format, src, size, flags, group)));
+    }
 }
\ No newline at end of file
@@ -68,6 +68,10 @@ namespace WrapAL {
         virtual auto SmallAlloc(size_t length) noexcept ->void* = 0;
         // free space that alloced via "SmallAlloc"
         virtual auto SmallFree(void* address) noexcept ->void = 0;
+        // choose api level, return Level_Unknown to try XAudio2 first and fall back to the software mixer; XAudio2 only by default
+        virtual auto ChooseAPILevel() noexcept ->APILevel { return APILevel::Level_XAudio2_8; }
+        // choose output latency for software mixer, ignored by XAudio2/OpenAL; unchanged(default) by default
+        virtual auto ChooseLatency(AudioLatency& latency) noexcept ->void { }
         // choose device, return index, if out of range, choose default device
         virtual auto ChooseDevice(
             const AudioDeviceInfo devices[/*count*/], 
@@ -83,6 +87,8 @@ namespace WrapAL {
         virtual auto GetRuntimeMessage(RuntimeMessage msg) noexcept ->const wchar_t* = 0;
         // get the "libmpg123.dll" path
         virtual auto GetLibmpg123Path(wchar_t path[/*MAX_PATH*/]) noexcept ->void = 0;
+        // clip played to the end, called in CALAudioEngine::Update before auto-destroying; nothing by default
+        virtual auto OnClipEnd(ALHandle clip) noexcept ->void { }
     public:
         // small alloc helper
         template<typename T> inline auto SmallAlloc() noexcept {
@@ -68,6 +68,32 @@ namespace WrapAL {
         // fixed buffer
         T           m_buffer[LEN];
     };
+    // statistics of default small allocator
+    struct SmallAllocStats {
+        // count of size classes
+        enum : uint32_t { CLASS_COUNT = 12 };
+        // size class
+        struct Class {
+            // object size in byte
+            uint32_t    size;
+            // count of slabs
+            uint32_t    slabs;
+            // count of objects out of slabs, in use or cached in threads
+            uint32_t    objects;
+            // count of batches moved to thread caches
+            uint32_t    refills;
+        };
+        // slab size in byte
+        uint32_t        slab_size;
+        // count of slabs
+        uint32_t        slabs;
+        // reserved memory in byte
+        size_t          reserved;
+        // used memory in byte, objects in use or cached in threads
+        size_t          used;
+        // each size class
+        Class           classes[CLASS_COUNT];
+    };
 #ifdef WRAPAL_INCLUDE_DEFAULT_CONFIGURE
     // default al configure
     class WRAPALAPI CALDefConfigure : public IALConfigure {
@@ -83,10 +109,14 @@ namespace WrapAL {
         virtual auto Release() noexcept ->uint32_t override { return 1; }
         // auto update? return true if you want and must undef "WRAPAL_SAME_THREAD_UPDATE"
         virtual auto IsAutoUpdate() noexcept ->bool override { return false; };
-        // alloc a small space less than 128-byte
+        // alloc a small space less than SmallSpaceThreshold, slab allocator with thread caches
         virtual void*SmallAlloc(size_t length) noexcept override;
         // free space that alloced via "SmallAlloc"
         virtual void SmallFree(void* address) noexcept override;
+        // choose api level, return Level_Unknown to try XAudio2 first and fall back to the software mixer
+        virtual auto ChooseAPILevel() noexcept ->APILevel override { return APILevel::Level_Unknown; }
+        // choose output latency, keep 0 for default
+        virtual auto ChooseLatency(AudioLatency&) noexcept ->void override { }
         // choose device, return index, if out of range, choose default device
         virtual auto ChooseDevice(const AudioDeviceInfo[], uint32_t count) noexcept ->uint32_t override { return count; };
         // create audio stream from file stream
@@ -99,6 +129,11 @@ namespace WrapAL {
         virtual auto GetRuntimeMessage(RuntimeMessage msg) noexcept ->const wchar_t* override { return BuildInMessageString[msg]; }
         // get the "libmpg123.dll" path on windows
         virtual void GetLibmpg123Path(wchar_t path[/*MAX_PATH*/]) noexcept;
+        // clip played to the end
+        virtual auto OnClipEnd(ALHandle) noexcept ->void override { }
+    public:
+        // get statistics of small allocator
+        static void GetSmallAllocStats(SmallAllocStats& stats) noexcept;
     private:
         // last error infomation
         wchar_t             m_szLastError[ErrorInfoLength];
@@ -91,8 +91,34 @@ namespace WrapAL {
         // wave format
         FormatWave  nFormatTag;
     };
+    // output latency, in microsecond, 0 for default
+    struct AudioLatency {
+        // period of each mixing pass
+        uint32_t    period;
+        // target latency of device buffer
+        uint32_t    latency;
+    };
     // CALAudioEngine
     class CALAudioEngine;
+    // API level
+    enum class APILevel : size_t {
+        // NO API, choose automatically when asked by IALConfigure
+        Level_Unknown = 0,
+        // XAudio ver2.7, user need install DirectX Runtime
+        Level_XAudio2_7,
+        // XAudio ver2.8, system component in Windows 8
+        Level_XAudio2_8,
+        // XAudio ver2.9, system component in Windows 10
+        Level_XAudio2_9,
+        // Open Audio Lib, user need install openal-runtime(OpenAL32.dll or OpenAL Soft)
+        Level_OpenAL,
+        // [invalid yet]Direct Sound in early sdk
+        Level_DirectSound,
+        // WrapAL built-in software mixer, no system component needed
+        Level_SoftwareMixer,
+        // WrapAL built-in software mixer without device, pulled by CALAudioEngine::RenderOffline
+        Level_Offline,
+    };
     // infomation for audio device
     struct AudioDeviceInfo {
         // name of device
@@ -124,8 +150,12 @@ namespace WrapAL {
         Flag_LoopInfinite = 1 << 1,
         // [AUTO-TASK] auto destroy if end of playing
         Flag_AutoDestroyEOP = 1 << 2,
-        // 3d audio
+        // 3d audio, positioned by CALAudioEngine::Update3D
         Flag_3D = 1 << 3,
+        // streaming decode priority: music, over ambience and one-shot
+        Flag_PriorityMusic = 1 << 4,
+        // streaming decode priority: ambience, over one-shot
+        Flag_PriorityAmbience = 1 << 5,
     };
     // operator for AudioClipFlag
     inline auto operator |(AudioClipFlag a, AudioClipFlag b) noexcept {
@@ -135,6 +165,229 @@ namespace WrapAL {
     inline auto&operator |=(AudioClipFlag& a, AudioClipFlag b) noexcept {
         return a = a | b;
     }
+    // built-in effect of group/master effect chain
+    enum class EffectType : uint32_t {
+        // biquad equalizer, EffectEQ
+        Effect_EQ = 0,
+        // compressor, EffectCompressor
+        Effect_Compressor,
+        // brickwall limiter, EffectLimiter
+        Effect_Limiter,
+        // algorithmic reverb, EffectReverb
+        Effect_Reverb,
+    };
+    // band type of EffectEQ
+    enum class EQBandType : uint32_t {
+        // bypassed
+        Band_Off = 0,
+        // peaking: gain around frequency
+        Band_Peak,
+        // low shelf: gain below frequency
+        Band_LowShelf,
+        // high shelf: gain above frequency
+        Band_HighShelf,
+        // low pass: cut above frequency, gain ignored
+        Band_LowPass,
+        // high pass: cut below frequency, gain ignored
+        Band_HighPass,
+    };
+    // band of EffectEQ
+    struct EffectEQBand {
+        // type of band
+        EQBandType  type;
+        // center/corner frequency in Hz
+        float       frequency;
+        // gain in dB
+        float       gain;
+        // quality factor, bandwidth of peak, slope of shelf/pass
+        float       q;
+    };
+    // parameters of EffectType::Effect_EQ, bands run in order
+    struct EffectEQ {
+        // count of bands
+        enum : uint32_t { BandCount = 4 };
+        // bands
+        EffectEQBand    bands[BandCount];
+    };
+    // parameters of EffectType::Effect_Compressor, channels linked
+    struct EffectCompressor {
+        // threshold in dB
+        float       threshold;
+        // ratio, 1 for no compression
+        float       ratio;
+        // width of soft knee in dB, 0 for hard knee
+        float       knee;
+        // attack time in ms
+        float       attack;
+        // release time in ms
+        float       release;
+        // makeup gain in dB
+        float       makeup;
+    };
+    // parameters of EffectType::Effect_Limiter, channels linked
+    struct EffectLimiter {
+        // ceiling of peak in dB
+        float       ceiling;
+        // release time in ms
+        float       release;
+    };
+    // parameters of EffectType::Effect_Reverb
+    struct EffectReverb {
+        // room size, 0~1
+        float       room_size;
+        // damping of high frequency, 0~1
+        float       damping;
+        // stereo width of wet signal, 0~1
+        float       width;
+        // level of wet signal, 0~1
+        float       wet;
+        // level of dry signal, 0~1
+        float       dry;
+    };
+    // 3D vector, left-handed like X3DAudio
+    struct Vector3F {
+        // x, y, z
+        float       x, y, z;
+    };
+    // sound cone of listener/emitters, angles in radian, on/within inner or on/beyond outer
+    struct AudioCone3D {
+        // full angle of inner cone, 0~2pi
+        float       inner_angle;
+        // full angle of outer cone, inner~2pi
+        float       outer_angle;
+        // volume scaler of inner cone, 0~2
+        float       inner_volume;
+        // volume scaler of outer cone, 0~2
+        float       outer_volume;
+        // LPF coefficient subtrahend of inner cone, 0~1
+        float       inner_lpf;
+        // LPF coefficient subtrahend of outer cone, 0~1
+        float       outer_lpf;
+        // reverb send scaler of inner cone, 0~2
+        float       inner_reverb;
+        // reverb send scaler of outer cone, 0~2
+        float       outer_reverb;
+    };
+    // point of distance curve
+    struct AudioCurvePoint3D {
+        // normalized distance(distance / curve scaler), 0~1, ascending
+        float       distance;
+        // DSP setting at the distance
+        float       value;
+    };
+    // piecewise linear distance curve, last value used beyond 1
+    struct AudioCurve3D {
+        // points, null for default curve
+        const AudioCurvePoint3D* points;
+        // count of points, 2~Curve3DMaxPoints
+        uint32_t    count;
+    };
+    // listener of 3D audio
+    struct AudioListener3D {
+        // position in world units
+        Vector3F    position;
+        // front direction, normalized
+        Vector3F    front;
+        // top direction, orthonormal with front
+        Vector3F    top;
+        // velocity in world units/sec., for doppler
+        Vector3F    velocity;
+    };
+    // what to calculate and apply in CALAudioEngine::Update3D
+    enum Audio3DFlag : uint32_t {
+        // output matrix of distance, cones and direction
+        Flag3D_Matrix = 1 << 0,
+        // doppler, scales frequency ratio of clip
+        Flag3D_Doppler = 1 << 1,
+        // low pass filter of direct path
+        Flag3D_LPFDirect = 1 << 2,
+        // low pass filter of reverb send, XAudio2 only
+        Flag3D_LPFReverb = 1 << 3,
+        // reverb send level, to group set by Set3DReverbGroup
+        Flag3D_Reverb = 1 << 4,
+        // never position to front center speaker
+        Flag3D_ZeroCenter = 1 << 16,
+        // equal mix of all source channels to LFE speaker
+        Flag3D_RedirectToLFE = 1 << 17,
+        // default flags
+        Flag3D_Default = Flag3D_Matrix | Flag3D_Doppler | Flag3D_LPFDirect | Flag3D_Reverb,
+    };
+    // settings of 3D calculation, copied by CALAudioEngine::Set3DSettings
+    struct Audio3DSettings {
+        // Audio3DFlag
+        uint32_t        flags;
+        // speed of sound in world units/sec., 343.5 for meter
+        float           speed_of_sound;
+        // doppler scaler, 0 to disable, 1 for physical
+        float           doppler_scaler;
+        // volume curve, default: 1/distance, no attenuation within curve scaler
+        AudioCurve3D    volume;
+        // direct LPF curve, default: [0, 1], [1, 0.75]
+        AudioCurve3D    lpf_direct;
+        // reverb LPF curve, default: [0, 0.75], [1, 0.75]
+        AudioCurve3D    lpf_reverb;
+        // reverb send curve, default: [0, 1], [1, 0]
+        AudioCurve3D    reverb;
+        // cone of listener, null for omnidirectional
+        const AudioCone3D* listener_cone;
+        // cone of emitters with front direction, null for omnidirectional
+        const AudioCone3D* emitter_cone;
+    };
+    // emitters of Flag_3D clips in SoA layout, optional arrays could be null
+    struct AudioEmitters3D {
+        // handles of clips, not Flag_3D ones skipped
+        const ALHandle* clips;
+        // position in world units
+        const float*    position_x, *position_y, *position_z;
+        // [optional] velocity in world units/sec., still if null
+        const float*    velocity_x, *velocity_y, *velocity_z;
+        // [optional] front direction for emitter cone, normalized, omnidirectional if null
+        const float*    front_x, *front_y, *front_z;
+        // [optional] scaler of normalized curve distance in world units, 1 if null
+        const float*    curve_scaler;
+        // [optional] spread to all speakers within this radius, 0 if null
+        const float*    inner_radius;
+        // [optional] radius of channels of multi-channel clip, 0 if null
+        const float*    channel_radius;
+        // [optional] occlusion 0 to 1, direct and reverb paths muffled, 0 if null
+        const float*    occlusion;
+        // [optional] obstruction 0 to 1, direct path muffled only, 0 if null
+        const float*    obstruction;
+        // count of emitters
+        uint32_t        count;
+    };
+    // performance data of engine, cumulative since Initialize, by CALAudioEngine::GetPerformanceData
+    struct AudioPerformanceData {
+        // decoding of a format
+        struct Decode {
+            // count of decoding calls
+            uint64_t    calls;
+            // time of decoding in microsecond
+            uint64_t    time;
+            // bytes of pcm decoded
+            uint64_t    bytes;
+        };
+        // decoding of each EncodingFormat, built-in streams only
+        Decode          decode[uint32_t(EncodingFormat::Format_UserDefined) + 1];
+        // count of processing passes of audio thread
+        uint64_t        passes;
+        // streaming buffer underruns of all clips
+        uint64_t        underruns;
+        // glitches reported by backend
+        uint64_t        glitches;
+        // bytes of pcm decoded, sum of decode
+        uint64_t        bytes_decoded;
+        // bytes read from files by default file stream
+        uint64_t        bytes_read;
+        // memory of clip buffers in byte, current
+        uint64_t        clip_memory;
+        // time of processing pass in microsecond
+        float           callback_min, callback_avg, callback_max, callback_p99;
+        // voices playing real, current
+        uint32_t        active_voices;
+        // clips virtualized without voice, current
+        uint32_t        virtual_voices;
+    };
     // safe release interface
     template<class T>
     auto SafeRelease(T*& pointer) noexcept {
@@ -72,18 +72,98 @@ namespace WrapAL {
         ErrorInfoLength = 1024,
         // each audio stream bucket size
         AudioStreamBucketSize = 32 * 1024,
-        // streaming buffer size
+        // streaming buffer size in defaultly
         StreamingBufferSize = 16 * 1024,
-        // streaming buffer count
+        // streaming buffer count in defaultly
         StreamingBufferCount = 3,
-        // group name max length in char, +1 for null-end character
-        GroupNameMaxLength = 15,
-        // group max size
-        GroupMaxSize = 8,
+        // streaming buffer min size
+        StreamingBufferMinSize = 1024,
+        // streaming buffer max count
+        StreamingBufferMaxCount = 16,
+        // decode thread count for streaming
+        DecodeThreadCount = 2,
+        // command queue length, power of 2
+        CommandQueueLength = 8192,
+        // auto-update thread: interval in ms
+        AutoUpdateInterval = 10,
+        // clip handle table: bits of slot index in ALHandle
+        ClipSlotIndexBits = 20,
+        // clip handle table: max count of clips
+        ClipSlotMaxCount = 1 << ClipSlotIndexBits,
+        // clip handle table: slots per chunk
+        ClipSlotChunkSize = 1024,
+        // voice pool: max count of formats
+        VoicePoolFormatCount = 16,
+        // voice pool: max count of free voices each format in defaultly
+        VoicePoolLength = 32,
+        // voice pool: recycled voice reused after passes
+        VoicePoolDelayPass = 2,
+        // voice virtualization: max count of real voices of engine in defaultly
+        RealVoiceBudget = 64,
+        // voice virtualization: default priority of clip, 0~255
+        ClipDefaultPriority = 128,
+        // scheduled playback: size of silence buffer for lead-in in byte
+        LeadInBufferSize = 16 * 1024,
+        // group: max depth of nested groups
+        GroupMaxDepth = 16,
+        // group: initial count of hash buckets, power of 2
+        GroupBucketCount = 16,
+        // effect: max count of effects in chain of each group/master
+        EffectChainMaxLength = 8,
+        // effect: frames of each block for compressor/limiter gain
+        EffectDynamicsBlock = 16,
+        // 3D: max channels of clip/output in 3D calculation
+        Spatial3DMaxChannels = 8,
+        // 3D: max points of each distance curve
+        Curve3DMaxPoints = 8,
+        // 3D: emitters applied to clips each lock of voices
+        Spatial3DBatch = 256,
+        // 3D: max count of clusters of distant clips
+        Cluster3DMaxCount = 64,
+        // 3D: max count of listeners
+        Listener3DMaxCount = 8,
+        // 3D: time of occlusion gain/LPF moving full range in ms.
+        Occlusion3DSmoothMs = 50,
+        // binaural: frames of each convolution block, also latency, power of 2
+        BinauralBlock = 256,
+        // binaural: sources(channels) of each bus voice, software mixer max
+        BinauralBusChannels = 8,
+        // binaural: max count of sources
+        BinauralMaxSources = 512,
+        // HRTF: max taps of each impulse response in file
+        HRTFMaxTaps = 4096,
+        // HRTF: max count of measurements in file
+        HRTFMaxMeasurements = 8192,
+        // ambisonic: max order of bus
+        AmbisonicMaxOrder = 3,
+        // ambisonic: max channels of bus, (order + 1)^2
+        AmbisonicMaxChannels = (AmbisonicMaxOrder + 1) * (AmbisonicMaxOrder + 1),
+        // ambisonic: virtual speakers on horizontal ring for decoding to speakers
+        AmbisonicRing = 16,
         // device max count
         DeviceMaxCount = 32,
         // small space threshold for IALConfigure::SmallAlloc/SmallFree
-        SmallSpaceThreshold = 128,
+        SmallSpaceThreshold = 256,
+        // small allocator: slab size, 64KB aligned as allocation granularity
+        SmallSlabSize = 64 * 1024,
+        // small allocator: max count of cached objects each size class each thread
+        SmallCacheLength = 32,
+        // software mixer: max channels of each voice
+        MixerMaxChannels = 8,
+        // software mixer: max output sends of each voice, listeners and reverb of 3D clip
+        MixerMaxSends = Listener3DMaxCount + 1,
+        // software mixer: default sample rate of mastering voice
+        MixerDefaultSampleRate = 48000,
+        // software mixer: quantum count per second, 10ms like XAudio2
+        MixerQuantumPerSecond = 100,
+        // software mixer: buffer count queued to output device
+        MixerOutputBufferCount = 3,
+        // software mixer: min period in frame
+        MixerMinPeriod = 32,
+        // OpenAL: polling interval of sources in ms
+        OpenALPollInterval = 5,
+        // OpenAL: request more data if less than this(in ms) queued
+        OpenALRefillThreshold = 40,
     };
     // message for runtime
     enum RuntimeMessage : unsigned int {
@@ -95,6 +175,10 @@ namespace WrapAL {
         Message_FileNotFound,
         // libmpg123 not found, 2-arguments[char*, wchar_t*]
         Message_NoLibmpg123,
+        // group name used with other parent or format, 2-arguments[char*, char*]
+        Message_GroupConflict,
+        // group nested deeper than GroupMaxDepth, 2-arguments[char*, char*]
+        Message_GroupTooDeep,
         // os before win8, XAudio2_7.dll only, 1-argument[char*]
 #ifdef WRAPAL_XAUDIO2_7_SUPPORT
         Message_NeedDxRuntime,
@@ -108,6 +192,8 @@ namespace WrapAL {
         L"<%S>: Out of memory",
         L"<%S>: file not found ---> %ls",
         L"<%S>: libmpg123 library not found ---> %ls",
+        L"<%S>: group '%S' exists with other parent or format",
+        L"<%S>: group '%S' nested deeper than GroupMaxDepth",
 #ifdef WRAPAL_XAUDIO2_7_SUPPORT
         L"<%S>: This app need dx-runtime, you should download 'directx_Jun2010_redist.exe' at first",
 #endif
@@ -16,6 +16,8 @@ load "#{PROJECT_ROOT}/3rdparty/3rdparty.rake"
 load "#{PROJECT_ROOT}/src/wrapal.rake"
 # demo
 load "#{PROJECT_ROOT}/demo/demo.rake"
+# test
+load "#{PROJECT_ROOT}/test/test.rake"
 
 
 # 榛樿rake
@@ -0,0 +1,542 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "Audio3D.h"
+#include "AudioSIMD.h"
+#include "p_X3DAudio.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+// spatial namespace
+namespace WrapAL { namespace spatial {
+    // 4 floats in a register, lanes of emitters
+    using simd::f4;
+    // load/store "n" lanes
+    using simd::load_lanes; using simd::store_lanes;
+    // pi
+    static constexpr float PI = X3DAUDIO_PI;
+    // 2pi
+    static constexpr float PI2 = X3DAUDIO_2PI;
+    // default curve of direct LPF
+    static const AudioCurvePoint3D DEFAULT_LPF_DIRECT[] = { { 0.f, 1.f }, { 1.f, 0.75f } };
+    // default curve of reverb LPF
+    static const AudioCurvePoint3D DEFAULT_LPF_REVERB[] = { { 0.f, 0.75f }, { 1.f, 0.75f } };
+    // default curve of reverb send
+    static const AudioCurvePoint3D DEFAULT_REVERB[] = { { 0.f, 1.f }, { 1.f, 0.f } };
+    // default channel mask of channels
+    static auto default_mask(uint32_t channels) noexcept -> uint32_t {
+        switch (channels)
+        {
+        case 1: return SPEAKER_MONO;
+        case 2: return SPEAKER_STEREO;
+        case 3: return SPEAKER_2POINT1;
+        case 4: return SPEAKER_QUAD;
+        case 5: return SPEAKER_4POINT1;
+        case 6: return SPEAKER_5POINT1;
+        case 7: return SPEAKER_5POINT1 | SPEAKER_BACK_CENTER;
+        default: return SPEAKER_7POINT1_SURROUND;
+        }
+    }
+    // atan2 of lanes, error less than 1e-5 radian
+    static inline auto atan2(f4 y, f4 x) noexcept {
+        const auto ax = x.abs(), ay = y.abs();
+        const auto a = f4::min(ax, ay) / f4::max(f4::max(ax, ay), f4::set(1e-30f));
+        const auto s = a * a;
+        auto r = (((((f4::set(-0.01172120f) * s + f4::set(0.05265332f)) * s + f4::set(-0.11643287f)) * s
+            + f4::set(0.19354346f)) * s + f4::set(-0.33262347f)) * s + f4::set(0.99997726f)) * a;
+        r = f4::select(f4::lt(ax, ay), f4::set(PI * 0.5f) - r, r);
+        r = f4::select(f4::lt(x, f4::set(0.f)), f4::set(PI) - r, r);
+        return r.flip(y.sign());
+    }
+    // cos(t * pi / 2) of lanes, t in [0, 1]
+    static inline auto cos_quarter(f4 t) noexcept {
+        const auto x = t * f4::set(PI * 0.5f);
+        const auto u = x * x;
+        return (((f4::set(1.f / 40320.f) * u - f4::set(1.f / 720.f)) * u
+            + f4::set(1.f / 24.f)) * u - f4::set(0.5f)) * u + f4::set(1.f);
+    }
+    // clamp lanes
+    static inline auto clamp(f4 x, float lo, float hi) noexcept {
+        return f4::min(f4::max(x, f4::set(lo)), f4::set(hi));
+    }
+    // lerp from a to b
+    static inline auto lerp(float a, float b, f4 t) noexcept {
+        return f4::set(a) + f4::set(b - a) * t;
+    }
+    // gain of ring speaker k for azimuth in [-pi, pi] of lanes, constant power with adjacent one
+    static inline auto ring_gain(const SpeakerLayout& layout, uint32_t k, f4 a) noexcept {
+        const auto zero = f4::set(0.f), one = f4::set(1.f);
+        if (layout.ring < 2) return one;
+        // 顺时针到此扬声器的角度, 逆时针的角度
+        auto dr = a - f4::set(layout.azimuth[k]);
+        dr = f4::select(f4::lt(dr, zero), dr + f4::set(PI2), dr);
+        const auto dl = f4::select(f4::lt(zero, dr), f4::set(PI2) - dr, zero);
+        const auto tr = (dr - f4::set(layout.hold_next[k])) * f4::set(layout.next[k]);
+        const auto tl = (dl - f4::set(layout.hold_prev[k])) * f4::set(layout.prev[k]);
+        const auto gr = f4::select(f4::lt(tr, one), spatial::cos_quarter(clamp(tr, 0.f, 1.f)), zero);
+        const auto gl = f4::select(f4::lt(tl, one), spatial::cos_quarter(clamp(tl, 0.f, 1.f)), zero);
+        return f4::max(gr, gl);
+    }
+    // output matrices of "n" emitters in lanes, "out" zeroed, [dst * src + s]
+    static void pan_lanes(const SpeakerLayout& layout, uint32_t src, bool lfe, uint32_t n, f4 center,
+        f4 width, f4 pan, const float volume[4], float* const out[4]) noexcept {
+        const auto zero = f4::set(0.f), one = f4::set(1.f), rest = one - pan;
+        const auto ring = layout.ring;
+        const auto uniform = f4::set(ring ? 1.f / std::sqrt(float(ring)) : 0.f);
+        const auto gain = f4::load(volume);
+        for (uint32_t s = 0; s != src; ++s) {
+            // 多声道: 均匀分布在 [-spread, spread]
+            auto a = center;
+            if (src > 1) a = a + width * f4::set(2.f * float(s) / float(src - 1) - 1.f);
+            a = f4::select(f4::lt(f4::set(PI), a), a - f4::set(PI2), a);
+            a = f4::select(f4::lt(a, f4::set(-PI)), a + f4::set(PI2), a);
+            f4 speaker[Spatial3DMaxChannels];
+            auto power = zero;
+            for (uint32_t k = 0; k != ring; ++k) {
+                const auto g = spatial::ring_gain(layout, k, a) * pan + uniform * rest;
+                speaker[k] = g;
+                power = power + g * g;
+            }
+            // 保持功率
+            const auto scale = gain / f4::max(power, f4::set(1e-12f)).sqrt();
+            for (uint32_t k = 0; k != ring; ++k) {
+                float lanes[4];
+                (speaker[k] * scale).store(lanes);
+                const auto offset = layout.index[k] * src + s;
+                for (uint32_t j = 0; j != n; ++j) out[j][offset] = lanes[j];
+            }
+            // 所有声道平均混合到 LFE
+            if (lfe) {
+                const auto offset = layout.lfe * src + s;
+                for (uint32_t j = 0; j != n; ++j) out[j][offset] = volume[j] / float(src);
+            }
+        }
+    }
+    // value of piecewise linear curve at normalized distance
+    template<typename T> static inline auto curve_at(const T& curve, f4 x) noexcept {
+        auto value = f4::set(curve.value[0]);
+        for (uint32_t i = 0; i + 1 < curve.count; ++i) {
+            const auto d = f4::set(curve.distance[i]);
+            const auto y = f4::set(curve.value[i]) +
+                (f4::min(x, f4::set(curve.distance[i + 1])) - d) * f4::set(curve.slope[i]);
+            value = f4::select(f4::le(d, x), y, value);
+        }
+        return value;
+    }
+    // apply cone, "cos" is cosine of angle between front of cone and direction
+    static inline void apply_cone(const AudioCone3D& cone, f4 cos,
+        f4& volume, f4& lpf_direct, f4& lpf_reverb, f4& reverb) noexcept {
+        const auto one = f4::set(1.f);
+        // 全角: 半角的两倍
+        const auto sin = f4::max(one - cos * cos, f4::set(0.f)).sqrt();
+        const auto angle = spatial::atan2(sin, cos) * f4::set(2.f);
+        const auto width = cone.outer_angle - cone.inner_angle;
+        const auto inner = f4::set(cone.inner_angle);
+        const auto t = width > 0.f
+            ? spatial::clamp((angle - inner) * f4::set(1.f / width), 0.f, 1.f)
+            : f4::select(f4::le(angle, inner), f4::set(0.f), one);
+        volume = volume * spatial::lerp(cone.inner_volume, cone.outer_volume, t);
+        const auto lpf = spatial::lerp(cone.inner_lpf, cone.outer_lpf, t);
+        lpf_direct = lpf_direct - lpf;
+        lpf_reverb = lpf_reverb - lpf;
+        reverb = reverb * spatial::lerp(cone.inner_reverb, cone.outer_reverb, t);
+    }
+}}
+
+/// <summary>
+/// Initializes the layout with channel mask.
+/// 初始化扬声器布局: 环上的扬声器按方位角排序
+/// </summary>
+/// <param name="ch">The channels.</param>
+/// <param name="mask">The mask, default mask of channels if 0.</param>
+/// <param name="zero_center">if set to <c>true</c> [never position to center].</param>
+/// <returns></returns>
+void WrapAL::spatial::SpeakerLayout::Init(uint32_t ch, uint32_t mask, bool zero_center) noexcept {
+    assert(ch && ch <= Spatial3DMaxChannels && "bad channels");
+    if (!mask) mask = spatial::default_mask(ch);
+    this->channels = ch;
+    this->ring = 0;
+    this->lfe = ch;
+    // 有侧置时后置更靠后
+    const bool side = !!(mask & (SPEAKER_SIDE_LEFT | SPEAKER_SIDE_RIGHT));
+    const float back = side ? PI * 5.f / 6.f : PI * 11.f / 18.f;
+    uint32_t center = ch, channel = 0;
+    for (uint32_t bit = 0; bit != 32 && channel != ch; ++bit) {
+        const uint32_t speaker = 1u << bit;
+        if (!(mask & speaker)) continue;
+        float angle = 0.f;
+        bool on_ring = true;
+        switch (speaker)
+        {
+        case SPEAKER_FRONT_LEFT:            angle = -PI / 6.f; break;
+        case SPEAKER_FRONT_RIGHT:           angle = PI / 6.f; break;
+        case SPEAKER_FRONT_CENTER:          center = channel; break;
+        case SPEAKER_LOW_FREQUENCY:         this->lfe = channel; on_ring = false; break;
+        case SPEAKER_BACK_LEFT:             angle = -back; break;
+        case SPEAKER_BACK_RIGHT:            angle = back; break;
+        case SPEAKER_FRONT_LEFT_OF_CENTER:  angle = -PI / 12.f; break;
+        case SPEAKER_FRONT_RIGHT_OF_CENTER: angle = PI / 12.f; break;
+        case SPEAKER_BACK_CENTER:           angle = PI; break;
+        case SPEAKER_SIDE_LEFT:             angle = -PI / 2.f; break;
+        case SPEAKER_SIDE_RIGHT:            angle = PI / 2.f; break;
+        // 顶部扬声器不在环上
+        default:                            on_ring = false; break;
+        }
+        if (on_ring) {
+            this->index[this->ring] = channel;
+            this->azimuth[this->ring] = angle;
+            ++this->ring;
+        }
+        ++channel;
+    }
+    // 不定位到中置, 仅在还有其他扬声器时
+    if (zero_center && center != ch && this->ring > 1) {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i != this->ring; ++i) {
+            if (this->index[i] == center) continue;
+            this->index[count] = this->index[i];
+            this->azimuth[count] = this->azimuth[i];
+            ++count;
+        }
+        this->ring = count;
+    }
+    // 按方位角排序
+    for (uint32_t i = 1; i < this->ring; ++i) {
+        const auto a = this->azimuth[i];
+        const auto c = this->index[i];
+        uint32_t j = i;
+        for (; j && this->azimuth[j - 1] > a; --j) {
+            this->azimuth[j] = this->azimuth[j - 1];
+            this->index[j] = this->index[j - 1];
+        }
+        this->azimuth[j] = a;
+        this->index[j] = c;
+    }
+    // 相邻扬声器的间隔, 超过 pi 时(如立体声的后方)两端各保持一段, 中间 pi 交叉淡化
+    for (uint32_t i = 0; i != this->ring; ++i) {
+        const auto n = i + 1 != this->ring ? i + 1 : 0;
+        auto gap = this->azimuth[n] - this->azimuth[i];
+        if (gap <= 0.f) gap += PI2;
+        const auto hold = gap > PI ? (gap - PI) * 0.5f : 0.f;
+        this->next[i] = 1.f / (gap - hold * 2.f);
+        this->prev[n] = this->next[i];
+        this->hold_next[i] = hold;
+        this->hold_prev[n] = hold;
+    }
+}
+
+/// <summary>
+/// Gets constant power gains of direction on ring.
+/// </summary>
+/// <param name="azimuth">The azimuth.</param>
+/// <param name="gain">The gains, [channel], 0 for speakers not on ring.</param>
+/// <returns></returns>
+void WrapAL::spatial::SpeakerLayout::Gains(float azimuth, float* gain) const noexcept {
+    std::memset(gain, 0, sizeof(float) * this->channels);
+    const auto a = f4::set(std::remainder(azimuth, PI2));
+    float power = 0.f, ring_gain[Spatial3DMaxChannels];
+    for (uint32_t k = 0; k != this->ring; ++k) {
+        float lanes[4];
+        spatial::ring_gain(*this, k, a).store(lanes);
+        ring_gain[k] = lanes[0];
+        power += lanes[0] * lanes[0];
+    }
+    // 保持功率
+    const auto scale = 1.f / std::sqrt(std::max(power, 1e-12f));
+    for (uint32_t k = 0; k != this->ring; ++k) gain[this->index[k]] = ring_gain[k] * scale;
+}
+
+/// <summary>
+/// Calculates output matrix of one emitter, same as <see cref="CALSpatial3D::Pan"/>.
+/// </summary>
+/// <param name="azimuth">The azimuth.</param>
+/// <param name="focus">The focus.</param>
+/// <param name="spread">The spread.</param>
+/// <param name="volume">The volume.</param>
+/// <param name="src">The source channels.</param>
+/// <param name="lfe">if set to <c>true</c> [redirect to LFE].</param>
+/// <param name="matrix">The matrix, [dst * src + s].</param>
+/// <returns></returns>
+void WrapAL::spatial::SpeakerLayout::Pan(float azimuth, float focus, float spread,
+    float volume, uint32_t src, bool lfe, float* matrix) const noexcept {
+    assert(src && src <= Spatial3DMaxChannels && "bad channels");
+    std::memset(matrix, 0, sizeof(float) * src * this->channels);
+    const float lanes[4] = { volume, 0.f, 0.f, 0.f };
+    float* const out[4] = { matrix };
+    spatial::pan_lanes(*this, src, lfe && this->lfe < this->channels, 1,
+        f4::set(azimuth), f4::set(spread), f4::set(focus), lanes, out);
+}
+
+/// <summary>
+/// Initializes a new instance of the <see cref="CALSpatial3D"/> class.
+/// </summary>
+WrapAL::spatial::CALSpatial3D::CALSpatial3D() noexcept {
+    std::memset(m_aResult, 0, sizeof(m_aResult));
+    m_fSpeedOfSound = X3DAUDIO_SPEED_OF_SOUND;
+    AudioListener3D listener;
+    std::memset(&listener, 0, sizeof(listener));
+    listener.front.z = 1.f;
+    listener.top.y = 1.f;
+    this->SetListener(listener);
+    const AudioCurve3D none = { nullptr, 0 };
+    CALSpatial3D::set_curve(m_volume, none, nullptr);
+    CALSpatial3D::set_curve(m_lpfDirect, none, DEFAULT_LPF_DIRECT);
+    CALSpatial3D::set_curve(m_lpfReverb, none, DEFAULT_LPF_REVERB);
+    CALSpatial3D::set_curve(m_reverb, none, DEFAULT_REVERB);
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALSpatial3D"/> class.
+/// </summary>
+/// <returns></returns>
+WrapAL::spatial::CALSpatial3D::~CALSpatial3D() noexcept {
+    std::free(m_pBuffer);
+    m_pBuffer = nullptr;
+}
+
+/// <summary>
+/// Sets the listeners.
+/// </summary>
+/// <param name="listeners">The listeners.</param>
+/// <param name="count">The count, 1 to Listener3DMaxCount.</param>
+/// <returns></returns>
+void WrapAL::spatial::CALSpatial3D::SetListeners(const AudioListener3D listeners[], uint32_t count) noexcept {
+    assert(count && count <= Listener3DMaxCount && "bad count");
+    // 听者数量变化时结果失效
+    if (count != m_cListener) {
+        for (auto& r : m_aResult) r.count = 0;
+        m_cListener = count;
+    }
+    for (uint32_t l = 0; l != count; ++l) {
+        m_aListener[l] = listeners[l];
+        // 右方: 上方 x 前方, 左手坐标系
+        const auto& f = listeners[l].front;
+        const auto& t = listeners[l].top;
+        m_aRight[l].x = t.y * f.z - t.z * f.y;
+        m_aRight[l].y = t.z * f.x - t.x * f.z;
+        m_aRight[l].z = t.x * f.y - t.y * f.x;
+    }
+}
+
+/// <summary>
+/// Sets the curve, default points if null.
+/// </summary>
+/// <param name="curve">The curve.</param>
+/// <param name="from">From.</param>
+/// <param name="def">The default points, null for inverse distance.</param>
+/// <returns>false if invalid</returns>
+bool WrapAL::spatial::CALSpatial3D::set_curve(Curve& curve, const AudioCurve3D& from, const AudioCurvePoint3D* def) noexcept {
+    const auto points = from.points ? from.points : def;
+    const uint32_t count = from.points ? from.count : 2;
+    if (!points) { curve.count = 0; return true; }
+    // 从 0 到 1 递增
+    if (count < 2 || count > Curve3DMaxPoints) return false;
+    if (points[0].distance != 0.f || points[count - 1].distance != 1.f) return false;
+    for (uint32_t i = 1; i != count; ++i) {
+        if (!(points[i].distance > points[i - 1].distance)) return false;
+    }
+    for (uint32_t i = 0; i != count; ++i) {
+        curve.distance[i] = points[i].distance;
+        curve.value[i] = points[i].value;
+        curve.slope[i] = i + 1 != count ? (points[i + 1].value - points[i].value)
+            / (points[i + 1].distance - points[i].distance) : 0.f;
+    }
+    curve.count = count;
+    return true;
+}
+
+/// <summary>
+/// Sets the settings, curves and cones copied.
+/// 设置参数, 全部有效才生效
+/// </summary>
+/// <param name="settings">The settings.</param>
+/// <returns>false if invalid</returns>
+bool WrapAL::spatial::CALSpatial3D::SetSettings(const Audio3DSettings& settings) noexcept {
+    if (!(settings.speed_of_sound > 0.f) || !(settings.doppler_scaler >= 0.f)) return false;
+    Curve curves[4];
+    if (!CALSpatial3D::set_curve(curves[0], settings.volume, nullptr)) return false;
+    if (!CALSpatial3D::set_curve(curves[1], settings.lpf_direct, DEFAULT_LPF_DIRECT)) return false;
+    if (!CALSpatial3D::set_curve(curves[2], settings.lpf_reverb, DEFAULT_LPF_REVERB)) return false;
+    if (!CALSpatial3D::set_curve(curves[3], settings.reverb, DEFAULT_REVERB)) return false;
+    m_volume = curves[0];
+    m_lpfDirect = curves[1];
+    m_lpfReverb = curves[2];
+    m_reverb = curves[3];
+    m_uFlags = settings.flags;
+    m_fSpeedOfSound = settings.speed_of_sound;
+    m_fDopplerScaler = settings.doppler_scaler;
+    if ((m_bListenerCone = !!settings.listener_cone)) m_listenerCone = *settings.listener_cone;
+    if ((m_bEmitterCone = !!settings.emitter_cone)) m_emitterCone = *settings.emitter_cone;
+    return true;
+}
+
+/// <summary>
+/// Grows the results to count for each listener.
+/// 每个听者的结果数组排在同一块内存中
+/// </summary>
+/// <param name="count">The count.</param>
+/// <returns>false if OOM</returns>
+bool WrapAL::spatial::CALSpatial3D::reserve(uint32_t count) noexcept {
+    const auto listeners = m_cListener, total = count * listeners;
+    if (total > m_cCapacity) {
+        const auto capacity = std::max(total, m_cCapacity * 2);
+        // 一次申请全部数组
+        const auto ptr = reinterpret_cast<float*>(std::malloc(sizeof(float) * capacity * 10));
+        if (!ptr) return false;
+        std::free(m_pBuffer);
+        m_pBuffer = ptr;
+        m_cCapacity = capacity;
+    }
+    // 按本次数量划分
+    for (uint32_t l = 0; l != listeners; ++l) {
+        auto& r = m_aResult[l];
+        float** const arrays[] = {
+            &r.volume, &r.doppler, &r.lpf_direct, &r.lpf_reverb, &r.reverb,
+            &r.distance, &r.azimuth, &r.elevation, &r.focus, &r.spread,
+        };
+        for (uint32_t i = 0; i != 10; ++i) *arrays[i] = m_pBuffer + (i * listeners + l) * count;
+    }
+    return true;
+}
+
+/// <summary>
+/// Calculates DSP settings of emitters for each listener, 4 emitters in SIMD lanes.
+/// 计算发声体: 每次 4 个, SoA 读入一次, 对每个听者计算, SoA 输出
+/// </summary>
+/// <param name="e">The emitters.</param>
+/// <returns>false if OOM</returns>
+bool WrapAL::spatial::CALSpatial3D::Calculate(const AudioEmitters3D& e) noexcept {
+    assert(e.position_x && e.position_y && e.position_z && "bad argument");
+    for (auto& r : m_aResult) r.count = 0;
+    if (!this->reserve(e.count)) return false;
+    const auto zero = f4::set(0.f), one = f4::set(1.f), tiny = f4::set(1e-6f);
+    const bool doppler = (m_uFlags & Flag3D_Doppler) && m_fDopplerScaler > 0.f;
+    const bool emitter_cone = m_bEmitterCone && e.front_x && e.front_y && e.front_z;
+    const bool velocity = e.velocity_x && e.velocity_y && e.velocity_z;
+    const auto speed = f4::set(m_fSpeedOfSound);
+    // 速度分量不超过声速
+    const auto limit = f4::set(m_fSpeedOfSound * 0.99f);
+    const auto scaler = f4::set(-m_fDopplerScaler);
+    for (uint32_t i = 0; i < e.count; i += 4) {
+        const auto n = std::min(e.count - i, 4u);
+        // 发声体数据只读入一次
+        const auto px = load_lanes(e.position_x + i, n);
+        const auto py = load_lanes(e.position_y + i, n);
+        const auto pz = load_lanes(e.position_z + i, n);
+        const auto inner = e.inner_radius ? load_lanes(e.inner_radius + i, n) : zero;
+        const auto radius = e.channel_radius ? load_lanes(e.channel_radius + i, n) : zero;
+        const auto curve = e.curve_scaler ? f4::max(load_lanes(e.curve_scaler + i, n), tiny) : one;
+        f4 ex = zero, ey = zero, ez = zero, evx = zero, evy = zero, evz = zero;
+        if (emitter_cone) {
+            ex = load_lanes(e.front_x + i, n);
+            ey = load_lanes(e.front_y + i, n);
+            ez = load_lanes(e.front_z + i, n);
+        }
+        if (doppler && velocity) {
+            evx = load_lanes(e.velocity_x + i, n);
+            evy = load_lanes(e.velocity_y + i, n);
+            evz = load_lanes(e.velocity_z + i, n);
+        }
+        for (uint32_t l = 0; l != m_cListener; ++l) {
+            const auto& listener = m_aListener[l];
+            const auto& r = m_aResult[l];
+            // 听者 -> 发声体
+            const auto dx = px - f4::set(listener.position.x);
+            const auto dy = py - f4::set(listener.position.y);
+            const auto dz = pz - f4::set(listener.position.z);
+            const auto distance = (dx * dx + dy * dy + dz * dz).sqrt();
+            const auto valid = f4::lt(tiny, distance);
+            const auto inv = one / f4::max(distance, tiny);
+            // 听者空间: 右方与前方
+            const auto right = dx * f4::set(m_aRight[l].x) + dy * f4::set(m_aRight[l].y) + dz * f4::set(m_aRight[l].z);
+            const auto front = dx * f4::set(listener.front.x) + dy * f4::set(listener.front.y) + dz * f4::set(listener.front.z);
+            const auto top = dx * f4::set(listener.top.x) + dy * f4::set(listener.top.y) + dz * f4::set(listener.top.z);
+            const auto horizon = (right * right + front * front).sqrt();
+            // 正上方/正下方或内半径中扩散到全部扬声器
+            auto focus = f4::min(horizon * inv, one);
+            if (e.inner_radius) focus = focus * f4::min(distance / f4::max(inner, tiny), one);
+            auto spread = zero;
+            if (e.channel_radius) spread = spatial::atan2(radius, distance);
+            // 曲线距离
+            auto x = distance;
+            if (e.curve_scaler) x = distance / curve;
+            auto volume = m_volume.count ? spatial::curve_at(m_volume, x)
+                : f4::select(f4::le(x, one), one, one / f4::max(x, tiny));
+            auto lpf_direct = spatial::curve_at(m_lpfDirect, x);
+            auto lpf_reverb = spatial::curve_at(m_lpfReverb, x);
+            auto reverb = spatial::curve_at(m_reverb, x);
+            // 听者声锥: 前方与发声体方向
+            if (m_bListenerCone) {
+                const auto cos = f4::select(valid, front * inv, one);
+                spatial::apply_cone(m_listenerCone, cos, volume, lpf_direct, lpf_reverb, reverb);
+            }
+            // 发声体声锥: 前方与听者方向
+            if (emitter_cone) {
+                const auto cos = f4::select(valid, (zero - (ex * dx + ey * dy + ez * dz)) * inv, one);
+                spatial::apply_cone(m_emitterCone, cos, volume, lpf_direct, lpf_reverb, reverb);
+            }
+            // 多普勒: 速度在发声体 -> 听者方向上的分量
+            auto factor = one;
+            if (doppler) {
+                const auto& v = listener.velocity;
+                const auto listener_v = f4::min((f4::set(v.x) * dx + f4::set(v.y) * dy
+                    + f4::set(v.z) * dz) * inv * scaler, limit);
+                auto emitter_v = zero;
+                if (velocity) emitter_v = f4::min((evx * dx + evy * dy + evz * dz) * inv * scaler, limit);
+                factor = f4::select(valid, (speed - listener_v) / (speed - emitter_v), one);
+            }
+            store_lanes(volume, r.volume + i, n);
+            store_lanes(factor, r.doppler + i, n);
+            store_lanes(spatial::clamp(lpf_direct, 0.f, 1.f), r.lpf_direct + i, n);
+            store_lanes(spatial::clamp(lpf_reverb, 0.f, 1.f), r.lpf_reverb + i, n);
+            store_lanes(f4::max(reverb, zero), r.reverb + i, n);
+            store_lanes(distance, r.distance + i, n);
+            store_lanes(spatial::atan2(right, front), r.azimuth + i, n);
+            store_lanes(spatial::atan2(top, horizon), r.elevation + i, n);
+            store_lanes(focus, r.focus + i, n);
+            store_lanes(spread, r.spread + i, n);
+        }
+    }
+    for (uint32_t l = 0; l != m_cListener; ++l) m_aResult[l].count = e.count;
+    return true;
+}
+
+/// <summary>
+/// Calculates output matrices of emitters with same source channels and layout.
+/// 计算输出矩阵: 相邻扬声器间等功率声像, 每次 4 个发声体
+/// </summary>
+/// <param name="listener">The listener.</param>
+/// <param name="index">The index of emitters.</param>
+/// <param name="count">The count.</param>
+/// <param name="src">The source channels.</param>
+/// <param name="layout">The layout of output.</param>
+/// <param name="matrix">The matrices, [i][dst * src + s].</param>
+/// <returns></returns>
+void WrapAL::spatial::CALSpatial3D::Pan(uint32_t listener, const uint32_t index[], uint32_t count,
+    uint32_t src, const SpeakerLayout& layout, float* matrix) const noexcept {
+    assert(src && src <= Spatial3DMaxChannels && "bad channels");
+    assert(listener < m_cListener && "bad listener");
+    const auto stride = src * layout.channels;
+    std::memset(matrix, 0, sizeof(float) * stride * count);
+    const bool lfe = (m_uFlags & Flag3D_RedirectToLFE) && layout.lfe < layout.channels;
+    const auto& r = m_aResult[listener];
+    for (uint32_t i = 0; i < count; i += 4) {
+        const auto n = std::min(count - i, 4u);
+        // 按索引收集
+        float azimuth[4] = { 0.f }, focus[4] = { 0.f }, spread[4] = { 0.f }, volume[4] = { 0.f };
+        float* out[4];
+        for (uint32_t j = 0; j != n; ++j) {
+            const auto k = index[i + j];
+            assert(k < r.count && "out of range");
+            azimuth[j] = r.azimuth[k];
+            focus[j] = r.focus[k];
+            spread[j] = r.spread[k];
+            volume[j] = r.volume[k];
+            out[j] = matrix + (i + j) * stride;
+        }
+        spatial::pan_lanes(layout, src, lfe, n, f4::load(azimuth),
+            f4::load(spread), f4::load(focus), volume, out);
+    }
+}
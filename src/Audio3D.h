@@ -0,0 +1,184 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL 3D calculation, X3DAudio-like DSP settings for emitters in SoA:
+    emitters(SoA) -> geometry, 4 emitters in SIMD lanes -> volume/doppler/LPF/reverb(SoA)
+                  -> panning, 4 emitters of same channels/layout -> output matrices
+
+listener space is left-handed like X3DAudio: x right, y top, z front,
+azimuth is clockwise from front. speakers of output layout(LFE and top
+ones excluded) are on a ring, each source channel is panned between the
+adjacent pair with constant power, and blended to all speakers within
+inner radius or when the emitter is above/below the listener. channels
+of multi-channel clip are spread by atan(channel radius / distance).
+
+with several listeners, each 4 emitters are loaded once and calculated
+for every listener in the same pass, results of listener l in its SoA.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// include the config
+#include "wrapalconf.h"
+// include the config
+#include "wrapal_common.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // 3D calculation
+    namespace spatial {
+        // speaker layout of output voice
+        struct SpeakerLayout {
+            // init with channel mask, default mask of channels if 0
+            void Init(uint32_t channels, uint32_t mask, bool zero_center) noexcept;
+            // constant power gains of direction on ring, [channel]
+            void Gains(float azimuth, float* gain) const noexcept;
+            // matrix of one emitter like CALSpatial3D::Pan, all channels to LFE if "lfe", [dst * src + s]
+            void Pan(float azimuth, float focus, float spread, float volume, uint32_t src, bool lfe, float* matrix) const noexcept;
+            // channels of output
+            uint32_t        channels;
+            // count of speakers on ring
+            uint32_t        ring;
+            // channel of LFE, channels if none
+            uint32_t        lfe;
+            // channel of ring speakers, azimuth ascending
+            uint32_t        index[Spatial3DMaxChannels];
+            // azimuth of ring speakers in radian, (-pi, pi]
+            float           azimuth[Spatial3DMaxChannels];
+            // 1 / crossfade angle to next speaker on ring
+            float           next[Spatial3DMaxChannels];
+            // 1 / crossfade angle from prev speaker on ring
+            float           prev[Spatial3DMaxChannels];
+            // angle held by this speaker toward next one, for gap over pi
+            float           hold_next[Spatial3DMaxChannels];
+            // angle held by this speaker toward prev one, for gap over pi
+            float           hold_prev[Spatial3DMaxChannels];
+        };
+        // DSP settings of emitters in SoA, each array of count
+        struct Result3D {
+            // volume: distance curve x cones, also attenuation for voice budget
+            float*          volume;
+            // doppler factor
+            float*          doppler;
+            // LPF coefficient of direct path
+            float*          lpf_direct;
+            // LPF coefficient of reverb path
+            float*          lpf_reverb;
+            // reverb send level
+            float*          reverb;
+            // distance to listener
+            float*          distance;
+            // azimuth in listener space
+            float*          azimuth;
+            // elevation in listener space, up positive
+            float*          elevation;
+            // 1 for panned, 0 for spread to all speakers
+            float*          focus;
+            // half angle of channels of multi-channel clip
+            float*          spread;
+            // count of emitters
+            uint32_t        count;
+        };
+        // 3D calculation for batch of emitters
+        class CALSpatial3D {
+            // distance curve
+            struct Curve {
+                // count of points, 0 for inverse distance
+                uint32_t    count;
+                // distance of points
+                float       distance[Curve3DMaxPoints];
+                // value of points
+                float       value[Curve3DMaxPoints];
+                // slope to next point
+                float       slope[Curve3DMaxPoints];
+            };
+        public:
+            // ctor
+            CALSpatial3D() noexcept;
+            // dtor
+            ~CALSpatial3D() noexcept;
+            // set single listener
+            void SetListener(const AudioListener3D& listener) noexcept { this->SetListeners(&listener, 1); }
+            // set listeners, 1 to Listener3DMaxCount
+            void SetListeners(const AudioListener3D listeners[], uint32_t count) noexcept;
+            // count of listeners
+            auto GetListeners() const noexcept { return m_cListener; }
+            // set settings, curves and cones copied, false if invalid
+            bool SetSettings(const Audio3DSettings& settings) noexcept;
+            // get Audio3DFlag
+            auto GetFlags() const noexcept { return m_uFlags; }
+            // calculate DSP settings of emitters for each listener, false if OOM
+            bool Calculate(const AudioEmitters3D& emitters) noexcept;
+            // results of last Calculate for listener
+            auto GetResult(uint32_t listener = 0) const noexcept -> const Result3D& { return m_aResult[listener]; }
+            // matrices of emitters by index for listener, same src channels and layout, [i][dst * src + s]
+            void Pan(uint32_t listener, const uint32_t index[], uint32_t count,
+                uint32_t src, const SpeakerLayout& layout, float* matrix) const noexcept;
+        private:
+            // set curve, default points if null, false if invalid
+            static bool set_curve(Curve& curve, const AudioCurve3D& from, const AudioCurvePoint3D* def) noexcept;
+            // grow results to count for each listener
+            bool reserve(uint32_t count) noexcept;
+        private:
+            // results of listeners
+            Result3D        m_aResult[Listener3DMaxCount];
+            // buffer of results
+            float*          m_pBuffer = nullptr;
+            // capacity of results, emitters x listeners
+            uint32_t        m_cCapacity = 0;
+            // count of listeners
+            uint32_t        m_cListener = 1;
+            // Audio3DFlag
+            uint32_t        m_uFlags = Flag3D_Default;
+            // speed of sound
+            float           m_fSpeedOfSound;
+            // doppler scaler
+            float           m_fDopplerScaler = 1.f;
+            // listeners
+            AudioListener3D m_aListener[Listener3DMaxCount];
+            // right direction of listeners, top x front
+            Vector3F        m_aRight[Listener3DMaxCount];
+            // cone of listener
+            AudioCone3D     m_listenerCone;
+            // cone of emitters
+            AudioCone3D     m_emitterCone;
+            // listener has cone
+            bool            m_bListenerCone = false;
+            // emitters have cone
+            bool            m_bEmitterCone = false;
+            // volume curve
+            Curve           m_volume;
+            // direct LPF curve
+            Curve           m_lpfDirect;
+            // reverb LPF curve
+            Curve           m_lpfReverb;
+            // reverb curve
+            Curve           m_reverb;
+        };
+    }
+}
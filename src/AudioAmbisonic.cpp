@@ -0,0 +1,193 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "AudioAmbisonic.h"
+#include "Audio3D.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+
+// ambisonic namespace
+namespace WrapAL { namespace ambisonic {
+    // pi
+    static constexpr float PI = 3.141592654f;
+    // max-rE weights of degree n, [order - 1][n]
+    static const float MAX_RE[AmbisonicMaxOrder][AmbisonicMaxOrder + 1] = {
+        { 1.f, 0.5773503f },
+        { 1.f, 0.7745967f, 0.4f },
+        { 1.f, 0.8611363f, 0.6123336f, 0.3047469f },
+    };
+    // real spherical harmonics of unit vector, ACN order, SN3D
+    static void harmonics(uint32_t order, float x, float y, float z, float* h) noexcept {
+        h[0] = 1.f;
+        if (order < 1) return;
+        h[1] = y; h[2] = z; h[3] = x;
+        if (order < 2) return;
+        const float s3 = 1.7320508f;
+        h[4] = s3 * x * y;
+        h[5] = s3 * y * z;
+        h[6] = 0.5f * (3.f * z * z - 1.f);
+        h[7] = s3 * x * z;
+        h[8] = 0.5f * s3 * (x * x - y * y);
+        if (order < 3) return;
+        const float s58 = 0.7905694f, s38 = 0.6123724f, s15 = 3.8729833f;
+        h[9] = s58 * y * (3.f * x * x - y * y);
+        h[10] = s15 * x * y * z;
+        h[11] = s38 * y * (5.f * z * z - 1.f);
+        h[12] = 0.5f * z * (5.f * z * z - 3.f);
+        h[13] = s38 * x * (5.f * z * z - 1.f);
+        h[14] = 0.5f * s15 * z * (x * x - y * y);
+        h[15] = s58 * x * (x * x - 3.f * y * y);
+    }
+    // harmonics of direction in listener space
+    static void harmonics(uint32_t order, float azimuth, float elevation, float* h) noexcept {
+        const auto c = std::cos(elevation);
+        ambisonic::harmonics(order, c * std::cos(azimuth), -c * std::sin(azimuth), std::sin(elevation), h);
+    }
+    // decoding row of virtual speaker: sampling, max-rE weighted, unnormalized
+    static void decode_row(uint32_t order, float azimuth, float elevation, float* row) noexcept {
+        ambisonic::harmonics(order, azimuth, elevation, row);
+        const auto weight = MAX_RE[order - 1];
+        for (uint32_t n = 0; n <= order; ++n) {
+            const auto w = weight[n] * float(2 * n + 1);
+            for (uint32_t c = n * n; c != (n + 1) * (n + 1); ++c) row[c] *= w;
+        }
+    }
+    // sum of decoded gains of "rows" for source in front
+    static auto front_gain(uint32_t order, const float* rows, uint32_t count) noexcept {
+        const auto channels = ambisonic::Channels(order);
+        float front[AmbisonicMaxChannels];
+        ambisonic::harmonics(order, 0.f, 0.f, front);
+        float sum = 0.f;
+        for (uint32_t i = 0; i != count; ++i) {
+            for (uint32_t c = 0; c != channels; ++c) sum += rows[i * channels + c] * front[c];
+        }
+        return sum;
+    }
+}}
+
+/// <summary>
+/// Encodes the direction.
+/// 编码方向: 方向分量乘上聚焦系数, 为 0 时只有全向
+/// </summary>
+/// <param name="order">The order.</param>
+/// <param name="azimuth">The azimuth.</param>
+/// <param name="elevation">The elevation.</param>
+/// <param name="focus">The focus.</param>
+/// <param name="gain">The gains, [channel].</param>
+/// <returns></returns>
+void WrapAL::ambisonic::Encode(uint32_t order, float azimuth, float elevation, float focus, float* gain) noexcept {
+    assert(order && order <= AmbisonicMaxOrder && "bad order");
+    ambisonic::harmonics(order, azimuth, elevation, gain);
+    const auto channels = ambisonic::Channels(order);
+    for (uint32_t c = 1; c != channels; ++c) gain[c] *= focus;
+}
+
+/// <summary>
+/// Encodes the clip to matrix.
+/// </summary>
+/// <param name="order">The order.</param>
+/// <param name="src">The source channels.</param>
+/// <param name="azimuth">The azimuth.</param>
+/// <param name="elevation">The elevation.</param>
+/// <param name="focus">The focus.</param>
+/// <param name="spread">The half angle of channels.</param>
+/// <param name="level">The level of each channel.</param>
+/// <param name="matrix">The matrix, [dst * src + s].</param>
+/// <returns></returns>
+void WrapAL::ambisonic::EncodeMatrix(uint32_t order, uint32_t src, float azimuth, float elevation,
+    float focus, float spread, float level, float* matrix) noexcept {
+    const auto channels = ambisonic::Channels(order);
+    float gain[AmbisonicMaxChannels];
+    for (uint32_t s = 0; s != src; ++s) {
+        // 多声道: 均匀分布在 [-spread, spread]
+        auto a = azimuth;
+        if (src > 1) a += spread * (2.f * float(s) / float(src - 1) - 1.f);
+        ambisonic::Encode(order, a, elevation, focus, gain);
+        for (uint32_t c = 0; c != channels; ++c) matrix[c * src + s] = gain[c] * level;
+    }
+}
+
+/// <summary>
+/// Builds the decoding matrix to speaker layout.
+/// 解码到扬声器: 先解码到均匀的虚拟环, 再等功率声像到实际扬声器
+/// </summary>
+/// <param name="order">The order.</param>
+/// <param name="layout">The layout.</param>
+/// <param name="lfe">if set to <c>true</c> [omni to LFE].</param>
+/// <param name="matrix">The matrix, [speaker * channels + c].</param>
+/// <returns></returns>
+void WrapAL::ambisonic::DecodeSpeakers(uint32_t order, const spatial::SpeakerLayout& layout,
+    bool lfe, float* matrix) noexcept {
+    assert(order && order <= AmbisonicMaxOrder && "bad order");
+    const auto channels = ambisonic::Channels(order), dst = layout.channels;
+    std::memset(matrix, 0, sizeof(float) * channels * dst);
+    float rows[AmbisonicRing * AmbisonicMaxChannels];
+    float azimuth[AmbisonicRing];
+    for (uint32_t v = 0; v != AmbisonicRing; ++v) {
+        azimuth[v] = PI * 2.f * float(v) / float(AmbisonicRing);
+        ambisonic::decode_row(order, azimuth[v], 0.f, rows + v * channels);
+    }
+    if (!layout.ring) return;
+    const auto scale = 1.f / ambisonic::front_gain(order, rows, AmbisonicRing);
+    float gain[Spatial3DMaxChannels];
+    for (uint32_t v = 0; v != AmbisonicRing; ++v) {
+        layout.Gains(azimuth[v], gain);
+        for (uint32_t k = 0; k != dst; ++k) {
+            if (gain[k] == 0.f) continue;
+            const auto g = gain[k] * scale;
+            for (uint32_t c = 0; c != channels; ++c) matrix[k * channels + c] += g * rows[v * channels + c];
+        }
+    }
+    // 虚拟扬声器合并后的功率, 各方向平均后归一化
+    float power = 0.f;
+    for (uint32_t v = 0; v != AmbisonicRing; ++v) {
+        float h[AmbisonicMaxChannels];
+        ambisonic::harmonics(order, azimuth[v] + PI / float(AmbisonicRing), 0.f, h);
+        for (uint32_t k = 0; k != dst; ++k) {
+            float out = 0.f;
+            for (uint32_t c = 0; c != channels; ++c) out += matrix[k * channels + c] * h[c];
+            power += out * out;
+        }
+    }
+    const auto norm = 1.f / std::sqrt(std::max(power / float(AmbisonicRing), 1e-12f));
+    for (uint32_t i = 0; i != channels * dst; ++i) matrix[i] *= norm;
+    if (lfe && layout.lfe < dst) matrix[layout.lfe * channels] = 1.f;
+}
+
+/// <summary>
+/// Gets direction of the virtual speaker of binaural decoder, spiral on sphere.
+/// </summary>
+/// <param name="order">The order.</param>
+/// <param name="index">The index.</param>
+/// <param name="azimuth">The azimuth.</param>
+/// <param name="elevation">The elevation.</param>
+/// <returns></returns>
+void WrapAL::ambisonic::VirtualSpeaker(uint32_t order, uint32_t index, float& azimuth, float& elevation) noexcept {
+    const auto count = ambisonic::VirtualSpeakers(order);
+    assert(index < count && "out of range");
+    // 黄金角螺旋, 高度等面积
+    const auto golden = PI * (3.f - 2.2360680f);
+    const auto z = 1.f - float(2 * index + 1) / float(count);
+    elevation = std::asin(z);
+    azimuth = std::remainder(golden * float(index), PI * 2.f);
+}
+
+/// <summary>
+/// Builds the decoding matrix to virtual speakers of binaural decoder.
+/// </summary>
+/// <param name="order">The order.</param>
+/// <param name="matrix">The matrix, [speaker * channels + c].</param>
+/// <returns></returns>
+void WrapAL::ambisonic::DecodeVirtual(uint32_t order, float* matrix) noexcept {
+    assert(order && order <= AmbisonicMaxOrder && "bad order");
+    const auto channels = ambisonic::Channels(order), count = ambisonic::VirtualSpeakers(order);
+    for (uint32_t v = 0; v != count; ++v) {
+        float azimuth, elevation;
+        ambisonic::VirtualSpeaker(order, v, azimuth, elevation);
+        ambisonic::decode_row(order, azimuth, elevation, matrix + v * channels);
+    }
+    // 正前方总增益为 1
+    const auto scale = 1.f / ambisonic::front_gain(order, matrix, count);
+    for (uint32_t i = 0; i != channels * count; ++i) matrix[i] *= scale;
+}
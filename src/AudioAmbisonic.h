@@ -0,0 +1,69 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL ambisonic bus, 3D clips mixed in spherical harmonics then decoded once:
+    3D clip -> encoding gains(ACN order, SN3D) -> bus of (order + 1)^2 channels
+    bus     -> output matrix of decoder -> speakers of master
+                                        -> virtual speakers on binaural buses
+
+listener space as spatial: azimuth clockwise from front, elevation up
+positive; harmonics use x front, y left, z up. decoders sample the field
+at virtual speakers with max-rE weights; for speakers(ring, no height) a
+uniform ring of AmbisonicRing virtual speakers is panned to the real ones
+with constant power, for binaural BinauralBusChannels x order virtual
+speakers are spread on sphere, each convolved with HRTF of its direction.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// include the config
+#include "wrapalconf.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // 3D calculation
+    namespace spatial { struct SpeakerLayout; }
+    // ambisonic
+    namespace ambisonic {
+        // channels of order
+        inline constexpr auto Channels(uint32_t order) noexcept -> uint32_t { return (order + 1) * (order + 1); }
+        // virtual speakers of binaural decoder of order
+        inline constexpr auto VirtualSpeakers(uint32_t order) noexcept -> uint32_t { return BinauralBusChannels * order; }
+        // gains of direction, [channel], directional ones scaled by focus(0 for omni)
+        void Encode(uint32_t order, float azimuth, float elevation, float focus, float* gain) noexcept;
+        // encoding matrix of clip, channels spread in [-spread, spread], [dst * src + s]
+        void EncodeMatrix(uint32_t order, uint32_t src, float azimuth, float elevation,
+            float focus, float spread, float level, float* matrix) noexcept;
+        // decoding matrix to speaker layout, LFE gets omni if "lfe", [speaker * channels + c]
+        void DecodeSpeakers(uint32_t order, const spatial::SpeakerLayout& layout, bool lfe, float* matrix) noexcept;
+        // direction of virtual speaker of binaural decoder, radian
+        void VirtualSpeaker(uint32_t order, uint32_t index, float& azimuth, float& elevation) noexcept;
+        // decoding matrix to virtual speakers of binaural decoder, [speaker * channels + c]
+        void DecodeVirtual(uint32_t order, float* matrix) noexcept;
+    }
+}
@@ -1,7 +1,12 @@
 ﻿#define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include "AudioClip.h"
+#include "AudioPerf.h"
 #include <AudioEngine.h>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <new>
 
 
 // WRAPAL: DEFINE_GUID
@@ -30,6 +35,26 @@ namespace WrapAL {
             return impl::read_any<T, 0>(ptr);
         }
     }
+    // buffer context of silence for lead-in
+    static void* const LeadInContext = reinterpret_cast<void*>(~size_t(0));
+    // free slots of stream ring in mask
+    static_assert(StreamingBufferMaxCount < 32, "slots out of mask");
+    // buffer context of slot of stream ring
+    static inline auto StreamContext(uint32_t epoch, uint32_t index) noexcept {
+        return reinterpret_cast<void*>(size_t(epoch) * StreamingBufferMaxCount + index);
+    }
+    // silence for lead-in
+    struct LeadInSilence {
+        // ctor
+        LeadInSilence() noexcept {
+            std::memset(zero, 0, sizeof(zero));
+            std::memset(pcm8, 0x80, sizeof(pcm8));
+        }
+        // silence of IEEE float and 16/24/32-bit PCM
+        uint8_t     zero[LeadInBufferSize];
+        // silence of 8-bit PCM, unsigned
+        uint8_t     pcm8[LeadInBufferSize];
+    };
     // CLSID_MMDeviceEnumerator
     WRAPAL_DEFINE_GUID(CLSID_MMDeviceEnumerator, 0xBCDE0395, 0xE52F, 0x467C,
         0x8E, 0x3D, 0xC4, 0x57, 0x92, 0x91, 0x69, 0x2E);
@@ -65,12 +90,61 @@ void* WrapAL::CALAudioSourceClipImpl::s_vtable = nullptr;
 /// </summary>
 /// <returns></returns>
 auto WrapAL::CALAudioSourceClipImpl::Release() noexcept -> uint32_t {
-    assert(m_cRefCount > 0 && m_cRefCount < 256 && "bad range");
-    uint32_t count = --m_cRefCount;
+    uint32_t count = this->ReleaseLater();
     if (!count) this->destroy();
     return count;
 }
 
+/// <summary>
+/// Releases this instance without destroying.
+/// 释放但不摧毁, 用于不能摧毁声音的音频线程
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::ReleaseLater() noexcept -> uint32_t {
+    // 队列中的命令也持有引用
+    assert(m_cRefCount > 0 && m_cRefCount < 0x10000 && "bad range");
+    return --m_cRefCount;
+}
+
+/// <summary>
+/// Adds the ref-count if not 0.
+/// 音频线程中增加引用, 片段可能正在其他线程中释放
+/// </summary>
+/// <returns></returns>
+bool WrapAL::CALAudioSourceClipImpl::AddRefIfAlive() noexcept {
+    auto count = m_cRefCount.load();
+    while (count) {
+        if (m_cRefCount.compare_exchange_weak(count, count + 1)) return true;
+    }
+    return false;
+}
+
+/// <summary>
+/// Adds the ref-count held by handle if not 0.
+/// 句柄引用, 用户释放后句柄失效
+/// </summary>
+/// <returns></returns>
+bool WrapAL::CALAudioSourceClipImpl::AddHandleRef() noexcept {
+    auto count = m_cHandleRef.load();
+    while (count) {
+        if (m_cHandleRef.compare_exchange_weak(count, count + 1)) return true;
+    }
+    return false;
+}
+
+/// <summary>
+/// Releases the ref-count held by handle if not 0.
+/// 释放句柄引用, 重复释放返回false
+/// </summary>
+/// <returns></returns>
+bool WrapAL::CALAudioSourceClipImpl::ReleaseHandleRef() noexcept {
+    auto count = m_cHandleRef.load();
+    while (count) {
+        if (m_cHandleRef.compare_exchange_weak(count, count - 1)) return true;
+    }
+    return false;
+}
+
 /// <summary>
 /// Destroys this instance.
 /// </summary>
@@ -98,8 +172,11 @@ WrapAL::CALAudioSourceClipImpl::CALAudioSourceClipImpl(
 ) noexcept : flags(flag),
 m_pAudioData(buf),
 m_pStream(Acquire(stream)),
-m_uBufferLength(buflen) {
+m_uBufferLength(buflen),
+m_cRefCount((flag & WrapAL::Flag_AutoDestroyEOP) ? 2 : 1),
+m_bAutoRef(!!(flag & WrapAL::Flag_AutoDestroyEOP)) {
     buf = nullptr;
+    if (m_pAudioData) CALPerfCounters::AddClipMemory(buflen);
     // 加入调试链表
 #ifndef NDEBUG
     this->s_vtable = impl::read_any<void*>(this);
@@ -118,10 +195,30 @@ m_uBufferLength(buflen) {
 /// </summary>
 /// <returns></returns>
 WrapAL::CALAudioSourceClipImpl::~CALAudioSourceClipImpl() {
-    if (m_pSourceVoice) m_pSourceVoice->DestroyVoice();
-    if (m_pStream) m_pStream->Release();
-    std::free(m_pAudioData);
+    // 句柄先失效
+    WrapALAudioEngine.unregister_clip(*this);
+    // 断开回调(摧毁是同步的), 之后不再请求解码
+    if (m_pPooledVoice) m_pPooledVoice->Detach();
+    else if (m_pSourceVoice) m_pSourceVoice->DestroyVoice();
+    if (m_pRing) WrapALAudioEngine.decode_pool().Cancel(*this);
+    // 停止与刷新是异步的: 声音或者虚拟化前的声音仍可能读取数据, 延迟释放
+    uint8_t* data[] = { m_pAudioData, m_pRing ? m_pRing->data : nullptr };
+    if (m_pAudioData) CALPerfCounters::AddClipMemory(-int64_t(m_uBufferLength));
+    if (m_pRing) CALPerfCounters::AddClipMemory(-int64_t(m_pRing->size) * m_pRing->count);
+    if (m_pPooledVoice || m_bVirtual) {
+        for (const auto ptr : data) WrapALAudioEngine.retire_memory(m_pPooledVoice, ptr);
+        if (m_pPooledVoice) WrapALAudioEngine.recycle_voice(*m_pPooledVoice);
+    }
+    else for (const auto ptr : data) std::free(ptr);
     m_pAudioData = nullptr;
+    if (m_pRing) {
+        m_pRing->~AudioStreamRing();
+        std::free(m_pRing);
+        m_pRing = nullptr;
+    }
+    if (m_pStream) m_pStream->Release();
+    std::free(m_pSpatial);
+    m_pSpatial = nullptr;
     // 链接前后指针
 #ifndef NDEBUG
     this->prev->next = this->next;
@@ -135,30 +232,21 @@ WrapAL::CALAudioSourceClipImpl::~CALAudioSourceClipImpl() {
 /// <param name="pos">The position.</param>
 /// <returns></returns>
 void WrapAL::CALAudioSourceClipImpl::Seek(float pos) noexcept {
+    // 检查采样位置
+    uint32_t pos_in_sample = static_cast<uint32_t>(static_cast<double>(pos) *
+        static_cast<double>(this->wave.nSamplesPerSec));
+    // 虚拟: 只记录位置
+    if (m_bVirtual) {
+        m_iPosBase = pos_in_sample;
+        m_dVirtualTime = WrapALAudioEngine.clock_sec();
+        return;
+    }
     assert(m_pSourceVoice);
     // 保留基本
     bool playing = this->IsPlaying();
     m_pSourceVoice->Stop(0);
     m_pSourceVoice->FlushSourceBuffers();
-    // 检查采样位置
-    uint32_t pos_in_sample = static_cast<uint32_t>(static_cast<double>(pos) *
-        static_cast<double>(this->wave.nSamplesPerSec));
-    // 流模式?
-    if (this->flags & WrapAL::Flag_StreamingReading) {
-        // 输入
-        m_pStream->Seek(pos_in_sample * this->wave.nBlockAlign);
-        for (unsigned int i = 0; i < StreamingBufferCount - 1; ++i) {
-            this->LoadAndBufferData(i);
-        }
-    }
-    // 直接播放
-    else {
-        XAUDIO2_BUFFER buffer; ZeroMemory(&buffer, sizeof(buffer));
-        buffer.PlayBegin = pos_in_sample;
-        buffer.pAudioData = m_pAudioData;
-        buffer.AudioBytes = m_uBufferLength;
-        this->ProcessBufferData(buffer);
-    }
+    this->submit_from(pos_in_sample);
     // 播放?
     if (playing) {
         m_pSourceVoice->Start();
@@ -166,21 +254,473 @@ void WrapAL::CALAudioSourceClipImpl::Seek(float pos) noexcept {
 }
 
 /// <summary>
-/// Tells this instance.
+/// Submits data from position in frame, after silence of lead.
+/// 从指定位置提交数据
 /// </summary>
+/// <param name="frame">The position in frame.</param>
+/// <param name="lead">The silence before data in frame.</param>
 /// <returns></returns>
-auto WrapAL::CALAudioSourceClipImpl::Tell() const noexcept ->float {
-    assert(m_pSourceVoice);
+auto WrapAL::CALAudioSourceClipImpl::submit_from(uint32_t frame, uint32_t lead) noexcept -> HRESULT {
+    // 位置基准, 静音不计入位置
+    XAUDIO2_VOICE_STATE state; state.SamplesPlayed = 0;
+    m_pSourceVoice->GetState(&state);
+    m_iPosBase = int64_t(frame) - int64_t(lead) - int64_t(state.SamplesPlayed);
+    m_uLeadIn = lead;
+    if (lead) {
+        const auto hr = this->submit_silence(lead);
+        if (FAILED(hr)) return hr;
+    }
+    // 流模式: 解码后在回调中提交
+    if (this->flags & WrapAL::Flag_StreamingReading) {
+        m_pRing->submit_end = state.SamplesPlayed + lead;
+        this->ResetStream(frame * this->wave.nBlockAlign);
+        return S_OK;
+    }
+    // 直接播放
+    XAUDIO2_BUFFER buffer; ZeroMemory(&buffer, sizeof(buffer));
+    buffer.PlayBegin = frame;
+    buffer.pAudioData = m_pAudioData;
+    buffer.AudioBytes = m_uBufferLength;
+    buffer.pContext = reinterpret_cast<void*>(size_t(++m_uGeneration));
+    return this->ProcessBufferData(buffer);
+}
+
+/// <summary>
+/// Submits silence, buffers of it are ignored in OnBufferEnd.
+/// 提交静音前导
+/// </summary>
+/// <param name="frames">The frames.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::submit_silence(uint32_t frames) noexcept -> HRESULT {
+    static const LeadInSilence silence;
+    const auto align = uint32_t(this->wave.nBlockAlign);
+    const bool pcm8 = this->wave.wFormatTag == Wave_PCM && this->wave.wBitsPerSample == 8;
+    const auto chunk = uint32_t(LeadInBufferSize) / align;
+    HRESULT hr = S_OK;
+    while (SUCCEEDED(hr) && frames) {
+        const auto count = std::min(frames, chunk);
+        XAUDIO2_BUFFER buffer = { 0 };
+        buffer.pAudioData = pcm8 ? silence.pcm8 : silence.zero;
+        buffer.AudioBytes = count * align;
+        buffer.pContext = LeadInContext;
+        hr = m_pSourceVoice->SubmitSourceBuffer(&buffer);
+        frames -= count;
+    }
+    return hr;
+}
+
+/// <summary>
+/// Gets position in frame, not wrapped.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::position() const noexcept -> int64_t {
+    // 虚拟: 按时间推进
+    if (m_bVirtual) {
+        auto pos = m_iPosBase.load();
+        if (m_bPlaying) pos += int64_t((WrapALAudioEngine.clock_sec() - m_dVirtualTime) *
+            double(this->wave.nSamplesPerSec) * double(this->ratio()));
+        return pos;
+    }
     XAUDIO2_VOICE_STATE state;
     state.SamplesPlayed = 0;
     m_pSourceVoice->GetState(&state);
+    return int64_t(state.SamplesPlayed) + m_iPosBase.load();
+}
+
+/// <summary>
+/// Gets length in frame.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::length() const noexcept -> uint32_t {
+    const auto bytes = (this->flags & WrapAL::Flag_StreamingReading) ?
+        m_pStream->GetSizeInByte() : m_uBufferLength;
+    return bytes / this->wave.nBlockAlign;
+}
+
+/// <summary>
+/// Tells this instance.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::Tell() const noexcept ->float {
+    auto pos = this->position();
+    if (pos < 0) pos = 0;
+    // 无限轮回
+    const auto len = this->length();
+    if (len && (this->flags & WrapAL::Flag_LoopInfinite)) pos %= len;
     // 已经播放
-    double p = static_cast<double>(state.SamplesPlayed);
+    double p = static_cast<double>(pos);
     double s = static_cast<double>(this->wave.nSamplesPerSec);
     // 计算
     return static_cast<float>(p / s);
 }
 
+/// <summary>
+/// Plays this instance.
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::Play() noexcept {
+    if (m_bVirtual) this->fold_virtual(WrapALAudioEngine.clock_sec());
+    else m_pSourceVoice->Start(0);
+    m_bPlaying = true;
+    m_uLeadIn = 0;
+}
+
+/// <summary>
+/// Stops this instance.
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::Stop() noexcept {
+    if (m_bVirtual) this->fold_virtual(WrapALAudioEngine.clock_sec());
+    else m_pSourceVoice->Stop(0);
+    m_bPlaying = false;
+}
+
+/// <summary>
+/// Queues silence before data, so Play at the start of a pass is heard inside it.
+/// 静音前导: 在处理周期开始时播放, 从周期中间的采样发声
+/// </summary>
+/// <param name="frames">The frames of silence.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::PrepareLeadIn(uint32_t frames) noexcept {
+    // 播放中无法对齐, 虚拟时不可闻
+    if (!frames || m_bPlaying || m_bVirtual) return;
+    // 已有的前导不计入位置
+    auto pos = this->position() + m_uLeadIn;
+    const auto len = this->length();
+    if (pos < 0) pos = 0;
+    if (len) pos %= len;
+    m_pSourceVoice->Stop(0);
+    m_pSourceVoice->FlushSourceBuffers();
+    this->submit_from(uint32_t(pos), frames);
+}
+
+/// <summary>
+/// Cuts data queued after frames, so Stop at the start of next pass is heard inside this pass.
+/// 截断: 只保留之后的若干帧, 下个周期开始时停止, 从周期中间的采样静音
+/// </summary>
+/// <param name="frames">The frames to play before silence.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::PrepareStop(uint32_t frames) noexcept {
+    // 停止时无需截断, 虚拟时不可闻
+    if (!m_bPlaying || m_bVirtual) return;
+    XAUDIO2_VOICE_STATE state; state.SamplesPlayed = 0;
+    m_pSourceVoice->GetState(&state);
+    const auto pos = int64_t(state.SamplesPlayed) + m_iPosBase.load();
+    // 剩余的静音前导
+    const auto lead = uint32_t(std::min(pos < 0 ? -pos : 0, int64_t(frames)));
+    m_pSourceVoice->Stop(0);
+    m_pSourceVoice->FlushSourceBuffers();
+    // 之后不再提交, 下个周期停止并回到开头
+    m_bPlaying = false;
+    HRESULT hr = S_OK;
+    if (lead) hr = this->submit_silence(lead);
+    auto keep = frames - lead;
+    const auto align = uint32_t(this->wave.nBlockAlign);
+    // 流模式: 重新提交声音中剩余的槽, 槽在所有缓冲区结束后归还
+    if (m_pRing) {
+        auto& ring = *m_pRing;
+        const auto start = state.SamplesPlayed + lead;
+        int64_t left = ring.submit_end > start ? int64_t(ring.submit_end - start) : 0;
+        // 从最后提交的往前找到正在播放的
+        auto i = ring.sent_index;
+        for (uint32_t n = 0; left > 0 && n != ring.count; ++n) {
+            i = (i + StreamingBufferMaxCount - 1) % StreamingBufferMaxCount;
+            left -= ring.sent[i].frames;
+        }
+        if (left > 0) left = 0;
+        auto skip = uint32_t(-left);
+        for (; SUCCEEDED(hr) && keep && i != ring.sent_index; i = (i + 1) % StreamingBufferMaxCount) {
+            const auto& sent = ring.sent[i];
+            auto& slot = ring.slot[sent.index];
+            const auto count = std::min(sent.frames - skip, keep);
+            XAUDIO2_BUFFER buffer = { 0 };
+            buffer.pAudioData = ring.data + ring.size * sent.index;
+            buffer.AudioBytes = slot.length;
+            buffer.PlayBegin = sent.begin + skip;
+            buffer.PlayLength = count;
+            buffer.pContext = WrapAL::StreamContext(ring.epoch, sent.index);
+            if (slot.eos && skip + count == sent.frames) buffer.Flags = XAUDIO2_END_OF_STREAM;
+            if (SUCCEEDED(hr = m_pSourceVoice->SubmitSourceBuffer(&buffer))) ++slot.queued;
+            keep -= count;
+            skip = 0;
+        }
+    }
+    // 重新提交剩余的数据, 轮回时可能跨过结尾
+    else if (const auto len = m_uBufferLength / align) {
+        auto frame = uint32_t((pos < 0 ? 0 : pos) % len);
+        const bool loop = !!(this->flags & WrapAL::Flag_LoopInfinite);
+        const auto context = reinterpret_cast<void*>(size_t(++m_uGeneration));
+        while (SUCCEEDED(hr) && keep) {
+            const auto count = std::min(len - frame, keep);
+            XAUDIO2_BUFFER buffer = { 0 };
+            buffer.pAudioData = m_pAudioData;
+            buffer.AudioBytes = m_uBufferLength;
+            buffer.PlayBegin = frame;
+            buffer.PlayLength = count;
+            buffer.pContext = context;
+            // 播放到结尾则照常结束
+            const bool end = frame + count == len;
+            if (end && !loop) buffer.Flags = XAUDIO2_END_OF_STREAM;
+            hr = m_pSourceVoice->SubmitSourceBuffer(&buffer);
+            if (end && !loop) break;
+            keep -= count;
+            frame = 0;
+        }
+    }
+    m_pSourceVoice->Start(0);
+}
+
+/// <summary>
+/// Stops and rewinds to the beginning, safe in audio thread.
+/// 停止并回到开头
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::StopAndRewind() noexcept {
+    m_bPlaying = false;
+    // 虚拟: 只记录位置
+    if (m_bVirtual) {
+        m_iPosBase = 0;
+        m_dVirtualTime = WrapALAudioEngine.clock_sec();
+        return;
+    }
+    m_pSourceVoice->Stop(0);
+    m_pSourceVoice->FlushSourceBuffers();
+    // 流模式交给解码线程从头解码
+    this->submit_from(0);
+}
+
+/// <summary>
+/// Sets the frequency ratio.
+/// </summary>
+/// <param name="f">The ratio.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::SetFrequencyRatio(float f) noexcept {
+    // 虚拟: 旧的速率推进到现在
+    if (m_bVirtual) this->fold_virtual(WrapALAudioEngine.clock_sec());
+    m_fRatio = f;
+    if (m_pSourceVoice) m_pSourceVoice->SetFrequencyRatio(this->ratio());
+}
+
+/// <summary>
+/// Sets the doppler factor, multiplied to frequency ratio.
+/// </summary>
+/// <param name="d">The doppler factor.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::SetDoppler(float d) noexcept {
+    if (m_fDoppler.load() == d) return;
+    // 虚拟: 旧的速率推进到现在
+    if (m_bVirtual) this->fold_virtual(WrapALAudioEngine.clock_sec());
+    m_fDoppler = d;
+    if (m_pSourceVoice) m_pSourceVoice->SetFrequencyRatio(this->ratio());
+}
+
+/// <summary>
+/// Gets frequency ratio x doppler, clamped to range of voice.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::ratio() const noexcept -> float {
+    const auto r = m_fRatio.load() * m_fDoppler.load();
+    return std::min(std::max(r, float(XAUDIO2_MIN_FREQ_RATIO)), float(XAUDIO2_DEFAULT_FREQ_RATIO));
+}
+
+/// <summary>
+/// Gets the 3D state, created on first call.
+/// </summary>
+/// <returns>null if OOM</returns>
+auto WrapAL::CALAudioSourceClipImpl::Spatial() noexcept -> Clip3DState* {
+    if (!m_pSpatial) {
+        const auto ptr = std::calloc(1, sizeof(Clip3DState));
+        m_pSpatial = reinterpret_cast<Clip3DState*>(ptr);
+    }
+    return m_pSpatial;
+}
+
+/// <summary>
+/// Sets the gain and LPF coefficient of direct path for occlusion.
+/// 设置直达增益与源音滤波器, 由音频线程平滑
+/// </summary>
+/// <param name="gain">The gain, multiplied to volume.</param>
+/// <param name="lpf">The LPF coefficient of voice filter.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::SetDirect(float gain, float lpf) noexcept {
+    const bool volume = m_fDirect != gain, filter = m_fDirectLPF != lpf;
+    m_fDirect = gain;
+    m_fDirectLPF = lpf;
+    if (!m_pSourceVoice) return;
+    if (volume) m_pSourceVoice->SetVolume(m_fVolume * gain);
+    if (filter) this->filter_direct();
+}
+
+/// <summary>
+/// Sets the voice filter of direct path, Flag_3D only.
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::filter_direct() noexcept {
+    if (!(this->flags & Flag_3D)) return;
+    // X3DAudio: 系数 c 对应 2 * sin(pi / 6 * c)
+    constexpr float pi_6 = 3.141592654f / 6.f;
+    const XAUDIO2_FILTER_PARAMETERS filter = {
+        LowPassFilter, 2.f * std::sin(pi_6 * m_fDirectLPF), 1.f
+    };
+    m_pSourceVoice->SetFilterParameters(&filter);
+}
+
+/// <summary>
+/// Applies the 3D state to voice, voice filter set by <see cref="SetDirect"/>.
+/// 应用 3D 状态: 输出矩阵, 混响发送
+/// </summary>
+/// <param name="output">The output voice of direct path.</param>
+/// <param name="matrix">The output matrix of direct path, null to keep.</param>
+/// <param name="dst">The channels of output voice.</param>
+/// <param name="reverb">The reverb voice, null for none.</param>
+/// <param name="reverb_channels">The channels of reverb voice.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::Apply3D(IXAudio2Voice* output, const float* matrix,
+    uint32_t dst, IXAudio2Voice* reverb, uint32_t reverb_channels) noexcept {
+    const auto state = m_pSpatial;
+    if (!state || !m_pSourceVoice) return;
+    // X3DAudio: 系数 c 对应 2 * sin(pi / 6 * c)
+    constexpr float pi_6 = 3.141592654f / 6.f;
+    const auto src = state->src;
+    if (matrix) m_pSourceVoice->SetOutputMatrix(output, src, dst, matrix);
+    if (reverb && (state->flags & Flag3D_Reverb) && reverb_channels <= Spatial3DMaxChannels) {
+        // 单声道发送到全部声道, 多声道按声道对应
+        float send[Spatial3DMaxChannels * Spatial3DMaxChannels];
+        const auto level = reverb_channels >= src ? state->reverb
+            : state->reverb * float(reverb_channels) / float(src);
+        for (uint32_t r = 0; r != reverb_channels; ++r) {
+            for (uint32_t i = 0; i != src; ++i) {
+                const bool on = reverb_channels >= src ? r % src == i : i % reverb_channels == r;
+                send[r * src + i] = on ? level : 0.f;
+            }
+        }
+        m_pSourceVoice->SetOutputMatrix(reverb, src, reverb_channels, send);
+        if (state->flags & Flag3D_LPFReverb) {
+            const XAUDIO2_FILTER_PARAMETERS filter = {
+                LowPassFilter, 2.f * std::sin(pi_6 * state->lpf_reverb), 1.f
+            };
+            m_pSourceVoice->SetOutputFilterParameters(reverb, &filter);
+        }
+    }
+}
+
+/// <summary>
+/// Applies the matrix and LPF of send to output of one listener.
+/// 应用一个听者的输出: 矩阵与发送的滤波器
+/// </summary>
+/// <param name="output">The output voice of listener.</param>
+/// <param name="matrix">The output matrix, [dst * src + s].</param>
+/// <param name="dst">The channels of output voice.</param>
+/// <param name="lpf">The LPF coefficient of send.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::Apply3DSend(IXAudio2Voice* output, const float* matrix,
+    uint32_t dst, float lpf) noexcept {
+    const auto state = m_pSpatial;
+    if (!state || !m_pSourceVoice) return;
+    // X3DAudio: 系数 c 对应 2 * sin(pi / 6 * c)
+    constexpr float pi_6 = 3.141592654f / 6.f;
+    m_pSourceVoice->SetOutputMatrix(output, state->src, dst, matrix);
+    if (state->flags & Flag3D_LPFDirect) {
+        const XAUDIO2_FILTER_PARAMETERS filter = { LowPassFilter, 2.f * std::sin(pi_6 * lpf), 1.f };
+        m_pSourceVoice->SetOutputFilterParameters(output, &filter);
+    }
+}
+
+/// <summary>
+/// Folds elapsed time of virtual playing into position.
+/// </summary>
+/// <param name="now">The now.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::fold_virtual(double now) noexcept {
+    if (m_bPlaying) m_iPosBase += int64_t((now - m_dVirtualTime) *
+        double(this->wave.nSamplesPerSec) * double(this->ratio()));
+    m_dVirtualTime = now;
+}
+
+/// <summary>
+/// Attaches the voice acquired from voice pool.
+/// </summary>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::AttachVoice(CALPooledVoice& voice) noexcept {
+    m_pPooledVoice = &voice;
+    m_pSourceVoice = voice.voice;
+    // 虚拟时保留位置, 去虚拟化时重新计算
+    if (m_bVirtual) return;
+    // 回收的声音保留了上个片段的滤波器
+    this->filter_direct();
+    // 回收的声音保留了已播放的采样数
+    XAUDIO2_VOICE_STATE state; state.SamplesPlayed = 0;
+    m_pSourceVoice->GetState(&state);
+    m_iPosBase = -int64_t(state.SamplesPlayed);
+    if (m_pRing) m_pRing->submit_end = state.SamplesPlayed;
+}
+
+/// <summary>
+/// Releases the voice, keeps advancing position, under voice lock of engine.
+/// 虚拟化: 归还声音, 位置继续按时间推进
+/// </summary>
+/// <param name="now">The now.</param>
+/// <returns>false if virtual already or voice not pooled</returns>
+bool WrapAL::CALAudioSourceClipImpl::Virtualize(double now) noexcept {
+    if (m_bVirtual || !m_pPooledVoice) return false;
+    auto pos = this->position();
+    const auto len = this->length();
+    if (pos < 0) pos = 0;
+    if (len && (this->flags & WrapAL::Flag_LoopInfinite)) pos %= len;
+    // 归还后不再有回调, 再取消解码
+    WrapALAudioEngine.recycle_voice(*m_pPooledVoice);
+    m_pPooledVoice = nullptr;
+    m_pSourceVoice = nullptr;
+    // 已提交的槽不会再有回调归还
+    if (m_pRing) {
+        WrapALAudioEngine.decode_pool().Cancel(*this);
+        m_pRing->Drop();
+    }
+    m_iPosBase = pos;
+    m_dVirtualTime = now;
+    m_bEOB = false;
+    m_bVirtual = true;
+    return true;
+}
+
+/// <summary>
+/// Plays with voice again at position now, voice attached.
+/// 去虚拟化: 从当前位置继续播放
+/// </summary>
+/// <param name="now">The now.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::Devirtualize(double now) noexcept -> HRESULT {
+    assert(m_bVirtual && m_pSourceVoice && "attach voice first");
+    this->fold_virtual(now);
+    auto pos = m_iPosBase.load();
+    const auto len = this->length();
+    if (pos < 0) pos = 0;
+    if (len) pos %= len;
+    m_pSourceVoice->SetVolume(m_fVolume * m_fDirect);
+    this->filter_direct();
+    m_pSourceVoice->SetFrequencyRatio(this->ratio());
+    m_bVirtual = false;
+    auto hr = this->submit_from(uint32_t(pos));
+    if (SUCCEEDED(hr) && m_bPlaying) hr = m_pSourceVoice->Start(0);
+    return hr;
+}
+
+/// <summary>
+/// Advances the virtual position.
+/// 推进虚拟位置
+/// </summary>
+/// <param name="now">The now.</param>
+/// <returns>false if played to the end</returns>
+bool WrapAL::CALAudioSourceClipImpl::AdvanceVirtual(double now) noexcept {
+    assert(m_bVirtual);
+    this->fold_virtual(now);
+    if (!m_bPlaying || (this->flags & WrapAL::Flag_LoopInfinite)) return true;
+    if (m_iPosBase.load() < int64_t(this->length())) return true;
+    this->end_of_playing();
+    return false;
+}
+
 /// <summary>
 /// Durations this instance.
 /// </summary>
@@ -192,7 +732,7 @@ auto WrapAL::CALAudioSourceClipImpl::Duration() const noexcept ->float {
         length = m_pStream->GetSizeInByte();
     }
     else {
-        length = m_uBufferIndex;
+        length = m_uBufferLength;
     }
     // 计算
     double l = static_cast<double>(length);
@@ -203,37 +743,45 @@ auto WrapAL::CALAudioSourceClipImpl::Duration() const noexcept ->float {
 
 // 音频处理开始
 void WrapAL::CALAudioSourceClipImpl::OnVoiceProcessingPassStart(UINT32 SamplesRequired) noexcept {
-    if (SamplesRequired && this->IsPlaying()) {
-        // 流模式
-        if (this->flags & WrapAL::Flag_StreamingReading) {
-            m_pSourceVoice->FlushSourceBuffers();
-            auto id = m_uBufferIndex + 1;
-            if (id >= StreamingBufferCount) id -= StreamingBufferCount;
-#ifndef NDEBUG
-            //std::wprintf(L"%d", id);
-#endif
-            // [0, StreamingBufferCount)
-            assert(id >= 0 && id < StreamingBufferCount && "out of range");
-            this->LoadAndBufferData(id);
-        }
+    if (!m_pRing || !this->IsPlaying()) return;
+    // 流模式: 只提交已经解码的数据
+    if (m_pRing->decoded.load()) {
+        m_bStarved = false;
+        this->SubmitStream();
+    }
+    // 需要数据却未解码: 欠载, 每次断流计一次, 重置后等待解码不计
+    else if (SamplesRequired && !m_bStreamEnd && !m_bStarved
+        && m_pRing->submit_generation == m_pRing->generation.load()) {
+        m_bStarved = true;
+        m_cUnderrun.fetch_add(1, std::memory_order_relaxed);
+        CALPerfCounters::AddUnderrun();
     }
-
 }
 
 // 音频流结束
 void WrapAL::CALAudioSourceClipImpl::OnStreamEnd() noexcept {
+    this->end_of_playing();
     // 自动释放?
-    if (this->flags & WrapAL::Flag_AutoDestroyEOP) {
-        m_bPlaying = false;
-        return;
+    if (this->flags & WrapAL::Flag_AutoDestroyEOP) return;
+    // 流模式: 在解码线程中回到开头(无限轮回在解码时处理)
+    if (m_pRing) {
+        m_pRing->rewind = true;
+        WrapALAudioEngine.decode_pool().Request(*this);
     }
-    // 流模式 + 无线轮回
-    if (this->flags & (WrapAL::Flag_StreamingReading | WrapAL::Flag_LoopInfinite)) {
-        // = 重置
-        this->m_pStream->Seek(0);
-    }
-    else {
-        m_bPlaying = false;
+}
+
+/// <summary>
+/// Played to the end, push to end list of engine.
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::end_of_playing() noexcept {
+    m_bPlaying = false;
+    // 流结束后已播放采样数归零
+    m_iPosBase = 0;
+    // 加入结束队列, 在 Update 中通知(与自动释放)
+    if (!m_bEnded.exchange(true)) {
+        if (this->AddRefIfAlive()) WrapALAudioEngine.end_clip(*this);
+        else m_bEnded = false;
     }
 }
 
@@ -242,19 +790,35 @@ void WrapAL::CALAudioSourceClipImpl::OnStreamEnd() noexcept {
 /// </summary>
 /// <returns></returns>
 void WrapAL::CALAudioSourceClipImpl::Terminate() noexcept {
-    m_pSourceVoice->Stop(0);
-    m_pSourceVoice->FlushSourceBuffers();
+    if (m_pSourceVoice) {
+        m_pSourceVoice->Stop(0);
+        m_pSourceVoice->FlushSourceBuffers();
+    }
     m_bPlaying = false;
     m_bEOB = false;
 }
 
 // 缓冲区结束
 void WrapAL::CALAudioSourceClipImpl::OnBufferEnd(void* pBufferContext) noexcept {
+    // 静音前导
+    if (pBufferContext == LeadInContext) return;
     m_bEOB = true;
-    if (this->flags & WrapAL::Flag_StreamingReading) {
-        // todo
+    if (m_pRing) {
+        auto& ring = *m_pRing;
+        const auto index = uint32_t(reinterpret_cast<size_t>(pBufferContext) % StreamingBufferMaxCount);
+        // 换过数据的旧缓冲区不计入
+        if (pBufferContext != WrapAL::StreamContext(ring.epoch, index)) return;
+        // 截断时重新提交的槽, 所有缓冲区结束后归还
+        if (--ring.slot[index].queued) return;
+        // 槽在结束前不会重新解码, 旧世代的(Seek时刷新)只归还
+        const bool current = ring.slot[index].generation == ring.generation.load();
+        ring.free.fetch_or(uint32_t(1) << index);
+        // 下一段已解码则立即提交
+        if (current && ring.decoded.load() && this->IsPlaying()) this->SubmitStream();
+        WrapALAudioEngine.decode_pool().Request(*this);
     }
-    else {
+    // 旧的缓冲区(Seek时刷新)不计入
+    else if (pBufferContext == reinterpret_cast<void*>(size_t(m_uGeneration.load()))) {
         m_bPlaying = false;
     }
 }
@@ -271,33 +835,216 @@ auto WrapAL::CALAudioSourceClipImpl::ProcessBufferData(
     if (eos) {
         buffer.Flags = XAUDIO2_END_OF_STREAM;
     }
-    // 流模式
-    if (flags & WrapAL::Flag_StreamingReading) {
-        // todo
-    }
-    else {
-        // 无限轮回?
-        if (flags & WrapAL::Flag_LoopInfinite) {
-            buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
-        }
+    // 无限轮回? 流模式的轮回在解码环中处理
+    if (!(flags & WrapAL::Flag_StreamingReading) && (flags & WrapAL::Flag_LoopInfinite)) {
+        buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
     }
     // 提交
     return this->m_pSourceVoice->SubmitSourceBuffer(&buffer);
 }
 
 /// <summary>
-/// Loads the and buffer data.
-/// 读取下一段
+/// Creates the decoded ring for streaming.
+/// 创建解码环
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::CreateStreamRing() noexcept -> HRESULT {
+    assert(!m_pRing && m_pStream && "bad action");
+    constexpr size_t blen = StreamingBufferSize * StreamingBufferCount;
+    auto ring = reinterpret_cast<AudioStreamRing*>(std::malloc(sizeof(AudioStreamRing)));
+    auto data = reinterpret_cast<uint8_t*>(std::malloc(blen));
+    if (!ring || !data) {
+        std::free(ring);
+        std::free(data);
+        return E_OUTOFMEMORY;
+    }
+    m_pRing = new(ring) AudioStreamRing;
+    m_pRing->data = data;
+    m_pRing->priority = WrapAL::GetDecodePriority(this->flags);
+    CALPerfCounters::AddClipMemory(blen);
+    return S_OK;
+}
+
+/// <summary>
+/// Sets size/count of the streaming buffer, keeps the position.
+/// 运行时调整流缓冲区
+/// </summary>
+/// <param name="size">The size of each buffer in byte.</param>
+/// <param name="count">The count of buffers.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::SetStreamingBuffer(uint32_t size, uint32_t count) noexcept -> HRESULT {
+    assert(m_pRing && "streaming only");
+    if (!m_pRing) return E_INVALIDARG;
+    // 对齐到块
+    size -= size % this->wave.nBlockAlign;
+    if (size < StreamingBufferMinSize || count < 2 || count > StreamingBufferMaxCount) {
+        return E_INVALIDARG;
+    }
+    auto& ring = *m_pRing;
+    if (size == ring.size && count == ring.count) return S_OK;
+    const auto data = reinterpret_cast<uint8_t*>(std::malloc(size_t(size) * count));
+    if (!data) return E_OUTOFMEMORY;
+    // 虚拟时没有声音, 去虚拟化时重新解码
+    const bool real = !m_bVirtual;
+    // 保留位置
+    auto pos = this->position();
+    const auto len = this->length();
+    if (pos < 0) pos = 0;
+    if (len) pos %= len;
+    // 旧的缓冲区不再使用, 断开回调使音频线程不再访问解码环
+    if (real) {
+        m_pSourceVoice->Stop(0);
+        m_pSourceVoice->FlushSourceBuffers();
+        m_pPooledVoice->Detach();
+    }
+    uint8_t* old = nullptr;
+    {
+        // 只等待解码线程解码完当前的槽
+        ring.reset = true;
+        std::lock_guard<std::mutex> locker(ring.mutex);
+        CALPerfCounters::AddClipMemory(int64_t(size) * count - int64_t(ring.size) * ring.count);
+        old = ring.data;
+        ring.data = data;
+        ring.size = size;
+        ring.count = count;
+        ++ring.epoch;
+        ring.Drop();
+    }
+    // 刷新的缓冲区可能仍在读取旧的数据, 其回调因 epoch 而忽略
+    WrapALAudioEngine.retire_memory(nullptr, old);
+    // 重新解码
+    if (real) {
+        m_pPooledVoice->Attach(*this);
+        this->submit_from(uint32_t(pos));
+        if (m_bPlaying) m_pSourceVoice->Start(0);
+    }
+    return S_OK;
+}
+
+/// <summary>
+/// Resets the stream to position, decoded by decode pool and submitted in callbacks.
+/// 重置流: 作废已解码的数据, 解码线程从指定位置解码, 不锁定解码环
+/// </summary>
+/// <param name="pos">The position in byte.</param>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::ResetStream(uint32_t pos) noexcept {
+    assert(m_pRing && "bad action");
+    auto& ring = *m_pRing;
+    // 先写位置再换代, 解码线程读到新世代时位置也是新的
+    ring.seek = pos;
+    ++ring.generation;
+    ring.reset = true;
+    WrapALAudioEngine.decode_pool().Request(*this);
+}
+
+/// <summary>
+/// Decodes free slots of the ring, called by decode pool.
+/// 解码空闲槽
 /// </summary>
-/// <param name="id">The identifier.</param>
 /// <returns></returns>
-auto WrapAL::CALAudioSourceClipImpl::LoadAndBufferData(uint16_t id) noexcept ->HRESULT {
-    assert(m_pStream);
-    XAUDIO2_BUFFER buffer = { 0 };
-    buffer.AudioBytes = StreamingBufferSize;
-    auto data = m_pAudioData + StreamingBufferSize * (m_uBufferIndex = id);
-    buffer.pAudioData = data;
-    // 已读取
-    auto read = m_pStream->ReadNext(StreamingBufferSize, data);
-    return this->ProcessBufferData(buffer, read != StreamingBufferSize);
+void WrapAL::CALAudioSourceClipImpl::DecodeStream() noexcept {
+    std::lock_guard<std::mutex> locker(m_pRing->mutex);
+    this->decode_ring();
+}
+
+/// <summary>
+/// Decodes free slots of the ring, under lock of ring.
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALAudioSourceClipImpl::decode_ring() noexcept {
+    auto& ring = *m_pRing;
+    // 重置: 收回未提交的槽, 从指定位置解码
+    if (ring.reset.exchange(false)) {
+        ring.decode_generation = ring.generation.load();
+        const auto pos = ring.seek.load();
+        // 音频线程逐个领取, 收回的是最后解码的几个
+        auto count = ring.decoded.exchange(0);
+        uint32_t mask = 0;
+        for (; count; --count) {
+            ring.decode_index = (ring.decode_index + ring.count - 1) % ring.count;
+            mask |= uint32_t(1) << ring.order[ring.decode_index];
+        }
+        ring.free.fetch_or(mask);
+        ring.rewind = false;
+        m_pStream->Seek(pos);
+        ring.end = false;
+    }
+    // 播放结束后回到开头
+    if (ring.rewind.exchange(false)) {
+        m_pStream->Seek(0);
+        ring.end = false;
+    }
+    // 有重置则尽快结束, 让出锁
+    while (!ring.end && !ring.reset.load()) {
+        const auto free = ring.free.load();
+        if (!free) break;
+        const auto index = WrapAL::LowestBit(free);
+        ring.free.fetch_and(~(uint32_t(1) << index));
+        const auto data = ring.data + ring.size * index;
+        auto read = m_pStream->ReadNext(ring.size, data);
+        // 无限轮回: 回到开头补满
+        if (read != ring.size && (this->flags & WrapAL::Flag_LoopInfinite)) {
+            m_pStream->Seek(0);
+            read += m_pStream->ReadNext(ring.size - read, data + read);
+        }
+        const bool eos = read != ring.size;
+        // 不能提交空缓冲区
+        if (!read) {
+            read = this->wave.nBlockAlign;
+            std::memset(data, 0, read);
+        }
+        ring.slot[index].length = read;
+        ring.slot[index].generation = ring.decode_generation;
+        ring.slot[index].eos = eos;
+        ring.order[ring.decode_index] = uint8_t(index);
+        ring.decode_index = (ring.decode_index + 1) % ring.count;
+        ring.end = eos;
+        ++ring.decoded;
+    }
+}
+
+/// <summary>
+/// Submits decoded slots of the ring.
+/// 提交已解码数据
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioSourceClipImpl::SubmitStream() noexcept -> HRESULT {
+    auto& ring = *m_pRing;
+    const auto generation = ring.generation.load();
+    HRESULT hr = S_OK;
+    bool dropped = false;
+    while (true) {
+        // 领取一个, 解码线程重置时会收回未领取的
+        auto count = ring.decoded.load();
+        while (count && !ring.decoded.compare_exchange_weak(count, count - 1));
+        if (!count) break;
+        const auto index = uint32_t(ring.order[ring.submit_index]);
+        ring.submit_index = (ring.submit_index + 1) % ring.count;
+        auto& slot = ring.slot[index];
+        // 旧世代的数据: 丢弃
+        if (slot.generation != generation) {
+            ring.free.fetch_or(uint32_t(1) << index);
+            dropped = true;
+            continue;
+        }
+        XAUDIO2_BUFFER buffer = { 0 };
+        buffer.pAudioData = ring.data + ring.size * index;
+        buffer.AudioBytes = slot.length;
+        buffer.pContext = WrapAL::StreamContext(ring.epoch, index);
+        if (FAILED(hr = this->ProcessBufferData(buffer, slot.eos))) {
+            ring.free.fetch_or(uint32_t(1) << index);
+            break;
+        }
+        // 记录提交的范围, 截断时使用
+        const auto frames = slot.length / this->wave.nBlockAlign;
+        ring.sent[ring.sent_index] = { index, 0, frames };
+        ring.sent_index = (ring.sent_index + 1) % StreamingBufferMaxCount;
+        ring.submit_end += frames;
+        slot.queued = 1;
+        ring.submit_generation = generation;
+        m_bStreamEnd = slot.eos;
+    }
+    // 丢弃的槽可以解码新的数据
+    if (dropped) WrapALAudioEngine.decode_pool().Request(*this);
+    return hr;
 }
@@ -31,12 +31,18 @@
 #include <cassert>
 // for atomic
 #include <atomic>
+// for steady_clock
+#include <chrono>
 // include the config
 #include "wrapalconf.h"
 // include the config
 #include "wrapal_common.h"
 // WrapAL interface
 #include "AudioInterface.h"
+// decode pool
+#include "AudioDecoder.h"
+// voice pool
+#include "AudioVoicePool.h"
 
 // XAudio
 #ifdef WRAPAL_XAUDIO2_7_SUPPORT
@@ -50,10 +56,83 @@ namespace WrapAL { using namespace xaudio2_8; }
 
 // wrapal namespace
 namespace WrapAL {
+    // now in sec.
+    static inline auto now_sec() noexcept -> double {
+        using namespace std::chrono;
+        return duration<double>(steady_clock::now().time_since_epoch()).count();
+    }
     // Audio Source Clip Handle
     class CALAudioSourceClip;
     // impl for group
     struct AudioSourceGroupImpl;
+    // 3D state of clip for one of listeners
+    struct Clip3DListener {
+        // volume of distance curve and cones
+        float                   volume;
+        // LPF coefficient of direct path
+        float                   lpf_direct;
+        // azimuth in listener space
+        float                   azimuth;
+        // 1 for panned, 0 for spread to all speakers
+        float                   focus;
+        // half angle of channels of multi-channel clip
+        float                   spread;
+    };
+    // 3D state of clip, written by CALAudioEngine::Update3D under voice lock
+    struct Clip3DState {
+        // reverb group routed to, null for none
+        AudioSourceGroupImpl*   reverb_group;
+        // Audio3DFlag applied
+        uint32_t                flags;
+        // channels of source
+        uint32_t                src;
+        // channels of output voice
+        uint32_t                dst;
+        // LPF coefficient of direct path
+        float                   lpf_direct;
+        // LPF coefficient of reverb path
+        float                   lpf_reverb;
+        // reverb send level
+        float                   reverb;
+        // volume of distance curve and cones
+        float                   volume;
+        // HRTF measurement of direction
+        uint32_t                filter;
+        // slot of binaural bus, index + 1, 0 for none
+        uint32_t                slot;
+        // generation of binaural buses of slot
+        uint32_t                slot_gen;
+        // generation of ambisonic bus routed to, 0 for none
+        uint32_t                ambisonic;
+        // cluster premixed into, index + 1, 0 for none
+        uint32_t                cluster;
+        // generation of clusters of cluster
+        uint32_t                cluster_gen;
+        // generation of listener outputs routed to, 0 for none
+        uint32_t                listener_gen;
+        // azimuth in listener space
+        float                   azimuth;
+        // elevation in listener space
+        float                   elevation;
+        // 1 for panned, 0 for spread to all speakers
+        float                   focus;
+        // half angle of channels of multi-channel clip
+        float                   spread;
+        // occlusion, 0 to 1
+        float                   occlusion;
+        // obstruction, 0 to 1
+        float                   obstruction;
+        // target gain of direct path, smoothed to in audio thread
+        float                   direct_gain;
+        // target LPF coefficient of voice filter, smoothed to in audio thread
+        float                   direct_lpf;
+        // in smoothing list of engine
+        uint32_t                smoothing;
+        // output matrix, [dst * src + s]
+        float                   matrix[Spatial3DMaxChannels * Spatial3DMaxChannels];
+        // state for each listener with own output
+        Clip3DListener          listener[Listener3DMaxCount];
+    };
     // Audio Source Clip implement
     class CALAudioSourceClipImpl final : public Node,
         public IXAudio2VoiceCallback {
@@ -69,8 +148,8 @@ namespace WrapAL {
         // Called when this voice has just finished processing a buffer.
         // The buffer can now be reused or destroyed.
         void STDMETHODCALLTYPE OnBufferEnd(void * pBufferContext) noexcept override;
-        // Called when this voice has just reached the end position of a loop.
-        void STDMETHODCALLTYPE OnLoopEnd(void * pBufferContext) noexcept override { m_bPlaying = false; }
+        // Called when this voice has just reached the end position of a loop, still playing the next loop.
+        void STDMETHODCALLTYPE OnLoopEnd(void * pBufferContext) noexcept override { }
         // Called in the event of a critical error during voice processing,
         // such as a failing xAPO or an error from the hardware XMA decoder.
         // The voice may have to be destroyed and re-created to recover from
@@ -78,6 +157,8 @@ namespace WrapAL {
         // processed when the error occurred, and its HRESULT code.
         void STDMETHODCALLTYPE OnVoiceError(void * pBufferContext, HRESULT Error) noexcept override { }
     public:
+        // no schedule for play_at/stop_at
+        static constexpr uint64_t NoSchedule = ~uint64_t(0);
         // Acquire stream
         static inline auto Acquire(XALAudioStream* steam) noexcept {
             if (steam) steam->AddRef(); return steam;
@@ -102,34 +183,96 @@ namespace WrapAL {
         bool IsPlaying() const noexcept { return m_bPlaying; }
         // is end of buufer
         bool IsEndOfBuffer() const noexcept { return m_bEOB; }
+        // is virtual, without voice
+        bool IsVirtual() const noexcept { return m_bVirtual; }
         // set volume
-        auto SetVolume(float v) noexcept { return m_pSourceVoice->SetVolume(v); }
+        void SetVolume(float v) noexcept { m_fVolume = v; if (m_pSourceVoice) m_pSourceVoice->SetVolume(v * m_fDirect); }
+        // set gain and LPF coefficient of direct path for occlusion, under voice lock of engine
+        void SetDirect(float gain, float lpf) noexcept;
+        // get gain of direct path
+        auto GetDirectGain() const noexcept { return m_fDirect; }
+        // get LPF coefficient of voice filter
+        auto GetDirectLPF() const noexcept { return m_fDirectLPF; }
+        // get count of streaming buffer underruns
+        auto GetUnderruns() const noexcept { return m_cUnderrun.load(std::memory_order_relaxed); }
         // set frequency ratio
-        auto SetFrequencyRatio(float f) noexcept { 
-            return m_pSourceVoice->SetFrequencyRatio(f); 
-        }
+        void SetFrequencyRatio(float f) noexcept;
         // get volume
-        auto GetVolume() const noexcept { 
-            float v = 0.f; m_pSourceVoice->GetVolume(&v); return v;
-        }
+        auto GetVolume() const noexcept { return m_fVolume.load(); }
+        // set volume of last queued command, on pushing thread
+        void QueueVolume(float v) noexcept { m_fQueuedVolume.store(v, std::memory_order_relaxed); }
+        // get volume of last queued command, volume that clip will have after commands run
+        auto GetQueuedVolume() const noexcept { return m_fQueuedVolume.load(std::memory_order_relaxed); }
         // get frequency ratio
-        auto GetFrequencyRatio() const noexcept { 
-            float f = 0.f; m_pSourceVoice->GetFrequencyRatio(&f); return f;
+        auto GetFrequencyRatio() const noexcept { return m_fRatio.load(); }
+        // set doppler factor, multiplied to frequency ratio
+        void SetDoppler(float d) noexcept;
+        // get 3D state, created on first call, null if OOM
+        auto Spatial() noexcept ->Clip3DState*;
+        // get 3D state, null if never updated
+        auto GetSpatial() const noexcept { return m_pSpatial; }
+        // apply 3D state to voice, direct path to output with matrix(null to keep), reverb send to reverb(null for none)
+        void Apply3D(IXAudio2Voice* output, const float* matrix, uint32_t dst, IXAudio2Voice* reverb, uint32_t reverb_channels) noexcept;
+        // apply matrix and LPF coefficient of send to output of one listener
+        void Apply3DSend(IXAudio2Voice* output, const float* matrix, uint32_t dst, float lpf) noexcept;
+        // flags of source voice for clip flags
+        static auto VoiceFlags(AudioClipFlag f) noexcept -> uint32_t {
+            return (f & Flag_3D) ? XAUDIO2_VOICE_USEFILTER : 0;
         }
+        // set priority, higher is more important
+        void SetPriority(uint8_t p) noexcept { m_uPriority = p; }
+        // get priority
+        auto GetPriority() const noexcept { return m_uPriority.load(); }
+        // set attenuation(distance gain) for voice budget
+        void SetAttenuation(float a) noexcept { m_fAttenuation = a; }
+        // get attenuation
+        auto GetAttenuation() const noexcept { return m_fAttenuation.load(); }
         // play
-        void Play() noexcept { m_pSourceVoice->Start(0); m_bPlaying = true; }
+        void Play() noexcept;
         // stop
-        void Stop() noexcept { m_pSourceVoice->Stop(0); m_bPlaying = false; }
+        void Stop() noexcept;
+        // queue silence(in frame) before data, so Play starts inside a pass, stopped clip only
+        void PrepareLeadIn(uint32_t frames) noexcept;
+        // cut data queued after frames, so StopAndRewind on next pass is heard inside this pass, playing clip only
+        void PrepareStop(uint32_t frames) noexcept;
+        // stop and rewind to the beginning, safe in audio thread
+        void StopAndRewind() noexcept;
         // terminate
         void Terminate() noexcept;
         // add ref-count
         auto AddRef() noexcept { return ++m_cRefCount; }
         // Release
         auto Release() noexcept ->uint32_t;
+        // release without destroying, caller should call Destroy if 0 returned
+        auto ReleaseLater() noexcept ->uint32_t;
+        // destroy this clip
+        void Destroy() noexcept { this->destroy(); }
+        // add ref-count if not 0, for audio thread
+        bool AddRefIfAlive() noexcept;
+        // add ref-count if handle not released by user, for finding by handle
+        bool AddRefIfHandle() noexcept { return m_cHandleRef.load() && this->AddRefIfAlive(); }
+        // add ref-count held by handle, false if handle released by user
+        bool AddHandleRef() noexcept;
+        // release ref-count held by handle, false if handle released by user
+        bool ReleaseHandleRef() noexcept;
+        // take the ref-count owned by engine for Flag_AutoDestroyEOP, only once
+        bool TakeAutoRef() noexcept { return m_bAutoRef.exchange(false); }
+        // end of playing had been handled
+        void ClearEnded() noexcept { m_bEnded = false; }
         // buffer the data
         auto ProcessBufferData(XAUDIO2_BUFFER&, bool = true) noexcept ->HRESULT;
-        // load next data and buffer it for streaming
-        auto LoadAndBufferData(uint16_t id) noexcept ->HRESULT;
+        // create decoded ring for streaming
+        auto CreateStreamRing() noexcept ->HRESULT;
+        // set size/count of streaming buffer, keep position
+        auto SetStreamingBuffer(uint32_t size, uint32_t count) noexcept ->HRESULT;
+        // get decoded ring for streaming
+        auto GetStreamRing() const noexcept { return m_pRing; }
+        // seek stream in byte, ring refilled by decode pool and submitted in callbacks
+        void ResetStream(uint32_t pos) noexcept;
+        // decode free slots of ring, called by decode pool
+        void DecodeStream() noexcept;
+        // submit decoded slots of ring, audio thread
+        auto SubmitStream() noexcept ->HRESULT;
         // isok
         bool IsOK() const noexcept { return !!m_pStream; }
         // has source
@@ -138,18 +281,44 @@ namespace WrapAL {
         template<typename T> auto SetOutputVoices(T t) noexcept {
             return m_pSourceVoice->SetOutputVoices(t);
         }
-        // CreateSourceVoice
+        // attach voice acquired from voice pool
+        void AttachVoice(CALPooledVoice& voice) noexcept;
+        // release voice, keep advancing position, under voice lock of engine
+        bool Virtualize(double now) noexcept;
+        // play with voice again at position now, voice attached
+        auto Devirtualize(double now) noexcept ->HRESULT;
+        // advance virtual position, return false if played to the end
+        bool AdvanceVirtual(double now) noexcept;
+        // CreateSourceVoice, not pooled
         template<typename T> auto CreateSourceVoice(T eng) noexcept {
             return eng->CreateSourceVoice(
                 &m_pSourceVoice,
                 &wave,
-                0, XAUDIO2_DEFAULT_FREQ_RATIO,
+                CALAudioSourceClipImpl::VoiceFlags(flags), XAUDIO2_DEFAULT_FREQ_RATIO,
                 this, nullptr, nullptr
             );
         }
     private:
         // destroy this clip
         void destroy() noexcept;
+        // played to the end, push to end list of engine
+        void end_of_playing() noexcept;
+        // submit data from position in frame, after silence of lead(in frame)
+        auto submit_from(uint32_t frame, uint32_t lead = 0) noexcept ->HRESULT;
+        // submit silence in frame, context of buffers is LeadInContext
+        auto submit_silence(uint32_t frames) noexcept ->HRESULT;
+        // position in frame, not wrapped
+        auto position() const noexcept ->int64_t;
+        // length in frame
+        auto length() const noexcept ->uint32_t;
+        // fold elapsed time of virtual playing into position
+        void fold_virtual(double now) noexcept;
+        // frequency ratio x doppler, clamped
+        auto ratio() const noexcept ->float;
+        // set voice filter of direct path, Flag_3D only
+        void filter_direct() noexcept;
+        // decode free slots of ring, under lock of ring
+        void decode_ring() noexcept;
 #ifndef NDEBUG
     public:
         // v-table address
@@ -167,18 +336,70 @@ namespace WrapAL {
         IXAudio2SourceVoice*        m_pSourceVoice = nullptr;
         // audio stream for streaming
         XALAudioStream*             m_pStream = nullptr;
+        // voice from voice pool, null if not pooled
+        CALPooledVoice*             m_pPooledVoice = nullptr;
     public:
         // group of this
         AudioSourceGroupImpl*       group = nullptr;
+        // prev clip in member list of group, under voice lock of engine
+        CALAudioSourceClipImpl*     group_prev = nullptr;
+        // next clip in member list of group, under voice lock of engine
+        CALAudioSourceClipImpl*     group_next = nullptr;
+        // next clip in task list of engine(to destroy or ended)
+        CALAudioSourceClipImpl*     task_next = nullptr;
+        // handle of this in handle table of engine
+        ALHandle                    handle = ALInvalidHandle;
+        // next clip in schedule list of engine, audio thread
+        CALAudioSourceClipImpl*     schedule_next = nullptr;
+        // sample time of engine clock to play on, audio thread
+        uint64_t                    play_at = NoSchedule;
+        // sample time of engine clock to stop on, audio thread
+        uint64_t                    stop_at = NoSchedule;
+        // in schedule list of engine, audio thread
+        bool                        scheduled = false;
+        // paused by PauseAll of group, resumed by ResumeAll, audio thread
+        bool                        group_paused = false;
     private:
         // audio data
         uint8_t*                    m_pAudioData = nullptr;
         // audio length in byte
         uint32_t             const  m_uBufferLength = 0;
-        // buffer index for streaming
-        uint32_t                    m_uBufferIndex = 0;
+        // decoded ring for streaming
+        AudioStreamRing*            m_pRing = nullptr;
         // ref-count
-        uint32_t                    m_cRefCount = 1;
+        std::atomic<uint32_t>       m_cRefCount{ 1 };
+        // ref-count held by handle of user, included in ref-count, handle is stale if 0
+        std::atomic<uint32_t>       m_cHandleRef{ 1 };
+        // position base in frame: played + base, or position if virtual
+        std::atomic<int64_t>        m_iPosBase{ 0 };
+        // time of virtual position
+        double                      m_dVirtualTime = 0.0;
+        // silence queued before data in frame, until played
+        uint32_t                    m_uLeadIn = 0;
+        // generation of buffer in memory, buffer context of old generation is ignored
+        std::atomic<uint32_t>       m_uGeneration{ 0 };
+        // volume
+        std::atomic<float>          m_fVolume{ 1.f };
+        // volume of last queued command
+        std::atomic<float>          m_fQueuedVolume{ 1.f };
+        // frequency ratio
+        std::atomic<float>          m_fRatio{ 1.f };
+        // attenuation(distance gain)
+        std::atomic<float>          m_fAttenuation{ 1.f };
+        // doppler factor
+        std::atomic<float>          m_fDoppler{ 1.f };
+        // 3D state, null if never updated
+        Clip3DState*                m_pSpatial = nullptr;
+        // gain of direct path, multiplied to volume, under voice lock of engine
+        float                       m_fDirect = 1.f;
+        // LPF coefficient of voice filter, under voice lock of engine
+        float                       m_fDirectLPF = 1.f;
+        // count of streaming buffer underruns
+        std::atomic<uint32_t>       m_cUnderrun{ 0 };
+        // last buffer submitted is end of stream, audio thread
+        bool                        m_bStreamEnd = false;
+        // voice starved, counted once until data submitted, audio thread
+        bool                        m_bStarved = false;
     public:
         // flags
         AudioClipFlag        const  flags;
@@ -189,6 +410,14 @@ namespace WrapAL {
         std::atomic_bool            m_bEOB;
         // is playing
         std::atomic_bool            m_bPlaying ;
+        // in end list of engine
+        std::atomic_bool            m_bEnded{ false };
+        // engine owns a ref-count for Flag_AutoDestroyEOP
+        std::atomic_bool            m_bAutoRef;
+        // virtual, voice released
+        std::atomic_bool            m_bVirtual{ false };
+        // priority
+        std::atomic<uint8_t>        m_uPriority{ uint8_t(ClipDefaultPriority) };
 #if defined _M_IX86
 
 #elif defined _M_X64
@@ -0,0 +1,57 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "AudioCommand.h"
+
+/// <summary>
+/// Initializes a new instance of the <see cref="CALCommandQueue"/> class.
+/// </summary>
+WrapAL::CALCommandQueue::CALCommandQueue() noexcept : m_uEnqueue(0) {
+    for (uint32_t i = 0; i != CommandQueueLength; ++i) {
+        m_aCell[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+/// <summary>
+/// Pushes the command, in any thread.
+/// 压入命令, 任意线程
+/// </summary>
+/// <param name="command">The command.</param>
+/// <returns>false if full</returns>
+bool WrapAL::CALCommandQueue::Push(const AudioCommand& command) noexcept {
+    Cell* cell;
+    auto pos = m_uEnqueue.load(std::memory_order_relaxed);
+    while (true) {
+        cell = m_aCell + (pos & (CommandQueueLength - 1));
+        const auto seq = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<int32_t>(seq - pos);
+        // 空位: 抢占该位置
+        if (!diff) {
+            if (m_uEnqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        // 已满
+        else if (diff < 0) return false;
+        // 被其他线程抢占
+        else pos = m_uEnqueue.load(std::memory_order_relaxed);
+    }
+    cell->command = command;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+/// <summary>
+/// Pops the command, in consumer thread.
+/// 弹出命令, 仅消费线程
+/// </summary>
+/// <param name="command">The command.</param>
+/// <returns>false if empty</returns>
+bool WrapAL::CALCommandQueue::Pop(AudioCommand& command) noexcept {
+    const auto pos = m_uDequeue;
+    const auto cell = m_aCell + (pos & (CommandQueueLength - 1));
+    const auto seq = cell->sequence.load(std::memory_order_acquire);
+    // 尚未写入
+    if (static_cast<int32_t>(seq - (pos + 1)) < 0) return false;
+    command = cell->command;
+    cell->sequence.store(pos + CommandQueueLength, std::memory_order_release);
+    m_uDequeue = pos + 1;
+    return true;
+}
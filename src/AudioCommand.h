@@ -0,0 +1,142 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL command queue, clip control from any thread:
+    game threads -> CALCommandQueue(lock-free, bounded) -> audio thread
+
+the engine drains it once each processing pass(mix quantum).
+
+commands between BeginBatch/CommitBatch are collected in a batch of the
+calling thread, the batch is pushed as one command, so they are run in
+the same pass.
+
+PlayAt/StopAt commands carry a sample time of the engine clock, the clip
+waits in the schedule list of the engine until the pass of that time.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for atomic
+#include <atomic>
+// include the config
+#include "wrapalconf.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // Audio Source Clip implement
+    class CALAudioSourceClipImpl;
+    // Audio Source Group implement
+    struct AudioSourceGroupImpl;
+    // batch of commands
+    struct CommandBatch;
+    // command for clip
+    enum ClipCommand : uint32_t {
+        // play
+        Command_Play = 0,
+        // pause
+        Command_Pause,
+        // seek, value in sec.
+        Command_Seek,
+        // set volume, value
+        Command_Volume,
+        // set frequency ratio, value
+        Command_Ratio,
+        // set volume of group, value, target is group
+        Command_GroupVolume,
+        // run commands of batch, target is batch
+        Command_Batch,
+        // play on the pass starting at sample time, time
+        Command_PlayAt,
+        // stop on the first pass at or after sample time, time
+        Command_StopAt,
+        // pause playing clips of group and children, target is group, null for all
+        Command_GroupPause,
+        // play clips paused by Command_GroupPause, target is group, null for all
+        Command_GroupResume,
+        // stop and rewind clips of group and children, target is group, null for all
+        Command_GroupStop,
+    };
+    // command, clip is add-ref-ed while queued
+    struct AudioCommand {
+        // target
+        union {
+            // target clip
+            CALAudioSourceClipImpl* clip;
+            // target group, null for master
+            AudioSourceGroupImpl*   group;
+            // target batch
+            CommandBatch*           batch;
+        };
+        // command
+        ClipCommand             command;
+        // argument
+        union {
+            // value
+            float               value;
+            // sample time of engine clock
+            uint64_t            time;
+        };
+    };
+    // batch of commands
+    struct CommandBatch {
+        // next in list
+        CommandBatch*           next;
+        // commands
+        AudioCommand*           data;
+        // count of commands
+        uint32_t                count;
+        // capacity of commands
+        uint32_t                capacity;
+    };
+    // multi-producer single-consumer command queue, lock-free, bounded
+    class CALCommandQueue {
+        // cell of queue
+        struct Cell {
+            // sequence
+            std::atomic<uint32_t>   sequence;
+            // command
+            AudioCommand            command;
+        };
+        // length must be power of 2
+        static_assert((CommandQueueLength & (CommandQueueLength - 1)) == 0, "bad length");
+    public:
+        // ctor
+        CALCommandQueue() noexcept;
+        // push command in any thread, return false if full
+        bool Push(const AudioCommand& command) noexcept;
+        // pop command in consumer thread, return false if empty
+        bool Pop(AudioCommand& command) noexcept;
+    private:
+        // cells
+        Cell                            m_aCell[CommandQueueLength];
+        // enqueue position, shared by producers
+        alignas(64) std::atomic<uint32_t> m_uEnqueue;
+        // dequeue position, consumer only
+        alignas(64) uint32_t            m_uDequeue = 0;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "AudioDecoder.h"
+#include "AudioClip.h"
+#include "AudioPerf.h"
+#include <AudioEngine.h>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+// WrapAL 命名空间
+namespace WrapAL {
+    // later job first in heap
+    static inline bool operator <(const DecodeJob& a, const DecodeJob& b) noexcept {
+        if (a.priority != b.priority) return a.priority > b.priority;
+        return a.deadline > b.deadline;
+    }
+}
+
+/// <summary>
+/// Starts the workers.
+/// 启动解码线程
+/// </summary>
+/// <param name="count">The count, 0 for decoding inline.</param>
+/// <returns></returns>
+auto WrapAL::CALDecodePool::Start(uint32_t count) noexcept -> HRESULT {
+    assert(!m_cThread && "started");
+    assert(count <= DecodeThreadCount && "out of range");
+    m_bExit = false;
+    for (uint32_t i = 0; i != count; ++i) {
+        m_aThread[i] = std::thread(&CALDecodePool::thread_proc, this);
+        ++m_cThread;
+    }
+    return S_OK;
+}
+
+/// <summary>
+/// Stops the workers.
+/// 停止解码线程
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALDecodePool::Stop() noexcept {
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_bExit = true;
+    }
+    m_cv.notify_all();
+    for (uint32_t i = 0; i != m_cThread; ++i) m_aThread[i].join();
+    m_cThread = 0;
+    assert(!m_cJob && "clips not disposed");
+    std::free(m_pJob);
+    m_pJob = nullptr;
+    m_cJob = m_cJobCapacity = 0;
+}
+
+/// <summary>
+/// Requests decoding free slots of the clip.
+/// 请求解码, 音频线程调用, 只在锁内操作队列
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <returns></returns>
+void WrapAL::CALDecodePool::Request(CALAudioSourceClipImpl& clip) noexcept {
+    auto& ring = *clip.GetStreamRing();
+    // 没有线程: 直接解码
+    if (!m_cThread) return clip.DecodeStream();
+    // 截止时间: 已解码与已提交的数据播放完毕
+    const auto buffered = ring.count - WrapAL::CountBits(ring.free.load());
+    const auto bytes = double(buffered) * double(ring.size);
+    DecodeJob job;
+    job.clip = &clip;
+    job.priority = ring.priority;
+    job.deadline = WrapAL::now_us() + int64_t(bytes * 1e6 / double(clip.wave.nAvgBytesPerSec));
+    bool inline_decode = false;
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        if (m_bExit) return;
+        // 已在队列: 提前截止时间
+        if (ring.queued) {
+            const auto end = m_pJob + m_cJob;
+            const auto itr = std::find_if(m_pJob, end, [&clip](const DecodeJob& j) noexcept {
+                return j.clip == &clip;
+            });
+            assert(itr != end && "not found");
+            if (itr != end && job.deadline < itr->deadline) {
+                itr->deadline = job.deadline;
+                std::make_heap(m_pJob, end);
+            }
+            return;
+        }
+        // 内存不足时直接解码
+        if (!(ring.queued = this->push(job))) inline_decode = true;
+    }
+    if (inline_decode) return clip.DecodeStream();
+    m_cv.notify_one();
+}
+
+/// <summary>
+/// Cancels the job of the clip, waits if decoding it.
+/// 取消任务, 之后不会再访问该片段
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <returns></returns>
+void WrapAL::CALDecodePool::Cancel(CALAudioSourceClipImpl& clip) noexcept {
+    auto& ring = *clip.GetStreamRing();
+    std::unique_lock<std::mutex> locker(m_mutex);
+    if (ring.queued) {
+        const auto end = m_pJob + m_cJob;
+        const auto itr = std::find_if(m_pJob, end, [&clip](const DecodeJob& j) noexcept {
+            return j.clip == &clip;
+        });
+        assert(itr != end && "not found");
+        *itr = end[-1];
+        --m_cJob;
+        std::make_heap(m_pJob, m_pJob + m_cJob);
+        ring.queued = false;
+    }
+    m_cvDone.wait(locker, [&ring]() noexcept { return !ring.decoding; });
+}
+
+/// <summary>
+/// Pushes the job to heap.
+/// </summary>
+/// <param name="job">The job.</param>
+/// <returns>false if out of memory</returns>
+bool WrapAL::CALDecodePool::push(const DecodeJob& job) noexcept {
+    if (m_cJob == m_cJobCapacity) {
+        const auto capacity = m_cJobCapacity ? m_cJobCapacity * 2 : 16;
+        const auto ptr = std::realloc(m_pJob, sizeof(DecodeJob) * capacity);
+        if (!ptr) return false;
+        m_pJob = reinterpret_cast<DecodeJob*>(ptr);
+        m_cJobCapacity = capacity;
+    }
+    m_pJob[m_cJob++] = job;
+    std::push_heap(m_pJob, m_pJob + m_cJob);
+    return true;
+}
+
+/// <summary>
+/// Pops the job from heap.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALDecodePool::pop() noexcept -> DecodeJob {
+    assert(m_cJob && "no job");
+    std::pop_heap(m_pJob, m_pJob + m_cJob);
+    return m_pJob[--m_cJob];
+}
+
+/// <summary>
+/// Thread for decoding.
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALDecodePool::thread_proc() noexcept {
+    std::unique_lock<std::mutex> locker(m_mutex);
+    while (true) {
+        m_cv.wait(locker, [this]() noexcept { return m_cJob || m_bExit; });
+        if (m_bExit) break;
+        const auto job = this->pop();
+        auto& ring = *job.clip->GetStreamRing();
+        ring.queued = false;
+        ring.decoding = true;
+        // 解码时不持有队列锁
+        locker.unlock();
+        job.clip->DecodeStream();
+        locker.lock();
+        ring.decoding = false;
+        m_cvDone.notify_all();
+    }
+}
@@ -0,0 +1,217 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL decode pool, streaming clips decode ahead of the audio callback:
+    decode worker -> AudioStreamRing(decoded slots) -> callback submits only
+
+jobs are picked by priority first(music > ambience > one-shot), then by
+deadline(time when decoded data of the clip runs out), earlier first.
+
+seeking bumps generation of ring and requests a job, the worker seeks and
+takes back decoded slots, audio thread drops slots of old generation. slots
+of flushed buffers are freed in their OnBufferEnd, never decoded before it.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for atomic
+#include <atomic>
+// for thread
+#include <thread>
+// for mutex
+#include <mutex>
+// for condition_variable
+#include <condition_variable>
+// include the config
+#include "wrapalconf.h"
+// include the config
+#include "wrapal_common.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // Audio Source Clip implement
+    class CALAudioSourceClipImpl;
+    // priority of decoding, less is higher
+    enum DecodePriority : uint32_t {
+        // music, Flag_PriorityMusic
+        Priority_Music = 0,
+        // ambience, Flag_PriorityAmbience
+        Priority_Ambience,
+        // one-shot, none of above
+        Priority_OneShot,
+    };
+    // get decode priority from clip flags
+    inline auto GetDecodePriority(AudioClipFlag flags) noexcept {
+        if (flags & Flag_PriorityMusic) return Priority_Music;
+        if (flags & Flag_PriorityAmbience) return Priority_Ambience;
+        return Priority_OneShot;
+    }
+    // count of bits set
+    inline auto CountBits(uint32_t mask) noexcept {
+        uint32_t count = 0;
+        for (; mask; mask &= mask - 1) ++count;
+        return count;
+    }
+    // index of lowest bit set, mask not 0
+    inline auto LowestBit(uint32_t mask) noexcept {
+        uint32_t index = 0;
+        for (; !(mask & 1); mask >>= 1) ++index;
+        return index;
+    }
+    // decoded buffer ring of streaming clip
+    struct AudioStreamRing {
+        // slot of ring
+        struct Slot {
+            // length in byte
+            uint32_t    length;
+            // generation decoded for
+            uint32_t    generation;
+            // end of stream
+            bool        eos;
+            // buffers of it in voice(or flushed) not ended, freed at 0, audio thread only
+            uint8_t     queued;
+        };
+        // range of slot submitted
+        struct Sent {
+            // index of slot
+            uint32_t    index;
+            // first frame
+            uint32_t    begin;
+            // count of frames
+            uint32_t    frames;
+        };
+        // mask of all slots
+        auto Mask() const noexcept { return (uint32_t(1) << this->count) - 1; }
+        // drop all slots, no callback or decoding running
+        void Drop() noexcept {
+            this->decoded = 0;
+            this->free = this->Mask();
+            this->decode_index = this->submit_index = 0;
+            for (auto& x : this->slot) x.queued = 0;
+        }
+        // lock for decoding, never locked by audio thread
+        std::mutex              mutex;
+        // decoded data, count * size
+        uint8_t*                data = nullptr;
+        // size of each slot in byte
+        uint32_t                size = StreamingBufferSize;
+        // count of slots, [2, StreamingBufferMaxCount]
+        uint32_t                count = StreamingBufferCount;
+        // count of decoded slots not submitted yet, taken by audio thread one by one
+        std::atomic<uint32_t>   decoded{ 0 };
+        // mask of free slots, neither decoded nor submitted
+        std::atomic<uint32_t>   free{ (uint32_t(1) << StreamingBufferCount) - 1 };
+        // generation, slots decoded for old generation are dropped
+        std::atomic<uint32_t>   generation{ 0 };
+        // position in byte to decode from after reset
+        std::atomic<uint32_t>   seek{ 0 };
+        // rewind the stream before next decoding
+        std::atomic_bool        rewind{ false };
+        // take back decoded slots and seek before next decoding, generation bumped by setter
+        std::atomic_bool        reset{ false };
+        // version of data in buffer context, changed with callbacks detached and under "mutex"
+        uint32_t                epoch = 0;
+        // generation of slots decoding, under "mutex"
+        uint32_t                decode_generation = 0;
+        // index in "order" of next slot decoded, under "mutex"
+        uint32_t                decode_index = 0;
+        // index in "order" of next slot to submit, audio thread only
+        uint32_t                submit_index = 0;
+        // generation of last slot submitted, audio thread only
+        uint32_t                submit_generation = 0;
+        // index in "sent" of next range submitted, audio thread only
+        uint32_t                sent_index = 0;
+        // samples played of voice when data submitted runs out, audio thread only
+        uint64_t                submit_end = 0;
+        // priority of decoding
+        DecodePriority          priority = Priority_OneShot;
+        // stream reached end, under "mutex"
+        bool                    end = false;
+        // queued in decode pool, under lock of pool
+        bool                    queued = false;
+        // decoding by worker, under lock of pool
+        bool                    decoding = false;
+        // slots in decoding order, last "decoded" ones before "decode_index" not submitted
+        uint8_t                 order[StreamingBufferMaxCount];
+        // slots
+        Slot                    slot[StreamingBufferMaxCount];
+        // ranges submitted lately, the ones in voice are the last of them, audio thread only
+        Sent                    sent[StreamingBufferMaxCount];
+    };
+    // job of decode pool
+    struct DecodeJob {
+        // clip to decode
+        CALAudioSourceClipImpl* clip;
+        // priority
+        DecodePriority          priority;
+        // deadline in microsecond
+        int64_t                 deadline;
+    };
+    // decode pool
+    class CALDecodePool {
+    public:
+        // ctor
+        CALDecodePool() noexcept = default;
+        // dtor
+        ~CALDecodePool() noexcept { this->Stop(); }
+        // start workers, decode inline in Request if count is 0
+        auto Start(uint32_t count) noexcept ->HRESULT;
+        // stop workers
+        void Stop() noexcept;
+        // request decoding free slots of clip
+        void Request(CALAudioSourceClipImpl& clip) noexcept;
+        // cancel the job of clip, wait if decoding it
+        void Cancel(CALAudioSourceClipImpl& clip) noexcept;
+    private:
+        // thread for decoding
+        void thread_proc() noexcept;
+        // push job to heap, under lock
+        bool push(const DecodeJob& job) noexcept;
+        // pop job from heap, under lock
+        auto pop() noexcept ->DecodeJob;
+    private:
+        // lock for jobs
+        std::mutex                  m_mutex;
+        // condition for jobs
+        std::condition_variable     m_cv;
+        // condition for job done
+        std::condition_variable     m_cvDone;
+        // workers
+        std::thread                 m_aThread[DecodeThreadCount];
+        // count of workers
+        uint32_t                    m_cThread = 0;
+        // jobs, binary heap
+        DecodeJob*                  m_pJob = nullptr;
+        // count of jobs
+        uint32_t                    m_cJob = 0;
+        // capacity of jobs
+        uint32_t                    m_cJobCapacity = 0;
+        // exit workers
+        bool                        m_bExit = false;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,738 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <objbase.h>
+#include "AudioEffect.h"
+#include "AudioSIMD.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cwchar>
+#include <cmath>
+#include <new>
+
+#ifndef WAVE_FORMAT_IEEE_FLOAT
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#endif
+
+#ifndef WAVE_FORMAT_EXTENSIBLE
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+#endif
+
+// effect namespace
+namespace WrapAL { namespace effect {
+    // KSDATAFORMAT_SUBTYPE_IEEE_FLOAT
+    static const GUID SUBTYPE_IEEE_FLOAT = { 0x00000003, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 } };
+    // IID_IUnknown
+    static const GUID IID_UNKNOWN = { 0x00000000, 0x0000, 0x0000, { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 } };
+    // same guid?
+    static inline bool same_guid(const GUID& a, const GUID& b) noexcept { return !std::memcmp(&a, &b, sizeof(GUID)); }
+    // is 32-bit float, WAVEFORMATEXTENSIBLE included
+    static inline bool is_float(const WAVEFORMATEX& wave) noexcept {
+        if (wave.wBitsPerSample != 32) return false;
+        if (wave.wFormatTag == WAVE_FORMAT_IEEE_FLOAT) return true;
+        if (wave.wFormatTag != WAVE_FORMAT_EXTENSIBLE || wave.cbSize < 22) return false;
+        // Samples(2) + dwChannelMask(4) 之后是 SubFormat
+        GUID sub; std::memcpy(&sub, reinterpret_cast<const uint8_t*>(&wave + 1) + 6, sizeof(sub));
+        return same_guid(sub, SUBTYPE_IEEE_FLOAT);
+    }
+    // decibel to linear
+    static inline auto db_to_linear(float db) noexcept { return std::pow(10.f, db * 0.05f); }
+    // clamp
+    static inline auto clamp(float x, float lo, float hi) noexcept { return std::min(std::max(x, lo), hi); }
+    // 4 floats in a register, lanes of channels or filters
+    using simd::f4;
+    // load/store "n" lanes
+    using simd::load_lanes; using simd::store_lanes;
+    // max absolute value of samples
+    static inline auto peak_of(const float* data, uint32_t count) noexcept {
+        auto peak = f4::set(0.f);
+        uint32_t i = 0;
+        for (; i + 4 <= count; i += 4) peak = f4::max(peak, f4::load(data + i).abs());
+        auto value = peak.hmax();
+        for (; i != count; ++i) value = std::max(value, std::fabs(data[i]));
+        return value;
+    }
+    // multiply samples by gain
+    static inline void scale(float* data, uint32_t count, float gain) noexcept {
+        const auto g = f4::set(gain);
+        uint32_t i = 0;
+        for (; i + 4 <= count; i += 4) (f4::load(data + i) * g).store(data + i);
+        for (; i != count; ++i) data[i] *= gain;
+    }
+}}
+
+// ----------------------------------------------------------------------------
+// ------------------------------------- EQ -----------------------------------
+// ----------------------------------------------------------------------------
+
+namespace WrapAL { namespace effect {
+    // biquad equalizer, transposed direct form II, channels in SIMD lanes
+    class CALEffectEQ final : public CALAudioEffect {
+        // count of bands
+        enum : uint32_t { BandCount = EffectEQ::BandCount };
+        // coefficients of band, normalized by a0
+        struct Coef { float b0, b1, b2, a1, a2; };
+    public:
+        // ctor
+        CALEffectEQ() noexcept : CALAudioEffect(EffectType::Effect_EQ) {}
+        // dtor
+        ~CALEffectEQ() noexcept { std::free(m_pState); }
+    protected:
+        // allocate state: [group][band][z1 x4, z2 x4]
+        auto lock() noexcept ->HRESULT override {
+            m_cGroup = (this->channels + 3) / 4;
+            const auto count = size_t(m_cGroup) * BandCount * 8;
+            std::free(m_pState);
+            m_pState = reinterpret_cast<float*>(std::malloc(sizeof(float) * count));
+            if (!m_pState) return E_OUTOFMEMORY;
+            this->reset();
+            return S_OK;
+        }
+        // free state
+        void unlock() noexcept override { std::free(m_pState); m_pState = nullptr; }
+        // clear state
+        void reset() noexcept override {
+            if (m_pState) std::memset(m_pState, 0, sizeof(float) * m_cGroup * BandCount * 8);
+        }
+        // RBJ audio EQ cookbook
+        void update(const EffectParameters& param) noexcept override {
+            const auto nyquist = float(this->rate) * 0.49f;
+            for (uint32_t b = 0; b != BandCount; ++b) {
+                const auto& band = param.eq.bands[b];
+                const bool active = band.type != EQBandType::Band_Off;
+                // 新启用的频段清空状态
+                if (active && !m_bActive[b] && m_pState) {
+                    for (uint32_t g = 0; g != m_cGroup; ++g)
+                        std::memset(m_pState + (g * BandCount + b) * 8, 0, sizeof(float) * 8);
+                }
+                m_bActive[b] = active;
+                if (!active) continue;
+                const auto freq = clamp(band.frequency, 10.f, nyquist);
+                const auto w0 = 2.f * 3.14159265f * freq / float(this->rate);
+                const auto cosw = std::cos(w0);
+                const auto alpha = std::sin(w0) / (2.f * std::max(band.q, 0.05f));
+                const auto A = std::pow(10.f, clamp(band.gain, -48.f, 48.f) / 40.f);
+                const auto sqa = 2.f * std::sqrt(A) * alpha;
+                float b0, b1, b2, a0, a1, a2;
+                switch (band.type)
+                {
+                case EQBandType::Band_LowShelf:
+                    b0 = A * ((A + 1.f) - (A - 1.f) * cosw + sqa);
+                    b1 = 2.f * A * ((A - 1.f) - (A + 1.f) * cosw);
+                    b2 = A * ((A + 1.f) - (A - 1.f) * cosw - sqa);
+                    a0 = (A + 1.f) + (A - 1.f) * cosw + sqa;
+                    a1 = -2.f * ((A - 1.f) + (A + 1.f) * cosw);
+                    a2 = (A + 1.f) + (A - 1.f) * cosw - sqa;
+                    break;
+                case EQBandType::Band_HighShelf:
+                    b0 = A * ((A + 1.f) + (A - 1.f) * cosw + sqa);
+                    b1 = -2.f * A * ((A - 1.f) + (A + 1.f) * cosw);
+                    b2 = A * ((A + 1.f) + (A - 1.f) * cosw - sqa);
+                    a0 = (A + 1.f) - (A - 1.f) * cosw + sqa;
+                    a1 = 2.f * ((A - 1.f) - (A + 1.f) * cosw);
+                    a2 = (A + 1.f) - (A - 1.f) * cosw - sqa;
+                    break;
+                case EQBandType::Band_LowPass:
+                    b0 = (1.f - cosw) * 0.5f; b1 = 1.f - cosw; b2 = b0;
+                    a0 = 1.f + alpha; a1 = -2.f * cosw; a2 = 1.f - alpha;
+                    break;
+                case EQBandType::Band_HighPass:
+                    b0 = (1.f + cosw) * 0.5f; b1 = -(1.f + cosw); b2 = b0;
+                    a0 = 1.f + alpha; a1 = -2.f * cosw; a2 = 1.f - alpha;
+                    break;
+                default: // Band_Peak
+                    b0 = 1.f + alpha * A; b1 = -2.f * cosw; b2 = 1.f - alpha * A;
+                    a0 = 1.f + alpha / A; a1 = -2.f * cosw; a2 = 1.f - alpha / A;
+                    break;
+                }
+                m_aCoef[b] = { b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0 };
+            }
+        }
+        // 4 channels each pass, bands in cascade
+        void process(float* data, uint32_t frames) noexcept override {
+            const auto ch = this->channels;
+            for (uint32_t g = 0; g != m_cGroup; ++g) {
+                const auto lanes = std::min(ch - g * 4, 4u);
+                for (uint32_t b = 0; b != BandCount; ++b) {
+                    if (!m_bActive[b]) continue;
+                    const auto& k = m_aCoef[b];
+                    const auto b0 = f4::set(k.b0), b1 = f4::set(k.b1), b2 = f4::set(k.b2);
+                    const auto a1 = f4::set(k.a1), a2 = f4::set(k.a2);
+                    const auto state = m_pState + (g * BandCount + b) * 8;
+                    auto z1 = f4::load(state), z2 = f4::load(state + 4);
+                    auto p = data + g * 4;
+                    for (uint32_t f = 0; f != frames; ++f, p += ch) {
+                        const auto x = load_lanes(p, lanes);
+                        const auto y = b0 * x + z1;
+                        z1 = b1 * x - a1 * y + z2;
+                        z2 = b2 * x - a2 * y;
+                        store_lanes(y, p, lanes);
+                    }
+                    z1.store(state);
+                    z2.store(state + 4);
+                }
+            }
+        }
+    private:
+        // state
+        float*          m_pState = nullptr;
+        // count of 4-channel groups
+        uint32_t        m_cGroup = 0;
+        // coefficients
+        Coef            m_aCoef[BandCount];
+        // band active
+        bool            m_bActive[BandCount] = { false };
+    };
+}}
+
+// ----------------------------------------------------------------------------
+// ---------------------------- Compressor & Limiter --------------------------
+// ----------------------------------------------------------------------------
+
+namespace WrapAL { namespace effect {
+    // compressor/limiter, gain computed each block from peak of all channels
+    class CALEffectDynamics final : public CALAudioEffect {
+        // frames of block
+        enum : uint32_t { Block = EffectDynamicsBlock };
+    public:
+        // ctor
+        CALEffectDynamics(EffectType type) noexcept : CALAudioEffect(type) {}
+    protected:
+        // nothing to allocate
+        auto lock() noexcept ->HRESULT override { this->reset(); return S_OK; }
+        // nothing to free
+        void unlock() noexcept override {}
+        // clear state
+        void reset() noexcept override { m_fEnvelope = 0.f; m_fGain = 1.f; }
+        // coefficients of each block
+        void update(const EffectParameters& param) noexcept override {
+            const auto block_ms = float(Block) * 1000.f / float(this->rate);
+            const auto coef = [=](float ms) noexcept { return ms > 0.f ? std::exp(-block_ms / ms) : 0.f; };
+            if (this->GetType() == EffectType::Effect_Limiter) {
+                m_fThreshold = std::min(param.limiter.ceiling, 0.f);
+                m_fSlope = 1.f;
+                m_fKnee = 0.f;
+                m_fAttack = 0.f;
+                m_fRelease = coef(param.limiter.release);
+                m_fMakeup = 1.f;
+            }
+            else {
+                const auto& c = param.compressor;
+                m_fThreshold = c.threshold;
+                m_fSlope = 1.f - 1.f / std::max(c.ratio, 1.f);
+                m_fKnee = std::max(c.knee, 0.f);
+                m_fAttack = coef(c.attack);
+                m_fRelease = coef(c.release);
+                m_fMakeup = db_to_linear(c.makeup);
+            }
+        }
+        // gain of envelope, soft knee
+        auto gain_of(float envelope) const noexcept {
+            const auto level = 20.f * std::log10(std::max(envelope, 1e-6f));
+            const auto over = level - m_fThreshold;
+            float reduce = 0.f;
+            if (m_fKnee > 0.f && 2.f * std::fabs(over) <= m_fKnee) {
+                const auto x = over + m_fKnee * 0.5f;
+                reduce = m_fSlope * x * x / (2.f * m_fKnee);
+            }
+            else if (over > 0.f) reduce = m_fSlope * over;
+            return db_to_linear(-reduce);
+        }
+        // limiter: instant attack on peak of block, never over ceiling
+        void process(float* data, uint32_t frames) noexcept override {
+            const auto ch = this->channels;
+            const bool limiter = this->GetType() == EffectType::Effect_Limiter;
+            for (uint32_t f = 0; f < frames; f += Block) {
+                const auto n = std::min(frames - f, uint32_t(Block));
+                const auto p = data + f * ch;
+                const auto peak = peak_of(p, n * ch);
+                // 包络
+                if (limiter) m_fEnvelope = std::max(peak, m_fEnvelope * m_fRelease);
+                else {
+                    const auto coef = peak > m_fEnvelope ? m_fAttack : m_fRelease;
+                    m_fEnvelope = peak + coef * (m_fEnvelope - peak);
+                }
+                const auto target = this->gain_of(m_fEnvelope);
+                auto from = m_fGain;
+                if (limiter && target < from) from = target;
+                m_fGain = target;
+                // 增益不变时整块相乘
+                if (from == target) { scale(p, n * ch, target * m_fMakeup); continue; }
+                const auto step = (target - from) / float(n);
+                for (uint32_t i = 0; i != n; ++i) {
+                    const auto g = (from + step * float(i + 1)) * m_fMakeup;
+                    for (uint32_t c = 0; c != ch; ++c) p[i * ch + c] *= g;
+                }
+            }
+        }
+    private:
+        // envelope of peak
+        float           m_fEnvelope = 0.f;
+        // gain of last block
+        float           m_fGain = 1.f;
+        // threshold in dB
+        float           m_fThreshold = 0.f;
+        // 1 - 1/ratio
+        float           m_fSlope = 0.f;
+        // knee width in dB
+        float           m_fKnee = 0.f;
+        // attack coefficient of each block
+        float           m_fAttack = 0.f;
+        // release coefficient of each block
+        float           m_fRelease = 0.f;
+        // makeup gain, linear
+        float           m_fMakeup = 1.f;
+    };
+}}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------- Reverb ---------------------------------
+// ----------------------------------------------------------------------------
+
+namespace WrapAL { namespace effect {
+    // Schroeder-Moorer reverb(freeverb tuning), 8 combs of each side in SIMD lanes
+    class CALEffectReverb final : public CALAudioEffect {
+        // constant
+        enum : uint32_t { CombCount = 8, AllpassCount = 4, Spread = 23, TuningRate = 44100 };
+        // one side
+        struct Side {
+            // comb buffers
+            float*      comb[CombCount];
+            // allpass buffers
+            float*      allpass[AllpassCount];
+            // comb lowpass state
+            float       filter[CombCount];
+            // comb length
+            uint32_t    comb_length[CombCount];
+            // comb position
+            uint32_t    comb_pos[CombCount];
+            // allpass length
+            uint32_t    allpass_length[AllpassCount];
+            // allpass position
+            uint32_t    allpass_pos[AllpassCount];
+        };
+    public:
+        // ctor
+        CALEffectReverb() noexcept : CALAudioEffect(EffectType::Effect_Reverb) {}
+        // dtor
+        ~CALEffectReverb() noexcept { std::free(m_pBuffer); }
+    protected:
+        // allocate delay lines, tuning scaled by rate
+        auto lock() noexcept ->HRESULT override {
+            static const uint32_t comb[CombCount] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+            static const uint32_t allpass[AllpassCount] = { 556, 441, 341, 225 };
+            const auto scale = [=](uint32_t x) noexcept {
+                return std::max(uint32_t(uint64_t(x) * this->rate / TuningRate), 1u);
+            };
+            m_cSide = this->channels > 1 ? 2 : 1;
+            size_t total = 0;
+            for (uint32_t s = 0; s != m_cSide; ++s) {
+                auto& side = m_aSide[s];
+                for (uint32_t i = 0; i != CombCount; ++i) total += side.comb_length[i] = scale(comb[i] + s * Spread);
+                for (uint32_t i = 0; i != AllpassCount; ++i) total += side.allpass_length[i] = scale(allpass[i] + s * Spread);
+            }
+            std::free(m_pBuffer);
+            m_pBuffer = reinterpret_cast<float*>(std::malloc(sizeof(float) * total));
+            if (!m_pBuffer) return E_OUTOFMEMORY;
+            m_cBuffer = uint32_t(total);
+            auto ptr = m_pBuffer;
+            for (uint32_t s = 0; s != m_cSide; ++s) {
+                auto& side = m_aSide[s];
+                for (uint32_t i = 0; i != CombCount; ++i) { side.comb[i] = ptr; ptr += side.comb_length[i]; }
+                for (uint32_t i = 0; i != AllpassCount; ++i) { side.allpass[i] = ptr; ptr += side.allpass_length[i]; }
+            }
+            this->reset();
+            return S_OK;
+        }
+        // free delay lines
+        void unlock() noexcept override { std::free(m_pBuffer); m_pBuffer = nullptr; m_cBuffer = 0; }
+        // clear delay lines
+        void reset() noexcept override {
+            if (m_pBuffer) std::memset(m_pBuffer, 0, sizeof(float) * m_cBuffer);
+            for (auto& side : m_aSide) {
+                std::memset(side.filter, 0, sizeof(side.filter));
+                std::memset(side.comb_pos, 0, sizeof(side.comb_pos));
+                std::memset(side.allpass_pos, 0, sizeof(side.allpass_pos));
+            }
+        }
+        // freeverb scale
+        void update(const EffectParameters& param) noexcept override {
+            const auto& r = param.reverb;
+            const auto width = clamp(r.width, 0.f, 1.f);
+            const auto wet = clamp(r.wet, 0.f, 1.f) * 3.f;
+            m_fFeedback = clamp(r.room_size, 0.f, 1.f) * 0.28f + 0.7f;
+            m_fDamp = clamp(r.damping, 0.f, 1.f) * 0.4f;
+            m_fWet1 = wet * (width * 0.5f + 0.5f);
+            m_fWet2 = wet * (1.f - width) * 0.5f;
+            m_fDry = std::max(r.dry, 0.f);
+        }
+        // combs in parallel, then allpasses in series
+        auto run(Side& side, float input) noexcept {
+            float out[CombCount], in[CombCount];
+            for (uint32_t i = 0; i != CombCount; ++i) out[i] = side.comb[i][side.comb_pos[i]];
+            const auto damp1 = f4::set(m_fDamp), damp2 = f4::set(1.f - m_fDamp);
+            const auto feedback = f4::set(m_fFeedback), x = f4::set(input);
+            const auto out0 = f4::load(out), out1 = f4::load(out + 4);
+            const auto filter0 = out0 * damp2 + f4::load(side.filter) * damp1;
+            const auto filter1 = out1 * damp2 + f4::load(side.filter + 4) * damp1;
+            filter0.store(side.filter);
+            filter1.store(side.filter + 4);
+            (x + filter0 * feedback).store(in);
+            (x + filter1 * feedback).store(in + 4);
+            for (uint32_t i = 0; i != CombCount; ++i) {
+                side.comb[i][side.comb_pos[i]] = in[i];
+                if (++side.comb_pos[i] == side.comb_length[i]) side.comb_pos[i] = 0;
+            }
+            auto y = (out0 + out1).sum();
+            for (uint32_t i = 0; i != AllpassCount; ++i) {
+                auto& value = side.allpass[i][side.allpass_pos[i]];
+                const auto buffered = value;
+                value = y + buffered * 0.5f;
+                y = buffered - y;
+                if (++side.allpass_pos[i] == side.allpass_length[i]) side.allpass_pos[i] = 0;
+            }
+            return y;
+        }
+        // mono input, wet of two sides to even/odd channels
+        void process(float* data, uint32_t frames) noexcept override {
+            const auto ch = this->channels;
+            const auto gain = 0.015f * 2.f / float(ch);
+            for (uint32_t f = 0; f != frames; ++f, data += ch) {
+                float input = 0.f;
+                for (uint32_t c = 0; c != ch; ++c) input += data[c];
+                input *= gain;
+                const auto l = this->run(m_aSide[0], input);
+                const auto r = m_cSide > 1 ? this->run(m_aSide[1], input) : l;
+                const float wet[2] = { l * m_fWet1 + r * m_fWet2, r * m_fWet1 + l * m_fWet2 };
+                for (uint32_t c = 0; c != ch; ++c) data[c] = data[c] * m_fDry + wet[c & 1];
+            }
+        }
+        // tail after input
+        bool tail() const noexcept override { return true; }
+    private:
+        // delay lines
+        float*          m_pBuffer = nullptr;
+        // length of delay lines
+        uint32_t        m_cBuffer = 0;
+        // count of sides
+        uint32_t        m_cSide = 0;
+        // feedback of combs
+        float           m_fFeedback = 0.f;
+        // damping of combs
+        float           m_fDamp = 0.f;
+        // wet to same side
+        float           m_fWet1 = 0.f;
+        // wet to other side
+        float           m_fWet2 = 0.f;
+        // dry level
+        float           m_fDry = 1.f;
+        // sides
+        Side            m_aSide[2];
+    };
+}}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------- Common ---------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Gets size of parameters of effect type.
+/// </summary>
+/// <param name="type">The type.</param>
+/// <returns>0 if unknown</returns>
+auto WrapAL::effect::ParametersSize(EffectType type) noexcept -> uint32_t {
+    switch (type)
+    {
+    case EffectType::Effect_EQ:         return sizeof(EffectEQ);
+    case EffectType::Effect_Compressor: return sizeof(EffectCompressor);
+    case EffectType::Effect_Limiter:    return sizeof(EffectLimiter);
+    case EffectType::Effect_Reverb:     return sizeof(EffectReverb);
+    }
+    return 0;
+}
+
+/// <summary>
+/// Creates the built-in effect with default parameters.
+/// 创建内置效果
+/// </summary>
+/// <param name="type">The type.</param>
+/// <returns>null if OOM or unknown type</returns>
+auto WrapAL::effect::CALAudioEffect::Create(EffectType type) noexcept -> CALAudioEffect* {
+    CALAudioEffect* effect = nullptr;
+    void* ptr = nullptr;
+    switch (type)
+    {
+    case EffectType::Effect_EQ:
+        if ((ptr = std::malloc(sizeof(CALEffectEQ)))) effect = new(ptr) CALEffectEQ;
+        break;
+    case EffectType::Effect_Compressor:
+    case EffectType::Effect_Limiter:
+        if ((ptr = std::malloc(sizeof(CALEffectDynamics)))) effect = new(ptr) CALEffectDynamics(type);
+        break;
+    case EffectType::Effect_Reverb:
+        if ((ptr = std::malloc(sizeof(CALEffectReverb)))) effect = new(ptr) CALEffectReverb;
+        break;
+    }
+    return effect;
+}
+
+/// <summary>
+/// Initializes a new instance of the <see cref="CALAudioEffect"/> class with default parameters.
+/// </summary>
+/// <param name="type">The type.</param>
+WrapAL::effect::CALAudioEffect::CALAudioEffect(EffectType type) noexcept
+    : m_uShared(1), m_cRefCount(1), m_bEnabled(true), m_type(type) {
+    auto& param = m_current;
+    std::memset(&param, 0, sizeof(param));
+    switch (type)
+    {
+    case EffectType::Effect_EQ:
+    {
+        const float freq[EffectEQ::BandCount] = { 100.f, 1000.f, 4000.f, 10000.f };
+        for (uint32_t i = 0; i != EffectEQ::BandCount; ++i)
+            param.eq.bands[i] = { EQBandType::Band_Off, freq[i], 0.f, 0.707f };
+        break;
+    }
+    case EffectType::Effect_Compressor:
+        param.compressor = { -18.f, 4.f, 6.f, 10.f, 100.f, 0.f };
+        break;
+    case EffectType::Effect_Limiter:
+        param.limiter = { -0.3f, 50.f };
+        break;
+    case EffectType::Effect_Reverb:
+        param.reverb = { 0.5f, 0.5f, 1.f, 0.33f, 1.f };
+        break;
+    }
+    // 双耳: 全部通道未使用
+    if (type == effect::Effect_Binaural)
+        std::memset(&param.binaural, 0xff, sizeof(param.binaural));
+    for (auto& slot : m_aSlot) slot = param;
+}
+
+/// <summary>
+/// Queries the interface.
+/// </summary>
+/// <param name="riid">The riid.</param>
+/// <param name="ppv">The PPV.</param>
+/// <returns></returns>
+HRESULT WrapAL::effect::CALAudioEffect::QueryInterface(REFIID riid, void** ppv) noexcept {
+    if (!ppv) return E_POINTER;
+    *ppv = nullptr;
+    // 同时支持 XAudio2_7 的 IID
+    if (same_guid(riid, IID_IXAPO) || same_guid(riid, IID_IXAPO_2_7) || same_guid(riid, IID_UNKNOWN))
+        *ppv = static_cast<IXAPO*>(this);
+    else if (same_guid(riid, IID_IXAPOParameters) || same_guid(riid, IID_IXAPOParameters_2_7))
+        *ppv = static_cast<IXAPOParameters*>(this);
+    else return E_NOINTERFACE;
+    this->AddRef();
+    return S_OK;
+}
+
+/// <summary>
+/// Releases this instance.
+/// </summary>
+/// <returns></returns>
+ULONG WrapAL::effect::CALAudioEffect::Release() noexcept {
+    const auto count = --m_cRefCount;
+    if (!count) {
+        if (m_bLocked) this->UnlockForProcess();
+        this->~CALAudioEffect();
+        std::free(this);
+    }
+    return count;
+}
+
+/// <summary>
+/// Gets the registration properties, allocated with CoTaskMemAlloc.
+/// </summary>
+/// <param name="ppRegistrationProperties">The registration properties.</param>
+/// <returns></returns>
+HRESULT WrapAL::effect::CALAudioEffect::GetRegistrationProperties(XAPO_REGISTRATION_PROPERTIES** ppRegistrationProperties) noexcept {
+    if (!ppRegistrationProperties) return E_POINTER;
+    const auto props = reinterpret_cast<XAPO_REGISTRATION_PROPERTIES*>(
+        ::CoTaskMemAlloc(sizeof(XAPO_REGISTRATION_PROPERTIES)));
+    *ppRegistrationProperties = props;
+    if (!props) return E_OUTOFMEMORY;
+    static const wchar_t* const names[] = {
+        L"WrapAL EQ", L"WrapAL Compressor", L"WrapAL Limiter", L"WrapAL Reverb"
+    };
+    std::memset(props, 0, sizeof(*props));
+    std::wcscpy(props->FriendlyName, m_type == effect::Effect_Binaural ? L"WrapAL Binaural" : names[uint32_t(m_type)]);
+    std::wcscpy(props->CopyrightInfo, L"Copyright (c) 2014-2015 dustpg");
+    props->MajorVersion = 1;
+    props->Flags = XAPO_FLAG_CHANNELS_MUST_MATCH | XAPO_FLAG_FRAMERATE_MUST_MATCH
+        | XAPO_FLAG_BITSPERSAMPLE_MUST_MATCH | XAPO_FLAG_BUFFERCOUNT_MUST_MATCH
+        | XAPO_FLAG_INPLACE_SUPPORTED | XAPO_FLAG_INPLACE_REQUIRED;
+    props->MinInputBufferCount = props->MaxInputBufferCount = 1;
+    props->MinOutputBufferCount = props->MaxOutputBufferCount = 1;
+    return S_OK;
+}
+
+/// <summary>
+/// Determines whether input format is supported: float, same as output.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::effect::CALAudioEffect::IsInputFormatSupported(const WAVEFORMATEX* pOutputFormat,
+    const WAVEFORMATEX* pRequestedInputFormat, WAVEFORMATEX** ppSupportedInputFormat) noexcept {
+    if (!pOutputFormat || !pRequestedInputFormat) return E_POINTER;
+    const auto& o = *pOutputFormat;
+    const auto& i = *pRequestedInputFormat;
+    const bool ok = is_float(i) && i.nChannels == o.nChannels && i.nSamplesPerSec == o.nSamplesPerSec
+        && i.nChannels >= XAPO_MIN_CHANNELS && i.nChannels <= XAPO_MAX_CHANNELS
+        && i.nSamplesPerSec >= XAPO_MIN_FRAMERATE && i.nSamplesPerSec <= XAPO_MAX_FRAMERATE;
+    if (ppSupportedInputFormat) *ppSupportedInputFormat = nullptr;
+    if (ok) return S_OK;
+    // 建议格式: 与输出一致的浮点
+    if (ppSupportedInputFormat) {
+        const auto wave = reinterpret_cast<WAVEFORMATEX*>(::CoTaskMemAlloc(sizeof(WAVEFORMATEX)));
+        if (!wave) return E_OUTOFMEMORY;
+        const auto channels = std::min(std::max(uint32_t(o.nChannels), uint32_t(XAPO_MIN_CHANNELS)), uint32_t(XAPO_MAX_CHANNELS));
+        const auto rate = std::min(std::max(uint32_t(o.nSamplesPerSec), uint32_t(XAPO_MIN_FRAMERATE)), uint32_t(XAPO_MAX_FRAMERATE));
+        wave->wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+        wave->nChannels = uint16_t(channels);
+        wave->nSamplesPerSec = rate;
+        wave->wBitsPerSample = 32;
+        wave->nBlockAlign = uint16_t(channels * sizeof(float));
+        wave->nAvgBytesPerSec = rate * wave->nBlockAlign;
+        wave->cbSize = 0;
+        *ppSupportedInputFormat = wave;
+    }
+    return XAPO_E_FORMAT_UNSUPPORTED;
+}
+
+/// <summary>
+/// Determines whether output format is supported: same as input.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::effect::CALAudioEffect::IsOutputFormatSupported(const WAVEFORMATEX* pInputFormat,
+    const WAVEFORMATEX* pRequestedOutputFormat, WAVEFORMATEX** ppSupportedOutputFormat) noexcept {
+    return this->IsInputFormatSupported(pInputFormat, pRequestedOutputFormat, ppSupportedOutputFormat);
+}
+
+/// <summary>
+/// Initializes with parameters.
+/// </summary>
+/// <param name="pData">The parameters, may be null.</param>
+/// <param name="DataByteSize">Size of the data.</param>
+/// <returns></returns>
+HRESULT WrapAL::effect::CALAudioEffect::Initialize(const void* pData, UINT32 DataByteSize) noexcept {
+    if (!pData) return S_OK;
+    if (DataByteSize != effect::ParametersSize(m_type)) return E_INVALIDARG;
+    this->SetParameters(pData, DataByteSize);
+    return S_OK;
+}
+
+/// <summary>
+/// Locks for process: allocates state, applies parameters.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::effect::CALAudioEffect::LockForProcess(UINT32 InputLockedParameterCount,
+    const XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS* pInputLockedParameters,
+    UINT32 OutputLockedParameterCount,
+    const XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS* pOutputLockedParameters) noexcept {
+    if (m_bLocked) return XAUDIO2_E_INVALID_CALL;
+    if (InputLockedParameterCount != 1 || OutputLockedParameterCount != 1) return E_INVALIDARG;
+    if (!pInputLockedParameters || !pOutputLockedParameters) return E_POINTER;
+    const auto input = pInputLockedParameters->pFormat;
+    const auto output = pOutputLockedParameters->pFormat;
+    if (!input || !output) return E_POINTER;
+    HRESULT hr = this->IsInputFormatSupported(output, input, nullptr);
+    if (FAILED(hr)) return hr;
+    this->channels = input->nChannels;
+    this->rate = input->nSamplesPerSec;
+    hr = this->lock();
+    if (FAILED(hr)) return hr;
+    this->update(m_aSlot[m_uFront]);
+    m_bLocked = true;
+    return S_OK;
+}
+
+/// <summary>
+/// Unlocks for process.
+/// </summary>
+/// <returns></returns>
+void WrapAL::effect::CALAudioEffect::UnlockForProcess() noexcept {
+    if (!m_bLocked) return;
+    this->unlock();
+    m_bLocked = false;
+}
+
+/// <summary>
+/// Processes the buffer in-place.
+/// 就地处理: 取最新参数, 旁路时直接通过
+/// </summary>
+/// <returns></returns>
+void WrapAL::effect::CALAudioEffect::Process(UINT32 InputProcessParameterCount,
+    const XAPO_PROCESS_BUFFER_PARAMETERS* pInputProcessParameters,
+    UINT32 OutputProcessParameterCount,
+    XAPO_PROCESS_BUFFER_PARAMETERS* pOutputProcessParameters,
+    BOOL IsEnabled) noexcept {
+    assert(InputProcessParameterCount == 1 && OutputProcessParameterCount == 1);
+    assert(m_bLocked && "not locked for process");
+    (void)InputProcessParameterCount; (void)OutputProcessParameterCount;
+    const auto& input = *pInputProcessParameters;
+    auto& output = *pOutputProcessParameters;
+    assert(input.pBuffer == output.pBuffer && "in-place only");
+    const auto frames = input.ValidFrameCount;
+    output.ValidFrameCount = frames;
+    output.BufferFlags = input.BufferFlags;
+    // 新参数
+    if (m_uShared.load(std::memory_order_relaxed) & 4) {
+        m_uFront = m_uShared.exchange(m_uFront, std::memory_order_acq_rel) & 3;
+        this->update(m_aSlot[m_uFront]);
+    }
+    if (!IsEnabled || !m_bEnabled.load(std::memory_order_relaxed)) return;
+    const auto data = reinterpret_cast<float*>(output.pBuffer);
+    // 静音输入: 没有尾音则保持静音
+    if (input.BufferFlags == XAPO_BUFFER_SILENT) {
+        if (!this->tail()) return;
+        std::memset(data, 0, sizeof(float) * frames * this->channels);
+        output.BufferFlags = XAPO_BUFFER_VALID;
+    }
+#ifdef WRAPAL_SIMD_SSE
+    // 非规格化数清零, 避免反馈滤波器变慢
+    const auto csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040);
+    this->process(data, frames);
+    _mm_setcsr(csr);
+#else
+    this->process(data, frames);
+#endif
+}
+
+/// <summary>
+/// Sets the parameters, published lock-free.
+/// </summary>
+/// <param name="pParameters">The parameters.</param>
+/// <param name="ParameterByteSize">Size of the parameters.</param>
+/// <returns></returns>
+void WrapAL::effect::CALAudioEffect::SetParameters(const void* pParameters, UINT32 ParameterByteSize) noexcept {
+    assert(pParameters && ParameterByteSize == effect::ParametersSize(m_type) && "bad parameters");
+    if (!pParameters || ParameterByteSize != effect::ParametersSize(m_type)) return;
+    EffectParameters param = m_current;
+    std::memcpy(&param, pParameters, ParameterByteSize);
+    this->Publish(param);
+}
+
+/// <summary>
+/// Gets the parameters published last.
+/// </summary>
+/// <param name="pParameters">The parameters.</param>
+/// <param name="ParameterByteSize">Size of the parameters.</param>
+/// <returns></returns>
+void WrapAL::effect::CALAudioEffect::GetParameters(void* pParameters, UINT32 ParameterByteSize) noexcept {
+    if (!pParameters || ParameterByteSize != effect::ParametersSize(m_type)) return;
+    std::memcpy(pParameters, &m_current, ParameterByteSize);
+}
+
+/// <summary>
+/// Publishes the parameters: write back slot, swap it with shared slot.
+/// 发布参数: 三缓冲, 处理线程在下个周期取得
+/// </summary>
+/// <param name="param">The parameters.</param>
+/// <returns></returns>
+void WrapAL::effect::CALAudioEffect::Publish(const EffectParameters& param) noexcept {
+    m_current = param;
+    m_aSlot[m_uBack] = param;
+    m_uBack = m_uShared.exchange(m_uBack | 4, std::memory_order_acq_rel) & 3;
+}
@@ -0,0 +1,173 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL built-in effects, XAPO running in-place on the mix buffer of
+submix(group) or mastering voice, after mixing and before volume:
+    [submix/master mix] -> effect 0 -> effect 1 -> ... -> volume -> output
+
+the same object works with XAudio2 and the software mixer. parameters
+are published from game thread through a triple buffer, the processing
+thread picks the newest at the start of next pass, never blocked.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for atomic
+#include <atomic>
+// include the config
+#include "wrapalconf.h"
+// include the config
+#include "wrapal_common.h"
+// XAPO interface
+#include "p_XAPO.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // built-in effect
+    namespace effect {
+        // interface to implement
+        using namespace xapo;
+        // internal binaural renderer of engine, see AudioHRTF.h
+        static constexpr EffectType Effect_Binaural = EffectType(0x100);
+        // parameters of Effect_Binaural
+        struct BinauralParameters {
+            // HRTF measurement of each channel(source slot), ~0 for unused
+            uint32_t            filter[BinauralBusChannels];
+        };
+        // parameters of any built-in effect
+        union EffectParameters {
+            // Effect_EQ
+            EffectEQ            eq;
+            // Effect_Compressor
+            EffectCompressor    compressor;
+            // Effect_Limiter
+            EffectLimiter       limiter;
+            // Effect_Reverb
+            EffectReverb        reverb;
+            // Effect_Binaural
+            BinauralParameters  binaural;
+        };
+        // size of parameters of effect type, 0 if unknown
+        auto ParametersSize(EffectType type) noexcept ->uint32_t;
+        // built-in effect, in-place XAPO
+        class WRAPAL_NOVTABLE CALAudioEffect : public IXAPO, public IXAPOParameters {
+        public: // IUnknown
+            // QueryInterface
+            HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) noexcept override;
+            // AddRef
+            ULONG STDMETHODCALLTYPE AddRef() noexcept override { return ++m_cRefCount; }
+            // Release
+            ULONG STDMETHODCALLTYPE Release() noexcept override;
+        public: // IXAPO
+            // GetRegistrationProperties
+            HRESULT STDMETHODCALLTYPE GetRegistrationProperties(XAPO_REGISTRATION_PROPERTIES** ppRegistrationProperties) noexcept override;
+            // IsInputFormatSupported
+            HRESULT STDMETHODCALLTYPE IsInputFormatSupported(const WAVEFORMATEX* pOutputFormat,
+                const WAVEFORMATEX* pRequestedInputFormat, WAVEFORMATEX** ppSupportedInputFormat) noexcept override;
+            // IsOutputFormatSupported
+            HRESULT STDMETHODCALLTYPE IsOutputFormatSupported(const WAVEFORMATEX* pInputFormat,
+                const WAVEFORMATEX* pRequestedOutputFormat, WAVEFORMATEX** ppSupportedOutputFormat) noexcept override;
+            // Initialize
+            HRESULT STDMETHODCALLTYPE Initialize(const void* pData, UINT32 DataByteSize) noexcept override;
+            // Reset
+            void STDMETHODCALLTYPE Reset() noexcept override { this->reset(); }
+            // LockForProcess
+            HRESULT STDMETHODCALLTYPE LockForProcess(UINT32 InputLockedParameterCount,
+                const XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS* pInputLockedParameters,
+                UINT32 OutputLockedParameterCount,
+                const XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS* pOutputLockedParameters) noexcept override;
+            // UnlockForProcess
+            void STDMETHODCALLTYPE UnlockForProcess() noexcept override;
+            // Process
+            void STDMETHODCALLTYPE Process(UINT32 InputProcessParameterCount,
+                const XAPO_PROCESS_BUFFER_PARAMETERS* pInputProcessParameters,
+                UINT32 OutputProcessParameterCount,
+                XAPO_PROCESS_BUFFER_PARAMETERS* pOutputProcessParameters,
+                BOOL IsEnabled) noexcept override;
+            // CalcInputFrames
+            UINT32 STDMETHODCALLTYPE CalcInputFrames(UINT32 OutputFrameCount) noexcept override { return OutputFrameCount; }
+            // CalcOutputFrames
+            UINT32 STDMETHODCALLTYPE CalcOutputFrames(UINT32 InputFrameCount) noexcept override { return InputFrameCount; }
+        public: // IXAPOParameters
+            // SetParameters, same as Publish
+            void STDMETHODCALLTYPE SetParameters(const void* pParameters, UINT32 ParameterByteSize) noexcept override;
+            // GetParameters, published last
+            void STDMETHODCALLTYPE GetParameters(void* pParameters, UINT32 ParameterByteSize) noexcept override;
+        public:
+            // create built-in effect with default parameters, null if OOM
+            static auto Create(EffectType type) noexcept ->CALAudioEffect*;
+            // get type
+            auto GetType() const noexcept { return m_type; }
+            // enable or bypass, lock-free
+            void Enable(bool enable) noexcept { m_bEnabled.store(enable, std::memory_order_relaxed); }
+            // publish parameters, lock-free, one writer at a time
+            void Publish(const EffectParameters& param) noexcept;
+        protected:
+            // ctor
+            CALAudioEffect(EffectType type) noexcept;
+            // dtor
+            virtual ~CALAudioEffect() noexcept {}
+            // allocate state for channels/rate, not in processing thread
+            virtual auto lock() noexcept ->HRESULT = 0;
+            // free state
+            virtual void unlock() noexcept = 0;
+            // clear state
+            virtual void reset() noexcept = 0;
+            // apply new parameters, in processing thread
+            virtual void update(const EffectParameters& param) noexcept = 0;
+            // process interleaved frames in-place, in processing thread
+            virtual void process(float* data, uint32_t frames) noexcept = 0;
+            // output after silent input?
+            virtual bool tail() const noexcept { return false; }
+        protected:
+            // channels locked
+            uint32_t                    channels = 0;
+            // sample rate locked
+            uint32_t                    rate = 0;
+        private:
+            // parameters: triple buffer
+            EffectParameters            m_aSlot[3];
+            // parameters published last, for writer
+            EffectParameters            m_current;
+            // slot shared between writer and reader, with dirty bit
+            std::atomic<uint32_t>       m_uShared;
+            // slot of writer
+            uint32_t                    m_uBack = 0;
+            // slot of reader
+            uint32_t                    m_uFront = 2;
+            // ref-count
+            std::atomic<uint32_t>       m_cRefCount;
+            // enabled
+            std::atomic_bool            m_bEnabled;
+            // locked for process
+            bool                        m_bLocked = false;
+            // type
+            EffectType          const   m_type;
+        };
+    }
+}
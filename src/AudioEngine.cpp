@@ -4,18 +4,222 @@
 #include <mmdeviceapi.h>
 #include "AudioGroup.h"
 #include "AudioClip.h"
+#include "AudioDecoder.h"
+#include "AudioCommand.h"
+#include "AudioSlotMap.h"
+#include "AudioVoicePool.h"
+#include "Audio3D.h"
+#include "AudioHRTF.h"
+#include "AudioAmbisonic.h"
+#include "AudioPerf.h"
 #include "mpg123.h"
+#ifndef WRAPAL_XAUDIO2_7_SUPPORT
+#include "AudioMixer.h"
+#include "AudioOpenAL.h"
+#endif
 
 #include <new>
 #include <cwchar>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 namespace WrapAL {
+    // volume fade of clip
+    struct ClipFade {
+        // clip, add-ref-ed
+        CALAudioSourceClipImpl* clip;
+        // volume from
+        float                   from;
+        // volume to
+        float                   to;
+        // fading time in sec.
+        float                   time;
+        // start time in sec. of engine clock
+        double                  start;
+    };
+    // clip playing, candidate of real voice
+    struct VoiceCandidate {
+        // clip, add-ref-ed
+        CALAudioSourceClipImpl* clip;
+        // volume x group volume x attenuation, -1 if ended
+        float                   audibility;
+        // priority
+        uint32_t                priority;
+        // group, null for top-level
+        AudioSourceGroupImpl*   group;
+    };
+    // binaural bus: submix with HRTF renderer, a 3D clip each channel
+    struct BinauralBus {
+        // submix voice, output L/R to master
+        IXAudio2SubmixVoice*    voice;
+        // renderer in effect chain
+        hrtf::CALBinaural*      effect;
+        // channels used, bitmask
+        uint32_t                used;
+        // filters changed, to publish
+        bool                    dirty;
+        // filters of channels
+        effect::EffectParameters param;
+    };
+    // ambisonic bus: submix of 3D clips, decoded by output matrix
+    struct AmbisonicBus {
+        // submix voice, null for none
+        IXAudio2SubmixVoice*    voice = nullptr;
+        // order, 0 for none
+        uint32_t                order = 0;
+        // count of binaural decoders, 0 for decoding to speakers
+        uint32_t                count = 0;
+        // binaural decoders, virtual speaker each channel
+        BinauralBus             decoder[AmbisonicMaxOrder];
+    };
+    // sums of playing members of cluster weighted by volume
+    struct ClusterSums {
+        // direction in listener space: x right, y top, z front
+        float                   x, y, z;
+        // sum of volume
+        float                   weight;
+        // LPF coefficient of direct path
+        float                   lpf_direct;
+        // LPF coefficient of reverb path
+        float                   lpf_reverb;
+        // reverb send level
+        float                   reverb;
+    };
+    // cluster of distant 3D clips: mono submix, spatialised at centroid of members
+    struct EmitterCluster {
+        // submix voice, 1 channel
+        IXAudio2SubmixVoice*    voice;
+        // output now, ambisonic bus or master
+        IXAudio2Voice*          output;
+        // reverb group now, null for none
+        AudioSourceGroupImpl*   reverb;
+        // sums of this Update3D
+        ClusterSums             sums;
+    };
     // impl for engine
-    struct engine_impl {
+    struct engine_impl final : IXAudio2EngineCallback {
         // ctor
         engine_impl() noexcept {};
         // dtor
-        ~engine_impl() noexcept {};
+        ~engine_impl() noexcept { std::free(m_pCandidate); std::free(m_pKey3D); };
+        // drain commands, once each processing pass
+        void STDMETHODCALLTYPE OnProcessingPassStart() noexcept override;
+        // time of processing pass
+        void STDMETHODCALLTYPE OnProcessingPassEnd() noexcept override {
+            CALPerfCounters::AddPass(uint32_t(WrapAL::now_us() - m_iPassStart));
+        }
+        // Called in the event of a critical system error.
+        void STDMETHODCALLTYPE OnCriticalError(HRESULT Error) noexcept override {}
+        // push command owning a reference of clip, execute at once if full
+        void PushCommand(CALAudioSourceClipImpl& clip, ClipCommand cmd, float value = 0.f) noexcept;
+        // push PlayAt/StopAt command owning a reference of clip, execute at once if full
+        void PushSchedule(CALAudioSourceClipImpl& clip, ClipCommand cmd, uint64_t time) noexcept;
+        // push command of group, execute at once if full
+        void PushGroupCommand(AudioSourceGroupImpl* group, ClipCommand cmd) noexcept;
+        // push command to batch of this thread, false if not in batch
+        bool BatchCommand(const AudioCommand& command) noexcept;
+        // push batch of this thread as one command, execute at once if full
+        void CommitBatch(CommandBatch& batch) noexcept;
+        // run command, release clip of it, in audio thread or under m_voicing
+        void RunCommand(const AudioCommand& command) noexcept;
+        // set play_at/stop_at of clip, add it to schedule list, under m_voicing
+        void Schedule(CALAudioSourceClipImpl& clip, ClipCommand cmd, uint64_t time) noexcept;
+        // play/stop clips whose time is reached, under m_voicing
+        void RunSchedule() noexcept;
+        // queue silence before data for play_at of clip, under m_voicing
+        void LeadIn(CALAudioSourceClipImpl& clip) noexcept;
+        // frames of source for frames of output
+        auto SourceFrames(const CALAudioSourceClipImpl& clip, uint64_t frames) const noexcept {
+            return uint32_t(double(frames) * double(clip.wave.nSamplesPerSec)
+                * double(clip.GetFrequencyRatio()) / double(m_uSampleRate) + 0.5);
+        }
+        // release all clips in schedule list, under m_voicing
+        void ClearSchedule() noexcept;
+        // run pause/resume/stop on clips of group and children, under m_voicing
+        void RunGroupCommand(AudioSourceGroupImpl& group, ClipCommand cmd) noexcept;
+        // group or root of group tree for null
+        auto GroupNode(AudioSourceGroupImpl* group) noexcept ->AudioSourceGroupImpl& { return group ? *group : m_root; }
+        // destroy clips released in audio thread, free batches run
+        void ReapClips() noexcept;
+        // notify and auto-destroy clips played to the end
+        void EndClips(IALConfigure& config) noexcept;
+        // add or update fade of clip, under m_locker
+        bool AddFade(CALAudioSourceClipImpl& clip, float volume, float time) noexcept;
+        // advance fades, under m_locker
+        void UpdateFades() noexcept;
+        // release all fades, under m_locker
+        void ClearFades() noexcept;
+        // choose real voices in budget, virtualize others, under m_voicing
+        void UpdateVoices() noexcept;
+        // engine clock in sec., virtual clips advance by it
+        auto ClockSec() const noexcept { return m_uSampleRate ? double(m_uClock.load()) / double(m_uSampleRate) : 0.0; }
+        // acquire voice and play virtual clip again, under m_voicing
+        auto Devirtualize(CALAudioSourceClipImpl& clip, double now) noexcept ->HRESULT;
+        // output clip to its group(master if none), and reverb group of 3D clip, under m_voicing
+        auto RouteClip(CALAudioSourceClipImpl& clip) noexcept ->HRESULT;
+        // apply 3D state of clip to its voice, under m_voicing
+        void Apply3D(CALAudioSourceClipImpl& clip) noexcept;
+        // init speaker layouts of each channels, under m_spatial and m_voicing
+        void InitLayouts() noexcept;
+        // calculate emitters and apply to 3D clips, under m_spatial
+        auto Update3D(const AudioEmitters3D& emitters) noexcept ->uint32_t;
+        // is 3D clip routed to outputs of listeners, under m_voicing
+        bool ClipListeners(const Clip3DState* state) const noexcept;
+        // Update3D for listeners with own outputs, under m_spatial
+        auto UpdateListeners(const AudioEmitters3D& emitters) noexcept ->uint32_t;
+        // apply matrices of listeners(panned again if null) to their outputs, under m_voicing
+        void ApplyListeners(CALAudioSourceClipImpl& clip, const float* const matrices[]) noexcept;
+        // set occlusion of 3D clip, targets of direct path to smoothing list, under m_voicing
+        void Occlude(CALAudioSourceClipImpl& clip, Clip3DState& state, float occlusion, float obstruction) noexcept;
+        // smooth direct path of clips in list to targets, in audio thread under m_voicing
+        void UpdateOcclusion() noexcept;
+        // release all clips in smoothing list, under m_voicing
+        void ClearOcclusion() noexcept;
+        // binaural bus of 3D clip, null for speaker panning, under m_voicing
+        auto ClipBus(const Clip3DState* state) noexcept ->BinauralBus*;
+        // take free channel of binaural buses for 3D clip, false if full, under m_voicing
+        bool AcquireSlot(Clip3DState& state) noexcept;
+        // give back channel of binaural bus of clip, under m_voicing
+        void ReleaseSlot(CALAudioSourceClipImpl& clip) noexcept;
+        // publish filters of changed binaural buses, under m_voicing
+        void PublishBuses() noexcept;
+        // destroy binaural buses and release HRTF set, no clip outputs to them
+        void ClearBuses(BinauralBus* buses, uint32_t count) noexcept;
+        // create binaural bus with renderer of HRTF set, L/R to master
+        auto CreateBinauralBus(hrtf::CALHRTF& set, BinauralBus& bus) noexcept ->HRESULT;
+        // is 3D clip routed to ambisonic bus, under m_voicing
+        bool ClipAmbisonic(const Clip3DState* state) const noexcept;
+        // create ambisonic bus, decoded binaurally if HRTF set, or to speakers, under m_spatial
+        auto CreateAmbisonic(uint32_t order, hrtf::CALHRTF* set, AmbisonicBus& bus) noexcept ->HRESULT;
+        // set decoding matrix of ambisonic bus to speakers of master, under m_spatial
+        auto DecodeAmbisonic(IXAudio2SubmixVoice* voice, uint32_t order) noexcept ->HRESULT;
+        // replace ambisonic bus with "bus", old one back in it, reroute clips, under m_spatial and m_voicing
+        void SwapAmbisonic(AmbisonicBus& bus) noexcept;
+        // destroy ambisonic bus and decoders, no clip outputs to it
+        void ClearAmbisonic(AmbisonicBus& bus) noexcept;
+        // volume of group x parents', for buses bypassing groups
+        auto GroupVolume(AudioSourceGroupImpl* group) noexcept ->float;
+        // cluster of distant 3D clip by azimuth, kept near last one, under m_spatial and m_voicing
+        auto ClusterOf(const Clip3DState* state, float azimuth) const noexcept ->uint32_t;
+        // cluster of 3D clip, null if not clustered, under m_voicing
+        auto ClipCluster(const Clip3DState* state) noexcept ->EmitterCluster*;
+        // output clusters to ambisonic bus(master if none), and reverb group, under m_spatial
+        void RouteClusters() noexcept;
+        // spatialise clusters at centroid of members, under m_spatial
+        void ApplyClusters() noexcept;
+        // destroy clusters, no clip outputs to them
+        void ClearClusters(EmitterCluster* clusters, uint32_t count) noexcept;
+        // key bit of clustered emitter, cluster << 40
+        static constexpr uint64_t ClusterKey = uint64_t(1) << 63;
+        // volume of group x parents', reset real voices of it in new pass, under m_voicing
+        auto GroupMix(AudioSourceGroupImpl* group) noexcept ->float;
+        // find group in hash table, under m_grouping
+        auto FindGroup(const char* name, size_t length, uint32_t hash) const noexcept ->AudioSourceGroupImpl*;
+        // add group to hash table, grow it if needed, under m_grouping, false if OOM
+        bool InsertGroup(AudioSourceGroupImpl& group) noexcept;
+        // destroy all groups, children first
+        void ClearGroups() noexcept;
         // XAudio2
         HMODULE                 m_hXAudio2 = nullptr;
         // XAudio2 interface
@@ -24,10 +228,128 @@ namespace WrapAL {
         IXAudio2MasteringVoice* m_pMasterVoice = nullptr;
         // libmpg123.dll handle
         HMODULE         const   libmpg123 = nullptr;
-        // group
-        AudioSourceGroupImpl    m_aGroup[GroupMaxSize];
-        // count of it
-        size_t                  m_cGroupCount = 0;
+        // hash buckets of groups
+        AudioSourceGroupImpl**  m_ppGroupBucket = nullptr;
+        // groups, newest first
+        AudioSourceGroupImpl*   m_pGroupList = nullptr;
+        // count of buckets, power of 2
+        uint32_t                m_cGroupBucket = 0;
+        // count of groups
+        uint32_t                m_cGroup = 0;
+        // locker for group table
+        std::mutex              m_grouping;
+        // root of group tree: top-level groups as children, clips without group as members
+        AudioSourceGroupImpl    m_root;
+        // decode pool for streaming
+        CALDecodePool           m_decoder;
+        // clips released in audio thread, to destroy
+        std::atomic<CALAudioSourceClipImpl*> m_pDeadClip{ nullptr };
+        // clips played to the end, completion queue
+        std::atomic<CALAudioSourceClipImpl*> m_pEndClip{ nullptr };
+        // batches run in audio thread, to free
+        std::atomic<CommandBatch*> m_pDoneBatch{ nullptr };
+        // clips waiting for PlayAt/StopAt, add-ref-ed, under m_voicing
+        CALAudioSourceClipImpl* m_pSchedule = nullptr;
+        // engine clock: sample time at start of current pass
+        std::atomic<uint64_t>   m_uClock{ 0 };
+        // engine clock: sample time at start of next pass
+        uint64_t                m_uNextPass = 0;
+        // engine clock: start time in sec., for clock by time
+        double                  m_dClockStart = 0.0;
+        // frames each pass, 0 if not fixed(OpenAL), clock by time
+        uint32_t                m_cPassFrames = 0;
+        // sample rate of mastering voice
+        uint32_t                m_uSampleRate = 0;
+        // fades
+        ClipFade*               m_pFade = nullptr;
+        // count of fades
+        uint32_t                m_cFade = 0;
+        // capacity of fades
+        uint32_t                m_cFadeCapacity = 0;
+        // locker for update
+        CALLocker               m_locker;
+        // auto-update thread
+        std::thread             m_updater;
+        // exit auto-update thread
+        std::atomic_bool        m_bExitUpdate{ false };
+        // command queue of clips
+        CALCommandQueue         m_commands;
+        // handle table of clips
+        CALClipSlotMap          m_clips;
+        // source voice pool
+        CALVoicePool            m_voices;
+        // locker for changing voice of clips, audio thread try-locks it
+        std::mutex              m_voicing;
+        // candidates of real voice
+        VoiceCandidate*         m_pCandidate = nullptr;
+        // count of candidates
+        uint32_t                m_cCandidate = 0;
+        // capacity of candidates
+        uint32_t                m_cCandidateCapacity = 0;
+        // pass of UpdateVoices, for scratch of groups
+        uint32_t                m_uVoicePass = 0;
+        // max count of real voices
+        uint32_t                m_cVoiceBudget = RealVoiceBudget;
+        // locker for 3D calculation
+        std::mutex              m_spatial;
+        // 3D calculation
+        spatial::CALSpatial3D   m_3d;
+        // speaker layout of output voice, [channels - 1]
+        spatial::SpeakerLayout  m_aLayout[Spatial3DMaxChannels];
+        // channel mask of mastering voice, 0 for default of channels
+        uint32_t                m_uMasterMask = 0;
+        // channels of mastering voice
+        uint32_t                m_cMasterChannels = 0;
+        // reverb group of 3D clips, null for none
+        AudioSourceGroupImpl*   m_pReverb3D = nullptr;
+        // sort keys of Update3D: (src << 4 | dst) << 32 | index, ClusterKey | cluster << 40 for clustered
+        uint64_t*               m_pKey3D = nullptr;
+        // capacity of sort keys
+        uint32_t                m_cKey3DCapacity = 0;
+        // output matrices of one batch in Update3D
+        float                   m_aMatrix3D[Spatial3DBatch * Spatial3DMaxChannels * Spatial3DMaxChannels];
+        // HRTF set, null for speaker panning, under m_spatial and m_voicing
+        hrtf::CALHRTF*          m_pHRTF = nullptr;
+        // count of binaural buses, under m_voicing
+        uint32_t                m_cBus = 0;
+        // generation of binaural buses, slot of clip stale if differs
+        uint32_t                m_uBusGen = 0;
+        // binaural buses, under m_voicing
+        BinauralBus             m_aBus[BinauralMaxSources / BinauralBusChannels];
+        // ambisonic bus, under m_spatial and m_voicing
+        AmbisonicBus            m_ambisonic;
+        // generation of ambisonic bus, routed one of clip stale if differs
+        uint32_t                m_uAmbiGen = 0;
+        // clusters of distant 3D clips, under m_spatial and m_voicing
+        EmitterCluster          m_aCluster[Cluster3DMaxCount];
+        // count of clusters, 0 for none
+        uint32_t                m_cCluster = 0;
+        // generation of clusters, cluster of clip stale if differs
+        uint32_t                m_uClusterGen = 0;
+        // 3D clips at this distance or farther are clustered
+        float                   m_fClusterDistance = 0.f;
+        // output groups of listeners, under m_spatial and m_voicing
+        AudioSourceGroupImpl*   m_apListener[Listener3DMaxCount];
+        // count of listener outputs, 0 for single listener, under m_spatial and m_voicing
+        uint32_t                m_cListener = 0;
+        // generation of listener outputs, routed ones of clip stale if differs
+        uint32_t                m_uListenerGen = 0;
+        // clips smoothing direct path to occlusion targets, add-ref-ed, under m_voicing
+        CALAudioSourceClipImpl**m_ppOcclusion = nullptr;
+        // count of clips smoothing
+        uint32_t                m_cOcclusion = 0;
+        // capacity of smoothing list
+        uint32_t                m_cOcclusionCapacity = 0;
+        // engine clock of last UpdateOcclusion
+        uint64_t                m_uOcclusionClock = 0;
+        // start of this processing pass in microsecond, audio thread
+        int64_t                 m_iPassStart = 0;
+        // count of real voices of last UpdateVoices
+        std::atomic<uint32_t>   m_cRealVoice{ 0 };
+        // count of virtual clips of last UpdateVoices
+        std::atomic<uint32_t>   m_cVirtualVoice{ 0 };
+        // glitches of backend, queried in Update
+        std::atomic<uint32_t>   m_uGlitches{ 0 };
         // create xaduio2
         HRESULT(__stdcall*XAudio2Create) (IXAudio2**, UINT32, XAUDIO2_PROCESSOR) = nullptr;
 #ifdef WRAPAL_INCLUDE_DEFAULT_CONFIGURE
@@ -39,6 +361,1501 @@ namespace WrapAL {
     template<typename T> static inline auto load_func(T& pointer, HMODULE dll, const char* name) noexcept {
         pointer = reinterpret_cast<T>(::GetProcAddress(dll, name));
     }
+    // is built-in software mixer
+    static inline bool is_mixer(APILevel level) noexcept {
+        return level == APILevel::Level_SoftwareMixer || level == APILevel::Level_Offline;
+    }
+    // is built-in backend without XAudio2 dll
+    static inline bool is_builtin(APILevel level) noexcept {
+        return WrapAL::is_mixer(level) || level == APILevel::Level_OpenAL;
+    }
+    // add emitter of results to sums of cluster
+    static inline void add_member(ClusterSums& sums, const spatial::Result3D& r, uint32_t i) noexcept {
+        const auto w = r.volume[i], c = std::cos(r.elevation[i]);
+        sums.x += w * c * std::sin(r.azimuth[i]);
+        sums.y += w * std::sin(r.elevation[i]);
+        sums.z += w * c * std::cos(r.azimuth[i]);
+        sums.weight += w;
+        sums.lpf_direct += w * r.lpf_direct[i];
+        sums.lpf_reverb += w * r.lpf_reverb[i];
+        sums.reverb += w * r.reverb[i];
+    }
+    // optional value of emitter clamped to [0, 1], 0 if null
+    static inline auto emitter_at(const float* values, uint32_t i) noexcept {
+        return values ? std::min(std::max(values[i], 0.f), 1.f) : 0.f;
+    }
+    // push clip to lock-free task list
+    static inline void push_task(std::atomic<CALAudioSourceClipImpl*>& list, CALAudioSourceClipImpl* clip) noexcept {
+        auto head = list.load();
+        do { clip->task_next = head; } while (!list.compare_exchange_weak(head, clip));
+    }
+    // batch of this thread
+    struct ThreadBatch {
+        // depth of BeginBatch
+        uint32_t                depth;
+        // commands, null if empty
+        CommandBatch*           batch;
+        // command ran out of batch for OOM, CommitBatch returns false
+        bool                    failed;
+    };
+    // batch of this thread
+    static thread_local ThreadBatch t_batch = { 0, nullptr, false };
+    // free batch
+    static inline void free_batch(CommandBatch* batch) noexcept {
+        std::free(batch->data);
+        std::free(batch);
+    }
+    // make command of group volume, null group for master
+    static inline auto group_volume(AudioSourceGroupImpl* group, float volume) noexcept {
+        AudioCommand command;
+        command.group = group;
+        command.command = Command_GroupVolume;
+        command.value = volume;
+        return command;
+    }
+    // release clip failed to create, with ref-count owned by engine for Flag_AutoDestroyEOP
+    static inline void release_failed(CALAudioSourceClipImpl& clip) noexcept {
+        if (clip.TakeAutoRef()) clip.Release();
+        clip.ReleaseHandleRef();
+        clip.Release();
+    }
+    // execute command of clip
+    static inline void execute_command(CALAudioSourceClipImpl& clip, ClipCommand cmd, float value) noexcept {
+        switch (cmd)
+        {
+        case WrapAL::Command_Play:   clip.Play(); break;
+        case WrapAL::Command_Pause:  clip.Stop(); break;
+        case WrapAL::Command_Seek:   clip.Seek(value); break;
+        case WrapAL::Command_Volume: clip.SetVolume(value); break;
+        case WrapAL::Command_Ratio:  clip.SetFrequencyRatio(value); break;
+        }
+    }
+}
+
+/// <summary>
+/// Drains the commands, called once each processing pass in audio thread.
+/// 每个处理周期执行一次队列中的命令
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::OnProcessingPassStart() noexcept {
+    m_iPassStart = WrapAL::now_us();
+    AudioCommand command;
+    // 引擎时钟: 周期固定则按周期累计
+    if (m_cPassFrames) {
+        m_uClock = m_uNextPass;
+        m_uNextPass += m_cPassFrames;
+    }
+    else m_uClock = uint64_t((WrapAL::now_sec() - m_dClockStart) * double(m_uSampleRate));
+    m_voices.OnPass();
+    // 正在更换声音, 下个周期再执行
+    if (!m_voicing.try_lock()) return;
+    // 最多执行一圈, 避免生产者过快时无法返回
+    for (uint32_t i = 0; i != CommandQueueLength && m_commands.Pop(command); ++i) {
+        this->RunCommand(command);
+    }
+    // 命令之后, 本周期到时的计划
+    if (m_pSchedule) this->RunSchedule();
+    this->UpdateOcclusion();
+    m_voicing.unlock();
+}
+
+/// <summary>
+/// Runs the command, releases the clip of it.
+/// 执行命令
+/// </summary>
+/// <param name="command">The command.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::RunCommand(const AudioCommand& command) noexcept {
+    switch (command.command)
+    {
+    case WrapAL::Command_Batch:
+    {
+        // 同一周期执行整批命令
+        const auto batch = command.batch;
+        for (uint32_t i = 0; i != batch->count; ++i) this->RunCommand(batch->data[i]);
+        // 音频线程中不释放内存, 交给 Update
+        auto head = m_pDoneBatch.load();
+        do { batch->next = head; } while (!m_pDoneBatch.compare_exchange_weak(head, batch));
+        break;
+    }
+    case WrapAL::Command_GroupVolume:
+        if (command.group) command.group->voice->SetVolume(command.value);
+        else m_pMasterVoice->SetVolume(command.value);
+        break;
+    case WrapAL::Command_PlayAt:
+    case WrapAL::Command_StopAt:
+        // 引用交给计划列表
+        this->Schedule(*command.clip, command.command, command.time);
+        break;
+    case WrapAL::Command_GroupPause:
+    case WrapAL::Command_GroupResume:
+    case WrapAL::Command_GroupStop:
+        this->RunGroupCommand(this->GroupNode(command.group), command.command);
+        break;
+    default:
+    {
+        const auto clip = command.clip;
+        // 暂停取消计划, 播放取消计划的播放
+        if (command.command == Command_Pause) clip->play_at = clip->stop_at = CALAudioSourceClipImpl::NoSchedule;
+        else if (command.command == Command_Play) clip->play_at = CALAudioSourceClipImpl::NoSchedule;
+        // 单独控制后不再由组别恢复
+        if (command.command == Command_Pause || command.command == Command_Play) clip->group_paused = false;
+        WrapAL::execute_command(*clip, command.command, command.value);
+        // 定位刷新了静音前导, 重新准备
+        if (command.command == Command_Seek && clip->play_at != CALAudioSourceClipImpl::NoSchedule) this->LeadIn(*clip);
+        // 音频线程中不能摧毁声音, 交给 Update
+        if (!clip->ReleaseLater()) WrapAL::push_task(m_pDeadClip, clip);
+        break;
+    }
+    }
+}
+
+/// <summary>
+/// Pushes the command, executes at once if queue is full.
+/// 压入命令, 队列满了则直接执行
+/// </summary>
+/// <param name="clip">The clip, add-ref-ed, the command owns the reference.</param>
+/// <param name="cmd">The command.</param>
+/// <param name="value">The value.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::PushCommand(CALAudioSourceClipImpl& clip, ClipCommand cmd, float value) noexcept {
+    AudioCommand command{ &clip, cmd, value };
+    // 渐变从最后压入的音量开始
+    if (cmd == Command_Volume) clip.QueueVolume(value);
+    if (this->BatchCommand(command) || m_commands.Push(command)) return;
+    std::lock_guard<std::mutex> locker(m_voicing);
+    this->RunCommand(command);
+}
+
+/// <summary>
+/// Pushes the command of group, executes at once if queue is full.
+/// 压入组别命令, 整个组别只占一个命令
+/// </summary>
+/// <param name="group">The group, null for all clips.</param>
+/// <param name="cmd">The command.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::PushGroupCommand(AudioSourceGroupImpl* group, ClipCommand cmd) noexcept {
+    AudioCommand command;
+    command.group = group;
+    command.command = cmd;
+    command.value = 0.f;
+    if (this->BatchCommand(command) || m_commands.Push(command)) return;
+    std::lock_guard<std::mutex> locker(m_voicing);
+    this->RunCommand(command);
+}
+
+/// <summary>
+/// Pushes the PlayAt/StopAt command, executes at once if queue is full.
+/// 压入计划命令
+/// </summary>
+/// <param name="clip">The clip, add-ref-ed, the command owns the reference.</param>
+/// <param name="cmd">The command.</param>
+/// <param name="time">The sample time of engine clock.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::PushSchedule(CALAudioSourceClipImpl& clip, ClipCommand cmd, uint64_t time) noexcept {
+    AudioCommand command;
+    command.clip = &clip;
+    command.command = cmd;
+    command.time = time;
+    if (this->BatchCommand(command) || m_commands.Push(command)) return;
+    std::lock_guard<std::mutex> locker(m_voicing);
+    this->RunCommand(command);
+}
+
+/// <summary>
+/// Sets play_at/stop_at of the clip, adds it to schedule list with ref-count of command.
+/// 加入计划列表
+/// </summary>
+/// <param name="clip">The clip, add-ref-ed.</param>
+/// <param name="cmd">The command.</param>
+/// <param name="time">The sample time of engine clock.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::Schedule(CALAudioSourceClipImpl& clip, ClipCommand cmd, uint64_t time) noexcept {
+    // 按队列顺序准备前导, 之前的命令不会刷新它
+    if (cmd == Command_PlayAt) {
+        clip.play_at = time;
+        this->LeadIn(clip);
+    }
+    else clip.stop_at = time;
+    // 已在列表中, 列表持有引用
+    if (clip.scheduled) {
+        clip.ReleaseLater();
+        return;
+    }
+    clip.scheduled = true;
+    clip.schedule_next = m_pSchedule;
+    m_pSchedule = &clip;
+}
+
+/// <summary>
+/// Plays/stops clips whose time is reached, once each processing pass.
+/// 执行到时的计划
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::RunSchedule() noexcept {
+    constexpr auto none = CALAudioSourceClipImpl::NoSchedule;
+    const auto clock = m_uClock.load();
+    // 本周期内的最后一个采样
+    const auto last = clock + (m_cPassFrames ? m_cPassFrames - 1 : 0);
+    auto link = &m_pSchedule;
+    while (const auto clip = *link) {
+        // 在所在周期开始时播放, 前导对齐到采样
+        if (clip->play_at <= last) {
+            clip->play_at = none;
+            clip->Play();
+        }
+        // 在所在周期截断, 下个周期开始时停止
+        if (clip->stop_at <= clock) {
+            clip->stop_at = none;
+            clip->StopAndRewind();
+        }
+        else if (clip->stop_at <= last) {
+            clip->PrepareStop(this->SourceFrames(*clip, clip->stop_at - clock));
+        }
+        // 没有计划了: 移出列表
+        if (clip->play_at == none && clip->stop_at == none) {
+            *link = clip->schedule_next;
+            clip->scheduled = false;
+            // 音频线程中不能摧毁声音, 交给 Update
+            if (!clip->ReleaseLater()) WrapAL::push_task(m_pDeadClip, clip);
+        }
+        else link = &clip->schedule_next;
+    }
+}
+
+/// <summary>
+/// Queues silence before data, so the clip played on the start of pass is heard on play_at.
+/// 准备静音前导
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::LeadIn(CALAudioSourceClipImpl& clip) noexcept {
+    const auto pass = m_cPassFrames;
+    if (!pass) return;
+    const auto lead = clip.play_at % pass;
+    // 已经错过则尽快播放
+    if (lead && clip.play_at - lead >= m_uClock.load()) clip.PrepareLeadIn(this->SourceFrames(clip, lead));
+}
+
+/// <summary>
+/// Releases all clips in schedule list.
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::ClearSchedule() noexcept {
+    while (const auto clip = m_pSchedule) {
+        m_pSchedule = clip->schedule_next;
+        clip->play_at = clip->stop_at = CALAudioSourceClipImpl::NoSchedule;
+        clip->scheduled = false;
+        if (!clip->ReleaseLater()) WrapAL::push_task(m_pDeadClip, clip);
+    }
+}
+
+/// <summary>
+/// Runs pause/resume/stop on clips of the group and its children.
+/// 执行组别命令: 遍历成员与子组别
+/// </summary>
+/// <param name="group">The group.</param>
+/// <param name="cmd">The command.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::RunGroupCommand(AudioSourceGroupImpl& group, ClipCommand cmd) noexcept {
+    constexpr auto none = CALAudioSourceClipImpl::NoSchedule;
+    for (auto clip = group.members; clip; clip = clip->group_next) {
+        // 正在其他线程中释放
+        if (!clip->AddRefIfAlive()) continue;
+        switch (cmd)
+        {
+        case WrapAL::Command_GroupPause:
+            if (!clip->IsPlaying()) break;
+            clip->play_at = clip->stop_at = none;
+            clip->Stop();
+            clip->group_paused = true;
+            break;
+        case WrapAL::Command_GroupResume:
+            if (!clip->group_paused) break;
+            clip->group_paused = false;
+            clip->Play();
+            break;
+        case WrapAL::Command_GroupStop:
+            clip->play_at = clip->stop_at = none;
+            clip->group_paused = false;
+            clip->StopAndRewind();
+            break;
+        }
+        // 音频线程中不能摧毁声音, 交给 Update
+        if (!clip->ReleaseLater()) WrapAL::push_task(m_pDeadClip, clip);
+    }
+    for (auto child = group.child; child; child = child->sibling) {
+        this->RunGroupCommand(*child, cmd);
+    }
+}
+
+/// <summary>
+/// Pushes the command to batch of this thread.
+/// 在批处理中则压入本线程的批
+/// </summary>
+/// <param name="command">The command.</param>
+/// <returns>false if not in batch or out of memory, batch marked failed for OOM</returns>
+bool WrapAL::engine_impl::BatchCommand(const AudioCommand& command) noexcept {
+    if (!t_batch.depth) return false;
+    auto batch = t_batch.batch;
+    // 首个命令
+    if (!batch) {
+        const auto ptr = std::malloc(sizeof(CommandBatch));
+        // 命令在批外执行, 提交时报告
+        if (!ptr) {
+            t_batch.failed = true;
+            return false;
+        }
+        batch = reinterpret_cast<CommandBatch*>(ptr);
+        *batch = { nullptr, nullptr, 0, 0 };
+        t_batch.batch = batch;
+    }
+    if (batch->count == batch->capacity) {
+        const auto capacity = batch->capacity ? batch->capacity * 2 : 64;
+        const auto ptr = std::realloc(batch->data, sizeof(AudioCommand) * capacity);
+        if (!ptr) {
+            t_batch.failed = true;
+            return false;
+        }
+        batch->data = reinterpret_cast<AudioCommand*>(ptr);
+        batch->capacity = capacity;
+    }
+    batch->data[batch->count++] = command;
+    return true;
+}
+
+/// <summary>
+/// Pushes the batch as one command, executes at once if queue is full.
+/// 提交批: 作为一个命令压入
+/// </summary>
+/// <param name="batch">The batch.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::CommitBatch(CommandBatch& batch) noexcept {
+    AudioCommand command;
+    command.batch = &batch;
+    command.command = Command_Batch;
+    command.value = 0.f;
+    if (m_commands.Push(command)) return;
+    std::lock_guard<std::mutex> locker(m_voicing);
+    this->RunCommand(command);
+}
+
+/// <summary>
+/// Destroys clips released in audio thread.
+/// 摧毁在音频线程中释放的片段
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::ReapClips() noexcept {
+    auto clip = m_pDeadClip.exchange(nullptr);
+    while (clip) {
+        const auto next = clip->task_next;
+        clip->Destroy();
+        clip = next;
+    }
+    // 释放执行完毕的批
+    auto batch = m_pDoneBatch.exchange(nullptr);
+    while (batch) {
+        const auto next = batch->next;
+        WrapAL::free_batch(batch);
+        batch = next;
+    }
+}
+
+/// <summary>
+/// Notifies and auto-destroys clips played to the end.
+/// 处理播放结束的片段
+/// </summary>
+/// <param name="config">The configuration.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::EndClips(IALConfigure& config) noexcept {
+    // 反转为结束的先后顺序
+    CALAudioSourceClipImpl* list = nullptr;
+    for (auto clip = m_pEndClip.exchange(nullptr); clip; ) {
+        const auto next = clip->task_next;
+        clip->task_next = list;
+        list = clip;
+        clip = next;
+    }
+    while (list) {
+        const auto clip = list;
+        list = clip->task_next;
+        clip->ClearEnded();
+        config.OnClipEnd(clip->handle);
+        // 释放引擎持有的引用
+        if (clip->TakeAutoRef()) clip->Release();
+        // 释放结束队列持有的引用
+        clip->Release();
+    }
+}
+
+/// <summary>
+/// Adds or updates the fade of clip.
+/// 添加渐变
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <param name="volume">The target volume.</param>
+/// <param name="time">The time in sec.</param>
+/// <returns></returns>
+bool WrapAL::engine_impl::AddFade(CALAudioSourceClipImpl& clip, float volume, float time) noexcept {
+    // 按引擎时钟, 离线渲染时按渲染位置; 队列中的音量命令尚未执行
+    ClipFade fade{ &clip, clip.GetQueuedVolume(), volume, time, this->ClockSec() };
+    // 已在渐变: 从当前音量重新开始
+    for (uint32_t i = 0; i != m_cFade; ++i) {
+        if (m_pFade[i].clip == &clip) {
+            m_pFade[i] = fade;
+            return true;
+        }
+    }
+    if (m_cFade == m_cFadeCapacity) {
+        const auto capacity = m_cFadeCapacity ? m_cFadeCapacity * 2 : 16;
+        const auto ptr = std::realloc(m_pFade, sizeof(ClipFade) * capacity);
+        if (!ptr) return false;
+        m_pFade = reinterpret_cast<ClipFade*>(ptr);
+        m_cFadeCapacity = capacity;
+    }
+    clip.AddRef();
+    m_pFade[m_cFade++] = fade;
+    return true;
+}
+
+/// <summary>
+/// Advances the fades.
+/// 推进渐变
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::UpdateFades() noexcept {
+    const auto now = this->ClockSec();
+    for (uint32_t i = 0; i < m_cFade; ) {
+        auto& fade = m_pFade[i];
+        const auto t = std::min(float(now - fade.start) / fade.time, 1.f);
+        fade.clip->AddRef();
+        this->PushCommand(*fade.clip, Command_Volume, fade.from + (fade.to - fade.from) * t);
+        // 完成: 与最后一个交换
+        if (t >= 1.f) {
+            fade.clip->Release();
+            fade = m_pFade[--m_cFade];
+        }
+        else ++i;
+    }
+}
+
+/// <summary>
+/// Releases all fades.
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::ClearFades() noexcept {
+    for (uint32_t i = 0; i != m_cFade; ++i) m_pFade[i].clip->Release();
+    std::free(m_pFade);
+    m_pFade = nullptr;
+    m_cFade = m_cFadeCapacity = 0;
+}
+
+/// <summary>
+/// Chooses real voices in budget by priority then audibility, virtualizes others.
+/// 选择真实声音: 优先级优先, 其次是可闻度, 其余虚拟化
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::UpdateVoices() noexcept {
+    // 收集播放中的片段
+    m_cCandidate = 0;
+    m_clips.ForEach([this](CALAudioSourceClipImpl& clip) noexcept {
+        if (!clip.IsPlaying()) return;
+        if (m_cCandidate == m_cCandidateCapacity) {
+            const auto cap = m_cCandidateCapacity ? m_cCandidateCapacity * 2 : 64;
+            const auto ptr = std::realloc(m_pCandidate, sizeof(VoiceCandidate) * cap);
+            if (!ptr) return;
+            m_pCandidate = reinterpret_cast<VoiceCandidate*>(ptr);
+            m_cCandidateCapacity = cap;
+        }
+        if (!clip.AddRefIfAlive()) return;
+        m_pCandidate[m_cCandidate++].clip = &clip;
+    });
+    if (!m_cCandidate) {
+        m_cRealVoice.store(0, std::memory_order_relaxed);
+        m_cVirtualVoice.store(0, std::memory_order_relaxed);
+        return;
+    }
+    // 按引擎时钟, 离线渲染时快于真实时间
+    const auto now = this->ClockSec();
+    ++m_uVoicePass;
+    // 可闻度
+    const auto begin = m_pCandidate, end = m_pCandidate + m_cCandidate;
+    for (auto itr = begin; itr != end; ++itr) {
+        auto& clip = *itr->clip;
+        itr->group = clip.group;
+        itr->priority = clip.GetPriority();
+        itr->audibility = clip.GetVolume() * clip.GetAttenuation() * this->GroupMix(clip.group);
+        // 虚拟片段播放完毕
+        if (clip.IsVirtual() && !clip.AdvanceVirtual(now)) itr->audibility = -1.f;
+    }
+    std::sort(begin, end, [](const VoiceCandidate& a, const VoiceCandidate& b) noexcept {
+        if (a.priority != b.priority) return a.priority > b.priority;
+        return a.audibility > b.audibility;
+    });
+    // 在预算内选择, 先归还声音
+    uint32_t count = 0;
+    for (auto itr = begin; itr != end; ++itr) {
+        // -60dB 以下视为不可闻
+        bool real = itr->audibility > 0.001f && count < m_cVoiceBudget;
+        // 上级组别预算同样计入
+        for (auto group = itr->group; real && group; group = group->parent)
+            real = !group->budget || group->real < group->budget;
+        if (real) {
+            ++count;
+            for (auto group = itr->group; group; group = group->parent) ++group->real;
+        }
+        else if (itr->clip->Virtualize(now)) this->ReleaseSlot(*itr->clip);
+        itr->audibility = real ? 1.f : 0.f;
+    }
+    uint32_t real = 0, virt = 0;
+    for (auto itr = begin; itr != end; ++itr) {
+        auto& clip = *itr->clip;
+        if (itr->audibility > 0.f && clip.IsVirtual()) this->Devirtualize(clip, now);
+        if (clip.IsPlaying()) ++(clip.IsVirtual() ? virt : real);
+        // 最后的引用: 交给 ReapClips
+        if (!clip.ReleaseLater()) WrapAL::push_task(m_pDeadClip, &clip);
+    }
+    m_cCandidate = 0;
+    m_cRealVoice.store(real, std::memory_order_relaxed);
+    m_cVirtualVoice.store(virt, std::memory_order_relaxed);
+    this->PublishBuses();
+}
+
+/// <summary>
+/// Gets volume of group x parents' volume, cached for this pass.
+/// 组别混合音量
+/// </summary>
+/// <param name="group">The group, null for top-level.</param>
+/// <returns></returns>
+auto WrapAL::engine_impl::GroupMix(AudioSourceGroupImpl* group) noexcept -> float {
+    if (!group) return 1.f;
+    // 本轮已计算
+    if (group->pass == m_uVoicePass) return group->mix;
+    float volume = 1.f;
+    group->voice->GetVolume(&volume);
+    group->pass = m_uVoicePass;
+    group->real = 0;
+    group->mix = volume * this->GroupMix(group->parent);
+    return group->mix;
+}
+
+/// <summary>
+/// Finds the group in hash table.
+/// </summary>
+/// <param name="name">The name.</param>
+/// <param name="length">The length of name.</param>
+/// <param name="hash">The hash of name.</param>
+/// <returns></returns>
+auto WrapAL::engine_impl::FindGroup(const char* name, size_t length, uint32_t hash) const noexcept -> AudioSourceGroupImpl* {
+    if (!m_cGroupBucket) return nullptr;
+    auto group = m_ppGroupBucket[hash & (m_cGroupBucket - 1)];
+    while (group && !group->Match(name, length, hash)) group = group->bucket_next;
+    return group;
+}
+
+/// <summary>
+/// Inserts the group into hash table, rehash if load factor over 1.
+/// 加入哈希表
+/// </summary>
+/// <param name="group">The group.</param>
+/// <returns>false if no bucket for OOM</returns>
+bool WrapAL::engine_impl::InsertGroup(AudioSourceGroupImpl& group) noexcept {
+    // 扩容, 失败则继续用旧表
+    if (m_cGroup >= m_cGroupBucket) {
+        const auto count = m_cGroupBucket ? m_cGroupBucket * 2 : uint32_t(GroupBucketCount);
+        const auto size = sizeof(AudioSourceGroupImpl*) * count;
+        if (const auto buckets = reinterpret_cast<AudioSourceGroupImpl**>(std::malloc(size))) {
+            std::memset(buckets, 0, size);
+            for (auto itr = m_pGroupList; itr; itr = itr->next) {
+                auto& head = buckets[itr->hash & (count - 1)];
+                itr->bucket_next = head;
+                head = itr;
+            }
+            std::free(m_ppGroupBucket);
+            m_ppGroupBucket = buckets;
+            m_cGroupBucket = count;
+        }
+        else if (!m_cGroupBucket) return false;
+    }
+    group.next = m_pGroupList;
+    m_pGroupList = &group;
+    ++m_cGroup;
+    auto& head = m_ppGroupBucket[group.hash & (m_cGroupBucket - 1)];
+    group.bucket_next = head;
+    head = &group;
+    return true;
+}
+
+/// <summary>
+/// Destroys all groups, children before parents.
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::ClearGroups() noexcept {
+    auto group = m_pGroupList;
+    while (group) {
+        const auto next = group->next;
+        group->Destroy();
+        group = next;
+    }
+    std::free(m_ppGroupBucket);
+    m_ppGroupBucket = nullptr;
+    m_pGroupList = nullptr;
+    m_root.child = nullptr;
+    m_cGroupBucket = 0;
+    m_cGroup = 0;
+}
+
+/// <summary>
+/// Acquires voice and plays virtual clip again.
+/// 去虚拟化
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <param name="now">The now.</param>
+/// <returns></returns>
+auto WrapAL::engine_impl::Devirtualize(CALAudioSourceClipImpl& clip, double now) noexcept -> HRESULT {
+    CALPooledVoice* voice = nullptr;
+    const auto flags = CALAudioSourceClipImpl::VoiceFlags(clip.flags);
+    auto hr = m_voices.Acquire(clip.wave, flags, clip, voice);
+    if (FAILED(hr)) return hr;
+    clip.AttachVoice(*voice);
+    this->RouteClip(clip);
+    this->Apply3D(clip);
+    return clip.Devirtualize(now);
+}
+
+/// <summary>
+/// Outputs clip to its group, and reverb group for 3D clip.
+/// 设置输出链: 直达到组别(没有则主音), 3D 片段另外发送到混响组别
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <returns>S_FALSE if default output kept</returns>
+auto WrapAL::engine_impl::RouteClip(CALAudioSourceClipImpl& clip) noexcept -> HRESULT {
+    const bool spatial = !!(clip.flags & Flag_3D);
+    const auto state = spatial ? clip.GetSpatial() : nullptr;
+    const auto reverb = state ? state->reverb_group : nullptr;
+    const auto bus = this->ClipBus(state);
+    const bool ambisonic = this->ClipAmbisonic(state);
+    const auto cluster = this->ClipCluster(state);
+    // 多个听者: 发送到每个听者的输出, 各自滤波
+    if (this->ClipListeners(state)) {
+        XAUDIO2_SEND_DESCRIPTOR descriptors[Listener3DMaxCount + 1];
+        uint32_t count = 0;
+        for (uint32_t l = 0; l != m_cListener; ++l) descriptors[count++] = { XAUDIO2_SEND_USEFILTER, m_apListener[l]->voice };
+        if (reverb) descriptors[count++] = { XAUDIO2_SEND_USEFILTER, reverb->voice };
+        XAUDIO2_VOICE_SENDS sends = { count, descriptors };
+        auto hr = clip.SetOutputVoices(&sends);
+        if (FAILED(hr) && reverb) {
+            --sends.SendCount;
+            hr = clip.SetOutputVoices(&sends);
+        }
+        return hr;
+    }
+    // 3D 片段的源音可能来自带混响发送的片段
+    if (!clip.group && !reverb && !bus && !ambisonic && !cluster) return spatial ? clip.SetOutputVoices(nullptr) : S_FALSE;
+    // 聚类/环绕声/双耳: 直达到总线
+    IXAudio2Voice* output = m_pMasterVoice;
+    if (cluster) output = cluster->voice;
+    else if (ambisonic) output = m_ambisonic.voice;
+    else if (bus) output = bus->voice;
+    else if (clip.group) output = clip.group->voice;
+    XAUDIO2_SEND_DESCRIPTOR descriptors[] = {
+        { 0, output },
+        { XAUDIO2_SEND_USEFILTER, reverb ? reverb->voice : nullptr },
+    };
+    XAUDIO2_VOICE_SENDS sends = { reverb ? 2u : 1u, descriptors };
+    auto hr = clip.SetOutputVoices(&sends);
+    // 无法发送到混响(如采样率不同)则只输出直达
+    if (FAILED(hr) && reverb) {
+        sends.SendCount = 1;
+        hr = clip.SetOutputVoices(&sends);
+    }
+    return hr;
+}
+
+/// <summary>
+/// Applies the 3D state of clip to its voice.
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::Apply3D(CALAudioSourceClipImpl& clip) noexcept {
+    const auto state = clip.GetSpatial();
+    if (!state || !clip.HasSource()) return;
+    const auto reverb = state->reverb_group;
+    const auto reverb_voice = reverb ? reverb->voice : nullptr;
+    const auto reverb_channels = reverb ? reverb->channels : 0;
+    // 多个听者: 各自的输出, 混响照常发送
+    if (this->ClipListeners(state)) {
+        this->ApplyListeners(clip, nullptr);
+        clip.Apply3D(nullptr, nullptr, 0, reverb_voice, reverb_channels);
+        return;
+    }
+    // 聚类成员: 混合到聚类的单声道, 绕过了组别所以乘上组别音量
+    if (const auto cluster = this->ClipCluster(state)) {
+        float matrix[Spatial3DMaxChannels];
+        const auto level = state->volume / float(state->src) * this->GroupVolume(clip.group);
+        for (uint32_t i = 0; i != state->src; ++i) matrix[i] = level;
+        clip.Apply3D(cluster->voice, matrix, 1, nullptr, 0);
+        return;
+    }
+    // 环绕声: 编码到总线, 同样乘上组别音量
+    if (this->ClipAmbisonic(state)) {
+        const auto order = m_ambisonic.order;
+        float matrix[Spatial3DMaxChannels * AmbisonicMaxChannels];
+        const auto level = state->volume * this->GroupVolume(clip.group);
+        ambisonic::EncodeMatrix(order, state->src, state->azimuth, state->elevation,
+            state->focus, state->spread, level, matrix);
+        clip.Apply3D(m_ambisonic.voice, matrix, ambisonic::Channels(order), reverb_voice, reverb_channels);
+        return;
+    }
+    // 双耳: 混合到总线的对应声道, 同样乘上组别音量
+    if (const auto bus = this->ClipBus(state)) {
+        float matrix[Spatial3DMaxChannels * BinauralBusChannels] = { 0.f };
+        const auto level = state->volume / float(state->src) * this->GroupVolume(clip.group);
+        const auto channel = (state->slot - 1) % BinauralBusChannels;
+        for (uint32_t i = 0; i != state->src; ++i) matrix[channel * state->src + i] = level;
+        clip.Apply3D(bus->voice, matrix, BinauralBusChannels, reverb_voice, reverb_channels);
+        return;
+    }
+    // 计算后改变了组别, 下次 Update3D 再应用
+    const auto channels = clip.group ? clip.group->channels : m_cMasterChannels;
+    if (channels != state->dst) return;
+    IXAudio2Voice* const output = clip.group
+        ? static_cast<IXAudio2Voice*>(clip.group->voice) : m_pMasterVoice;
+    const auto matrix = (state->flags & Flag3D_Matrix) ? state->matrix : nullptr;
+    clip.Apply3D(output, matrix, state->dst, reverb_voice, reverb_channels);
+}
+
+/// <summary>
+/// Initializes the speaker layouts of each channels, mask of master for its channels.
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::InitLayouts() noexcept {
+    const bool zero_center = !!(m_3d.GetFlags() & Flag3D_ZeroCenter);
+    for (uint32_t i = 0; i != Spatial3DMaxChannels; ++i) {
+        const auto channels = i + 1;
+        const auto mask = channels == m_cMasterChannels ? m_uMasterMask : 0;
+        m_aLayout[i].Init(channels, mask, zero_center);
+    }
+    // 扬声器解码随布局改变
+    if (m_ambisonic.voice && !m_ambisonic.count) this->DecodeAmbisonic(m_ambisonic.voice, m_ambisonic.order);
+}
+
+/// <summary>
+/// Calculates emitters and applies to 3D clips.
+/// 计算全部发声体, 按声道排序后分批计算矩阵并应用
+/// </summary>
+/// <param name="e">The emitters.</param>
+/// <returns>count of clips applied</returns>
+auto WrapAL::engine_impl::Update3D(const AudioEmitters3D& e) noexcept -> uint32_t {
+    if (!e.count || !e.clips || !m_3d.Calculate(e)) return 0;
+    // 排序键
+    if (e.count > m_cKey3DCapacity) {
+        const auto cap = std::max(e.count, m_cKey3DCapacity * 2);
+        const auto ptr = std::realloc(m_pKey3D, sizeof(uint64_t) * cap);
+        if (!ptr) return 0;
+        m_pKey3D = reinterpret_cast<uint64_t*>(ptr);
+        m_cKey3DCapacity = cap;
+    }
+    // 每个听者有各自的输出
+    if (m_cListener) return this->UpdateListeners(e);
+    const auto& result = m_3d.GetResult();
+    // 远处的发声体按方向聚类, 累计播放中成员的方向
+    const auto clusters = m_cCluster;
+    for (uint32_t c = 0; c != clusters; ++c) std::memset(&m_aCluster[c].sums, 0, sizeof(ClusterSums));
+    uint32_t count = 0;
+    m_voicing.lock();
+    for (uint32_t i = 0; i != e.count; ++i) {
+        const auto clip = m_clips.Find(e.clips[i]);
+        if (!clip || !(clip->flags & Flag_3D)) continue;
+        const uint32_t src = clip->wave.nChannels;
+        const uint32_t dst = clip->group ? clip->group->channels : m_cMasterChannels;
+        if (!src || src > Spatial3DMaxChannels || !dst || dst > Spatial3DMaxChannels) continue;
+        auto key = uint64_t(src << 4 | dst) << 32 | i;
+        if (clusters && result.distance[i] >= m_fClusterDistance) {
+            const auto c = this->ClusterOf(clip->GetSpatial(), result.azimuth[i]);
+            key |= ClusterKey | uint64_t(c) << 40;
+            if (clip->IsPlaying()) WrapAL::add_member(m_aCluster[c].sums, result, i);
+        }
+        m_pKey3D[count++] = key;
+    }
+    m_voicing.unlock();
+    // 同样声道的一起计算, 聚类成员在最后
+    std::sort(m_pKey3D, m_pKey3D + count);
+    const auto flags = m_3d.GetFlags();
+    const auto reverb = (flags & Flag3D_Reverb) ? m_pReverb3D : nullptr;
+    // 环绕声总线: 编码代替声像矩阵
+    const bool ambisonic = !!m_ambisonic.voice;
+    uint32_t index[Spatial3DBatch];
+    uint32_t applied = 0;
+    for (uint32_t begin = 0; begin != count; ) {
+        const auto kind = m_pKey3D[begin] >> 32;
+        const bool member = !!(m_pKey3D[begin] & ClusterKey);
+        auto end = begin + 1;
+        while (end != count && end - begin < Spatial3DBatch) {
+            const auto next = m_pKey3D[end] >> 32;
+            if (member ? !(m_pKey3D[end] & ClusterKey) : next != kind) break;
+            ++end;
+        }
+        const auto n = end - begin;
+        for (uint32_t i = 0; i != n; ++i) index[i] = uint32_t(m_pKey3D[begin + i]);
+        if (!ambisonic && !member) {
+            const auto dst = uint32_t(kind) & 0xf;
+            m_3d.Pan(0, index, n, uint32_t(kind) >> 4 & 0xf, m_aLayout[dst - 1], m_aMatrix3D);
+        }
+        // 每批加锁一次
+        m_voicing.lock();
+        for (uint32_t i = 0; i != n; ++i) {
+            const auto k = index[i];
+            const auto key = m_pKey3D[begin + i];
+            const auto src = uint32_t(key >> 36) & 0xf, dst = uint32_t(key >> 32) & 0xf;
+            const auto clip = m_clips.Find(e.clips[k]);
+            if (!clip) continue;
+            const auto channels = clip->group ? clip->group->channels : m_cMasterChannels;
+            const auto state = channels == dst ? clip->Spatial() : nullptr;
+            if (!state) continue;
+            state->flags = flags;
+            state->src = src;
+            state->dst = dst;
+            state->lpf_direct = result.lpf_direct[k];
+            state->lpf_reverb = result.lpf_reverb[k];
+            state->reverb = result.reverb[k];
+            state->volume = result.volume[k];
+            state->azimuth = result.azimuth[k];
+            state->elevation = result.elevation[k];
+            state->focus = result.focus[k];
+            state->spread = result.spread[k];
+            if (!ambisonic && !member) std::memcpy(state->matrix, m_aMatrix3D + i * src * dst, sizeof(float) * src * dst);
+            clip->SetDoppler(result.doppler[k]);
+            // 聚类成员的混响由聚类发送
+            const auto reverb_group = member ? nullptr : reverb;
+            bool route = state->reverb_group != reverb_group;
+            state->reverb_group = reverb_group;
+            const auto cluster = member ? (uint32_t(key >> 40) & 0xff) + 1 : 0;
+            const auto was = this->ClipCluster(state) ? state->cluster : 0;
+            route = route || was != cluster;
+            state->cluster = cluster;
+            state->cluster_gen = m_uClusterGen;
+            // 聚类成员: 只有音量混合到聚类, 声像/滤波由聚类做, 源音滤波只有遮挡
+            if (member) {
+                if (this->ClipBus(state)) this->ReleaseSlot(*clip);
+                state->lpf_direct = 1.f;
+            }
+            // 环绕声: 全部片段编码到总线, 不占用双耳声道
+            else if (ambisonic) {
+                if (this->ClipBus(state)) this->ReleaseSlot(*clip);
+                route = route || state->ambisonic != m_uAmbiGen;
+                state->ambisonic = m_uAmbiGen;
+            }
+            // 双耳: 播放中的片段占用总线声道, 用完则回到扬声器声像
+            else if (m_pHRTF) {
+                state->filter = m_pHRTF->Find(result.azimuth[k], result.elevation[k]);
+                const bool want = clip->HasSource() && clip->IsPlaying();
+                const bool has = !!this->ClipBus(state);
+                if (has && !want) {
+                    this->ReleaseSlot(*clip);
+                    route = true;
+                }
+                // 总线已满则继续扬声器声像
+                else if (want && !has && this->AcquireSlot(*state)) route = true;
+                if (const auto bus = this->ClipBus(state)) {
+                    bus->param.binaural.filter[(state->slot - 1) % BinauralBusChannels] = state->filter;
+                    bus->dirty = true;
+                }
+            }
+            this->Occlude(*clip, *state, WrapAL::emitter_at(e.occlusion, k), WrapAL::emitter_at(e.obstruction, k));
+            // 音量同时作为声音预算的衰减
+            clip->SetAttenuation(result.volume[k] * state->direct_gain);
+            if (route && clip->HasSource()) this->RouteClip(*clip);
+            this->Apply3D(*clip);
+            ++applied;
+        }
+        this->PublishBuses();
+        m_voicing.unlock();
+        begin = end;
+    }
+    this->ApplyClusters();
+    return applied;
+}
+
+/// <summary>
+/// Determines whether 3D clip is routed to outputs of listeners.
+/// </summary>
+/// <param name="state">The 3D state of clip.</param>
+/// <returns></returns>
+bool WrapAL::engine_impl::ClipListeners(const Clip3DState* state) const noexcept {
+    return state && m_cListener && state->listener_gen == m_uListenerGen;
+}
+
+/// <summary>
+/// Calculates emitters for listeners with own outputs and applies to 3D clips.
+/// 多个听者: 按源声道排序, 每批对每个听者计算矩阵; 最响的听者决定多普勒与混响
+/// </summary>
+/// <param name="e">The emitters, calculated.</param>
+/// <returns>count of clips applied</returns>
+auto WrapAL::engine_impl::UpdateListeners(const AudioEmitters3D& e) noexcept -> uint32_t {
+    const auto listeners = m_cListener;
+    assert(listeners == m_3d.GetListeners() && "bad listeners");
+    uint32_t count = 0;
+    m_voicing.lock();
+    for (uint32_t i = 0; i != e.count; ++i) {
+        const auto clip = m_clips.Find(e.clips[i]);
+        if (!clip || !(clip->flags & Flag_3D)) continue;
+        const uint32_t src = clip->wave.nChannels;
+        if (!src || src > Spatial3DMaxChannels) continue;
+        m_pKey3D[count++] = uint64_t(src) << 32 | i;
+    }
+    m_voicing.unlock();
+    std::sort(m_pKey3D, m_pKey3D + count);
+    const auto flags = m_3d.GetFlags();
+    const auto reverb = (flags & Flag3D_Reverb) ? m_pReverb3D : nullptr;
+    // 矩阵缓存按听者分段
+    const auto batch = Spatial3DBatch / listeners;
+    const auto segment = batch * Spatial3DMaxChannels * Spatial3DMaxChannels;
+    uint32_t index[Spatial3DBatch];
+    uint32_t applied = 0;
+    for (uint32_t begin = 0; begin != count; ) {
+        const auto src = uint32_t(m_pKey3D[begin] >> 32);
+        auto end = begin + 1;
+        while (end != count && end - begin < batch && uint32_t(m_pKey3D[end] >> 32) == src) ++end;
+        const auto n = end - begin;
+        for (uint32_t i = 0; i != n; ++i) index[i] = uint32_t(m_pKey3D[begin + i]);
+        uint32_t dst[Listener3DMaxCount];
+        for (uint32_t l = 0; l != listeners; ++l) {
+            dst[l] = m_apListener[l]->channels;
+            m_3d.Pan(l, index, n, src, m_aLayout[dst[l] - 1], m_aMatrix3D + l * segment);
+        }
+        // 每批加锁一次
+        m_voicing.lock();
+        for (uint32_t i = 0; i != n; ++i) {
+            const auto k = index[i];
+            const auto clip = m_clips.Find(e.clips[k]);
+            const auto state = clip ? clip->Spatial() : nullptr;
+            if (!state) continue;
+            uint32_t primary = 0;
+            const float* matrices[Listener3DMaxCount];
+            for (uint32_t l = 0; l != listeners; ++l) {
+                const auto& r = m_3d.GetResult(l);
+                auto& to = state->listener[l];
+                to.volume = r.volume[k];
+                to.lpf_direct = r.lpf_direct[k];
+                to.azimuth = r.azimuth[k];
+                to.focus = r.focus[k];
+                to.spread = r.spread[k];
+                if (r.volume[k] > m_3d.GetResult(primary).volume[k]) primary = l;
+                matrices[l] = m_aMatrix3D + l * segment + i * src * dst[l];
+            }
+            const auto& result = m_3d.GetResult(primary);
+            state->flags = flags;
+            state->src = src;
+            // 没有扬声器矩阵
+            state->dst = 0;
+            // 源音滤波器打开, 直达由每个发送滤波
+            state->lpf_direct = 1.f;
+            state->lpf_reverb = result.lpf_reverb[k];
+            state->reverb = result.reverb[k];
+            state->volume = result.volume[k];
+            state->azimuth = result.azimuth[k];
+            state->elevation = result.elevation[k];
+            state->focus = result.focus[k];
+            state->spread = result.spread[k];
+            this->Occlude(*clip, *state, WrapAL::emitter_at(e.occlusion, k), WrapAL::emitter_at(e.obstruction, k));
+            clip->SetAttenuation(result.volume[k] * state->direct_gain);
+            clip->SetDoppler(result.doppler[k]);
+            // 不使用双耳/环绕声/聚类
+            if (this->ClipBus(state)) this->ReleaseSlot(*clip);
+            state->ambisonic = 0;
+            state->cluster = 0;
+            bool route = state->reverb_group != reverb || state->listener_gen != m_uListenerGen;
+            state->reverb_group = reverb;
+            state->listener_gen = m_uListenerGen;
+            if (clip->HasSource()) {
+                if (route) this->RouteClip(*clip);
+                this->ApplyListeners(*clip, matrices);
+                const auto reverb_voice = reverb ? reverb->voice : nullptr;
+                clip->Apply3D(nullptr, nullptr, 0, reverb_voice, reverb ? reverb->channels : 0);
+            }
+            ++applied;
+        }
+        this->PublishBuses();
+        m_voicing.unlock();
+        begin = end;
+    }
+    return applied;
+}
+
+/// <summary>
+/// Applies matrices of listeners to their outputs, bypassing group of clip.
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <param name="matrices">The matrices of listeners, panned again from state if null.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::ApplyListeners(CALAudioSourceClipImpl& clip, const float* const matrices[]) noexcept {
+    const auto state = clip.GetSpatial();
+    if (!state || !clip.HasSource()) return;
+    const auto src = state->src;
+    const bool lfe = !!(state->flags & Flag3D_RedirectToLFE);
+    // 绕过了组别所以乘上组别音量
+    const auto level = this->GroupVolume(clip.group);
+    float matrix[Spatial3DMaxChannels * Spatial3DMaxChannels];
+    for (uint32_t l = 0; l != m_cListener; ++l) {
+        const auto output = m_apListener[l];
+        const auto dst = output->channels;
+        const auto& from = state->listener[l];
+        if (matrices) {
+            for (uint32_t j = 0; j != src * dst; ++j) matrix[j] = matrices[l][j] * level;
+        }
+        else {
+            m_aLayout[dst - 1].Pan(from.azimuth, from.focus, from.spread,
+                from.volume * level, src, lfe, matrix);
+        }
+        clip.Apply3DSend(output->voice, matrix, dst, from.lpf_direct);
+    }
+}
+
+/// <summary>
+/// Sets occlusion of 3D clip, puts targets of direct path to smoothing list.
+/// 遮蔽: 直达与混响都衰减并滤波; 阻挡: 只有直达. 源音的增益与滤波在音频线程平滑
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <param name="state">The 3D state of clip, written by Update3D.</param>
+/// <param name="occlusion">The occlusion.</param>
+/// <param name="obstruction">The obstruction.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::Occlude(CALAudioSourceClipImpl& clip, Clip3DState& state,
+    float occlusion, float obstruction) noexcept {
+    state.occlusion = occlusion;
+    state.obstruction = obstruction;
+    // 完全遮蔽 -12dB, 完全阻挡 -6dB
+    const auto through = 1.f - 0.75f * occlusion;
+    state.reverb *= through;
+    state.lpf_reverb *= through;
+    const auto lpf = (state.flags & Flag3D_LPFDirect) ? state.lpf_direct : 1.f;
+    state.direct_gain = through * (1.f - 0.5f * obstruction);
+    state.direct_lpf = lpf * (1.f - 0.75f * std::max(occlusion, obstruction));
+    // 已在列表或已到达
+    if (state.smoothing) return;
+    if (clip.GetDirectGain() == state.direct_gain && clip.GetDirectLPF() == state.direct_lpf) return;
+    if (m_cOcclusion == m_cOcclusionCapacity) {
+        const auto capacity = m_cOcclusionCapacity ? m_cOcclusionCapacity * 2 : 64;
+        const auto ptr = std::realloc(m_ppOcclusion, sizeof(CALAudioSourceClipImpl*) * capacity);
+        // 下次 Update3D 再加入
+        if (!ptr) return;
+        m_ppOcclusion = reinterpret_cast<CALAudioSourceClipImpl**>(ptr);
+        m_cOcclusionCapacity = capacity;
+    }
+    clip.AddRef();
+    state.smoothing = 1;
+    m_ppOcclusion[m_cOcclusion++] = &clip;
+}
+
+/// <summary>
+/// Smooths direct path of clips in list to targets, each processing pass in audio thread.
+/// 推进遮挡平滑: 按经过的采样数线性移动, 到达后移出列表
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::UpdateOcclusion() noexcept {
+    const uint64_t clock = m_uClock;
+    const auto elapsed = clock - m_uOcclusionClock;
+    m_uOcclusionClock = clock;
+    if (!m_cOcclusion || !m_uSampleRate) return;
+    const auto step = float(elapsed) / float(m_uSampleRate) * (1000.f / float(Occlusion3DSmoothMs));
+    const auto approach = [step](float from, float to) noexcept {
+        return from < to ? std::min(from + step, to) : std::max(from - step, to);
+    };
+    for (uint32_t i = 0; i < m_cOcclusion; ) {
+        const auto clip = m_ppOcclusion[i];
+        const auto state = clip->GetSpatial();
+        assert(state && state->smoothing && "bad clip");
+        const auto gain = approach(clip->GetDirectGain(), state->direct_gain);
+        const auto lpf = approach(clip->GetDirectLPF(), state->direct_lpf);
+        clip->SetDirect(gain, lpf);
+        if (gain != state->direct_gain || lpf != state->direct_lpf) { ++i; continue; }
+        // 到达: 与最后一个交换, 音频线程中不摧毁
+        state->smoothing = 0;
+        m_ppOcclusion[i] = m_ppOcclusion[--m_cOcclusion];
+        if (!clip->ReleaseLater()) WrapAL::push_task(m_pDeadClip, clip);
+    }
+}
+
+/// <summary>
+/// Releases all clips in smoothing list.
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::ClearOcclusion() noexcept {
+    for (uint32_t i = 0; i != m_cOcclusion; ++i) {
+        const auto clip = m_ppOcclusion[i];
+        clip->GetSpatial()->smoothing = 0;
+        if (!clip->ReleaseLater()) WrapAL::push_task(m_pDeadClip, clip);
+    }
+    std::free(m_ppOcclusion);
+    m_ppOcclusion = nullptr;
+    m_cOcclusion = m_cOcclusionCapacity = 0;
+}
+
+/// <summary>
+/// Gets the binaural bus of 3D clip.
+/// </summary>
+/// <param name="state">The 3D state of clip.</param>
+/// <returns>null for speaker panning</returns>
+auto WrapAL::engine_impl::ClipBus(const Clip3DState* state) noexcept -> BinauralBus* {
+    if (!state || !state->slot || state->slot_gen != m_uBusGen) return nullptr;
+    const auto index = (state->slot - 1) / BinauralBusChannels;
+    return index < m_cBus ? m_aBus + index : nullptr;
+}
+
+/// <summary>
+/// Takes the first free channel of binaural buses.
+/// 占用双耳总线声道
+/// </summary>
+/// <param name="state">The 3D state of clip.</param>
+/// <returns>false if all used</returns>
+bool WrapAL::engine_impl::AcquireSlot(Clip3DState& state) noexcept {
+    constexpr uint32_t full = (1u << BinauralBusChannels) - 1;
+    for (uint32_t i = 0; i != m_cBus; ++i) {
+        auto& bus = m_aBus[i];
+        if (bus.used == full) continue;
+        uint32_t channel = 0;
+        while (bus.used & (1u << channel)) ++channel;
+        bus.used |= 1u << channel;
+        state.slot = i * BinauralBusChannels + channel + 1;
+        state.slot_gen = m_uBusGen;
+        return true;
+    }
+    return false;
+}
+
+/// <summary>
+/// Gives back the channel of binaural bus of clip.
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::ReleaseSlot(CALAudioSourceClipImpl& clip) noexcept {
+    const auto state = clip.GetSpatial();
+    if (!state) return;
+    if (const auto bus = this->ClipBus(state)) {
+        const auto channel = (state->slot - 1) % BinauralBusChannels;
+        bus->used &= ~(1u << channel);
+        bus->param.binaural.filter[channel] = ~0u;
+        bus->dirty = true;
+    }
+    state->slot = 0;
+}
+
+/// <summary>
+/// Publishes filters of changed binaural buses.
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::PublishBuses() noexcept {
+    for (uint32_t i = 0; i != m_cBus; ++i) {
+        auto& bus = m_aBus[i];
+        if (!bus.dirty) continue;
+        bus.effect->Publish(bus.param);
+        bus.dirty = false;
+    }
+}
+
+/// <summary>
+/// Destroys the binaural buses.
+/// </summary>
+/// <param name="buses">The buses.</param>
+/// <param name="count">The count.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::ClearBuses(BinauralBus* buses, uint32_t count) noexcept {
+    for (uint32_t i = 0; i != count; ++i) {
+        buses[i].voice->DestroyVoice();
+        buses[i].effect->Release();
+    }
+}
+
+/// <summary>
+/// Creates the binaural bus, output L/R to master.
+/// </summary>
+/// <param name="set">The HRTF set.</param>
+/// <param name="bus">The bus, no channel used.</param>
+/// <returns></returns>
+auto WrapAL::engine_impl::CreateBinauralBus(hrtf::CALHRTF& set, BinauralBus& bus) noexcept -> HRESULT {
+    XAUDIO2_VOICE_DETAILS details = { 0 };
+    m_pMasterVoice->GetVoiceDetails(&details);
+    // L/R 输出到主音前两个声道, 单声道则平均
+    const uint32_t master = details.InputChannels;
+    float matrix[BinauralBusChannels * XAUDIO2_MAX_AUDIO_CHANNELS] = { 0.f };
+    if (master == 1) matrix[0] = matrix[1] = 0.5f;
+    else if (master <= XAUDIO2_MAX_AUDIO_CHANNELS) matrix[0] = matrix[BinauralBusChannels + 1] = 1.f;
+    std::memset(&bus, 0, sizeof(bus));
+    std::memset(&bus.param.binaural, 0xff, sizeof(bus.param.binaural));
+    bus.effect = hrtf::CALBinaural::Create(set);
+    if (!bus.effect) return E_OUTOFMEMORY;
+    XAUDIO2_EFFECT_DESCRIPTOR descriptor = {
+        static_cast<xapo::IXAPO*>(bus.effect), TRUE, BinauralBusChannels
+    };
+    XAUDIO2_EFFECT_CHAIN chain = { 1, &descriptor };
+    auto hr = m_pXAudio2Engine->CreateSubmixVoice(
+        &bus.voice,
+        BinauralBusChannels,
+        details.InputSampleRate,
+        0, GroupMaxDepth,
+        nullptr,
+        &chain
+        );
+    if (SUCCEEDED(hr)) hr = bus.voice->SetOutputMatrix(nullptr, BinauralBusChannels, master, matrix);
+    if (FAILED(hr)) {
+        if (bus.voice) bus.voice->DestroyVoice();
+        bus.effect->Release();
+    }
+    return hr;
+}
+
+/// <summary>
+/// Is 3D clip routed to the ambisonic bus.
+/// </summary>
+/// <param name="state">The 3D state of clip.</param>
+/// <returns></returns>
+bool WrapAL::engine_impl::ClipAmbisonic(const Clip3DState* state) const noexcept {
+    return state && state->ambisonic && state->ambisonic == m_uAmbiGen && m_ambisonic.voice;
+}
+
+/// <summary>
+/// Creates the ambisonic bus.
+/// 创建环绕声总线: 有HRTF则解码到双耳总线的虚拟扬声器, 否则到主音扬声器
+/// </summary>
+/// <param name="order">The order.</param>
+/// <param name="set">The HRTF set, null for speakers.</param>
+/// <param name="bus">The bus.</param>
+/// <returns></returns>
+auto WrapAL::engine_impl::CreateAmbisonic(uint32_t order, hrtf::CALHRTF* set, AmbisonicBus& bus) noexcept -> HRESULT {
+    assert(!bus.voice && "bus in use");
+    const auto channels = ambisonic::Channels(order);
+    XAUDIO2_VOICE_DETAILS details = { 0 };
+    m_pMasterVoice->GetVoiceDetails(&details);
+    bus.order = order;
+    // 在聚类之后, 双耳总线之前处理
+    auto hr = m_pXAudio2Engine->CreateSubmixVoice(
+        &bus.voice,
+        channels,
+        details.InputSampleRate,
+        0, 1,
+        nullptr,
+        nullptr
+        );
+    if (SUCCEEDED(hr) && set) {
+        XAUDIO2_SEND_DESCRIPTOR descriptors[AmbisonicMaxOrder];
+        for (; bus.count != order; ++bus.count) {
+            auto& decoder = bus.decoder[bus.count];
+            hr = this->CreateBinauralBus(*set, decoder);
+            if (FAILED(hr)) break;
+            // 虚拟扬声器方向固定
+            for (uint32_t i = 0; i != BinauralBusChannels; ++i) {
+                float azimuth, elevation;
+                ambisonic::VirtualSpeaker(order, bus.count * BinauralBusChannels + i, azimuth, elevation);
+                decoder.param.binaural.filter[i] = set->Find(azimuth, elevation);
+            }
+            decoder.effect->Publish(decoder.param);
+            descriptors[bus.count] = { 0, decoder.voice };
+        }
+        XAUDIO2_VOICE_SENDS sends = { order, descriptors };
+        if (SUCCEEDED(hr)) hr = bus.voice->SetOutputVoices(&sends);
+        float matrix[AmbisonicMaxOrder * BinauralBusChannels * AmbisonicMaxChannels];
+        ambisonic::DecodeVirtual(order, matrix);
+        for (uint32_t i = 0; SUCCEEDED(hr) && i != order; ++i) {
+            hr = bus.voice->SetOutputMatrix(bus.decoder[i].voice, channels,
+                BinauralBusChannels, matrix + i * BinauralBusChannels * channels);
+        }
+    }
+    else if (SUCCEEDED(hr)) hr = this->DecodeAmbisonic(bus.voice, order);
+    if (FAILED(hr)) this->ClearAmbisonic(bus);
+    return hr;
+}
+
+/// <summary>
+/// Sets decoding matrix of the ambisonic bus to speakers of master.
+/// </summary>
+/// <param name="voice">The voice of bus.</param>
+/// <param name="order">The order.</param>
+/// <returns>E_INVALIDARG if master has too many channels</returns>
+auto WrapAL::engine_impl::DecodeAmbisonic(IXAudio2SubmixVoice* voice, uint32_t order) noexcept -> HRESULT {
+    const auto dst = m_cMasterChannels, channels = ambisonic::Channels(order);
+    if (!dst || dst > Spatial3DMaxChannels) return E_INVALIDARG;
+    float matrix[Spatial3DMaxChannels * AmbisonicMaxChannels];
+    const bool lfe = !!(m_3d.GetFlags() & Flag3D_RedirectToLFE);
+    ambisonic::DecodeSpeakers(order, m_aLayout[dst - 1], lfe, matrix);
+    return voice->SetOutputMatrix(m_pMasterVoice, channels, dst, matrix);
+}
+
+/// <summary>
+/// Replaces the ambisonic bus, clips on old one output to new one, or back to panning.
+/// 替换环绕声总线, 旧总线上的片段改变输出, 声像矩阵在下次 Update3D 应用
+/// </summary>
+/// <param name="bus">The new bus, old one back in it.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::SwapAmbisonic(AmbisonicBus& bus) noexcept {
+    std::swap(m_ambisonic, bus);
+    ++m_uAmbiGen;
+    this->RouteClusters();
+    const auto gen = m_ambisonic.voice ? m_uAmbiGen : 0;
+    m_clips.ForEach([this, gen](CALAudioSourceClipImpl& clip) noexcept {
+        const auto state = clip.GetSpatial();
+        if (!state || !state->ambisonic) return;
+        state->ambisonic = gen;
+        if (!clip.HasSource()) return;
+        this->RouteClip(clip);
+        this->Apply3D(clip);
+    });
+}
+
+/// <summary>
+/// Destroys the ambisonic bus and its decoders.
+/// </summary>
+/// <param name="bus">The bus.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::ClearAmbisonic(AmbisonicBus& bus) noexcept {
+    if (bus.voice) bus.voice->DestroyVoice();
+    this->ClearBuses(bus.decoder, bus.count);
+    bus.voice = nullptr;
+    bus.order = 0;
+    bus.count = 0;
+}
+
+/// <summary>
+/// Gets volume of group x parents'.
+/// </summary>
+/// <param name="group">The group, null for top-level.</param>
+/// <returns></returns>
+auto WrapAL::engine_impl::GroupVolume(AudioSourceGroupImpl* group) noexcept -> float {
+    float level = 1.f;
+    for (; group; group = group->parent) {
+        float volume = 1.f;
+        group->voice->GetVolume(&volume);
+        level *= volume;
+    }
+    return level;
+}
+
+/// <summary>
+/// Gets cluster of distant 3D clip: sector of azimuth, last one kept if still near it.
+/// 按方位角扇区聚类, 离原扇区不远时保留, 避免在边界来回切换
+/// </summary>
+/// <param name="state">The 3D state of clip, null for none.</param>
+/// <param name="azimuth">The azimuth.</param>
+/// <returns>index of cluster</returns>
+auto WrapAL::engine_impl::ClusterOf(const Clip3DState* state, float azimuth) const noexcept -> uint32_t {
+    constexpr float pi = 3.141592654f;
+    const auto count = m_cCluster;
+    const auto width = pi * 2.f / float(count);
+    if (state && state->cluster && state->cluster_gen == m_uClusterGen) {
+        const auto last = state->cluster - 1;
+        const auto center = -pi + (float(last) + 0.5f) * width;
+        if (std::abs(std::remainder(azimuth - center, pi * 2.f)) < width * 0.75f) return last;
+    }
+    return std::min(uint32_t((azimuth + pi) / width), count - 1);
+}
+
+/// <summary>
+/// Gets the cluster of 3D clip.
+/// </summary>
+/// <param name="state">The 3D state of clip.</param>
+/// <returns>null if not clustered</returns>
+auto WrapAL::engine_impl::ClipCluster(const Clip3DState* state) noexcept -> EmitterCluster* {
+    if (!state || !state->cluster || state->cluster_gen != m_uClusterGen) return nullptr;
+    return state->cluster <= m_cCluster ? m_aCluster + state->cluster - 1 : nullptr;
+}
+
+/// <summary>
+/// Outputs clusters to the ambisonic bus or master, and reverb group of 3D clips.
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::RouteClusters() noexcept {
+    IXAudio2Voice* const output = m_ambisonic.voice
+        ? static_cast<IXAudio2Voice*>(m_ambisonic.voice) : m_pMasterVoice;
+    const auto reverb = (m_3d.GetFlags() & Flag3D_Reverb) ? m_pReverb3D : nullptr;
+    for (uint32_t i = 0; i != m_cCluster; ++i) {
+        auto& cluster = m_aCluster[i];
+        if (cluster.output == output && cluster.reverb == reverb) continue;
+        XAUDIO2_SEND_DESCRIPTOR descriptors[] = {
+            { 0, output },
+            { XAUDIO2_SEND_USEFILTER, reverb ? reverb->voice : nullptr },
+        };
+        XAUDIO2_VOICE_SENDS sends = { reverb ? 2u : 1u, descriptors };
+        // 无法发送到混响(如采样率不同)则只输出直达
+        if (FAILED(cluster.voice->SetOutputVoices(&sends)) && reverb) {
+            sends.SendCount = 1;
+            cluster.voice->SetOutputVoices(&sends);
+        }
+        cluster.output = output;
+        cluster.reverb = sends.SendCount == 2 ? reverb : nullptr;
+    }
+}
+
+/// <summary>
+/// Spatialises clusters at centroid of playing members.
+/// 聚类在成员的重心方向声像, 成员越分散越接近全向
+/// </summary>
+/// <returns></returns>
+void WrapAL::engine_impl::ApplyClusters() noexcept {
+    // X3DAudio: 系数 c 对应 2 * sin(pi / 6 * c)
+    constexpr float pi_6 = 3.141592654f / 6.f;
+    const auto flags = m_3d.GetFlags();
+    const auto order = m_ambisonic.order;
+    const auto dst = order ? ambisonic::Channels(order) : m_cMasterChannels;
+    if (!order && (!dst || dst > Spatial3DMaxChannels)) return;
+    const auto& layout = m_aLayout[order ? 0 : dst - 1];
+    for (uint32_t i = 0; i != m_cCluster; ++i) {
+        auto& cluster = m_aCluster[i];
+        const auto& sums = cluster.sums;
+        if (!(sums.weight > 0.f)) continue;
+        const auto inv = 1.f / sums.weight;
+        const auto horizon = std::sqrt(sums.x * sums.x + sums.z * sums.z);
+        const auto azimuth = std::atan2(sums.x, sums.z);
+        float matrix[AmbisonicMaxChannels > Spatial3DMaxChannels ? AmbisonicMaxChannels : Spatial3DMaxChannels];
+        if (order) {
+            const auto elevation = std::atan2(sums.y, horizon);
+            const auto length = std::sqrt(horizon * horizon + sums.y * sums.y);
+            ambisonic::EncodeMatrix(order, 1, azimuth, elevation, std::min(length * inv, 1.f), 0.f, 1.f, matrix);
+        }
+        else {
+            // 等功率声像与均匀分布按聚焦混合
+            const auto focus = std::min(horizon * inv, 1.f);
+            const auto uniform = layout.ring ? (1.f - focus) / std::sqrt(float(layout.ring)) : 0.f;
+            layout.Gains(azimuth, matrix);
+            float power = 0.f;
+            for (uint32_t k = 0; k != layout.ring; ++k) {
+                auto& g = matrix[layout.index[k]];
+                g = g * focus + uniform;
+                power += g * g;
+            }
+            const auto scale = 1.f / std::sqrt(std::max(power, 1e-12f));
+            for (uint32_t k = 0; k != dst; ++k) matrix[k] *= scale;
+        }
+        cluster.voice->SetOutputMatrix(cluster.output, 1, dst, matrix);
+        if (flags & Flag3D_LPFDirect) {
+            const XAUDIO2_FILTER_PARAMETERS filter = {
+                LowPassFilter, 2.f * std::sin(pi_6 * sums.lpf_direct * inv), 1.f
+            };
+            cluster.voice->SetFilterParameters(&filter);
+        }
+        // 单声道发送到混响全部声道
+        if (const auto reverb = cluster.reverb) {
+            float send[XAUDIO2_MAX_AUDIO_CHANNELS];
+            const auto channels = std::min(reverb->channels, uint32_t(XAUDIO2_MAX_AUDIO_CHANNELS));
+            for (uint32_t k = 0; k != channels; ++k) send[k] = sums.reverb * inv;
+            cluster.voice->SetOutputMatrix(reverb->voice, 1, channels, send);
+            if (flags & Flag3D_LPFReverb) {
+                const XAUDIO2_FILTER_PARAMETERS filter = {
+                    LowPassFilter, 2.f * std::sin(pi_6 * sums.lpf_reverb * inv), 1.f
+                };
+                cluster.voice->SetOutputFilterParameters(reverb->voice, &filter);
+            }
+        }
+    }
+}
+
+/// <summary>
+/// Destroys the clusters.
+/// </summary>
+/// <param name="clusters">The clusters.</param>
+/// <param name="count">The count.</param>
+/// <returns></returns>
+void WrapAL::engine_impl::ClearClusters(EmitterCluster* clusters, uint32_t count) noexcept {
+    for (uint32_t i = 0; i != count; ++i) clusters[i].voice->DestroyVoice();
 }
 
 /// <summary>
@@ -62,6 +1879,10 @@ auto WrapAL::GetApiLevelString(APILevel level) noexcept -> const char* {
         return "OpenAL";
     case WrapAL::APILevel::Level_DirectSound:
         return "Direct Sound";
+    case WrapAL::APILevel::Level_SoftwareMixer:
+        return "Software Mixer";
+    case WrapAL::APILevel::Level_Offline:
+        return "Offline";
     default:
         return "ERROR";
     }
@@ -83,7 +1904,7 @@ auto WrapAL::GetApiLevelString(APILevel level) noexcept -> const char* {
 /// <returns></returns>
 auto WrapAL::CALAudioSourceClip::GetGroup() const noexcept -> CALAudioSourceGroup {
     return CALAudioSourceGroup(
-        m_handle ? reinterpret_cast<ALHandle>((*this)->group) : ALInvalidHandle
+        WrapALAudioEngine.ac_group(m_handle)
     );
 }
 
@@ -165,8 +1986,15 @@ auto WrapAL::CALAudioEngine::Initialize(IALConfigure* config) noexcept -> ECode
     // 提前声明
     UINT create_flags = 0;
     UINT32 device_count = 0;
+    const auto level = this->configure ? this->configure->ChooseAPILevel() : APILevel::Level_Unknown;
+#ifndef WRAPAL_XAUDIO2_7_SUPPORT
+    // 指定软件混音或 OpenAL
+    if (WrapAL::is_builtin(level)) {
+        m_lvAPI = level;
+    }
+#endif
     // 载入 XAudio2 动态链接库
-    if (SUCCEEDED(hr)) {
+    if (SUCCEEDED(hr) && !WrapAL::is_builtin(m_lvAPI)) {
 #ifdef WRAPAL_XAUDIO2_7_SUPPORT
 #ifndef NDEBUG
         create_flags |= XAUDIO2_DEBUG_ENGINE;
@@ -229,7 +2057,10 @@ auto WrapAL::CALAudioEngine::Initialize(IALConfigure* config) noexcept -> ECode
         // 有效
         if (const auto xa2 = m_pImpl->m_hXAudio2) {
             load_func(m_pImpl->XAudio2Create, xa2, "XAudio2Create");
-            //load_func(m_pImpl->X3DAudioInitialize, xa2, "X3DAudioInitialize");
+        }
+        // 没有找到, 自动选择时退回软件混音
+        else if (level == APILevel::Level_Unknown) {
+            m_lvAPI = APILevel::Level_SoftwareMixer;
         }
         // 没有找到
         else {
@@ -239,18 +2070,35 @@ auto WrapAL::CALAudioEngine::Initialize(IALConfigure* config) noexcept -> ECode
 #endif
     }
     // 检查是否自动刷新
-    if (SUCCEEDED(hr) && this->configure->IsAutoUpdate()) {
+    const bool auto_update = SUCCEEDED(hr) && this->configure->IsAutoUpdate();
 #ifdef WRAPAL_SAME_THREAD_UPDATE
+    if (auto_update) {
         assert(!"you must undef 'WRAPAL_SAME_THREAD_UPDATE' if want auto-update");
         hr = E_ABORT;
-#else
-
-#endif
-        assert(!"noimpl");
     }
+#endif
     // 创建 XAudio2 引擎
     if (SUCCEEDED(hr)) {
         assert(!m_pImpl->m_pXAudio2Engine && "m_pXAudio2 must be null");
+#ifndef WRAPAL_XAUDIO2_7_SUPPORT
+        // 软件混音, 离线模式没有输出设备
+        if (WrapAL::is_mixer(m_lvAPI)) {
+            mixer::IALMixerOutput* output = nullptr;
+            if (m_lvAPI == APILevel::Level_SoftwareMixer) output = mixer::CreateDefaultOutput();
+            // 周期与延迟
+            AudioLatency latency = { 0, 0 };
+            this->configure->ChooseLatency(latency);
+            if (output || m_lvAPI == APILevel::Level_Offline)
+                hr = mixer::CALMixerEngine::Create(&m_pImpl->m_pXAudio2Engine, output, latency);
+            else hr = E_OUTOFMEMORY;
+        }
+        // OpenAL, 运行时载入 OpenAL32.dll
+        else if (m_lvAPI == APILevel::Level_OpenAL) {
+            hr = openal::CALOpenALEngine::Create(&m_pImpl->m_pXAudio2Engine);
+            if (FAILED(hr)) this->FormatErrorFoF(error, __FUNCTION__, L"OpenAL32.dll");
+        }
+        else
+#endif
         hr = m_pImpl->XAudio2Create(&m_pImpl->m_pXAudio2Engine, 0, XAUDIO2_DEFAULT_PROCESSOR);
     }
 #ifdef WRAPAL_XAUDIO2_7_SUPPORT
@@ -267,11 +2115,13 @@ auto WrapAL::CALAudioEngine::Initialize(IALConfigure* config) noexcept -> ECode
         }
     }
 #else
+    // 软件混音或 OpenAL
+    const bool use_mixer = WrapAL::is_builtin(m_lvAPI);
     // 枚举输出
     IMMDeviceEnumerator* enumerator = nullptr;
     IMMDeviceCollection * devices = nullptr;
     // 获取枚举器
-    if (SUCCEEDED(hr)) {
+    if (SUCCEEDED(hr) && !use_mixer) {
         hr = ::CoCreateInstance(
             CLSID_MMDeviceEnumerator, 
             nullptr,
@@ -281,7 +2131,7 @@ auto WrapAL::CALAudioEngine::Initialize(IALConfigure* config) noexcept -> ECode
             );
     }
     // 获取输出设备集合
-    if (SUCCEEDED(hr)) {
+    if (SUCCEEDED(hr) && !use_mixer) {
         hr = enumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &devices);
     }
     // 设备信息
@@ -289,11 +2139,11 @@ auto WrapAL::CALAudioEngine::Initialize(IALConfigure* config) noexcept -> ECode
     struct { PROPVARIANT name, id; } 
     devices_info[WrapAL::DeviceMaxCount];
     // 获取输出设备数量
-    if (SUCCEEDED(hr)) {
+    if (SUCCEEDED(hr) && !use_mixer) {
         hr = devices->GetCount(&device_count);
     }
     // 获取设备信息
-    if (SUCCEEDED(hr)) {
+    if (SUCCEEDED(hr) && !use_mixer) {
         // 太大
         if (device_count > DeviceMaxCount) {
             device_count = DeviceMaxCount;
@@ -338,6 +2188,23 @@ auto WrapAL::CALAudioEngine::Initialize(IALConfigure* config) noexcept -> ECode
             WrapAL::SafeRelease(device);
         }
     }
+    // 软件混音设备
+    mixer::MixerDeviceList mixer_devices;
+    mixer_devices.count = 0;
+    if (SUCCEEDED(hr) && m_lvAPI == APILevel::Level_SoftwareMixer) {
+        mixer::EnumOutputDevices(mixer_devices);
+        device_count = mixer_devices.count;
+        std::memcpy(list, mixer_devices.list, sizeof(list[0]) * device_count);
+    }
+    // OpenAL 设备
+    openal::ALDeviceList al_devices;
+    al_devices.count = 0;
+    if (SUCCEEDED(hr) && m_lvAPI == APILevel::Level_OpenAL) {
+        const auto engine = static_cast<openal::CALOpenALEngine*>(m_pImpl->m_pXAudio2Engine);
+        openal::EnumOutputDevices(engine->AL(), al_devices);
+        device_count = al_devices.count;
+        std::memcpy(list, al_devices.list, sizeof(list[0]) * device_count);
+    }
 #endif
     // 创建 Mastering Voice 接口
     if (SUCCEEDED(hr)) {
@@ -376,23 +2243,68 @@ auto WrapAL::CALAudioEngine::Initialize(IALConfigure* config) noexcept -> ECode
     }
 #ifndef WRAPAL_XAUDIO2_7_SUPPORT
     // 扫尾
-    for (UINT i = 0; i < device_count; ++i) {
+    if (!use_mixer) for (UINT i = 0; i < device_count; ++i) {
         ::PropVariantClear(&devices_info[i].id);
         ::PropVariantClear(&devices_info[i].name);
     }
     WrapAL::SafeRelease(enumerator);
     WrapAL::SafeRelease(devices);
 #endif
-    // 初始化X3DAudio
+    // 启动解码线程, 离线渲染时在回调中直接解码
     if (SUCCEEDED(hr)) {
-        /*DWORD mask;
-        X3DAUDIO_HANDLE instance;
-        // 获取通道掩码
-        hr = m_pMasterVoice->GetChannelMask(&mask);
-        // 初始化 X3D
-        if (SUCCEEDED(hr)) {
-            hr = CALAudioEngine::X3DAudioInitialize(mask, X3DAUDIO_SPEED_OF_SOUND, instance);
-        }*/
+        const auto offline = m_lvAPI == APILevel::Level_Offline;
+        hr = m_pImpl->m_decoder.Start(offline ? 0 : DecodeThreadCount);
+    }
+    // 声音池
+    if (SUCCEEDED(hr)) {
+        m_pImpl->m_voices.Init(m_pImpl->m_pXAudio2Engine);
+    }
+    // 引擎时钟: 每个处理周期的帧数, OpenAL 没有固定周期则按时间
+    if (SUCCEEDED(hr)) {
+        XAUDIO2_VOICE_DETAILS details = { 0 };
+        m_pImpl->m_pMasterVoice->GetVoiceDetails(&details);
+        m_pImpl->m_uSampleRate = details.InputSampleRate;
+        m_pImpl->m_cPassFrames = details.InputSampleRate
+            * XAUDIO2_QUANTUM_NUMERATOR / XAUDIO2_QUANTUM_DENOMINATOR;
+#ifndef WRAPAL_XAUDIO2_7_SUPPORT
+        if (WrapAL::is_mixer(m_lvAPI)) {
+            const auto engine = static_cast<mixer::CALMixerEngine*>(m_pImpl->m_pXAudio2Engine);
+            m_pImpl->m_cPassFrames = engine->GetQuantum();
+        }
+        else if (m_lvAPI == APILevel::Level_OpenAL) m_pImpl->m_cPassFrames = 0;
+#endif
+        m_pImpl->m_dClockStart = WrapAL::now_sec();
+        CALPerfCounters::Reset();
+    }
+    // 每个处理周期执行命令
+    if (SUCCEEDED(hr)) {
+        hr = m_pImpl->m_pXAudio2Engine->RegisterForCallbacks(m_pImpl);
+    }
+#ifndef WRAPAL_SAME_THREAD_UPDATE
+    // 自动刷新线程
+    if (SUCCEEDED(hr) && auto_update) {
+        m_pImpl->m_updater = std::thread([this]() noexcept {
+            while (!m_pImpl->m_bExitUpdate) {
+                this->Update();
+                std::this_thread::sleep_for(std::chrono::milliseconds(AutoUpdateInterval));
+            }
+        });
+    }
+#endif
+    // 3D: 主音声道与扬声器布局
+    if (SUCCEEDED(hr)) {
+        XAUDIO2_VOICE_DETAILS details = { 0 };
+        m_pImpl->m_pMasterVoice->GetVoiceDetails(&details);
+        DWORD mask = 0;
+#ifndef WRAPAL_XAUDIO2_7_SUPPORT
+        // 获取通道掩码, 失败则按声道数
+        if (FAILED(m_pImpl->m_pMasterVoice->GetChannelMask(&mask))) mask = 0;
+#endif
+        m_pImpl->m_spatial.lock();
+        m_pImpl->m_cMasterChannels = details.InputChannels;
+        m_pImpl->m_uMasterMask = mask;
+        m_pImpl->InitLayouts();
+        m_pImpl->m_spatial.unlock();
     }
     // 获取libmpg123.dll句柄
     if (SUCCEEDED(hr)) {
@@ -430,6 +2342,25 @@ auto WrapAL::CALAudioEngine::Initialize(IALConfigure* config) noexcept -> ECode
 /// </summary>
 /// <returns></returns>
 void WrapAL::CALAudioEngine::Uninitialize() noexcept {
+    // 停止自动刷新
+    if (m_pImpl && m_pImpl->m_updater.joinable()) {
+        m_pImpl->m_bExitUpdate = true;
+        m_pImpl->m_updater.join();
+    }
+    // 执行剩余命令, 释放渐变与命令持有的片段
+    if (m_pImpl && m_pImpl->m_pXAudio2Engine) {
+        m_pImpl->m_pXAudio2Engine->StopEngine();
+        m_pImpl->m_pXAudio2Engine->UnregisterForCallbacks(m_pImpl);
+        m_pImpl->OnProcessingPassStart();
+        m_pImpl->m_voicing.lock();
+        m_pImpl->ClearSchedule();
+        m_pImpl->ClearOcclusion();
+        m_pImpl->m_voicing.unlock();
+        m_pImpl->m_locker.Lock();
+        m_pImpl->ClearFades();
+        m_pImpl->m_locker.Unlock();
+        this->Update();
+    }
 #ifndef NDEBUG
     bool linked1 = first_clip__dbg.next == &last_clip__dbg;
     bool linked2 = last_clip__dbg.prev == &first_clip__dbg;
@@ -437,8 +2368,20 @@ void WrapAL::CALAudioEngine::Uninitialize() noexcept {
 #endif
     // 释放
     if (m_pImpl) {
-        for (auto& group : m_pImpl->m_aGroup) { group.Release(); }
+        m_pImpl->m_decoder.Stop();
+        m_pImpl->m_voices.Clear();
+        m_pImpl->m_pReverb3D = nullptr;
+        m_pImpl->m_cListener = 0;
+        m_pImpl->m_cRealVoice = m_pImpl->m_cVirtualVoice = m_pImpl->m_uGlitches = 0;
+        m_pImpl->ClearClusters(m_pImpl->m_aCluster, m_pImpl->m_cCluster);
+        m_pImpl->m_cCluster = 0;
+        m_pImpl->ClearGroups();
+        m_pImpl->ClearAmbisonic(m_pImpl->m_ambisonic);
+        m_pImpl->ClearBuses(m_pImpl->m_aBus, m_pImpl->m_cBus);
+        m_pImpl->m_cBus = 0;
+        WrapAL::SafeRelease(m_pImpl->m_pHRTF);
         if (m_pImpl->m_pMasterVoice) m_pImpl->m_pMasterVoice->DestroyVoice();
+        m_pImpl->m_root.ReleaseEffects();
         if (m_pImpl->m_pXAudio2Engine) m_pImpl->m_pXAudio2Engine->Release();
         // 释放dll文件
         if (m_pImpl->libmpg123) {
@@ -451,56 +2394,58 @@ void WrapAL::CALAudioEngine::Uninitialize() noexcept {
         // 释放实现代码
         m_pImpl->~engine_impl();
         std::free(m_pImpl);
+        m_pImpl = nullptr;
     }
+    // 可以再次初始化
+    m_lvAPI = APILevel::Level_Unknown;
     WrapAL::SafeRelease(force_cast(this->configure));
 }
 
 // 创建音频片段
-auto WrapAL::CALAudioEngine::CreateClip(XALAudioStream* stream, AudioClipFlag flags, const char* group_name) noexcept -> ALHandle {
+auto WrapAL::CALAudioEngine::CreateClip(XALAudioStream* stream, AudioClipFlag flags, const CALAudioSourceGroup& group) noexcept -> ALHandle {
     assert(stream && "bad argument");
     wchar_t error[ErrorInfoLength]; error[0] = 0;
     ALHandle id = ALInvalidHandle;
+    const auto group_impl = reinterpret_cast<AudioSourceGroupImpl*>(group.m_handle);
     // 获取错误信息
     if (!stream->GetLastErrorInfo(error)) {
         // 流模式?
         if (flags & WrapAL::Flag_StreamingReading) {
-            constexpr size_t blen = StreamingBufferSize*StreamingBufferCount;
-            auto buffer = reinterpret_cast<uint8_t*>(std::malloc(blen));
+            uint8_t* buffer = nullptr;
             auto* real = this->configure->SmallAlloc<CALAudioSourceClipImpl>();
             // 申请成功
-            if (buffer && (id = reinterpret_cast<ALHandle>(real))) {
-                // 置换构造
+            if (real) {
+                // 置换构造, 数据在解码环中
                 new (real) CALAudioSourceClipImpl(
-                    std::move(buffer), stream, flags,
-                    StreamingBufferSize*StreamingBufferCount
+                    std::move(buffer), stream, flags, 0
                 );
+                // 登记句柄
+                id = this->register_clip(*real);
                 // 设置
                 stream->GetFormat().MakeWave(real->wave);
-                auto hr = S_OK;
+                // 解码环
+                auto hr = id ? real->CreateStreamRing() : E_OUTOFMEMORY;
                 // 创建source
                 if (SUCCEEDED(hr)) {
-                    hr = this->create_source_voice(*real, group_name);
+                    hr = this->create_source_voice(*real, group_impl);
                 }
-                // 输入数据
-                for (unsigned int i = 0; i < StreamingBufferCount-1; ++i) {
-                    if (SUCCEEDED(hr)) {
-                        hr = real->LoadAndBufferData(i);
-                    }
+                // 解码线程预先解码, 回调中输入数据
+                if (SUCCEEDED(hr)) {
+                    real->ResetStream(0);
                 }
                 // 检查错误
                 if (FAILED(hr)) {
                     this->FormatErrorHR(error, __FUNCTION__, hr);
                 }
+                // 失败则释放片段, 没有句柄则无法释放
+                if (!id) real->Destroy();
+                else if (FAILED(hr)) WrapAL::release_failed(*real);
+                if (FAILED(hr)) id = ALInvalidHandle;
             }
             // 错误
             else {
                 this->FormatErrorOOM(error, __FUNCTION__);
             }
-            if (buffer) {
-                std::free(buffer);
-                buffer = nullptr;
-            }
-            
         }
         // 整片读取
         else {
@@ -510,7 +2455,7 @@ auto WrapAL::CALAudioEngine::CreateClip(XALAudioStream* stream, AudioClipFlag fl
             if (buffer) {
                 stream->ReadNext(size_in_byte, buffer);
                 stream->GetLastErrorInfo(error);
-                id = this->CreateClip(stream->GetFormat(), std::move(buffer), size_in_byte, flags, group_name);
+                id = this->CreateClip(stream->GetFormat(), std::move(buffer), size_in_byte, flags, group);
             }
             // OOM
             else {
@@ -527,7 +2472,7 @@ auto WrapAL::CALAudioEngine::CreateClip(XALAudioStream* stream, AudioClipFlag fl
 }
 
 // 创建音频片段
-auto WrapAL::CALAudioEngine::CreateClip(EncodingFormat format, const wchar_t* file_path, AudioClipFlag flags, const char* group_name) noexcept ->ALHandle {
+auto WrapAL::CALAudioEngine::CreateClip(EncodingFormat format, const wchar_t* file_path, AudioClipFlag flags, const CALAudioSourceGroup& group) noexcept ->ALHandle {
     // 创建音频流
     auto file_stream = this->CreatStreamFromFile(file_path);
     // 内存不足?
@@ -536,11 +2481,11 @@ auto WrapAL::CALAudioEngine::CreateClip(EncodingFormat format, const wchar_t* fi
         return ALHandle(ALInvalidHandle);
     }
     // 嫁接
-    return this->CreateClip(format, file_stream, flags, group_name);
+    return this->CreateClip(format, file_stream, flags, group);
 }
 
 // 创建音频片段
-auto WrapAL::CALAudioEngine::CreateClip(EncodingFormat format, IALFileStream* file_stream, AudioClipFlag flags, const char* group_name) noexcept ->ALHandle {
+auto WrapAL::CALAudioEngine::CreateClip(EncodingFormat format, IALFileStream* file_stream, AudioClipFlag flags, const CALAudioSourceGroup& group) noexcept ->ALHandle {
     assert(file_stream && "bad argument");
     ALHandle clip(ALInvalidHandle);
     // 错误(已报错)
@@ -550,7 +2495,7 @@ auto WrapAL::CALAudioEngine::CreateClip(EncodingFormat format, IALFileStream* fi
     }
     // 创建音频流
     if (const auto as = this->configure->CreateAudioStream(format, file_stream)) {
-        clip = this->CreateClip(as, flags, group_name);
+        clip = this->CreateClip(as, flags, group);
         as->Release();
     }
     // 出现错误
@@ -565,7 +2510,7 @@ auto WrapAL::CALAudioEngine::CreateClip(
     const AudioFormat& format, 
     uint8_t*&& buf, size_t len, 
     AudioClipFlag flags, 
-    const char* group_name) noexcept -> ALHandle {
+    const CALAudioSourceGroup& group) noexcept -> ALHandle {
     // 直接使用缓冲区不能只用流模式
     assert(!(flags & WrapAL::Flag_StreamingReading) && "directly buffer can't be streaming mode");
     auto* real = this->configure->SmallAlloc<CALAudioSourceClipImpl>();
@@ -576,12 +2521,18 @@ auto WrapAL::CALAudioEngine::CreateClip(
         new (real) CALAudioSourceClipImpl(
             std::move(buf), nullptr, flags, static_cast<uint32_t>(len)
         );
+        // 登记句柄
+        if (!this->register_clip(*real)) {
+            real->Destroy();
+            this->OutputErrorOOM(__FUNCTION__);
+            return ALInvalidHandle;
+        }
         // 设置
         format.MakeWave(real->wave);
         auto hr = S_OK;
         // 创建source
         if (SUCCEEDED(hr)) {
-            hr = this->create_source_voice(*real, group_name);
+            hr = this->create_source_voice(*real, reinterpret_cast<AudioSourceGroupImpl*>(group.m_handle));
         }
         // 提交缓冲区
         if (SUCCEEDED(hr)) {
@@ -590,9 +2541,11 @@ auto WrapAL::CALAudioEngine::CreateClip(
             buffer.AudioBytes = static_cast<UINT32>(len);
             hr = real->ProcessBufferData(buffer);
         }
-        // 检查错误
+        // 检查错误, 释放片段
         if (FAILED(hr)) {
             this->OutputErrorHR(__FUNCTION__, hr);
+            WrapAL::release_failed(*real);
+            return ALInvalidHandle;
         }
     }
     // 依然有效?
@@ -600,7 +2553,7 @@ auto WrapAL::CALAudioEngine::CreateClip(
         std::free(buf);
         buf = nullptr;
     }
-    return reinterpret_cast<ALHandle>(real);
+    return real ? real->handle : ALInvalidHandle;
 }
 
 
@@ -609,11 +2562,12 @@ auto WrapAL::CALAudioEngine::CreateClip(
     const AudioFormat & format, 
     const uint8_t* src, size_t size, 
     AudioClipFlag config, 
-    const char* group_name) noexcept ->ALHandle {
+    const CALAudioSourceGroup& group) noexcept ->ALHandle {
     // 申请空间
-    if (const auto new_src = reinterpret_cast< uint8_t*>(std::malloc(size))) {
+    // 非 const, 才能移动到接管缓冲区的重载
+    if (auto new_src = reinterpret_cast< uint8_t*>(std::malloc(size))) {
         std::memcpy(new_src, src, size);
-        return this->CreateClip(format, std::move(new_src), size, config, group_name);
+        return this->CreateClip(format, std::move(new_src), size, config, group);
     }
     else {
         this->OutputErrorOOM(__FUNCTION__);
@@ -621,32 +2575,65 @@ auto WrapAL::CALAudioEngine::CreateClip(
     return ALInvalidHandle;
 }
 
-// 摧毁指定片段
+// 创建音频片段: 按名称查找或创建组别
+auto WrapAL::CALAudioEngine::CreateClip(XALAudioStream* stream, AudioClipFlag flags, const char* group_name) noexcept -> ALHandle {
+    return this->CreateClip(stream, flags, this->clip_group(group_name));
+}
+
+// 创建音频片段: 按名称查找或创建组别
+auto WrapAL::CALAudioEngine::CreateClip(EncodingFormat format, const wchar_t* file_path, AudioClipFlag flags, const char* group_name) noexcept -> ALHandle {
+    return this->CreateClip(format, file_path, flags, this->clip_group(group_name));
+}
+
+// 创建音频片段: 按名称查找或创建组别
+auto WrapAL::CALAudioEngine::CreateClip(EncodingFormat format, IALFileStream* file_stream, AudioClipFlag flags, const char* group_name) noexcept -> ALHandle {
+    return this->CreateClip(format, file_stream, flags, this->clip_group(group_name));
+}
+
+// 创建音频片段: 按名称查找或创建组别
+auto WrapAL::CALAudioEngine::CreateClip(const AudioFormat& format, uint8_t*&& buf, size_t len, AudioClipFlag flags, const char* group_name) noexcept -> ALHandle {
+    return this->CreateClip(format, std::move(buf), len, flags, this->clip_group(group_name));
+}
+
+// 创建音频片段: 按名称查找或创建组别
+auto WrapAL::CALAudioEngine::CreateClip(const AudioFormat& format, const uint8_t* src, size_t size, AudioClipFlag flags, const char* group_name) noexcept -> ALHandle {
+    return this->CreateClip(format, src, size, flags, this->clip_group(group_name));
+}
+
+// 增加句柄引用
 bool WrapAL::CALAudioEngine::ac_addref(ALHandle id) noexcept {
     assert(id != ALInvalidHandle);
-    auto clip = reinterpret_cast<CALAudioSourceClipImpl*>(id);
+    const auto clip = this->acquire_clip(id);
+    // 过期句柄
+    if (!clip) return false;
     assert(clip->Check_debug());
-    clip->AddRef();
-    return true;
+    // 查找时的引用交给句柄
+    if (clip->AddHandleRef()) return true;
+    clip->Release();
+    return false;
 }
 
-// 摧毁指定片段
+// 释放句柄引用, 用户的引用全部释放后句柄失效
 bool WrapAL::CALAudioEngine::ac_release(ALHandle id) noexcept {
     assert(id != ALInvalidHandle);
-    auto clip = reinterpret_cast<CALAudioSourceClipImpl*>(id);
+    const auto clip = this->acquire_clip(id);
+    // 过期句柄
+    if (!clip) return false;
     assert(clip->Check_debug());
+    // 重复释放: 队列中的命令可能仍持有引用
+    const auto released = clip->ReleaseHandleRef();
+    if (released) clip->Release();
     clip->Release();
-    return true;
+    return released;
 }
 
 // 播放指定片段
 bool WrapAL::CALAudioEngine::ac_play(ALHandle id) noexcept {
     assert(id != ALInvalidHandle);
-    // OK
-    if (id != ALInvalidHandle) {
-        auto clip = reinterpret_cast<CALAudioSourceClipImpl*>(id);
+    // OK, 引用交给命令
+    if (const auto clip = this->acquire_clip(id)) {
         assert(clip->Check_debug());
-        clip->Play();
+        m_pImpl->PushCommand(*clip, Command_Play);
         return true;
     }
     return false;
@@ -655,11 +2642,10 @@ bool WrapAL::CALAudioEngine::ac_play(ALHandle id) noexcept {
 // 暂停指定片段
 bool WrapAL::CALAudioEngine::ac_pause(ALHandle id) noexcept{
     assert(id != ALInvalidHandle);
-    // OK
-    if (id != ALInvalidHandle) {
-        auto clip = reinterpret_cast<CALAudioSourceClipImpl*>(id);
+    // OK, 引用交给命令
+    if (const auto clip = this->acquire_clip(id)) {
         assert(clip->Check_debug());
-        clip->Stop();
+        m_pImpl->PushCommand(*clip, Command_Pause);
         return true;
     }
     return false;
@@ -668,11 +2654,34 @@ bool WrapAL::CALAudioEngine::ac_pause(ALHandle id) noexcept{
 // 音频定位
 bool WrapAL::CALAudioEngine::ac_seek(ALHandle id, float pos) noexcept {
     assert(id != ALInvalidHandle);
-    // OK
-    if (id != ALInvalidHandle) {
-        auto* clip = reinterpret_cast<CALAudioSourceClipImpl*>(id);
+    // OK, 引用交给命令, 流模式在解码线程中解码
+    if (const auto clip = this->acquire_clip(id)) {
         assert(clip->Check_debug());
-        clip->Seek(pos);
+        m_pImpl->PushCommand(*clip, Command_Seek, pos);
+        return true;
+    }
+    return false;
+}
+
+// 在引擎时钟的采样时间播放
+bool WrapAL::CALAudioEngine::ac_play_at(ALHandle id, uint64_t time) noexcept {
+    assert(id != ALInvalidHandle);
+    // OK, 引用交给命令, 静音前导在执行命令时准备
+    if (const auto clip = this->acquire_clip(id)) {
+        assert(clip->Check_debug());
+        m_pImpl->PushSchedule(*clip, Command_PlayAt, time);
+        return true;
+    }
+    return false;
+}
+
+// 在引擎时钟的采样时间停止
+bool WrapAL::CALAudioEngine::ac_stop_at(ALHandle id, uint64_t time) noexcept {
+    assert(id != ALInvalidHandle);
+    // OK, 引用交给命令, 在所在周期截断数据
+    if (const auto clip = this->acquire_clip(id)) {
+        assert(clip->Check_debug());
+        m_pImpl->PushSchedule(*clip, Command_StopAt, time);
         return true;
     }
     return false;
@@ -683,10 +2692,12 @@ auto WrapAL::CALAudioEngine::ac_tell(ALHandle id) noexcept -> float {
     assert(id != ALInvalidHandle);
     float pos = 0.0f;
     // OK
-    if (id != ALInvalidHandle) {
-        auto* clip = reinterpret_cast<CALAudioSourceClipImpl*>(id);
+    if (const auto clip = this->acquire_clip(id)) {
         assert(clip->Check_debug());
+        m_pImpl->m_voicing.lock();
         pos = clip->Tell();
+        m_pImpl->m_voicing.unlock();
+        clip->Release();
     }
     return pos;
 }
@@ -696,48 +2707,139 @@ auto WrapAL::CALAudioEngine::ac_duration(ALHandle id) noexcept -> float {
     assert(id != ALInvalidHandle);
     float duration = 0.f;
     // OK
-    if (id != ALInvalidHandle) {
-        auto* clip = reinterpret_cast<CALAudioSourceClipImpl*>(id);
+    if (const auto clip = this->acquire_clip(id)) {
         duration = clip->Duration();
+        clip->Release();
     }
     return duration;
 }
 
 
-// 设置或获取片段音量
-auto WrapAL::CALAudioEngine::ac_volume(ALHandle id, float volume) noexcept -> float {
+// 设置或获取片段音量
+auto WrapAL::CALAudioEngine::ac_volume(ALHandle id, float volume) noexcept -> float {
+    assert(id != ALInvalidHandle);
+    // OK
+    if (const auto clip = this->acquire_clip(id)) {
+        if (volume >= 0.f) m_pImpl->PushCommand(*clip, Command_Volume, volume);
+        else {
+            volume = clip->GetVolume();
+            clip->Release();
+        }
+    }
+    return volume;
+}
+
+
+// 设置或获取片段回放速率
+auto WrapAL::CALAudioEngine::ac_ratio(ALHandle id, float ratio) noexcept -> float {
+    assert(id != ALInvalidHandle);
+    // OK
+    if (const auto clip = this->acquire_clip(id)) {
+        if (ratio >= 0.f) m_pImpl->PushCommand(*clip, Command_Ratio, ratio);
+        else {
+            ratio = clip->GetFrequencyRatio();
+            clip->Release();
+        }
+    }
+    return ratio;
+}
+
+// 音量渐变
+bool WrapAL::CALAudioEngine::ac_fade(ALHandle id, float volume, float time) noexcept {
+    assert(id != ALInvalidHandle);
+    // OK
+    if (const auto clip = this->acquire_clip(id)) {
+        assert(clip->Check_debug());
+        // 立即
+        if (time <= 0.f) {
+            m_pImpl->PushCommand(*clip, Command_Volume, volume);
+            return true;
+        }
+        m_pImpl->m_locker.Lock();
+        const auto ok = m_pImpl->AddFade(*clip, volume, time);
+        m_pImpl->m_locker.Unlock();
+        clip->Release();
+        return ok;
+    }
+    return false;
+}
+
+// 设置流缓冲区
+bool WrapAL::CALAudioEngine::ac_streaming(ALHandle id, uint32_t size, uint32_t count) noexcept {
+    assert(id != ALInvalidHandle);
+    // OK, 只更换内存, 在解码线程中重新解码
+    if (const auto clip = this->acquire_clip(id)) {
+        assert(clip->Check_debug());
+        m_pImpl->m_voicing.lock();
+        const auto hr = clip->SetStreamingBuffer(size, count);
+        m_pImpl->m_voicing.unlock();
+        clip->Release();
+        if (FAILED(hr)) this->OutputErrorHR(__FUNCTION__, hr);
+        return SUCCEEDED(hr);
+    }
+    return false;
+}
+
+// 设置或获取片段优先级
+auto WrapAL::CALAudioEngine::ac_priority(ALHandle id, int32_t priority) noexcept -> int32_t {
+    assert(id != ALInvalidHandle);
+    if (const auto clip = this->acquire_clip(id)) {
+        if (priority < 0) priority = clip->GetPriority();
+        else clip->SetPriority(uint8_t(std::min(priority, 255)));
+        clip->Release();
+    }
+    return priority;
+}
+
+// 设置或获取片段衰减
+auto WrapAL::CALAudioEngine::ac_attenuation(ALHandle id, float attenuation) noexcept -> float {
     assert(id != ALInvalidHandle);
-    // OK
-    if (id != ALInvalidHandle) {
-        auto* clip = reinterpret_cast<CALAudioSourceClipImpl*>(id);
-        if (volume < 0.f) volume = clip->GetVolume();
-        else clip->SetVolume(volume);
+    if (const auto clip = this->acquire_clip(id)) {
+        if (attenuation < 0.f) attenuation = clip->GetAttenuation();
+        else clip->SetAttenuation(attenuation);
+        clip->Release();
     }
-    return volume;
+    return attenuation;
 }
 
+// 片段是否为虚拟
+bool WrapAL::CALAudioEngine::ac_virtual(ALHandle id) noexcept {
+    assert(id != ALInvalidHandle);
+    const auto clip = this->acquire_clip(id);
+    if (!clip) return false;
+    const auto virt = clip->IsVirtual();
+    clip->Release();
+    return virt;
+}
 
-// 设置或获取片段回放速率
-auto WrapAL::CALAudioEngine::ac_ratio(ALHandle id, float ratio) noexcept -> float {
+// 获取片段缓冲区欠载次数
+auto WrapAL::CALAudioEngine::ac_underruns(ALHandle id) noexcept -> uint32_t {
     assert(id != ALInvalidHandle);
-    // OK
-    if (id != ALInvalidHandle) {
-        auto* clip = reinterpret_cast<CALAudioSourceClipImpl*>(id);
-        if (ratio < 0.f) ratio = clip->GetFrequencyRatio();
-        else clip->SetFrequencyRatio(ratio);
-    }
-    return ratio;
+    const auto clip = this->acquire_clip(id);
+    if (!clip) return 0;
+    const auto count = clip->GetUnderruns();
+    clip->Release();
+    return count;
+}
+
+// 获取片段组别
+auto WrapAL::CALAudioEngine::ac_group(ALHandle id) noexcept -> ALHandle {
+    const auto clip = this->acquire_clip(id);
+    if (!clip) return ALInvalidHandle;
+    const auto group = reinterpret_cast<ALHandle>(clip->group);
+    clip->Release();
+    return group;
 }
 
 // namesapce!
 namespace WrapAL {
     // stop clip anyway
-    WRAPAL_NOINLINE auto TerminateClipAnyway(ALHandle clip_id) {
+    WRAPAL_NOINLINE void TerminateClipAnyway(ALHandle clip_id) noexcept {
         assert(clip_id != ALInvalidHandle);
-        if (clip_id != ALInvalidHandle) {
-            auto clip = reinterpret_cast<CALAudioSourceClipImpl*>(clip_id);
+        if (const auto clip = WrapALAudioEngine.acquire_clip(clip_id)) {
             assert(clip->Check_debug());
             clip->Terminate();
+            clip->Release();
         }
     }
 }
@@ -771,13 +2873,15 @@ bool WrapAL::CALAudioEngine::ac_recreate(ALHandle clip_id, XALAudioStream* m_pSt
     assert(clip_id != ALInvalidHandle && m_pStream);
     if (m_pStream) {
         WrapAL::StopClipAnyway(clip_id);
-        auto clip = reinterpret_cast<CALAudioSourceClipImpl*>(clip_id);
+        auto clip = this->acquire_clip(clip_id);
+        if (!clip) return false;
         // 检查新旧格式是否一致
         WAVEFORMATEX format; m_pStream->GetFormat().MakeWave(format);
         // 不一致?
         if (std::memcmp(&format, &clip->wave, sizeof(format))) {
             clip->wave = format;
         }
+        clip->Release();
     }
     assert(!"noimpl");
     return false;
@@ -814,28 +2918,521 @@ auto WrapAL::CALAudioEngine::Volume(float volume) noexcept -> float {
     if (volume < 0.f) {
         voice->GetVolume(&volume);
     }
-    // Set
-    else {
+    // Set, 批处理中则延迟到提交
+    else if (!m_pImpl->BatchCommand(WrapAL::group_volume(nullptr, volume))) {
         voice->SetVolume(volume);
     }
     return volume;
 }
 
+/// <summary>
+/// Gets the sample time of engine clock, frames of master mix at start of current pass.
+/// 引擎时钟
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::GetSampleTime() const noexcept -> uint64_t {
+    return m_pImpl->m_uClock.load();
+}
+
+/// <summary>
+/// Gets the engine clock in sec., virtual clips advance by it.
+/// 引擎时钟(秒)
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::clock_sec() const noexcept -> double {
+    return m_pImpl->ClockSec();
+}
+
+/// <summary>
+/// Gets the performance data, counters cumulative since Initialize.
+/// 性能数据: 只读取原子计数, 不加锁
+/// </summary>
+/// <param name="data">The data.</param>
+/// <returns></returns>
+void WrapAL::CALAudioEngine::GetPerformanceData(AudioPerformanceData& data) noexcept {
+    CALPerfCounters::Get(data);
+    data.active_voices = m_pImpl->m_cRealVoice.load(std::memory_order_relaxed);
+    data.virtual_voices = m_pImpl->m_cVirtualVoice.load(std::memory_order_relaxed);
+    data.glitches = m_pImpl->m_uGlitches.load(std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Begins the batch in this thread, nestable.
+/// 开始本线程的批处理, 可嵌套
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALAudioEngine::BeginBatch() noexcept {
+    ++WrapAL::t_batch.depth;
+}
+
+/// <summary>
+/// Commits the batch in this thread, changes run in the same processing pass.
+/// 提交本线程的批处理, 所有改变在同一处理周期生效
+/// </summary>
+/// <returns>false if not in batch, or commands ran out of batch for OOM</returns>
+bool WrapAL::CALAudioEngine::CommitBatch() noexcept {
+    auto& state = WrapAL::t_batch;
+    assert(state.depth && "CommitBatch without BeginBatch");
+    if (!state.depth) return false;
+    // 嵌套: 最外层提交
+    if (--state.depth) return !state.failed;
+    if (const auto batch = state.batch) {
+        state.batch = nullptr;
+        m_pImpl->CommitBatch(*batch);
+    }
+    // 批不完整
+    const auto failed = state.failed;
+    state.failed = false;
+    return !failed;
+}
+
+// 预先创建源音
+auto WrapAL::CALAudioEngine::PrewarmVoices(const AudioFormat& format,
+    uint32_t count, AudioClipFlag flags) noexcept -> ECode {
+    WAVEFORMATEX wave; format.MakeWave(wave);
+    const auto voice_flags = CALAudioSourceClipImpl::VoiceFlags(flags);
+    const auto hr = m_pImpl->m_voices.Prewarm(wave, voice_flags, count);
+    if (FAILED(hr)) this->OutputErrorHR(__FUNCTION__, hr);
+    return hr;
+}
+
+// 设置 3D 听者
+void WrapAL::CALAudioEngine::SetListener(const AudioListener3D& listener) noexcept {
+    this->SetListeners(&listener, nullptr, 1);
+}
+
+/// <summary>
+/// Sets listeners of 3D audio, each panned to own output group.
+/// 设置多个听者: 每个听者声像到各自的输出组别(如分屏), 不使用双耳/环绕声/聚类
+/// </summary>
+/// <param name="listeners">The listeners.</param>
+/// <param name="outputs">The output groups of listeners, null for single listener.</param>
+/// <param name="count">The count, up to Listener3DMaxCount, 1 if null outputs.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::SetListeners(const AudioListener3D listeners[],
+    const CALAudioSourceGroup outputs[], uint32_t count) noexcept -> ECode {
+    const auto impl = m_pImpl;
+    if (!listeners || !count || count > Listener3DMaxCount || (!outputs && count != 1)) return E_INVALIDARG;
+    AudioSourceGroupImpl* groups[Listener3DMaxCount] = { nullptr };
+    if (outputs) {
+        // OpenAL 没有输出矩阵
+        if (m_lvAPI == APILevel::Level_OpenAL) return E_NOTIMPL;
+        for (uint32_t i = 0; i != count; ++i) {
+            const auto group = reinterpret_cast<AudioSourceGroupImpl*>(outputs[i].m_handle);
+            if (!group || !group->voice || group->channels > Spatial3DMaxChannels) return E_INVALIDARG;
+            // 同一组别只能发送一次
+            if (std::find(groups, groups + i, group) != groups + i) return E_INVALIDARG;
+            groups[i] = group;
+        }
+    }
+    const auto outputs_count = outputs ? count : 0;
+    impl->m_spatial.lock();
+    impl->m_3d.SetListeners(listeners, count);
+    // 输出改变时重新设置输出链, 每帧移动听者不会
+    if (outputs_count != impl->m_cListener || !std::equal(groups, groups + outputs_count, impl->m_apListener)) {
+        impl->m_voicing.lock();
+        std::memcpy(impl->m_apListener, groups, sizeof(groups));
+        impl->m_cListener = outputs_count;
+        ++impl->m_uListenerGen;
+        impl->m_clips.ForEach([impl](CALAudioSourceClipImpl& clip) noexcept {
+            const auto state = clip.GetSpatial();
+            if (!state || !state->listener_gen) return;
+            state->listener_gen = 0;
+            if (!clip.HasSource()) return;
+            impl->RouteClip(clip);
+            impl->Apply3D(clip);
+        });
+        impl->m_voicing.unlock();
+    }
+    impl->m_spatial.unlock();
+    return S_OK;
+}
+
+// 设置 3D 参数
+auto WrapAL::CALAudioEngine::Set3DSettings(const Audio3DSettings& settings) noexcept -> ECode {
+    m_pImpl->m_spatial.lock();
+    const auto ok = m_pImpl->m_3d.SetSettings(settings);
+    // 布局也在 Apply3D 中读取
+    if (ok) {
+        m_pImpl->m_voicing.lock();
+        m_pImpl->InitLayouts();
+        m_pImpl->m_voicing.unlock();
+    }
+    if (ok) m_pImpl->RouteClusters();
+    m_pImpl->m_spatial.unlock();
+    return ok ? S_OK : E_INVALIDARG;
+}
+
+// 设置 3D 混响组别
+void WrapAL::CALAudioEngine::Set3DReverbGroup(const CALAudioSourceGroup& group) noexcept {
+    const auto group_impl = reinterpret_cast<AudioSourceGroupImpl*>(group.m_handle);
+    m_pImpl->m_spatial.lock();
+    m_pImpl->m_pReverb3D = group_impl;
+    m_pImpl->RouteClusters();
+    m_pImpl->m_spatial.unlock();
+}
+
+/// <summary>
+/// Calculates emitters in SoA and applies to Flag_3D clips of them.
+/// 计算 3D 发声体并应用到片段
+/// </summary>
+/// <param name="emitters">The emitters.</param>
+/// <returns>count of clips applied</returns>
+auto WrapAL::CALAudioEngine::Update3D(const AudioEmitters3D& emitters) noexcept -> uint32_t {
+    m_pImpl->m_spatial.lock();
+    const auto count = m_pImpl->Update3D(emitters);
+    m_pImpl->m_spatial.unlock();
+    return count;
+}
+
+/// <summary>
+/// Sets HRTF set from file for binaural rendering of 3D clips.
+/// </summary>
+/// <param name="file_name">The file name of HRTF set, null for speaker panning.</param>
+/// <param name="sources">The max count of binaural clips, 0 for speaker panning.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::SetHRTF(const wchar_t* file_name, uint32_t sources) noexcept -> ECode {
+    if (!file_name || !sources) return this->SetHRTF(static_cast<IALStream*>(nullptr), 0);
+    const auto stream = this->CreatStreamFromFile(file_name);
+    if (!stream) {
+        this->OutputErrorOOM(__FUNCTION__);
+        return E_OUTOFMEMORY;
+    }
+    // 错误(已报错)
+    if (!stream->OK()) {
+        stream->Release();
+        return E_FAIL;
+    }
+    const auto hr = this->SetHRTF(stream, sources);
+    stream->Release();
+    return hr;
+}
+
+/// <summary>
+/// Sets HRTF set for binaural rendering of 3D clips, speaker panning if null.
+/// 设置HRTF: 创建双耳总线, 替换旧的, 占用声道的片段回到扬声器声像
+/// </summary>
+/// <param name="stream">The stream of HRTF set, not released, null for speaker panning.</param>
+/// <param name="sources">The max count of binaural clips, 0 for speaker panning.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::SetHRTF(IALStream* stream, uint32_t sources) noexcept -> ECode {
+    const auto impl = m_pImpl;
+    if (!impl->m_pMasterVoice) return XAUDIO2_E_INVALID_CALL;
+    HRESULT hr = S_OK;
+    hrtf::CALHRTF* set = nullptr;
+    BinauralBus buses[BinauralMaxSources / BinauralBusChannels];
+    uint32_t count = 0;
+    if (stream && sources) {
+        // OpenAL 没有效果链
+        if (m_lvAPI == APILevel::Level_OpenAL) return E_NOTIMPL;
+        XAUDIO2_VOICE_DETAILS details = { 0 };
+        impl->m_pMasterVoice->GetVoiceDetails(&details);
+        set = hrtf::CALHRTF::Load(*stream, details.InputSampleRate, hr);
+        const auto need = (std::min(sources, uint32_t(BinauralMaxSources)) + BinauralBusChannels - 1) / BinauralBusChannels;
+        for (; set && count != need; ++count) {
+            hr = impl->CreateBinauralBus(*set, buses[count]);
+            if (FAILED(hr)) break;
+        }
+    }
+    // 环绕声总线随之解码到新的双耳或扬声器
+    AmbisonicBus ambisonic;
+    impl->m_spatial.lock();
+    if (SUCCEEDED(hr) && impl->m_ambisonic.order)
+        hr = impl->CreateAmbisonic(impl->m_ambisonic.order, set, ambisonic);
+    if (FAILED(hr)) {
+        impl->m_spatial.unlock();
+        impl->ClearBuses(buses, count);
+        WrapAL::SafeRelease(set);
+        this->OutputErrorHR(__FUNCTION__, hr);
+        return hr;
+    }
+    // 替换, 旧总线上的片段先改变输出
+    impl->m_voicing.lock();
+    const auto old = impl->m_cBus;
+    std::swap_ranges(buses, buses + std::max(count, old), impl->m_aBus);
+    impl->m_cBus = count;
+    ++impl->m_uBusGen;
+    std::swap(impl->m_pHRTF, set);
+    impl->m_clips.ForEach([impl](CALAudioSourceClipImpl& clip) noexcept {
+        const auto state = clip.GetSpatial();
+        if (!state || !state->slot) return;
+        state->slot = 0;
+        if (!clip.HasSource()) return;
+        impl->RouteClip(clip);
+        impl->Apply3D(clip);
+    });
+    if (ambisonic.voice) impl->SwapAmbisonic(ambisonic);
+    impl->m_voicing.unlock();
+    impl->m_spatial.unlock();
+    impl->ClearAmbisonic(ambisonic);
+    impl->ClearBuses(buses, old);
+    WrapAL::SafeRelease(set);
+    return S_OK;
+}
+
+/// <summary>
+/// Sets ambisonic bus for 3D clips, panning of each clip if order is 0.
+/// 设置环绕声总线: 3D 片段编码到总线, 总线一次解码到扬声器(有HRTF则双耳)
+/// </summary>
+/// <param name="order">The order, 1 to AmbisonicMaxOrder, 0 for none.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::SetAmbisonic(uint32_t order) noexcept -> ECode {
+    const auto impl = m_pImpl;
+    if (!impl->m_pMasterVoice) return XAUDIO2_E_INVALID_CALL;
+    if (order > AmbisonicMaxOrder) return E_INVALIDARG;
+    // OpenAL 没有输出矩阵
+    if (order && m_lvAPI == APILevel::Level_OpenAL) return E_NOTIMPL;
+    HRESULT hr = S_OK;
+    AmbisonicBus bus;
+    impl->m_spatial.lock();
+    if (order) hr = impl->CreateAmbisonic(order, impl->m_pHRTF, bus);
+    if (SUCCEEDED(hr)) {
+        impl->m_voicing.lock();
+        impl->SwapAmbisonic(bus);
+        impl->m_voicing.unlock();
+    }
+    impl->m_spatial.unlock();
+    impl->ClearAmbisonic(bus);
+    if (FAILED(hr)) this->OutputErrorHR(__FUNCTION__, hr);
+    return hr;
+}
+
+/// <summary>
+/// Sets clusters of distant 3D clips: premixed by direction, only clusters spatialised.
+/// 设置聚类: 远处的 3D 片段按方向预混合, 只对聚类计算声像
+/// </summary>
+/// <param name="count">The count of clusters, up to Cluster3DMaxCount, 0 for none.</param>
+/// <param name="distance">The distance, clips at it or farther are clustered.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::Set3DClusters(uint32_t count, float distance) noexcept -> ECode {
+    const auto impl = m_pImpl;
+    if (!impl->m_pMasterVoice) return XAUDIO2_E_INVALID_CALL;
+    if (count > Cluster3DMaxCount || !(distance >= 0.f)) return E_INVALIDARG;
+    // OpenAL 没有输出矩阵
+    if (count && m_lvAPI == APILevel::Level_OpenAL) return E_NOTIMPL;
+    XAUDIO2_VOICE_DETAILS details = { 0 };
+    impl->m_pMasterVoice->GetVoiceDetails(&details);
+    EmitterCluster clusters[Cluster3DMaxCount];
+    HRESULT hr = S_OK;
+    uint32_t created = 0;
+    // 只从源音输入, 最先处理
+    for (; created != count; ++created) {
+        auto& cluster = clusters[created];
+        std::memset(&cluster, 0, sizeof(cluster));
+        hr = impl->m_pXAudio2Engine->CreateSubmixVoice(
+            &cluster.voice,
+            1,
+            details.InputSampleRate,
+            XAUDIO2_VOICE_USEFILTER, 0,
+            nullptr,
+            nullptr
+            );
+        if (FAILED(hr)) break;
+    }
+    if (FAILED(hr)) {
+        impl->ClearClusters(clusters, created);
+        this->OutputErrorHR(__FUNCTION__, hr);
+        return hr;
+    }
+    // 替换, 旧聚类上的片段在下次 Update3D 重新聚类
+    impl->m_spatial.lock();
+    impl->m_voicing.lock();
+    const auto old = impl->m_cCluster;
+    std::swap_ranges(clusters, clusters + std::max(count, old), impl->m_aCluster);
+    impl->m_cCluster = count;
+    impl->m_fClusterDistance = distance;
+    ++impl->m_uClusterGen;
+    impl->RouteClusters();
+    impl->m_clips.ForEach([impl](CALAudioSourceClipImpl& clip) noexcept {
+        const auto state = clip.GetSpatial();
+        if (!state || !state->cluster) return;
+        state->cluster = 0;
+        if (!clip.HasSource()) return;
+        impl->RouteClip(clip);
+        impl->Apply3D(clip);
+    });
+    impl->m_voicing.unlock();
+    impl->m_spatial.unlock();
+    impl->ClearClusters(clusters, old);
+    return S_OK;
+}
+
+// 获取主音输出格式
+auto WrapAL::CALAudioEngine::GetOutputFormat() noexcept -> AudioFormat {
+    XAUDIO2_VOICE_DETAILS details = { 0 };
+    assert(m_pImpl->m_pMasterVoice);
+    m_pImpl->m_pMasterVoice->GetVoiceDetails(&details);
+    AudioFormat format;
+    format.nSamplesPerSec = details.InputSampleRate;
+    format.nChannels = uint8_t(details.InputChannels);
+    format.nBlockAlign = uint16_t(details.InputChannels * sizeof(float));
+    format.nFormatTag = Wave_IEEEFloat;
+    return format;
+}
+
+/// <summary>
+/// Renders the master mix in offline mode.
+/// 离线渲染
+/// </summary>
+/// <param name="data">The interleaved output, frames * channels.</param>
+/// <param name="frames">The frames.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::RenderOffline(float* data, uint32_t frames) noexcept -> ECode {
+    assert(data && "bad argument");
+#ifndef WRAPAL_XAUDIO2_7_SUPPORT
+    if (m_lvAPI == APILevel::Level_Offline) {
+        const auto engine = static_cast<mixer::CALMixerEngine*>(m_pImpl->m_pXAudio2Engine);
+        return engine->Pull(data, frames);
+    }
+#endif
+    assert(!"Level_Offline only");
+    return E_NOTIMPL;
+}
+
+/// <summary>
+/// Renders the master mix to file in offline mode.
+/// 离线渲染到文件
+/// </summary>
+/// <param name="file_name">Name of the file.</param>
+/// <param name="frames">The frames.</param>
+/// <param name="wav">WAV file(IEEE float) if true, raw float if false.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::RenderOffline(const wchar_t* file_name, uint32_t frames, bool wav) noexcept -> ECode {
+    assert(file_name && "bad argument");
+    if (m_lvAPI != APILevel::Level_Offline) return E_NOTIMPL;
+    const auto format = this->GetOutputFormat();
+    const uint64_t bytes = uint64_t(frames) * format.nBlockAlign;
+    // WAV 文件不能超过 4GB
+    if (wav && bytes > uint64_t(0xFFFFFFFFu - 58)) return E_INVALIDARG;
+    const auto file = ::CreateFileW(
+        file_name, GENERIC_WRITE, 0, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr
+        );
+    if (file == INVALID_HANDLE_VALUE) {
+        this->OutputErrorFoF(__FUNCTION__, file_name);
+        return E_FAIL;
+    }
+    HRESULT hr = S_OK;
+    DWORD written = 0;
+    // 写入文件头
+    if (wav) {
+        uint8_t header[58]; auto ptr = header;
+        const auto write32 = [&ptr](uint32_t v) noexcept { std::memcpy(ptr, &v, 4); ptr += 4; };
+        const auto write16 = [&ptr](uint16_t v) noexcept { std::memcpy(ptr, &v, 2); ptr += 2; };
+        std::memcpy(ptr, "RIFF", 4); ptr += 4; write32(uint32_t(50 + bytes));
+        std::memcpy(ptr, "WAVEfmt ", 8); ptr += 8; write32(18);
+        write16(Wave_IEEEFloat); write16(format.nChannels);
+        write32(format.nSamplesPerSec); write32(format.nSamplesPerSec * format.nBlockAlign);
+        write16(format.nBlockAlign); write16(32); write16(0);
+        std::memcpy(ptr, "fact", 4); ptr += 4; write32(4); write32(frames);
+        std::memcpy(ptr, "data", 4); ptr += 4; write32(uint32_t(bytes));
+        if (!::WriteFile(file, header, sizeof(header), &written, nullptr)) hr = E_FAIL;
+    }
+    // 分段渲染
+    constexpr uint32_t chunk = 4096;
+    const auto buffer = reinterpret_cast<float*>(std::malloc(chunk * format.nBlockAlign));
+    if (SUCCEEDED(hr) && !buffer) hr = E_OUTOFMEMORY;
+    while (SUCCEEDED(hr) && frames) {
+        const auto count = frames < chunk ? frames : chunk;
+        hr = this->RenderOffline(buffer, count);
+        if (SUCCEEDED(hr) && !::WriteFile(file, buffer, count * format.nBlockAlign, &written, nullptr)) hr = E_FAIL;
+        frames -= count;
+    }
+    std::free(buffer);
+    ::CloseHandle(file);
+    if (FAILED(hr)) this->OutputErrorHR(__FUNCTION__, hr);
+    return hr;
+}
+
 // find group by group name
 auto WrapAL::CALAudioEngine::GetGroup(const char* name) noexcept ->CALAudioSourceGroup {
     return CALAudioSourceGroup(reinterpret_cast<ALHandle>(this->find_group(name)));
 }
 
+// 创建顶层组别
+auto WrapAL::CALAudioEngine::CreateGroup(const char* name) noexcept ->CALAudioSourceGroup {
+    return CALAudioSourceGroup(reinterpret_cast<ALHandle>(this->create_group(name, nullptr)));
+}
+
+// 创建子组别
+auto WrapAL::CALAudioEngine::CreateGroup(const char* name, const CALAudioSourceGroup& parent) noexcept ->CALAudioSourceGroup {
+    const auto parent_impl = reinterpret_cast<AudioSourceGroupImpl*>(parent.m_handle);
+    return CALAudioSourceGroup(reinterpret_cast<ALHandle>(this->create_group(name, parent_impl)));
+}
+
+// 创建指定声道数与采样率的子组别
+auto WrapAL::CALAudioEngine::CreateGroup(const char* name, const CALAudioSourceGroup& parent,
+    uint32_t channels, uint32_t rate) noexcept ->CALAudioSourceGroup {
+    const auto parent_impl = reinterpret_cast<AudioSourceGroupImpl*>(parent.m_handle);
+    return CALAudioSourceGroup(reinterpret_cast<ALHandle>(this->create_group(name, parent_impl, channels, rate)));
+}
+
 // 获取组名称
 auto WrapAL::CALAudioEngine::ag_name(ALHandle id) const noexcept -> const char* {
     // 句柄有效?
     if (id != ALInvalidHandle) {
-        return reinterpret_cast<AudioSourceGroupImpl*>(id)->name;
+        return reinterpret_cast<AudioSourceGroupImpl*>(id)->Name();
     }
     // TOP-LEVEL!
     return "TOPLEVEL";
 }
 
+// 暂停组别中播放的片段
+void WrapAL::CALAudioEngine::ag_pause_all(ALHandle group_id) noexcept {
+    m_pImpl->PushGroupCommand(reinterpret_cast<AudioSourceGroupImpl*>(group_id), Command_GroupPause);
+}
+
+// 恢复组别中被暂停的片段
+void WrapAL::CALAudioEngine::ag_resume_all(ALHandle group_id) noexcept {
+    m_pImpl->PushGroupCommand(reinterpret_cast<AudioSourceGroupImpl*>(group_id), Command_GroupResume);
+}
+
+// 停止组别中的片段
+void WrapAL::CALAudioEngine::ag_stop_all(ALHandle group_id) noexcept {
+    m_pImpl->PushGroupCommand(reinterpret_cast<AudioSourceGroupImpl*>(group_id), Command_GroupStop);
+}
+
+/// <summary>
+/// Calls the callback with handle of each clip in group and children, in caller thread.
+/// 遍历组别中的片段: 先复制句柄, 回调中可以控制片段
+/// </summary>
+/// <param name="group_id">The group identifier.</param>
+/// <param name="call">The callback.</param>
+/// <param name="data">The data for callback.</param>
+/// <returns>count of clips</returns>
+auto WrapAL::CALAudioEngine::ag_foreach(ALHandle group_id, void(*call)(ALHandle, void*), void* data) noexcept -> uint32_t {
+    struct list_t { ALHandle* data; uint32_t count, capacity; } list = { nullptr, 0, 0 };
+    // 递归复制句柄
+    struct collect_t {
+        static void collect(list_t& list, AudioSourceGroupImpl& group) noexcept {
+            for (auto clip = group.members; clip; clip = clip->group_next) {
+                if (list.count == list.capacity) {
+                    const auto cap = list.capacity ? list.capacity * 2 : 64;
+                    const auto ptr = std::realloc(list.data, sizeof(ALHandle) * cap);
+                    if (!ptr) return;
+                    list.data = reinterpret_cast<ALHandle*>(ptr);
+                    list.capacity = cap;
+                }
+                if (clip->handle) list.data[list.count++] = clip->handle;
+            }
+            for (auto child = group.child; child; child = child->sibling) collect(list, *child);
+        }
+    };
+    m_pImpl->m_voicing.lock();
+    collect_t::collect(list, m_pImpl->GroupNode(reinterpret_cast<AudioSourceGroupImpl*>(group_id)));
+    m_pImpl->m_voicing.unlock();
+    // 过期句柄由调用处检查
+    for (uint32_t i = 0; i != list.count; ++i) call(list.data[i], data);
+    std::free(list.data);
+    return list.count;
+}
+
+// 获取上级组别
+auto WrapAL::CALAudioEngine::ag_parent(ALHandle id) const noexcept -> ALHandle {
+    if (id == ALInvalidHandle) return ALInvalidHandle;
+    return reinterpret_cast<ALHandle>(reinterpret_cast<AudioSourceGroupImpl*>(id)->parent);
+}
+
 // 设置或获取组别音量
 auto WrapAL::CALAudioEngine::ag_volume(ALHandle group_id, float volume) noexcept -> float {
     IXAudio2Voice* voice = nullptr;
@@ -853,91 +3450,339 @@ auto WrapAL::CALAudioEngine::ag_volume(ALHandle group_id, float volume) noexcept
         if (volume < 0.f) {
             voice->GetVolume(&volume);
         }
-        // Set
-        else {
+        // Set, 批处理中则延迟到提交
+        else if (!m_pImpl->BatchCommand(WrapAL::group_volume(
+            reinterpret_cast<AudioSourceGroupImpl*>(group_id), volume))) {
             voice->SetVolume(volume);
         }
     }
     return volume;
 }
 
+// 设置或获取组别真实声音预算
+auto WrapAL::CALAudioEngine::ag_budget(ALHandle group_id, int32_t budget) noexcept -> int32_t {
+    auto& count = group_id != ALInvalidHandle ?
+        reinterpret_cast<AudioSourceGroupImpl*>(group_id)->budget : m_pImpl->m_cVoiceBudget;
+    m_pImpl->m_voicing.lock();
+    if (budget < 0) budget = int32_t(count);
+    else count = uint32_t(budget);
+    m_pImpl->m_voicing.unlock();
+    return budget;
+}
+
+/// <summary>
+/// Sets chain of built-in effects of group, master's if top-level.
+/// 设置组别效果链: 创建XAPO, 替换子混音(主音)的效果链
+/// </summary>
+/// <param name="group_id">The group identifier.</param>
+/// <param name="list">The list of effect type.</param>
+/// <param name="count">The count, 0 to remove chain.</param>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::ag_effect_chain(ALHandle group_id, const EffectType list[], uint32_t count) noexcept -> ECode {
+    if (count > EffectChainMaxLength || (count && !list)) return E_INVALIDARG;
+    for (uint32_t i = 0; i != count; ++i) if (!effect::ParametersSize(list[i])) return E_INVALIDARG;
+    const auto group = reinterpret_cast<AudioSourceGroupImpl*>(group_id);
+    auto& node = m_pImpl->GroupNode(group);
+    IXAudio2Voice* voice = m_pImpl->m_pMasterVoice;
+    if (group) voice = group->voice;
+    if (!voice) return XAUDIO2_E_INVALID_CALL;
+    XAUDIO2_VOICE_DETAILS details = { 0 };
+    voice->GetVoiceDetails(&details);
+    // 创建效果
+    effect::CALAudioEffect* effects[EffectChainMaxLength];
+    XAUDIO2_EFFECT_DESCRIPTOR descriptors[EffectChainMaxLength];
+    HRESULT hr = S_OK;
+    uint32_t created = 0;
+    for (; created != count; ++created) {
+        const auto effect = effect::CALAudioEffect::Create(list[created]);
+        if (!effect) { hr = E_OUTOFMEMORY; break; }
+        effects[created] = effect;
+        descriptors[created] = { static_cast<xapo::IXAPO*>(effect), TRUE, details.InputChannels };
+    }
+    // 替换, 旧效果由XAudio2持有到不再使用
+    if (SUCCEEDED(hr)) {
+        XAUDIO2_EFFECT_CHAIN chain = { count, descriptors };
+        std::lock_guard<std::mutex> locker(m_pImpl->m_grouping);
+        hr = voice->SetEffectChain(count ? &chain : nullptr);
+        if (SUCCEEDED(hr)) {
+            node.ReleaseEffects();
+            std::memcpy(node.effects, effects, sizeof(effects[0]) * count);
+            node.effect_count = count;
+            created = 0;
+        }
+    }
+    for (uint32_t i = 0; i != created; ++i) effects[i]->Release();
+    if (FAILED(hr)) this->OutputErrorHR(__FUNCTION__, hr);
+    return hr;
+}
+
+/// <summary>
+/// Publishes parameters of effect in chain.
+/// 设置效果参数: 三缓冲发布, 音频线程不等待
+/// </summary>
+/// <param name="group_id">The group identifier.</param>
+/// <param name="index">The index in chain.</param>
+/// <param name="type">The type of parameters.</param>
+/// <param name="param">The parameters.</param>
+/// <returns>false if no effect at index or type differs</returns>
+bool WrapAL::CALAudioEngine::ag_effect_set(ALHandle group_id, uint32_t index, EffectType type, const void* param) noexcept {
+    auto& node = m_pImpl->GroupNode(reinterpret_cast<AudioSourceGroupImpl*>(group_id));
+    std::lock_guard<std::mutex> locker(m_pImpl->m_grouping);
+    if (index >= node.effect_count || !param) return false;
+    const auto effect = node.effects[index];
+    if (effect->GetType() != type) return false;
+    effect->SetParameters(param, effect::ParametersSize(type));
+    return true;
+}
+
+/// <summary>
+/// Enables or bypasses effect in chain.
+/// </summary>
+/// <param name="group_id">The group identifier.</param>
+/// <param name="index">The index in chain.</param>
+/// <param name="enable">if set to <c>true</c> [enable].</param>
+/// <returns>false if no effect at index</returns>
+bool WrapAL::CALAudioEngine::ag_effect_enable(ALHandle group_id, uint32_t index, bool enable) noexcept {
+    auto& node = m_pImpl->GroupNode(reinterpret_cast<AudioSourceGroupImpl*>(group_id));
+    std::lock_guard<std::mutex> locker(m_pImpl->m_grouping);
+    if (index >= node.effect_count) return false;
+    node.effects[index]->Enable(enable);
+    return true;
+}
+
 // 获取组指针
 auto WrapAL::CALAudioEngine::find_group(const char* name) noexcept ->AudioSourceGroupImpl* {
-    // 循环
-    for (size_t i = 0u; i < m_pImpl->m_cGroupCount; ++i) {
-        if (!::strncmp(m_pImpl->m_aGroup[i].name, name, GroupNameMaxLength)) {
-            return m_pImpl->m_aGroup + i;
-        }
+    if (!name || !*name) return nullptr;
+    size_t length = 0;
+    const auto hash = WrapAL::hash_group_name(name, length);
+    std::lock_guard<std::mutex> locker(m_pImpl->m_grouping);
+    return m_pImpl->FindGroup(name, length, hash);
+}
+
+// 片段使用的组别: 任意层级的同名组别, 没有则创建顶层组别
+auto WrapAL::CALAudioEngine::clip_group(const char* name) noexcept ->CALAudioSourceGroup {
+    auto group = this->find_group(name);
+    if (!group) group = this->create_group(name, nullptr);
+    return CALAudioSourceGroup(reinterpret_cast<ALHandle>(group));
+}
+
+/// <summary>
+/// Creates the group, submix output to parent's.
+/// 创建组别
+/// </summary>
+/// <param name="name">The name, interned.</param>
+/// <param name="parent">The parent, null for master.</param>
+/// <param name="channels">The channels, 0 for parent's.</param>
+/// <param name="rate">The sample rate, 0 for parent's.</param>
+/// <returns>null for failed, empty name, or name used with other parent or format</returns>
+auto WrapAL::CALAudioEngine::create_group(const char* name, AudioSourceGroupImpl* parent,
+    uint32_t channels, uint32_t rate) noexcept ->AudioSourceGroupImpl* {
+    if (!name || !*name) return nullptr;
+    size_t length = 0;
+    const auto hash = WrapAL::hash_group_name(name, length);
+    XAUDIO2_VOICE_DETAILS details = { 0 };
+    m_pImpl->m_pMasterVoice->GetVoiceDetails(&details);
+    // 采样率取整到处理周期(XAudio2要求)
+    constexpr uint32_t unit = XAUDIO2_QUANTUM_DENOMINATOR;
+    if (rate) rate = std::min((rate + unit - 1) / unit * unit, uint32_t(details.InputSampleRate));
+    std::lock_guard<std::mutex> locker(m_pImpl->m_grouping);
+    // 名称已使用: 上级与指定的格式需一致
+    if (const auto group = m_pImpl->FindGroup(name, length, hash)) {
+        if (group->parent == parent && (!channels || channels == group->channels)
+            && (!rate || rate == group->rate)) return group;
+        this->OutputErrorGroup(__FUNCTION__, Message_GroupConflict, name);
+        return nullptr;
+    }
+    // 太深了?
+    if (parent && parent->stage <= 1) {
+        this->OutputErrorGroup(__FUNCTION__, Message_GroupTooDeep, name);
+        return nullptr;
+    }
+    const auto group = AudioSourceGroupImpl::Create(name, length, hash);
+    if (!group) {
+        this->OutputErrorOOM(__FUNCTION__);
+        return nullptr;
+    }
+    group->parent = parent;
+    // 子混音只能输出到更后的阶段
+    group->stage = parent ? parent->stage - 1 : uint32_t(GroupMaxDepth);
+    // 默认同上级
+    if (!channels) channels = parent ? parent->channels : details.InputChannels;
+    if (!rate) rate = parent ? parent->rate : details.InputSampleRate;
+    group->channels = channels;
+    group->rate = rate;
+    XAUDIO2_SEND_DESCRIPTOR descriptors[] = {
+        { 0, parent ? parent->voice : nullptr }
+    };
+    XAUDIO2_VOICE_SENDS sends = {
+        sizeof(descriptors) / sizeof(*descriptors),
+        descriptors
+    };
+    // 创建submix
+    auto hr = m_pImpl->m_pXAudio2Engine->CreateSubmixVoice(
+        &group->voice,
+        channels,
+        rate,
+        0, group->stage,
+        parent ? &sends : nullptr,
+        nullptr
+        );
+    assert(SUCCEEDED(hr));
+    if (SUCCEEDED(hr) && !m_pImpl->InsertGroup(*group)) hr = E_OUTOFMEMORY;
+    // 失败
+    if (FAILED(hr)) {
+        this->OutputErrorHR(__FUNCTION__, hr);
+        group->Destroy();
+        return nullptr;
     }
-    return nullptr;
+    // 加入组别树
+    auto& node = m_pImpl->GroupNode(parent);
+    m_pImpl->m_voicing.lock();
+    group->sibling = node.child;
+    node.child = group;
+    m_pImpl->m_voicing.unlock();
+    return group;
 }
 
 // 设置clip的组ID
 auto WrapAL::CALAudioEngine::set_clip_group(
-    CALAudioSourceClipImpl& clip, const char* group_name) noexcept ->ECode {
+    CALAudioSourceClipImpl& clip, AudioSourceGroupImpl* group) noexcept ->ECode {
     assert(clip.HasSource());
     // 参数无效
     if (!clip.HasSource()) return E_INVALIDARG;
-    // 参数将就
-    clip.group = nullptr;
-    if (!group_name || !*group_name) return S_FALSE;
-    // 查找clip组别
-    auto group_id = this->find_group(group_name);
-    // 没有就添加组别
-    if (!group_id) {
-        // 满了?
-        if (m_pImpl->m_cGroupCount == GroupMaxSize) return S_FALSE;
-        XAUDIO2_VOICE_DETAILS details = { 0 };
-        m_pImpl->m_pMasterVoice->GetVoiceDetails(&details);
-        // 创建submix
-        auto hr = m_pImpl->m_pXAudio2Engine->CreateSubmixVoice(
-            &m_pImpl->m_aGroup[m_pImpl->m_cGroupCount].voice,
-            details.InputChannels,
-            details.InputSampleRate,
-            0, 0,
-            nullptr,
-            nullptr
-            );
-        // 失败
-        assert(SUCCEEDED(hr));
-        if (FAILED(hr)) return S_FALSE;
-        group_id = m_pImpl->m_aGroup + m_pImpl->m_cGroupCount;
-        std::strncpy(group_id->name, group_name, GroupNameMaxLength);
-        ++m_pImpl->m_cGroupCount;
-    }
-    // 设置组别
-    clip.group = group_id;
+    // 设置组别, 加入成员列表
+    m_pImpl->m_voicing.lock();
+    m_pImpl->GroupNode(clip.group).Leave(clip);
+    clip.group = group;
+    m_pImpl->GroupNode(group).Join(clip);
     // 设置输出链
-    XAUDIO2_SEND_DESCRIPTOR descriptors[] = {
-        { 0, group_id->voice }
-    };
-    XAUDIO2_VOICE_SENDS sends = {
-        sizeof(descriptors)/sizeof(*descriptors),
-        descriptors
-    };
-    auto hr = clip.SetOutputVoices(&sends);
+    const auto hr = m_pImpl->RouteClip(clip);
+    m_pImpl->Apply3D(clip);
+    m_pImpl->m_voicing.unlock();
     assert(SUCCEEDED(hr));
     return hr;
 }
 
 // 创建源音
 auto WrapAL::CALAudioEngine::create_source_voice(
-    CALAudioSourceClipImpl& clip, const char* group_name) noexcept ->ECode {
+    CALAudioSourceClipImpl& clip, AudioSourceGroupImpl* group) noexcept ->ECode {
     HRESULT hr = S_OK;
-    // 创建源音
+    // 从声音池获取源音
     if (SUCCEEDED(hr)) {
-        hr = clip.CreateSourceVoice(m_pImpl->m_pXAudio2Engine);
+        CALPooledVoice* voice = nullptr;
+        const auto flags = CALAudioSourceClipImpl::VoiceFlags(clip.flags);
+        hr = m_pImpl->m_voices.Acquire(clip.wave, flags, clip, voice);
+        if (SUCCEEDED(hr)) clip.AttachVoice(*voice);
     }
     // 设置组别
     if (SUCCEEDED(hr)) {
-        hr = this->set_clip_group(clip, group_name);
+        hr = this->set_clip_group(clip, group);
     }
     return hr;
 }
 
-// 刷新
-void WrapAL::CALAudioEngine::Update() noexcept {
+/// <summary>
+/// Recycles the voice of clip to voice pool.
+/// 回收源音
+/// </summary>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+void WrapAL::CALAudioEngine::recycle_voice(CALPooledVoice& voice) noexcept {
+    m_pImpl->m_voices.Recycle(voice);
+}
+
+/// <summary>
+/// Retires the memory read by flushed buffers, freed after delay of voice pool.
+/// 延迟释放: 刷新的缓冲区可能仍在读取
+/// </summary>
+/// <param name="voice">The voice to recycle, null for voice recycled before.</param>
+/// <param name="data">The data.</param>
+/// <returns></returns>
+void WrapAL::CALAudioEngine::retire_memory(CALPooledVoice* voice, void* data) noexcept {
+    if (!data) return;
+    if (voice && voice->Retire(data)) return;
+    m_pImpl->m_voices.Retire(data);
+}
 
+/// <summary>
+/// Gets the decode pool.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::CALAudioEngine::decode_pool() noexcept -> CALDecodePool& {
+    return m_pImpl->m_decoder;
+}
+
+/// <summary>
+/// Clip played to the end, push it to completion queue.
+/// 音频线程: 加入结束队列
+/// </summary>
+/// <param name="clip">The clip, add-ref-ed.</param>
+/// <returns></returns>
+void WrapAL::CALAudioEngine::end_clip(CALAudioSourceClipImpl& clip) noexcept {
+    WrapAL::push_task(m_pImpl->m_pEndClip, &clip);
+}
+
+/// <summary>
+/// Finds the clip by handle and adds ref-count of it, in any thread.
+/// 句柄查找片段并增加引用, 过期句柄或用户已释放返回null
+/// </summary>
+/// <param name="id">The handle.</param>
+/// <returns>add-ref-ed clip, caller should release it</returns>
+auto WrapAL::CALAudioEngine::acquire_clip(ALHandle id) const noexcept -> CALAudioSourceClipImpl* {
+    return m_pImpl->m_clips.Acquire(id, [](CALAudioSourceClipImpl& clip) noexcept {
+        return clip.AddRefIfHandle();
+    });
+}
+
+/// <summary>
+/// Registers the clip into handle table.
+/// 登记片段句柄
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <returns>ALInvalidHandle if table full or OOM</returns>
+auto WrapAL::CALAudioEngine::register_clip(CALAudioSourceClipImpl& clip) noexcept -> ALHandle {
+    return clip.handle = m_pImpl->m_clips.Insert(clip);
+}
+
+/// <summary>
+/// Unregisters the clip, handle of it becomes stale.
+/// 注销片段句柄, 在片段析构时调用
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <returns></returns>
+void WrapAL::CALAudioEngine::unregister_clip(CALAudioSourceClipImpl& clip) noexcept {
+    // 先移出组别成员列表
+    auto& node = m_pImpl->GroupNode(clip.group);
+    m_pImpl->m_voicing.lock();
+    node.Leave(clip);
+    m_pImpl->ReleaseSlot(clip);
+    // 在声音锁中移除, 锁中查找的片段不会释放
+    m_pImpl->m_clips.Remove(clip.handle);
+    m_pImpl->m_voicing.unlock();
+    clip.handle = ALInvalidHandle;
+}
+
+/// <summary>
+/// Updates this instance: notifies ended clips, auto-destroys them,
+/// advances fades and destroys clips released in audio thread.
+/// 刷新: 自动任务
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALAudioEngine::Update() noexcept {
+    const auto impl = m_pImpl;
+    impl->m_locker.Lock();
+    impl->EndClips(*this->configure);
+    impl->UpdateFades();
+    impl->m_voicing.lock();
+    impl->UpdateVoices();
+    impl->m_voicing.unlock();
+    impl->ReapClips();
+    impl->m_voices.Collect();
+    // 后端断音计数, 在此查询使 GetPerformanceData 无锁
+    XAUDIO2_PERFORMANCE_DATA perf;
+    impl->m_pXAudio2Engine->GetPerformanceData(&perf);
+    impl->m_uGlitches.store(perf.GlitchesSinceEngineStarted, std::memory_order_relaxed);
+    impl->m_locker.Unlock();
 }
 
 
@@ -997,4 +3842,13 @@ WRAPAL_NOINLINE void WrapAL::CALAudioEngine::FormatErrorOOM(wchar_t err_buf[], c
         WrapALAudioEngine.configure->GetRuntimeMessage(Message_OOM),
         func_name
         );
+}
+
+// 组别错误
+WRAPAL_NOINLINE void WrapAL::CALAudioEngine::FormatErrorGroup(wchar_t err_buf[], const char* func_name, RuntimeMessage msg, const char* name) noexcept {
+    std::swprintf(
+        err_buf, ErrorInfoLength,
+        WrapALAudioEngine.configure->GetRuntimeMessage(msg),
+        func_name, name
+        );
 }
\ No newline at end of file
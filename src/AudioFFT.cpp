@@ -0,0 +1,360 @@
+﻿#include "AudioFFT.h"
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+// fft namespace
+namespace WrapAL { namespace fft {
+    // 4 floats in a register, lanes of transforms
+    using simd::f4;
+    // broadcast twiddle to lane type
+    template<typename T> static inline T splat(float x) noexcept;
+    // broadcast twiddle to float
+    template<> inline float splat<float>(float x) noexcept { return x; }
+    // broadcast twiddle to f4
+    template<> inline f4 splat<f4>(float x) noexcept { return f4::set(x); }
+    // radix-2 forward, dradf2
+    template<typename T>
+    static void radf2(int ido, int l1, const T* cc, T* ch, const float* wa1) noexcept {
+        int t0, t1, t2, t3, t4, t5, t6;
+        t1 = 0; t0 = (t2 = l1 * ido); t3 = ido << 1;
+        for (int k = 0; k < l1; ++k) {
+            ch[t1 << 1] = cc[t1] + cc[t2];
+            ch[(t1 << 1) + t3 - 1] = cc[t1] - cc[t2];
+            t1 += ido; t2 += ido;
+        }
+        if (ido < 2) return;
+        if (ido != 2) {
+            t1 = 0; t2 = t0;
+            for (int k = 0; k < l1; ++k) {
+                t3 = t2; t4 = (t1 << 1) + (ido << 1); t5 = t1; t6 = t1 + t1;
+                for (int i = 2; i < ido; i += 2) {
+                    t3 += 2; t4 -= 2; t5 += 2; t6 += 2;
+                    const auto wr = splat<T>(wa1[i - 2]), wi = splat<T>(wa1[i - 1]);
+                    const T tr2 = wr * cc[t3 - 1] + wi * cc[t3];
+                    const T ti2 = wr * cc[t3] - wi * cc[t3 - 1];
+                    ch[t6] = cc[t5] + ti2;
+                    ch[t4] = ti2 - cc[t5];
+                    ch[t6 - 1] = cc[t5 - 1] + tr2;
+                    ch[t4 - 1] = cc[t5 - 1] - tr2;
+                }
+                t1 += ido; t2 += ido;
+            }
+            if (ido % 2 == 1) return;
+        }
+        t3 = (t2 = (t1 = ido) - 1); t2 += t0;
+        const auto zero = splat<T>(0.f);
+        for (int k = 0; k < l1; ++k) {
+            ch[t1] = zero - cc[t2];
+            ch[t1 - 1] = cc[t3];
+            t1 += ido << 1; t2 += ido; t3 += ido;
+        }
+    }
+    // radix-4 forward, dradf4
+    template<typename T>
+    static void radf4(int ido, int l1, const T* cc, T* ch, const float* wa1, const float* wa2, const float* wa3) noexcept {
+        const float hsqt2 = .70710678118654752f;
+        int t0, t1, t2, t3, t4, t5, t6;
+        t0 = l1 * ido;
+        t1 = t0; t4 = t1 << 1; t2 = t1 + (t1 << 1); t3 = 0;
+        for (int k = 0; k < l1; ++k) {
+            const T tr1 = cc[t1] + cc[t2];
+            const T tr2 = cc[t3] + cc[t4];
+            ch[t5 = t3 << 2] = tr1 + tr2;
+            ch[(ido << 2) + t5 - 1] = tr2 - tr1;
+            ch[(t5 += (ido << 1)) - 1] = cc[t3] - cc[t4];
+            ch[t5] = cc[t2] - cc[t1];
+            t1 += ido; t2 += ido; t3 += ido; t4 += ido;
+        }
+        if (ido < 2) return;
+        if (ido != 2) {
+            t1 = 0;
+            for (int k = 0; k < l1; ++k) {
+                t2 = t1; t4 = t1 << 2; t5 = (t6 = ido << 1) + t4;
+                for (int i = 2; i < ido; i += 2) {
+                    t3 = (t2 += 2); t4 += 2; t5 -= 2;
+                    t3 += t0;
+                    const auto w1r = splat<T>(wa1[i - 2]), w1i = splat<T>(wa1[i - 1]);
+                    const T cr2 = w1r * cc[t3 - 1] + w1i * cc[t3];
+                    const T ci2 = w1r * cc[t3] - w1i * cc[t3 - 1];
+                    t3 += t0;
+                    const auto w2r = splat<T>(wa2[i - 2]), w2i = splat<T>(wa2[i - 1]);
+                    const T cr3 = w2r * cc[t3 - 1] + w2i * cc[t3];
+                    const T ci3 = w2r * cc[t3] - w2i * cc[t3 - 1];
+                    t3 += t0;
+                    const auto w3r = splat<T>(wa3[i - 2]), w3i = splat<T>(wa3[i - 1]);
+                    const T cr4 = w3r * cc[t3 - 1] + w3i * cc[t3];
+                    const T ci4 = w3r * cc[t3] - w3i * cc[t3 - 1];
+                    const T tr1 = cr2 + cr4, tr4 = cr4 - cr2;
+                    const T ti1 = ci2 + ci4, ti4 = ci2 - ci4;
+                    const T ti2 = cc[t2] + ci3, ti3 = cc[t2] - ci3;
+                    const T tr2 = cc[t2 - 1] + cr3, tr3 = cc[t2 - 1] - cr3;
+                    ch[t4 - 1] = tr1 + tr2;
+                    ch[t4] = ti1 + ti2;
+                    ch[t5 - 1] = tr3 - ti4;
+                    ch[t5] = tr4 - ti3;
+                    ch[t4 + t6 - 1] = ti4 + tr3;
+                    ch[t4 + t6] = tr4 + ti3;
+                    ch[t5 + t6 - 1] = tr2 - tr1;
+                    ch[t5 + t6] = ti1 - ti2;
+                }
+                t1 += ido;
+            }
+            if (ido & 1) return;
+        }
+        t2 = (t1 = t0 + ido - 1) + (t0 << 1);
+        t3 = ido << 2; t4 = ido; t5 = ido << 1; t6 = ido;
+        const auto nh = splat<T>(-hsqt2), h = splat<T>(hsqt2);
+        for (int k = 0; k < l1; ++k) {
+            const T ti1 = nh * (cc[t1] + cc[t2]);
+            const T tr1 = h * (cc[t1] - cc[t2]);
+            ch[t4 - 1] = tr1 + cc[t6 - 1];
+            ch[t4 + t5 - 1] = cc[t6 - 1] - tr1;
+            ch[t4] = ti1 - cc[t1 + t0];
+            ch[t4 + t5] = ti1 + cc[t1 + t0];
+            t1 += ido; t2 += ido; t4 += t3; t6 += ido;
+        }
+    }
+    // radix-2 backward, dradb2
+    template<typename T>
+    static void radb2(int ido, int l1, const T* cc, T* ch, const float* wa1) noexcept {
+        int t0, t1, t2, t3, t4, t5, t6;
+        t0 = l1 * ido;
+        t1 = 0; t2 = 0; t3 = (ido << 1) - 1;
+        for (int k = 0; k < l1; ++k) {
+            ch[t1] = cc[t2] + cc[t3 + t2];
+            ch[t1 + t0] = cc[t2] - cc[t3 + t2];
+            t2 = (t1 += ido) << 1;
+        }
+        if (ido < 2) return;
+        if (ido != 2) {
+            t1 = 0; t2 = 0;
+            for (int k = 0; k < l1; ++k) {
+                t3 = t1; t5 = (t4 = t2) + (ido << 1); t6 = t0 + t1;
+                for (int i = 2; i < ido; i += 2) {
+                    t3 += 2; t4 += 2; t5 -= 2; t6 += 2;
+                    const auto wr = splat<T>(wa1[i - 2]), wi = splat<T>(wa1[i - 1]);
+                    ch[t3 - 1] = cc[t4 - 1] + cc[t5 - 1];
+                    const T tr2 = cc[t4 - 1] - cc[t5 - 1];
+                    ch[t3] = cc[t4] - cc[t5];
+                    const T ti2 = cc[t4] + cc[t5];
+                    ch[t6 - 1] = wr * tr2 - wi * ti2;
+                    ch[t6] = wr * ti2 + wi * tr2;
+                }
+                t2 = (t1 += ido) << 1;
+            }
+            if (ido % 2 == 1) return;
+        }
+        t1 = ido - 1; t2 = ido - 1;
+        const auto zero = splat<T>(0.f);
+        for (int k = 0; k < l1; ++k) {
+            ch[t1] = cc[t2] + cc[t2];
+            ch[t1 + t0] = zero - (cc[t2 + 1] + cc[t2 + 1]);
+            t1 += ido; t2 += ido << 1;
+        }
+    }
+    // radix-4 backward, dradb4
+    template<typename T>
+    static void radb4(int ido, int l1, const T* cc, T* ch, const float* wa1, const float* wa2, const float* wa3) noexcept {
+        const float sqrt2 = 1.414213562373095f;
+        int t0, t1, t2, t3, t4, t5, t6, t7, t8;
+        t0 = l1 * ido;
+        t1 = 0; t2 = ido << 2; t3 = 0; t6 = ido << 1;
+        for (int k = 0; k < l1; ++k) {
+            t4 = t3 + t6; t5 = t1;
+            const T tr3 = cc[t4 - 1] + cc[t4 - 1];
+            const T tr4 = cc[t4] + cc[t4];
+            const T tr1 = cc[t3] - cc[(t4 += t6) - 1];
+            const T tr2 = cc[t3] + cc[t4 - 1];
+            ch[t5] = tr2 + tr3;
+            ch[t5 += t0] = tr1 - tr4;
+            ch[t5 += t0] = tr2 - tr3;
+            ch[t5 += t0] = tr1 + tr4;
+            t1 += ido; t3 += t2;
+        }
+        if (ido < 2) return;
+        if (ido != 2) {
+            t1 = 0;
+            for (int k = 0; k < l1; ++k) {
+                t5 = (t4 = (t3 = (t2 = t1 << 2) + t6)) + t6;
+                t7 = t1;
+                for (int i = 2; i < ido; i += 2) {
+                    t2 += 2; t3 += 2; t4 -= 2; t5 -= 2; t7 += 2;
+                    const T ti1 = cc[t2] + cc[t5], ti2 = cc[t2] - cc[t5];
+                    const T ti3 = cc[t3] - cc[t4], tr4 = cc[t3] + cc[t4];
+                    const T tr1 = cc[t2 - 1] - cc[t5 - 1], tr2 = cc[t2 - 1] + cc[t5 - 1];
+                    const T ti4 = cc[t3 - 1] - cc[t4 - 1], tr3 = cc[t3 - 1] + cc[t4 - 1];
+                    ch[t7 - 1] = tr2 + tr3;
+                    const T cr3 = tr2 - tr3;
+                    ch[t7] = ti2 + ti3;
+                    const T ci3 = ti2 - ti3;
+                    const T cr2 = tr1 - tr4, cr4 = tr1 + tr4;
+                    const T ci2 = ti1 + ti4, ci4 = ti1 - ti4;
+                    const auto w1r = splat<T>(wa1[i - 2]), w1i = splat<T>(wa1[i - 1]);
+                    const auto w2r = splat<T>(wa2[i - 2]), w2i = splat<T>(wa2[i - 1]);
+                    const auto w3r = splat<T>(wa3[i - 2]), w3i = splat<T>(wa3[i - 1]);
+                    ch[(t8 = t7 + t0) - 1] = w1r * cr2 - w1i * ci2;
+                    ch[t8] = w1r * ci2 + w1i * cr2;
+                    ch[(t8 += t0) - 1] = w2r * cr3 - w2i * ci3;
+                    ch[t8] = w2r * ci3 + w2i * cr3;
+                    ch[(t8 += t0) - 1] = w3r * cr4 - w3i * ci4;
+                    ch[t8] = w3r * ci4 + w3i * cr4;
+                }
+                t1 += ido;
+            }
+            if (ido % 2 == 1) return;
+        }
+        t1 = ido; t2 = ido << 2; t3 = ido - 1; t4 = ido + (ido << 1);
+        const auto s = splat<T>(sqrt2), ns = splat<T>(-sqrt2);
+        for (int k = 0; k < l1; ++k) {
+            t5 = t3;
+            const T ti1 = cc[t1] + cc[t4], ti2 = cc[t4] - cc[t1];
+            const T tr1 = cc[t1 - 1] - cc[t4 - 1], tr2 = cc[t1 - 1] + cc[t4 - 1];
+            ch[t5] = tr2 + tr2;
+            ch[t5 += t0] = s * (tr1 - ti1);
+            ch[t5 += t0] = ti2 + ti2;
+            ch[t5 += t0] = ns * (tr1 + ti1);
+            t3 += ido; t1 += t2; t4 += t2;
+        }
+    }
+    // forward, drftf1
+    template<typename T>
+    static void forward(int n, T* c, T* ch, const float* wa, const uint32_t* fac, int nf) noexcept {
+        int na = 1, l2 = n, iw = n;
+        for (int k1 = 0; k1 < nf; ++k1) {
+            const int ip = int(fac[nf - k1 - 1]);
+            const int l1 = l2 / ip;
+            const int ido = n / l2;
+            iw -= (ip - 1) * ido;
+            na = 1 - na;
+            // 结果在ch或者c
+            const auto from = na ? ch : c;
+            const auto to = na ? c : ch;
+            if (ip == 4) {
+                const int ix2 = iw + ido, ix3 = ix2 + ido;
+                radf4(ido, l1, from, to, wa + iw - 1, wa + ix2 - 1, wa + ix3 - 1);
+            }
+            else radf2(ido, l1, from, to, wa + iw - 1);
+            l2 = l1;
+        }
+        if (na == 1) return;
+        std::memcpy(c, ch, sizeof(T) * n);
+    }
+    // backward, drftb1
+    template<typename T>
+    static void backward(int n, T* c, T* ch, const float* wa, const uint32_t* fac, int nf) noexcept {
+        int na = 0, l1 = 1, iw = 1;
+        for (int k1 = 0; k1 < nf; ++k1) {
+            const int ip = int(fac[k1]);
+            const int l2 = ip * l1;
+            const int ido = n / l2;
+            // 结果在ch或者c
+            const auto from = na ? ch : c;
+            const auto to = na ? c : ch;
+            if (ip == 4) {
+                const int ix2 = iw + ido, ix3 = ix2 + ido;
+                radb4(ido, l1, from, to, wa + iw - 1, wa + ix2 - 1, wa + ix3 - 1);
+            }
+            else radb2(ido, l1, from, to, wa + iw - 1);
+            na = 1 - na;
+            l1 = l2;
+            iw += (ip - 1) * ido;
+        }
+        if (na == 0) return;
+        std::memcpy(c, ch, sizeof(T) * n);
+    }
+}}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALRealFFT"/> class.
+/// </summary>
+/// <returns></returns>
+WrapAL::fft::CALRealFFT::~CALRealFFT() noexcept {
+    std::free(m_pTwiddle);
+}
+
+/// <summary>
+/// Initializes with the specified size.
+/// 用指定大小初始化
+/// </summary>
+/// <param name="n">The size, power of 2.</param>
+/// <returns>false if invalid or OOM</returns>
+bool WrapAL::fft::CALRealFFT::Init(uint32_t n) noexcept {
+    // 2的幂
+    if (n < 4 || (n & (n - 1)) || n > (1u << 24)) return false;
+    const auto wa = static_cast<float*>(std::realloc(m_pTwiddle, sizeof(float) * n));
+    if (!wa) return false;
+    m_pTwiddle = wa; m_n = n;
+    // 分解: 奇数次幂时2在最前面, 同drfti1
+    uint32_t exp = 0; while ((1u << exp) != n) ++exp;
+    m_cFactor = 0;
+    if (exp & 1) m_aFactor[m_cFactor++] = 2;
+    for (uint32_t i = 0; i != exp / 2; ++i) m_aFactor[m_cFactor++] = 4;
+    // 旋转因子
+    const double argh = 6.28318530717958648 / double(n);
+    uint32_t is = 0, l1 = 1;
+    for (uint32_t k1 = 0; k1 + 1 < m_cFactor; ++k1) {
+        const auto ip = m_aFactor[k1];
+        const auto l2 = l1 * ip;
+        const auto ido = n / l2;
+        uint32_t ld = 0;
+        for (uint32_t j = 0; j != ip - 1; ++j) {
+            ld += l1;
+            auto i = is;
+            const auto argld = double(ld) * argh;
+            double fi = 0.0;
+            for (uint32_t ii = 2; ii < ido; ii += 2) {
+                fi += 1.0;
+                wa[i++] = float(std::cos(fi * argld));
+                wa[i++] = float(std::sin(fi * argld));
+            }
+            is += ido;
+        }
+        l1 = l2;
+    }
+    return true;
+}
+
+/// <summary>
+/// Forward transform in-place.
+/// 原地正变换
+/// </summary>
+/// <param name="data">The data.</param>
+/// <param name="scratch">The scratch buffer of size.</param>
+/// <returns></returns>
+void WrapAL::fft::CALRealFFT::Forward(float* data, float* scratch) const noexcept {
+    fft::forward(int(m_n), data, scratch, m_pTwiddle, m_aFactor, int(m_cFactor));
+}
+
+/// <summary>
+/// Backward transform in-place.
+/// 原地逆变换
+/// </summary>
+/// <param name="data">The data.</param>
+/// <param name="scratch">The scratch buffer of size.</param>
+/// <returns></returns>
+void WrapAL::fft::CALRealFFT::Backward(float* data, float* scratch) const noexcept {
+    fft::backward(int(m_n), data, scratch, m_pTwiddle, m_aFactor, int(m_cFactor));
+}
+
+/// <summary>
+/// Forward 4 transforms in lanes in-place.
+/// 原地正变换(4通道)
+/// </summary>
+/// <param name="data">The data.</param>
+/// <param name="scratch">The scratch buffer of size.</param>
+/// <returns></returns>
+void WrapAL::fft::CALRealFFT::Forward(simd::f4* data, simd::f4* scratch) const noexcept {
+    fft::forward(int(m_n), data, scratch, m_pTwiddle, m_aFactor, int(m_cFactor));
+}
+
+/// <summary>
+/// Backward 4 transforms in lanes in-place.
+/// 原地逆变换(4通道)
+/// </summary>
+/// <param name="data">The data.</param>
+/// <param name="scratch">The scratch buffer of size.</param>
+/// <returns></returns>
+void WrapAL::fft::CALRealFFT::Backward(simd::f4* data, simd::f4* scratch) const noexcept {
+    fft::backward(int(m_n), data, scratch, m_pTwiddle, m_aFactor, int(m_cFactor));
+}
@@ -0,0 +1,81 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL real FFT for convolution, radix-2/4 path of smallft.c(libvorbis) as
+template on lane type:
+    float       -> one transform
+    simd::f4    -> 4 transforms in SIMD lanes, data[i] is i-th sample of each
+
+same packing as smallft: r0, r1, i1, r2, i2, ... r(n/2), unnormalized so
+Backward(Forward(x)) = n * x.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for f4
+#include "AudioSIMD.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // FFT
+    namespace fft {
+        // real FFT of power-of-2 size
+        class CALRealFFT {
+        public:
+            // ctor
+            CALRealFFT() noexcept = default;
+            // dtor
+            ~CALRealFFT() noexcept;
+            // no copy
+            CALRealFFT(const CALRealFFT&) = delete;
+            // no copy
+            auto operator=(const CALRealFFT&) -> CALRealFFT& = delete;
+            // init with size, power of 2 not less than 4, false if invalid or OOM
+            bool Init(uint32_t n) noexcept;
+            // get size
+            auto GetSize() const noexcept { return m_n; }
+            // forward in-place, "scratch" of size
+            void Forward(float* data, float* scratch) const noexcept;
+            // backward in-place, "scratch" of size
+            void Backward(float* data, float* scratch) const noexcept;
+            // forward 4 transforms in lanes, "scratch" of size
+            void Forward(simd::f4* data, simd::f4* scratch) const noexcept;
+            // backward 4 transforms in lanes, "scratch" of size
+            void Backward(simd::f4* data, simd::f4* scratch) const noexcept;
+        private:
+            // twiddles
+            float*          m_pTwiddle = nullptr;
+            // size
+            uint32_t        m_n = 0;
+            // count of factors
+            uint32_t        m_cFactor = 0;
+            // factors, 4 or 2
+            uint32_t        m_aFactor[16];
+        };
+    }
+}
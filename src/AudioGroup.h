@@ -31,12 +31,18 @@ struct IXAudio2SubmixVoice;
 #include <cassert>
 // memory
 #include <cstring>
+// malloc
+#include <cstdlib>
+// placement new
+#include <new>
 // include the config
 #include "wrapalconf.h"
 // include the config
 #include "wrapal_common.h"
 // clip
 #include "AudioClip.h"
+// effect
+#include "AudioEffect.h"
 
 
 
@@ -44,19 +50,95 @@ struct IXAudio2SubmixVoice;
 namespace WrapAL {
     // Audio Source Group Handle
     class CALAudioSourceGroup;
-    // group of audio clip
+    // hash of group name, FNV-1a
+    static inline auto hash_group_name(const char* name, size_t& length) noexcept {
+        uint32_t hash = 2166136261u;
+        const auto begin = name;
+        for (; *name; ++name) hash = (hash ^ uint8_t(*name)) * 16777619u;
+        length = size_t(name - begin);
+        return hash;
+    }
+    // group of audio clip, name stored after it, alive until engine un-init
     struct AudioSourceGroupImpl {
-        // ctor
-        AudioSourceGroupImpl() noexcept { std::memset(name, 0, sizeof(name)); };
+        // create group with name, null if OOM
+        static auto Create(const char* name, size_t length, uint32_t hash) noexcept {
+            auto ptr = std::malloc(sizeof(AudioSourceGroupImpl) + length + 1);
+            if (!ptr) return static_cast<AudioSourceGroupImpl*>(nullptr);
+            auto group = new (ptr) AudioSourceGroupImpl;
+            group->hash = hash;
+            group->length = uint32_t(length);
+            std::memcpy(group + 1, name, length + 1);
+            return group;
+        }
+        // destroy
+        void Destroy() noexcept { this->Release(); this->~AudioSourceGroupImpl(); std::free(this); }
 #ifndef NDEBUG
         // dtor
         ~AudioSourceGroupImpl() { assert(!voice && "not be released!"); }
 #endif
         // Release
-        auto Release() noexcept { if (voice) voice->DestroyVoice(); voice = nullptr; }
+        void Release() noexcept { if (voice) voice->DestroyVoice(); voice = nullptr; this->ReleaseEffects(); }
+        // release effect chain, after voice destroyed
+        void ReleaseEffects() noexcept {
+            for (uint32_t i = 0; i != effect_count; ++i) effects[i]->Release();
+            effect_count = 0;
+        }
         // name
-        char                    name[GroupNameMaxLength + 1];
+        auto Name() const noexcept { return reinterpret_cast<const char*>(this + 1); }
+        // add clip to member list, under voice lock of engine
+        void Join(CALAudioSourceClipImpl& clip) noexcept {
+            clip.group_prev = nullptr;
+            clip.group_next = members;
+            if (members) members->group_prev = &clip;
+            members = &clip;
+        }
+        // remove clip from member list if joined, under voice lock of engine
+        void Leave(CALAudioSourceClipImpl& clip) noexcept {
+            if (!clip.group_prev && members != &clip) return;
+            if (clip.group_prev) clip.group_prev->group_next = clip.group_next;
+            else members = clip.group_next;
+            if (clip.group_next) clip.group_next->group_prev = clip.group_prev;
+            clip.group_prev = clip.group_next = nullptr;
+        }
+        // same name?
+        bool Match(const char* str, size_t len, uint32_t code) const noexcept {
+            return hash == code && length == len && !std::memcmp(this->Name(), str, len);
+        }
         // XAudio2
         IXAudio2SubmixVoice*    voice = nullptr;
+        // parent group, null for master
+        AudioSourceGroupImpl*   parent = nullptr;
+        // next group in hash bucket
+        AudioSourceGroupImpl*   bucket_next = nullptr;
+        // next group created before this, children before parents
+        AudioSourceGroupImpl*   next = nullptr;
+        // first child group, under voice lock of engine
+        AudioSourceGroupImpl*   child = nullptr;
+        // next group of the same parent, under voice lock of engine
+        AudioSourceGroupImpl*   sibling = nullptr;
+        // first clip in member list, under voice lock of engine
+        CALAudioSourceClipImpl* members = nullptr;
+        // hash of name
+        uint32_t                hash = 0;
+        // length of name
+        uint32_t                length = 0;
+        // processing stage of submix, lower than parent's
+        uint32_t                stage = 0;
+        // input channels of submix
+        uint32_t                channels = 0;
+        // input sample rate of submix
+        uint32_t                rate = 0;
+        // max count of real voices, 0 for no limit
+        uint32_t                budget = 0;
+        // count of effects, under group lock of engine
+        uint32_t                effect_count = 0;
+        // effect chain of submix, master's for root, under group lock of engine
+        effect::CALAudioEffect* effects[EffectChainMaxLength];
+        // UpdateVoices: volume x parents' volume
+        float                   mix = 1.f;
+        // UpdateVoices: count of real voices in this and children
+        uint32_t                real = 0;
+        // UpdateVoices: pass of mix/real
+        uint32_t                pass = 0;
     };
 }
\ No newline at end of file
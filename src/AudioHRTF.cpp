@@ -0,0 +1,421 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "AudioHRTF.h"
+#include "AudioInterface.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+
+// hrtf namespace
+namespace WrapAL { namespace hrtf {
+    // 4 floats in a register, lanes of slots
+    using simd::f4;
+    // pi
+    static constexpr float PI = 3.14159265358979f;
+    // steps of azimuth in nearest table, 5 deg.
+    static constexpr uint32_t AZIMUTH_STEPS = 72;
+    // steps of elevation in nearest table, 5 deg. from -90 to 90
+    static constexpr uint32_t ELEVATION_STEPS = 37;
+    // header of HRTF set file
+    struct FileHeader {
+        // "WHRF"
+        char        magic[4];
+        // version, 1
+        uint32_t    version;
+        // sample rate
+        uint32_t    rate;
+        // count of measurements
+        uint32_t    measurements;
+        // count of receivers, 2
+        uint32_t    receivers;
+        // taps of each impulse response
+        uint32_t    taps;
+    };
+    // lane of f4 array
+    static inline auto lane_at(f4* p, uint32_t i, uint32_t lane) noexcept -> float& {
+        return reinterpret_cast<float*>(p + i)[lane];
+    }
+    // y += x * h, packed spectra of smallft
+    static inline void mac(f4* y, const f4* x, const f4* h, uint32_t n) noexcept {
+        y[0] = y[0] + x[0] * h[0];
+        for (uint32_t k = 1; k < n - 1; k += 2) {
+            const auto xr = x[k], xi = x[k + 1], hr = h[k], hi = h[k + 1];
+            y[k] = y[k] + (xr * hr - xi * hi);
+            y[k + 1] = y[k + 1] + (xr * hi + xi * hr);
+        }
+        y[n - 1] = y[n - 1] + x[n - 1] * h[n - 1];
+    }
+}}
+
+// ----------------------------------------------------------------------------
+// ------------------------------------ HRTF ----------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Loads HRTF set from stream, resampled to rate.
+/// 载入HRTF: 线性插值重采样, 分块FFT
+/// </summary>
+/// <param name="stream">The stream.</param>
+/// <param name="rate">The sample rate of output.</param>
+/// <param name="hr">The reason if failed.</param>
+/// <returns>null if failed</returns>
+auto WrapAL::hrtf::CALHRTF::Load(IALStream& stream, uint32_t rate, HRESULT& hr) noexcept -> CALHRTF* {
+    FileHeader header;
+    hr = E_INVALIDARG;
+    // 文件头
+    if (stream.ReadNext(sizeof(header), &header) != sizeof(header)) return nullptr;
+    if (std::memcmp(header.magic, "WHRF", 4) || header.version != 1 || header.receivers != 2) return nullptr;
+    if (!header.measurements || header.measurements > uint32_t(HRTFMaxMeasurements)) return nullptr;
+    if (!header.taps || header.taps > uint32_t(HRTFMaxTaps)) return nullptr;
+    if (header.rate < XAUDIO2_MIN_SAMPLE_RATE || header.rate > XAUDIO2_MAX_SAMPLE_RATE || !rate) return nullptr;
+    const auto count = header.measurements, taps = header.taps;
+    // 重采样后的长度与分块
+    const auto step = double(header.rate) / double(rate);
+    const auto length = uint32_t(std::ceil(double(taps) / step));
+    const uint32_t block = BinauralBlock, size = block * 2;
+    const auto partitions = (length + block - 1) / block;
+    // 临时: 位置, 脉冲响应, FFT缓冲
+    hr = E_OUTOFMEMORY;
+    const auto temp = reinterpret_cast<float*>(std::malloc(
+        sizeof(float) * (count * 3 + count * 2 * taps + size * 2)));
+    if (!temp) return nullptr;
+    const auto position = temp, ir = temp + count * 3, buffer = ir + count * 2 * taps, scratch = buffer + size;
+    CALHRTF* set = nullptr;
+    if (const auto ptr = std::malloc(sizeof(CALHRTF))) {
+        set = new(ptr) CALHRTF;
+        set->m_cMeasurement = count;
+        set->m_cPartition = partitions;
+        set->m_uRate = rate;
+        set->m_pSpectra = reinterpret_cast<float*>(std::malloc(sizeof(float) * count * 2 * partitions * size));
+        set->m_pNearest = reinterpret_cast<uint32_t*>(std::malloc(sizeof(uint32_t) * AZIMUTH_STEPS * ELEVATION_STEPS));
+        if (!set->m_pSpectra || !set->m_pNearest || !set->m_fft.Init(size)) {
+            set->Release();
+            set = nullptr;
+        }
+    }
+    // 读取数据
+    if (set) {
+        const auto position_size = sizeof(float) * count * 3, ir_size = sizeof(float) * count * 2 * taps;
+        if (stream.ReadNext(uint32_t(position_size), position) != position_size
+            || stream.ReadNext(uint32_t(ir_size), ir) != ir_size) {
+            hr = E_INVALIDARG;
+            set->Release();
+            set = nullptr;
+        }
+    }
+    if (set) {
+        // 每个测量每只耳朵: 重采样, 分块, 变换
+        const auto scale = float(step) / float(size);
+        for (uint32_t i = 0; i != count * 2; ++i) {
+            const auto src = ir + i * taps;
+            auto dst = set->m_pSpectra + i * partitions * size;
+            for (uint32_t p = 0; p != partitions; ++p, dst += size) {
+                std::memset(buffer, 0, sizeof(float) * size);
+                for (uint32_t j = 0; j != block; ++j) {
+                    const auto t = double(p * block + j) * step;
+                    const auto k = uint32_t(t);
+                    if (k >= taps) break;
+                    const auto f = float(t - double(k));
+                    const auto next = k + 1 < taps ? src[k + 1] : 0.f;
+                    buffer[j] = (src[k] + (next - src[k]) * f) * scale;
+                }
+                set->m_fft.Forward(buffer, scratch);
+                std::memcpy(dst, buffer, sizeof(float) * size);
+            }
+        }
+        // SOFA: 方位角逆时针 -> 听者空间方向
+        constexpr float rad = PI / 180.f;
+        for (uint32_t i = 0; i != count; ++i) {
+            const auto a = position[i * 3] * rad, e = position[i * 3 + 1] * rad;
+            position[i * 3 + 0] = -std::sin(a) * std::cos(e);
+            position[i * 3 + 1] = std::sin(e);
+            position[i * 3 + 2] = std::cos(a) * std::cos(e);
+        }
+        set->build_nearest(position);
+        hr = S_OK;
+    }
+    std::free(temp);
+    return set;
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALHRTF"/> class.
+/// </summary>
+/// <returns></returns>
+WrapAL::hrtf::CALHRTF::~CALHRTF() noexcept {
+    std::free(m_pSpectra);
+    std::free(m_pNearest);
+}
+
+/// <summary>
+/// Releases this instance.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::hrtf::CALHRTF::Release() noexcept -> uint32_t {
+    const auto count = --m_cRefCount;
+    if (!count) {
+        this->~CALHRTF();
+        std::free(this);
+    }
+    return count;
+}
+
+/// <summary>
+/// Builds the nearest measurement of each direction of grid.
+/// 网格方向上最近的测量
+/// </summary>
+/// <param name="direction">The unit direction of measurements, [count][3].</param>
+/// <returns></returns>
+void WrapAL::hrtf::CALHRTF::build_nearest(const float* direction) noexcept {
+    for (uint32_t row = 0; row != ELEVATION_STEPS; ++row) {
+        const auto e = float(row) * PI / float(ELEVATION_STEPS - 1) - PI * 0.5f;
+        for (uint32_t col = 0; col != AZIMUTH_STEPS; ++col) {
+            const auto a = float(col) * PI * 2.f / float(AZIMUTH_STEPS);
+            const float x = std::sin(a) * std::cos(e), y = std::sin(e), z = std::cos(a) * std::cos(e);
+            uint32_t nearest = 0; float best = -2.f;
+            for (uint32_t i = 0; i != m_cMeasurement; ++i) {
+                const auto d = direction + i * 3;
+                const auto dot = d[0] * x + d[1] * y + d[2] * z;
+                if (dot > best) { best = dot; nearest = i; }
+            }
+            m_pNearest[row * AZIMUTH_STEPS + col] = nearest;
+        }
+    }
+}
+
+/// <summary>
+/// Finds the nearest measurement of direction, in 5 deg. grid.
+/// </summary>
+/// <param name="azimuth">The azimuth, clockwise from front.</param>
+/// <param name="elevation">The elevation, up positive.</param>
+/// <returns></returns>
+auto WrapAL::hrtf::CALHRTF::Find(float azimuth, float elevation) const noexcept -> uint32_t {
+    auto col = int(std::floor(azimuth * (float(AZIMUTH_STEPS) / (PI * 2.f)) + 0.5f)) % int(AZIMUTH_STEPS);
+    if (col < 0) col += int(AZIMUTH_STEPS);
+    auto row = int(std::floor((elevation + PI * 0.5f) * (float(ELEVATION_STEPS - 1) / PI) + 0.5f));
+    row = std::min(std::max(row, 0), int(ELEVATION_STEPS - 1));
+    return m_pNearest[uint32_t(row) * AZIMUTH_STEPS + uint32_t(col)];
+}
+
+// ----------------------------------------------------------------------------
+// ---------------------------------- Binaural --------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Creates the binaural renderer with HRTF set.
+/// </summary>
+/// <param name="hrtf">The HRTF set.</param>
+/// <returns>null if OOM</returns>
+auto WrapAL::hrtf::CALBinaural::Create(CALHRTF& hrtf) noexcept -> CALBinaural* {
+    const auto ptr = std::malloc(sizeof(CALBinaural));
+    return ptr ? new(ptr) CALBinaural(hrtf) : nullptr;
+}
+
+/// <summary>
+/// Initializes a new instance of the <see cref="CALBinaural"/> class.
+/// </summary>
+/// <param name="hrtf">The HRTF set, add-ref-ed.</param>
+WrapAL::hrtf::CALBinaural::CALBinaural(CALHRTF& hrtf) noexcept
+    : CALAudioEffect(effect::Effect_Binaural), m_hrtf(hrtf) {
+    m_hrtf.AddRef();
+    std::memset(m_aLanes, 0, sizeof(m_aLanes));
+    for (auto& f : m_aFilter) f = ~0u;
+    for (auto& f : m_aPending) f = ~0u;
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALBinaural"/> class.
+/// </summary>
+/// <returns></returns>
+WrapAL::hrtf::CALBinaural::~CALBinaural() noexcept {
+    std::free(m_pBuffer);
+    m_hrtf.Release();
+}
+
+/// <summary>
+/// Allocates state: lanes, FFT buffers and output, 16-byte aligned.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::hrtf::CALBinaural::lock() noexcept -> HRESULT {
+    // 每个声道一个源, 与HRTF同采样率
+    if (this->channels != BinauralBusChannels || this->rate != m_hrtf.GetRate()) return xapo::XAPO_E_FORMAT_UNSUPPORTED;
+    const auto n = m_hrtf.GetFFT().GetSize(), p = m_hrtf.GetPartitions();
+    constexpr uint32_t groups = BinauralBusChannels / 4;
+    const size_t lanes = size_t(n) * (1 + p * 5);
+    const size_t bytes = sizeof(f4) * (lanes * groups + n * 3) + sizeof(float) * n + 15;
+    std::free(m_pBuffer);
+    m_pBuffer = std::malloc(bytes);
+    if (!m_pBuffer) return E_OUTOFMEMORY;
+    auto ptr = reinterpret_cast<f4*>((reinterpret_cast<uintptr_t>(m_pBuffer) + 15) & ~uintptr_t(15));
+    for (auto& l : m_aLanes) {
+        l.input = ptr; ptr += n;
+        l.spectra = ptr; ptr += n * p;
+        l.filter = ptr; ptr += n * p * 2;
+        l.old = ptr; ptr += n * p * 2;
+    }
+    m_pScratch = ptr; ptr += n;
+    m_pNew = ptr; ptr += n;
+    m_pOld = ptr; ptr += n;
+    m_pOutput = reinterpret_cast<float*>(ptr);
+    this->reset();
+    return S_OK;
+}
+
+/// <summary>
+/// Frees the state.
+/// </summary>
+/// <returns></returns>
+void WrapAL::hrtf::CALBinaural::unlock() noexcept {
+    std::free(m_pBuffer);
+    m_pBuffer = nullptr;
+    std::memset(m_aLanes, 0, sizeof(m_aLanes));
+}
+
+/// <summary>
+/// Clears the state, filters of slots applied again at next block.
+/// </summary>
+/// <returns></returns>
+void WrapAL::hrtf::CALBinaural::reset() noexcept {
+    if (!m_pBuffer) return;
+    const auto n = m_hrtf.GetFFT().GetSize(), p = m_hrtf.GetPartitions();
+    constexpr uint32_t groups = BinauralBusChannels / 4;
+    std::memset(m_aLanes[0].input, 0, sizeof(f4) * (size_t(n) * (1 + p * 5) * groups + n * 3) + sizeof(float) * n);
+    for (auto& l : m_aLanes) l.quiet = l.fading = 0;
+    for (auto& f : m_aFilter) f = ~0u;
+    m_uFill = 0;
+    m_uRing = 0;
+}
+
+/// <summary>
+/// Takes filters of slots, applied at next block.
+/// </summary>
+/// <param name="param">The parameters.</param>
+/// <returns></returns>
+void WrapAL::hrtf::CALBinaural::update(const effect::EffectParameters& param) noexcept {
+    const auto count = m_hrtf.GetCount();
+    for (uint32_t i = 0; i != BinauralBusChannels; ++i) {
+        const auto filter = param.binaural.filter[i];
+        m_aPending[i] = filter < count ? filter : ~0u;
+    }
+}
+
+/// <summary>
+/// Processes: slots to lanes of input, output of last block to L/R.
+/// 处理: 一个块的延迟
+/// </summary>
+/// <param name="data">The interleaved frames.</param>
+/// <param name="frames">The frame count.</param>
+/// <returns></returns>
+void WrapAL::hrtf::CALBinaural::process(float* data, uint32_t frames) noexcept {
+    constexpr uint32_t block = BinauralBlock, groups = BinauralBusChannels / 4;
+    for (uint32_t f = 0; f != frames; ++f, data += BinauralBusChannels) {
+        // 声道正好是通道
+        for (uint32_t g = 0; g != groups; ++g)
+            std::memcpy(m_aLanes[g].input + block + m_uFill, data + g * 4, sizeof(f4));
+        data[0] = m_pOutput[m_uFill * 2];
+        data[1] = m_pOutput[m_uFill * 2 + 1];
+        std::memset(data + 2, 0, sizeof(float) * (BinauralBusChannels - 2));
+        if (++m_uFill == block) {
+            this->run();
+            m_uFill = 0;
+        }
+    }
+}
+
+/// <summary>
+/// Changes filter of slot, crossfading from old one in this block.
+/// 更换滤波器: 从未使用开始则清除历史
+/// </summary>
+/// <param name="slot">The slot.</param>
+/// <param name="filter">The filter, ~0 for unused.</param>
+/// <returns></returns>
+void WrapAL::hrtf::CALBinaural::change(uint32_t slot, uint32_t filter) noexcept {
+    auto& l = m_aLanes[slot / 4];
+    const auto lane = slot % 4;
+    const auto n = m_hrtf.GetFFT().GetSize(), p = m_hrtf.GetPartitions();
+    const auto length = n * p;
+    // 从未使用开始: 清除上个块与频谱, 这个块已是新的源
+    if (m_aFilter[slot] == ~0u) {
+        for (uint32_t i = 0; i != n / 2; ++i) lane_at(l.input, i, lane) = 0.f;
+        for (uint32_t i = 0; i != length; ++i) lane_at(l.spectra, i, lane) = 0.f;
+        for (uint32_t i = 0; i != length * 2; ++i) lane_at(l.old, i, lane) = 0.f;
+    }
+    else for (uint32_t i = 0; i != length * 2; ++i) lane_at(l.old, i, lane) = lane_at(l.filter, i, lane);
+    for (uint32_t ear = 0; ear != 2; ++ear) {
+        const auto src = filter != ~0u ? m_hrtf.GetSpectra(filter, ear) : nullptr;
+        const auto dst = l.filter + ear * length;
+        for (uint32_t i = 0; i != length; ++i) lane_at(dst, i, lane) = src ? src[i] : 0.f;
+    }
+    l.fading |= 1u << lane;
+    l.quiet = 0;
+    m_aFilter[slot] = filter;
+}
+
+/// <summary>
+/// Runs convolution of one block.
+/// </summary>
+/// <returns></returns>
+void WrapAL::hrtf::CALBinaural::run() noexcept {
+    for (uint32_t i = 0; i != BinauralBusChannels; ++i) {
+        if (m_aPending[i] != m_aFilter[i]) this->change(i, m_aPending[i]);
+    }
+    std::memset(m_pOutput, 0, sizeof(float) * BinauralBlock * 2);
+    for (auto& l : m_aLanes) this->convolve(l);
+    if (++m_uRing == m_hrtf.GetPartitions()) m_uRing = 0;
+}
+
+/// <summary>
+/// Convolves 4 slots in lanes: overlap-save, partitions in frequency domain.
+/// 卷积: 输入变换一次, 与各分块频谱相乘累加, 每只耳朵逆变换一次
+/// </summary>
+/// <param name="l">The lanes.</param>
+/// <returns></returns>
+void WrapAL::hrtf::CALBinaural::convolve(Lanes& l) noexcept {
+    const auto& fft = m_hrtf.GetFFT();
+    const auto n = fft.GetSize(), p = m_hrtf.GetPartitions();
+    constexpr uint32_t block = BinauralBlock;
+    const auto fading = l.fading;
+    l.fading = 0;
+    // 没有使用的通道
+    const auto slots = m_aFilter + (&l - m_aLanes) * 4;
+    if (!fading && slots[0] == ~0u && slots[1] == ~0u && slots[2] == ~0u && slots[3] == ~0u) return;
+    // 全部分块都是静音输入, 输出也是静音
+    auto peak = f4::set(0.f);
+    for (uint32_t i = block; i != n; ++i) peak = f4::max(peak, l.input[i].abs());
+    l.quiet = peak.hmax() > 0.f ? 0 : l.quiet + 1;
+    if (l.quiet > p + 1) return;
+    // 输入频谱
+    const auto x = l.spectra + m_uRing * n;
+    std::memcpy(x, l.input, sizeof(f4) * n);
+    fft.Forward(x, m_pScratch);
+    std::memcpy(l.input, l.input + block, sizeof(f4) * block);
+    float weight[4];
+    for (uint32_t j = 0; j != 4; ++j) weight[j] = (fading >> j) & 1 ? 1.f : 0.f;
+    const auto fade = f4::load(weight), one = f4::set(1.f), step = f4::set(1.f / float(block));
+    for (uint32_t ear = 0; ear != 2; ++ear) {
+        const auto filter = l.filter + ear * n * p, old = l.old + ear * n * p;
+        std::memset(m_pNew, 0, sizeof(f4) * n);
+        for (uint32_t i = 0; i != p; ++i)
+            hrtf::mac(m_pNew, l.spectra + ((m_uRing + p - i) % p) * n, filter + i * n, n);
+        fft.Backward(m_pNew, m_pScratch);
+        if (fading) {
+            std::memset(m_pOld, 0, sizeof(f4) * n);
+            for (uint32_t i = 0; i != p; ++i)
+                hrtf::mac(m_pOld, l.spectra + ((m_uRing + p - i) % p) * n, old + i * n, n);
+            fft.Backward(m_pOld, m_pScratch);
+        }
+        // 后半是这个块的输出
+        auto t = step;
+        for (uint32_t i = 0; i != block; ++i, t = t + step) {
+            auto y = m_pNew[block + i];
+            if (fading) {
+                const auto o = m_pOld[block + i];
+                y = o + (y - o) * (one + fade * (t - one));
+            }
+            m_pOutput[i * 2 + ear] += y.sum();
+        }
+    }
+}
@@ -0,0 +1,177 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL binaural rendering, HRTF convolution on engine-owned bus voices:
+    3D clip -> channel(slot) of 8-channel bus -> CALBinaural -> L/R -> master
+
+HRTF set file, little-endian, SOFA SimpleFreeFieldHRIR-like:
+    char[4]     "WHRF"
+    uint32      version, 1
+    uint32      sample rate
+    uint32      count of measurements M
+    uint32      count of receivers, 2
+    uint32      taps of each impulse response N
+    float[M][3] source position: azimuth(deg., counter-clockwise), elevation(deg.), distance
+    float[M][2][N] impulse responses, left then right
+
+each slot is convolved by uniformly partitioned overlap-save, block of
+BinauralBlock frames, 4 slots in SIMD lanes share one FFT. filter changes
+at block boundary, crossfading outputs of old/new filter over one block.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for atomic
+#include <atomic>
+// for FFT
+#include "AudioFFT.h"
+// for CALAudioEffect
+#include "AudioEffect.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // stream interface
+    struct IALStream;
+    // HRTF
+    namespace hrtf {
+        // HRTF set: spectra of partitions of each measurement
+        class CALHRTF {
+        public:
+            // load from stream, resampled to rate, null if failed with reason in "hr"
+            static auto Load(IALStream& stream, uint32_t rate, HRESULT& hr) noexcept ->CALHRTF*;
+            // add ref
+            auto AddRef() noexcept { return ++m_cRefCount; }
+            // release
+            auto Release() noexcept -> uint32_t;
+            // nearest measurement of direction in listener space, radian
+            auto Find(float azimuth, float elevation) const noexcept ->uint32_t;
+            // spectra of measurement for ear(0 left, 1 right), [partition][BinauralBlock * 2]
+            auto GetSpectra(uint32_t index, uint32_t ear) const noexcept -> const float* {
+                return m_pSpectra + (index * 2 + ear) * m_cPartition * m_fft.GetSize();
+            }
+            // count of measurements
+            auto GetCount() const noexcept { return m_cMeasurement; }
+            // count of partitions
+            auto GetPartitions() const noexcept { return m_cPartition; }
+            // sample rate
+            auto GetRate() const noexcept { return m_uRate; }
+            // FFT of BinauralBlock * 2
+            auto GetFFT() const noexcept -> const fft::CALRealFFT& { return m_fft; }
+        private:
+            // ctor
+            CALHRTF() noexcept : m_cRefCount(1) {}
+            // dtor
+            ~CALHRTF() noexcept;
+            // build nearest table of direction grid
+            void build_nearest(const float* direction) noexcept;
+        private:
+            // ref-count
+            std::atomic<uint32_t>   m_cRefCount;
+            // spectra, [measurement][ear][partition][size], scaled by 1/size
+            float*                  m_pSpectra = nullptr;
+            // nearest measurement of grid, [elevation][azimuth]
+            uint32_t*               m_pNearest = nullptr;
+            // count of measurements
+            uint32_t                m_cMeasurement = 0;
+            // count of partitions
+            uint32_t                m_cPartition = 0;
+            // sample rate
+            uint32_t                m_uRate = 0;
+            // FFT
+            fft::CALRealFFT         m_fft;
+        };
+        // binaural renderer: channel i is source slot i, output L/R to channel 0/1
+        class CALBinaural final : public effect::CALAudioEffect {
+            // 4 slots in lanes
+            struct Lanes {
+                // input of last 2 blocks, [BinauralBlock * 2]
+                simd::f4*   input;
+                // spectra of input blocks, ring of partitions, [partition][size]
+                simd::f4*   spectra;
+                // filter now, [ear][partition][size]
+                simd::f4*   filter;
+                // filter before change, [ear][partition][size]
+                simd::f4*   old;
+                // silent blocks in a row
+                uint32_t    quiet;
+                // lanes crossfading this block, bitmask
+                uint32_t    fading;
+            };
+        public:
+            // create with HRTF set, null if OOM
+            static auto Create(CALHRTF& hrtf) noexcept ->CALBinaural*;
+        protected:
+            // ctor
+            CALBinaural(CALHRTF& hrtf) noexcept;
+            // dtor
+            ~CALBinaural() noexcept;
+            // allocate state
+            auto lock() noexcept ->HRESULT override;
+            // free state
+            void unlock() noexcept override;
+            // clear state
+            void reset() noexcept override;
+            // take filters of slots
+            void update(const effect::EffectParameters& param) noexcept override;
+            // process
+            void process(float* data, uint32_t frames) noexcept override;
+            // tail after input
+            bool tail() const noexcept override { return true; }
+        private:
+            // change filter of slot at block boundary
+            void change(uint32_t slot, uint32_t filter) noexcept;
+            // run convolution of one block
+            void run() noexcept;
+            // convolve lanes, add to output
+            void convolve(Lanes& lanes) noexcept;
+        private:
+            // HRTF set
+            CALHRTF&                m_hrtf;
+            // buffer of all state
+            void*                   m_pBuffer = nullptr;
+            // FFT scratch, [size]
+            simd::f4*               m_pScratch = nullptr;
+            // output of new filter, [size]
+            simd::f4*               m_pNew = nullptr;
+            // output of old filter, [size]
+            simd::f4*               m_pOld = nullptr;
+            // output of last block, [BinauralBlock][2]
+            float*                  m_pOutput = nullptr;
+            // frames filled in block
+            uint32_t                m_uFill = 0;
+            // ring position of input spectra
+            uint32_t                m_uRing = 0;
+            // filters of slots applied
+            uint32_t                m_aFilter[BinauralBusChannels];
+            // filters of slots taken, applied at next block
+            uint32_t                m_aPending[BinauralBusChannels];
+            // lanes
+            Lanes                   m_aLanes[BinauralBusChannels / 4];
+        };
+    }
+}
@@ -0,0 +1,1686 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <mmsystem.h>
+#include "AudioMixer.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cwchar>
+#include <chrono>
+#include <new>
+
+#ifndef WAVE_FORMAT_IEEE_FLOAT
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#endif
+
+// mixer namespace
+namespace WrapAL { namespace mixer {
+    // load function
+    template<typename T> static inline auto load_func(T& pointer, HMODULE dll, const char* name) noexcept {
+        pointer = reinterpret_cast<T>(::GetProcAddress(dll, name));
+    }
+    // get time in ns
+    static inline auto get_time_ns() noexcept -> uint64_t {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+    // create object by malloc
+    template<typename T, typename... Args> static inline auto create_object(Args&&... args) noexcept {
+        const auto ptr = reinterpret_cast<T*>(std::malloc(sizeof(T)));
+        if (ptr) new(ptr) T(std::forward<Args>(args)...);
+        return ptr;
+    }
+    // destroy object created by create_object
+    template<typename T> static inline auto destroy_object(T* ptr) noexcept {
+        ptr->~T();
+        std::free(ptr);
+    }
+}}
+
+// ----------------------------------------------------------------------------
+// -------------------------------- Voice Common ------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Set default level matrix for the send.
+/// 设置默认输出矩阵
+/// </summary>
+/// <param name="send">The send.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceData::DefaultMatrix(MixerSend& send) const noexcept {
+    const auto src = this->channels;
+    const auto dst = send.target->channels;
+    std::memset(send.level, 0, sizeof(send.level));
+    // 单声道 -> 前置左右
+    if (src == 1) {
+        const auto count = std::min(dst, 2u);
+        for (uint32_t i = 0; i != count; ++i) send.level[i] = 1.f;
+    }
+    // 多声道 -> 单声道
+    else if (dst == 1) {
+        const auto level = 1.f / float(src);
+        for (uint32_t i = 0; i != src; ++i) send.level[i] = level;
+    }
+    // 对应声道
+    else {
+        const auto count = std::min(src, dst);
+        for (uint32_t i = 0; i != count; ++i) send.level[i * src + i] = 1.f;
+    }
+}
+
+/// <summary>
+/// Mix the data to all sends with volume.
+/// 混合数据到输出
+/// </summary>
+/// <param name="data">The data.</param>
+/// <param name="frames">The frames.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceData::MixToSends(const float* data, uint32_t frames) const noexcept {
+    const auto src = this->channels;
+    float gain[MixerMaxChannels * MixerMaxChannels];
+    for (uint32_t i = 0; i != this->send_count; ++i) {
+        const auto& send = this->sends[i];
+        const auto dst = send.target->channels;
+        // 合并音量到矩阵
+        for (uint32_t d = 0; d != dst; ++d) {
+            for (uint32_t s = 0; s != src; ++s) {
+                const auto index = d * src + s;
+                gain[index] = send.level[index] * this->volume * this->channel_volume[s];
+            }
+        }
+        // 混合
+        auto output = send.target->mix;
+        auto input = data;
+        for (uint32_t f = 0; f != frames; ++f) {
+            for (uint32_t d = 0; d != dst; ++d) {
+                float sample = 0.f;
+                for (uint32_t s = 0; s != src; ++s) sample += input[s] * gain[d * src + s];
+                output[d] += sample;
+            }
+            input += src;
+            output += dst;
+        }
+    }
+}
+
+/// <summary>
+/// Gets the input rate of output voices.
+/// </summary>
+/// <returns>rate of engine if no send</returns>
+auto WrapAL::mixer::MixerVoiceData::OutputRate() const noexcept -> uint32_t {
+    return this->send_count ? this->sends[0].target->rate : this->engine->GetSampleRate();
+}
+
+/// <summary>
+/// Gets the voice details.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="details">The details.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceImpl::GetVoiceDetails(MixerVoiceData& data, XAUDIO2_VOICE_DETAILS* details) noexcept {
+    assert(details && "bad argument");
+    details->CreationFlags = data.flags;
+    details->ActiveFlags = data.flags;
+    details->InputChannels = data.channels;
+    details->InputSampleRate = data.rate;
+}
+
+/// <summary>
+/// Sets the output voices.
+/// 设置输出链
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="list">The send list, null for mastering voice.</param>
+/// <returns></returns>
+auto WrapAL::mixer::MixerVoiceImpl::SetOutputVoices(MixerVoiceData& data, const XAUDIO2_VOICE_SENDS* list) noexcept -> HRESULT {
+    // 主音不能输出
+    if (data.kind == VoiceKind::Kind_Master) return XAUDIO2_E_INVALID_CALL;
+    const auto engine = data.engine;
+    MixerSend sends[MixerMaxSends];
+    uint32_t count = 0;
+    // 默认输出到主音
+    if (!list) {
+        if (!(sends[0].target = engine->GetMaster())) return XAUDIO2_E_INVALID_CALL;
+        count = 1;
+    }
+    // 指定输出
+    else {
+        if (list->SendCount > MixerMaxSends) return E_INVALIDARG;
+        engine->Lock();
+        for (; count != list->SendCount; ++count) {
+            const auto target = engine->FindVoice(list->pSends[count].pOutputVoice);
+            // 只能输出到更后的阶段, 输出采样率必须相同
+            if (!target || (target->kind == VoiceKind::Kind_Submix &&
+                data.kind == VoiceKind::Kind_Submix && target->stage <= data.stage)
+                || (count && target->rate != sends[0].target->rate)) {
+                engine->Unlock();
+                return XAUDIO2_E_INVALID_CALL;
+            }
+            sends[count].target = target;
+        }
+        engine->Unlock();
+    }
+    // 默认矩阵
+    for (uint32_t i = 0; i != count; ++i) data.DefaultMatrix(sends[i]);
+    // 提交
+    engine->Lock();
+    std::memcpy(data.sends, sends, sizeof(sends[0]) * count);
+    data.send_count = count;
+    engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Sets the volume.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="volume">The volume.</param>
+/// <returns></returns>
+auto WrapAL::mixer::MixerVoiceImpl::SetVolume(MixerVoiceData& data, float volume) noexcept -> HRESULT {
+    if (!(volume >= -XAUDIO2_MAX_VOLUME_LEVEL && volume <= XAUDIO2_MAX_VOLUME_LEVEL)) return E_INVALIDARG;
+    data.volume = volume;
+    return S_OK;
+}
+
+/// <summary>
+/// Gets the volume.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="volume">The volume.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceImpl::GetVolume(MixerVoiceData& data, float* volume) noexcept {
+    assert(volume && "bad argument");
+    *volume = data.volume;
+}
+
+/// <summary>
+/// Sets the channel volumes.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="count">The count of channels.</param>
+/// <param name="volumes">The volumes.</param>
+/// <returns></returns>
+auto WrapAL::mixer::MixerVoiceImpl::SetChannelVolumes(MixerVoiceData& data, UINT32 count, const float* volumes) noexcept -> HRESULT {
+    if (count != data.channels || !volumes) return E_INVALIDARG;
+    std::memcpy(data.channel_volume, volumes, sizeof(float) * count);
+    return S_OK;
+}
+
+/// <summary>
+/// Gets the channel volumes.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="count">The count of channels.</param>
+/// <param name="volumes">The volumes.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceImpl::GetChannelVolumes(MixerVoiceData& data, UINT32 count, float* volumes) noexcept {
+    assert(count == data.channels && volumes && "bad argument");
+    std::memcpy(volumes, data.channel_volume, sizeof(float) * std::min(count, data.channels));
+}
+
+// mixer namespace
+namespace WrapAL { namespace mixer {
+    // find send by target
+    static auto find_send(MixerVoiceData& data, IXAudio2Voice* target) noexcept -> MixerSend* {
+        // 唯一输出可以省略目标
+        if (!target) return data.send_count == 1 ? data.sends : nullptr;
+        for (uint32_t i = 0; i != data.send_count; ++i) {
+            if (data.sends[i].target->voice == target) return data.sends + i;
+        }
+        return nullptr;
+    }
+}}
+
+/// <summary>
+/// Sets the output matrix.
+/// 设置输出矩阵
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="target">The target voice.</param>
+/// <param name="src">The source channels.</param>
+/// <param name="dst">The destination channels.</param>
+/// <param name="matrix">The level matrix.</param>
+/// <returns></returns>
+auto WrapAL::mixer::MixerVoiceImpl::SetOutputMatrix(MixerVoiceData& data,
+    IXAudio2Voice* target, UINT32 src, UINT32 dst, const float* matrix) noexcept -> HRESULT {
+    const auto engine = data.engine;
+    HRESULT hr = XAUDIO2_E_INVALID_CALL;
+    engine->Lock();
+    if (const auto send = find_send(data, target)) {
+        // 声道数必须一致
+        if (matrix && src == data.channels && dst == send->target->channels) {
+            std::memcpy(send->level, matrix, sizeof(float) * src * dst);
+            hr = S_OK;
+        }
+        else hr = E_INVALIDARG;
+    }
+    engine->Unlock();
+    return hr;
+}
+
+/// <summary>
+/// Gets the output matrix.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="target">The target voice.</param>
+/// <param name="src">The source channels.</param>
+/// <param name="dst">The destination channels.</param>
+/// <param name="matrix">The level matrix.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceImpl::GetOutputMatrix(MixerVoiceData& data,
+    IXAudio2Voice* target, UINT32 src, UINT32 dst, float* matrix) noexcept {
+    const auto engine = data.engine;
+    engine->Lock();
+    const auto send = find_send(data, target);
+    if (send && matrix && src == data.channels && dst == send->target->channels) {
+        std::memcpy(matrix, send->level, sizeof(float) * src * dst);
+    }
+    engine->Unlock();
+}
+
+/// <summary>
+/// Runs the effect chain on mix buffer in-place.
+/// 就地运行效果链
+/// </summary>
+/// <param name="frames">The frames.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceData::RunEffects(uint32_t frames) noexcept {
+    xapo::XAPO_PROCESS_BUFFER_PARAMETERS param = { this->mix, xapo::XAPO_BUFFER_VALID, frames };
+    for (uint32_t i = 0; i != this->effect_count; ++i) {
+        this->effects[i]->Process(1, &param, 1, &param, this->effect_enabled[i]);
+    }
+}
+
+/// <summary>
+/// Unlocks and releases the effect chain.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceData::ReleaseEffects() noexcept {
+    for (uint32_t i = 0; i != this->effect_count; ++i) {
+        this->effects[i]->UnlockForProcess();
+        this->effects[i]->Release();
+    }
+    this->effect_count = 0;
+}
+
+/// <summary>
+/// Sets the effect chain, replaces the old one.
+/// 设置效果链: 只支持就地处理, 输出声道数与输入相同
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="chain">The chain, null to remove.</param>
+/// <returns></returns>
+auto WrapAL::mixer::MixerVoiceImpl::SetEffectChain(MixerVoiceData& data, const XAUDIO2_EFFECT_CHAIN* chain) noexcept -> HRESULT {
+    const auto count = chain ? chain->EffectCount : 0;
+    if (count && !chain->pEffectDescriptors) return E_INVALIDARG;
+    if (count > EffectChainMaxLength) return E_INVALIDARG;
+    if (count && data.kind == VoiceKind::Kind_Source) return E_NOTIMPL;
+    // 浮点格式
+    WAVEFORMATEX wave;
+    wave.wFormatTag = Wave_IEEEFloat;
+    wave.nChannels = uint16_t(data.channels);
+    wave.nSamplesPerSec = data.rate;
+    wave.wBitsPerSample = 32;
+    wave.nBlockAlign = uint16_t(sizeof(float) * data.channels);
+    wave.nAvgBytesPerSec = wave.nBlockAlign * data.rate;
+    wave.cbSize = 0;
+    const xapo::XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS param = { &wave, data.engine->GetQuantum() };
+    xapo::IXAPO* effects[EffectChainMaxLength];
+    bool enabled[EffectChainMaxLength];
+    HRESULT hr = S_OK;
+    uint32_t locked = 0;
+    for (; locked != count && SUCCEEDED(hr); ++locked) {
+        const auto& desc = chain->pEffectDescriptors[locked];
+        effects[locked] = nullptr;
+        enabled[locked] = !!desc.InitialState;
+        if (!desc.pEffect || desc.OutputChannels != data.channels) { hr = E_INVALIDARG; break; }
+        hr = desc.pEffect->QueryInterface(xapo::IID_IXAPO, reinterpret_cast<void**>(effects + locked));
+        if (FAILED(hr)) { hr = XAUDIO2_E_XAPO_CREATION_FAILED; break; }
+        hr = effects[locked]->LockForProcess(1, &param, 1, &param);
+        if (FAILED(hr)) { effects[locked]->Release(); break; }
+    }
+    // 失败则释放已锁定的
+    if (FAILED(hr)) {
+        for (uint32_t i = 0; i != locked; ++i) {
+            effects[i]->UnlockForProcess();
+            effects[i]->Release();
+        }
+        return hr;
+    }
+    // 交换, 旧效果链在锁外释放
+    xapo::IXAPO* old[EffectChainMaxLength];
+    const auto engine = data.engine;
+    engine->Lock();
+    const auto old_count = data.effect_count;
+    std::memcpy(old, data.effects, sizeof(old[0]) * old_count);
+    std::memcpy(data.effects, effects, sizeof(effects[0]) * count);
+    std::memcpy(data.effect_enabled, enabled, sizeof(enabled[0]) * count);
+    data.effect_count = count;
+    engine->Unlock();
+    for (uint32_t i = 0; i != old_count; ++i) {
+        old[i]->UnlockForProcess();
+        old[i]->Release();
+    }
+    return S_OK;
+}
+
+/// <summary>
+/// Enables or disables the effect.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="index">The index.</param>
+/// <param name="enable">if set to <c>true</c> [enable].</param>
+/// <returns></returns>
+auto WrapAL::mixer::MixerVoiceImpl::EnableEffect(MixerVoiceData& data, UINT32 index, bool enable) noexcept -> HRESULT {
+    HRESULT hr = E_INVALIDARG;
+    data.engine->Lock();
+    if (index < data.effect_count) {
+        data.effect_enabled[index] = enable;
+        hr = S_OK;
+    }
+    data.engine->Unlock();
+    return hr;
+}
+
+/// <summary>
+/// Gets the state of the effect.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="index">The index.</param>
+/// <param name="enabled">The enabled.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceImpl::GetEffectState(MixerVoiceData& data, UINT32 index, BOOL* enabled) noexcept {
+    if (!enabled) return;
+    data.engine->Lock();
+    *enabled = index < data.effect_count && data.effect_enabled[index];
+    data.engine->Unlock();
+}
+
+/// <summary>
+/// Sets or gets parameters of the effect through IXAPOParameters.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="index">The index.</param>
+/// <param name="param">The parameters.</param>
+/// <param name="size">The size.</param>
+/// <param name="set">if set to <c>true</c> [set].</param>
+/// <returns></returns>
+auto WrapAL::mixer::MixerVoiceImpl::EffectParameters(MixerVoiceData& data,
+    UINT32 index, void* param, UINT32 size, bool set) noexcept -> HRESULT {
+    xapo::IXAPOParameters* parameters = nullptr;
+    HRESULT hr = E_INVALIDARG;
+    data.engine->Lock();
+    if (index < data.effect_count) {
+        hr = data.effects[index]->QueryInterface(xapo::IID_IXAPOParameters, reinterpret_cast<void**>(&parameters));
+    }
+    data.engine->Unlock();
+    if (FAILED(hr)) return hr;
+    if (set) parameters->SetParameters(param, size);
+    else parameters->GetParameters(param, size);
+    parameters->Release();
+    return S_OK;
+}
+
+/// <summary>
+/// Sets the filter parameters, voice created with XAUDIO2_VOICE_USEFILTER only.
+/// 设置滤波器参数
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="param">The parameters.</param>
+/// <returns></returns>
+auto WrapAL::mixer::MixerVoiceImpl::SetFilterParameters(MixerVoiceData& data, const XAUDIO2_FILTER_PARAMETERS* param) noexcept -> HRESULT {
+    if (!(data.flags & XAUDIO2_VOICE_USEFILTER)) return XAUDIO2_E_INVALID_CALL;
+    if (!param || param->Type > HighPassOnePoleFilter) return E_INVALIDARG;
+    if (!(param->Frequency >= 0.f && param->Frequency <= XAUDIO2_MAX_FILTER_FREQUENCY)) return E_INVALIDARG;
+    if (!(param->OneOverQ > 0.f && param->OneOverQ <= XAUDIO2_MAX_FILTER_ONEOVERQ)) return E_INVALIDARG;
+    data.engine->Lock();
+    data.filter = *param;
+    data.engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Gets the filter parameters.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="param">The parameters.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceImpl::GetFilterParameters(MixerVoiceData& data, XAUDIO2_FILTER_PARAMETERS* param) noexcept {
+    assert(param && "bad argument");
+    data.engine->Lock();
+    *param = data.filter;
+    data.engine->Unlock();
+}
+
+/// <summary>
+/// Runs the filter in-place, Chamberlin state variable filter like XAudio2.
+/// 就地滤波: 状态变量滤波器, 频率为 2sin(πf/fs)
+/// </summary>
+/// <param name="data">The data.</param>
+/// <param name="frames">The frames.</param>
+/// <returns></returns>
+void WrapAL::mixer::MixerVoiceData::RunFilter(float* data, uint32_t frames) noexcept {
+    const auto ch = this->channels;
+    const auto param = this->filter;
+    // 默认参数的低通视为直通
+    if (param.Type == LowPassFilter && param.Frequency >= XAUDIO2_MAX_FILTER_FREQUENCY) {
+        std::memset(this->filter_state, 0, sizeof(this->filter_state));
+        return;
+    }
+    const auto f = param.Frequency, q = param.OneOverQ;
+    for (uint32_t c = 0; c != ch; ++c) {
+        auto low = this->filter_state[c][0], band = this->filter_state[c][1];
+        auto ptr = data + c;
+        switch (param.Type)
+        {
+        case LowPassOnePoleFilter:
+            for (uint32_t i = 0; i != frames; ++i, ptr += ch) *ptr = low += f * (*ptr - low);
+            break;
+        case HighPassOnePoleFilter:
+            for (uint32_t i = 0; i != frames; ++i, ptr += ch) { low += f * (*ptr - low); *ptr -= low; }
+            break;
+        default:
+            for (uint32_t i = 0; i != frames; ++i, ptr += ch) {
+                low += f * band;
+                const auto high = *ptr - low - q * band;
+                band += f * high;
+                switch (param.Type)
+                {
+                case LowPassFilter:  *ptr = low; break;
+                case BandPassFilter: *ptr = band; break;
+                case HighPassFilter: *ptr = high; break;
+                default:             *ptr = high + low; break;
+                }
+            }
+        }
+        this->filter_state[c][0] = low;
+        this->filter_state[c][1] = band;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// -------------------------------- Source Voice ------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Initializes a new instance of the <see cref="CALMixerSourceVoice"/> class.
+/// </summary>
+/// <param name="eng">The engine.</param>
+/// <param name="wave">The wave format.</param>
+/// <param name="flags">The flags.</param>
+/// <param name="max_ratio">The maximum frequency ratio.</param>
+/// <param name="cb">The callback.</param>
+WrapAL::mixer::CALMixerSourceVoice::CALMixerSourceVoice(CALMixerEngine* eng,
+    const WAVEFORMATEX& wave, uint32_t flags, float max_ratio, IXAudio2VoiceCallback* cb) noexcept
+    : Super(eng, VoiceKind::Kind_Source), m_pCallback(cb), m_fMaxRatio(max_ratio), wave(wave) {
+    this->channels = wave.nChannels;
+    this->rate = wave.nSamplesPerSec;
+    this->flags = flags;
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALMixerSourceVoice"/> class.
+/// </summary>
+/// <returns></returns>
+WrapAL::mixer::CALMixerSourceVoice::~CALMixerSourceVoice() noexcept {
+    std::free(m_pScratch);
+    std::free(this->mix);
+    m_pScratch = nullptr;
+    this->mix = nullptr;
+}
+
+/// <summary>
+/// Initializes the scratch buffer.
+/// 初始化缓冲区
+/// </summary>
+/// <returns></returns>
+auto WrapAL::mixer::CALMixerSourceVoice::Init() noexcept -> HRESULT {
+    const auto quantum = this->engine->GetQuantum();
+    const auto step = double(m_fMaxRatio) * double(this->rate) / double(this->engine->GetSampleRate());
+    // 历史帧 + 本次需要的帧 + 余量
+    const auto capacity = uint32_t(double(quantum) * step) + 4;
+    const auto scratch = reinterpret_cast<float*>(std::malloc(sizeof(float) * capacity * this->channels));
+    if (!scratch) return E_OUTOFMEMORY;
+    std::free(m_pScratch);
+    m_pScratch = scratch;
+    m_cScratch = capacity;
+    this->reset_resampler();
+    // 输出缓冲区
+    if (!this->mix) {
+        this->mix = reinterpret_cast<float*>(std::malloc(sizeof(float) * quantum * this->channels));
+        if (!this->mix) return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
+/// <summary>
+/// Resets the resampler.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerSourceVoice::reset_resampler() noexcept {
+    // 没有历史帧: 第一帧就是第一个输出采样, 不延迟
+    m_cReady = 0;
+    m_dPosition = 0.0;
+}
+
+/// <summary>
+/// Starts this voice.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerSourceVoice::Start(UINT32, UINT32) noexcept {
+    // 同步到混音线程
+    this->engine->Lock();
+    m_bRunning = true;
+    this->engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Stops this voice.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerSourceVoice::Stop(UINT32, UINT32) noexcept {
+    // 同步到混音线程
+    this->engine->Lock();
+    m_bRunning = false;
+    this->engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Submits the source buffer.
+/// 提交缓冲区
+/// </summary>
+/// <param name="pBuffer">The buffer.</param>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerSourceVoice::SubmitSourceBuffer(const XAUDIO2_BUFFER* pBuffer, const XAUDIO2_BUFFER_WMA*) noexcept {
+    if (!pBuffer || !pBuffer->pAudioData) return E_INVALIDARG;
+    const auto& buffer = *pBuffer;
+    const uint32_t total = buffer.AudioBytes / this->wave.nBlockAlign;
+    MixerBuffer data;
+    data.buffer = buffer;
+    data.begin = buffer.PlayBegin;
+    data.end = buffer.PlayLength ? buffer.PlayBegin + buffer.PlayLength : total;
+    data.loop_begin = buffer.LoopBegin;
+    data.loop_end = buffer.LoopLength ? buffer.LoopBegin + buffer.LoopLength : data.end;
+    data.cursor = data.begin;
+    data.loop_done = 0;
+    data.started = false;
+    // 检查范围
+    if (data.begin >= data.end || data.end > total) return XAUDIO2_E_INVALID_CALL;
+    if (buffer.LoopCount) {
+        if (buffer.LoopCount > XAUDIO2_MAX_LOOP_COUNT && buffer.LoopCount != XAUDIO2_LOOP_INFINITE)
+            return XAUDIO2_E_INVALID_CALL;
+        // 同XAudio2: 循环开始可以在播放开始之前(从中间开始的循环)
+        if (data.loop_end <= data.begin || data.loop_begin >= data.loop_end || data.loop_end > data.end)
+            return XAUDIO2_E_INVALID_CALL;
+    }
+    // 入队
+    HRESULT hr = XAUDIO2_E_INVALID_CALL;
+    this->engine->Lock();
+    if (m_cQueued < XAUDIO2_MAX_QUEUED_BUFFERS) {
+        m_aQueue[(m_uHead + m_cQueued) % XAUDIO2_MAX_QUEUED_BUFFERS] = data;
+        ++m_cQueued;
+        hr = S_OK;
+    }
+    this->engine->Unlock();
+    return hr;
+}
+
+/// <summary>
+/// Flushes the source buffers, callbacks fired in next pass.
+/// 清空缓冲区
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerSourceVoice::FlushSourceBuffers() noexcept {
+    this->engine->Lock();
+    // 运行中则保留正在播放的缓冲区
+    const uint32_t keep = (m_bRunning && m_cQueued && m_aQueue[m_uHead].started) ? 1 : 0;
+    for (uint32_t i = keep; i < m_cQueued; ++i) {
+        const auto& data = m_aQueue[(m_uHead + i) % XAUDIO2_MAX_QUEUED_BUFFERS];
+        m_aFlushed[m_cFlushed++] = data.buffer.pContext;
+    }
+    m_cQueued = keep;
+    // 完全清空则重置重采样
+    if (!keep) this->reset_resampler();
+    this->engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Fires the callbacks of flushed buffers.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerSourceVoice::FireFlushed() noexcept {
+    // 回调中可能继续刷新
+    for (uint32_t i = 0; i < m_cFlushed; ++i) {
+        if (m_pCallback) m_pCallback->OnBufferEnd(m_aFlushed[i]);
+    }
+    m_cFlushed = 0;
+}
+
+/// <summary>
+/// Exits the loop of current buffer.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerSourceVoice::ExitLoop(UINT32) noexcept {
+    this->engine->Lock();
+    if (m_cQueued) {
+        auto& data = m_aQueue[m_uHead];
+        data.buffer.LoopCount = data.loop_done;
+    }
+    this->engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Gets the state.
+/// </summary>
+/// <param name="pVoiceState">State of the voice.</param>
+/// <param name="Flags">The flags.</param>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerSourceVoice::GetState(XAUDIO2_VOICE_STATE* pVoiceState, UINT32 Flags) noexcept {
+    assert(pVoiceState && "bad argument");
+    this->engine->Lock();
+    pVoiceState->pCurrentBufferContext = m_cQueued ? m_aQueue[m_uHead].buffer.pContext : nullptr;
+    pVoiceState->BuffersQueued = m_cQueued;
+    if (!(Flags & XAUDIO2_VOICE_NOSAMPLESPLAYED)) pVoiceState->SamplesPlayed = m_cSamplesPlayed;
+    this->engine->Unlock();
+}
+
+/// <summary>
+/// Sets the frequency ratio.
+/// </summary>
+/// <param name="Ratio">The ratio.</param>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerSourceVoice::SetFrequencyRatio(float Ratio, UINT32) noexcept {
+    if (this->flags & XAUDIO2_VOICE_NOPITCH) return XAUDIO2_E_INVALID_CALL;
+    m_fRatio = std::max(XAUDIO2_MIN_FREQ_RATIO, std::min(Ratio, m_fMaxRatio));
+    return S_OK;
+}
+
+/// <summary>
+/// Gets the frequency ratio.
+/// </summary>
+/// <param name="pRatio">The ratio.</param>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerSourceVoice::GetFrequencyRatio(float* pRatio) noexcept {
+    assert(pRatio && "bad argument");
+    *pRatio = m_fRatio;
+}
+
+/// <summary>
+/// Sets the source sample rate.
+/// </summary>
+/// <param name="NewSourceSampleRate">The new source sample rate.</param>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerSourceVoice::SetSourceSampleRate(UINT32 NewSourceSampleRate) noexcept {
+    if (NewSourceSampleRate < XAUDIO2_MIN_SAMPLE_RATE || NewSourceSampleRate > XAUDIO2_MAX_SAMPLE_RATE)
+        return E_INVALIDARG;
+    HRESULT hr = XAUDIO2_E_INVALID_CALL;
+    this->engine->Lock();
+    // 必须没有缓冲区
+    if (!m_cQueued) {
+        this->rate = NewSourceSampleRate;
+        this->wave.nSamplesPerSec = NewSourceSampleRate;
+        this->wave.nAvgBytesPerSec = NewSourceSampleRate * this->wave.nBlockAlign;
+        hr = this->Init();
+    }
+    this->engine->Unlock();
+    return hr;
+}
+
+/// <summary>
+/// Destroys the voice.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerSourceVoice::DestroyVoice() noexcept {
+    this->engine->Unlink(*this);
+    mixer::destroy_object(this);
+}
+
+/// <summary>
+/// Gets the step in source of one output frame.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::mixer::CALMixerSourceVoice::get_step() const noexcept -> double {
+    return double(m_fRatio) * double(this->rate) / double(this->OutputRate());
+}
+
+/// <summary>
+/// Frames can be read in queue.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::mixer::CALMixerSourceVoice::queued_frames() const noexcept -> uint32_t {
+    uint32_t frames = 0;
+    for (uint32_t i = 0; i != m_cQueued; ++i) {
+        const auto& data = m_aQueue[(m_uHead + i) % XAUDIO2_MAX_QUEUED_BUFFERS];
+        // 无限循环
+        if (data.buffer.LoopCount == XAUDIO2_LOOP_INFINITE) return ~uint32_t(0);
+        const auto loop = data.loop_end - data.loop_begin;
+        const auto rest = data.buffer.LoopCount - std::min(data.loop_done, data.buffer.LoopCount);
+        frames += data.end - data.cursor + loop * rest;
+    }
+    return frames;
+}
+
+/// <summary>
+/// Converts the frames to float.
+/// 转换到浮点
+/// </summary>
+/// <param name="src">The source.</param>
+/// <param name="dst">The destination.</param>
+/// <param name="frames">The frames.</param>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerSourceVoice::convert(const uint8_t* src, float* dst, uint32_t frames) const noexcept {
+    const auto count = frames * this->channels;
+    // 浮点
+    if (this->wave.wFormatTag == Wave_IEEEFloat) {
+        std::memcpy(dst, src, sizeof(float) * count);
+        return;
+    }
+    // PCM
+    switch (this->wave.wBitsPerSample)
+    {
+    case 8:
+        for (uint32_t i = 0; i != count; ++i) dst[i] = float(int(src[i]) - 128) * (1.f / 128.f);
+        break;
+    case 16:
+        for (uint32_t i = 0; i != count; ++i, src += 2) {
+            int16_t s; std::memcpy(&s, src, sizeof(s));
+            dst[i] = float(s) * (1.f / 32768.f);
+        }
+        break;
+    case 24:
+        for (uint32_t i = 0; i != count; ++i, src += 3) {
+            const int32_t s = int32_t(uint32_t(src[0]) << 8 | uint32_t(src[1]) << 16 | uint32_t(src[2]) << 24);
+            dst[i] = float(s >> 8) * (1.f / 8388608.f);
+        }
+        break;
+    case 32:
+        for (uint32_t i = 0; i != count; ++i, src += 4) {
+            int32_t s; std::memcpy(&s, src, sizeof(s));
+            dst[i] = float(double(s) * (1.0 / 2147483648.0));
+        }
+        break;
+    default:
+        std::memset(dst, 0, sizeof(float) * count);
+        break;
+    }
+}
+
+/// <summary>
+/// Pulls frames from the queue.
+/// 从队列中读取
+/// </summary>
+/// <param name="data">The output.</param>
+/// <param name="frames">The frames.</param>
+/// <returns>count of frames pulled</returns>
+auto WrapAL::mixer::CALMixerSourceVoice::pull(float* data, uint32_t frames) noexcept -> uint32_t {
+    const auto cb = m_pCallback;
+    uint32_t done = 0;
+    while (done < frames && m_cQueued) {
+        auto& buf = m_aQueue[m_uHead];
+        const auto context = buf.buffer.pContext;
+        // 开始
+        if (!buf.started) {
+            buf.started = true;
+            if (cb) cb->OnBufferStart(context);
+        }
+        const auto loop_count = buf.buffer.LoopCount;
+        const bool looping = loop_count && (loop_count == XAUDIO2_LOOP_INFINITE || buf.loop_done < loop_count);
+        const auto stop = looping ? buf.loop_end : buf.end;
+        // 读取
+        if (buf.cursor < stop) {
+            const auto count = std::min(stop - buf.cursor, frames - done);
+            const auto src = reinterpret_cast<const uint8_t*>(buf.buffer.pAudioData);
+            this->convert(src + size_t(buf.cursor) * this->wave.nBlockAlign, data + size_t(done) * this->channels, count);
+            buf.cursor += count;
+            done += count;
+            m_cSamplesPlayed += count;
+            continue;
+        }
+        // 循环
+        if (looping) {
+            ++buf.loop_done;
+            buf.cursor = buf.loop_begin;
+            if (cb) cb->OnLoopEnd(context);
+            continue;
+        }
+        // 结束
+        const bool eos = !!(buf.buffer.Flags & XAUDIO2_END_OF_STREAM);
+        m_uHead = (m_uHead + 1) % XAUDIO2_MAX_QUEUED_BUFFERS;
+        --m_cQueued;
+        if (cb) cb->OnBufferEnd(context);
+        if (eos) {
+            m_cSamplesPlayed = 0;
+            if (cb) cb->OnStreamEnd();
+        }
+    }
+    return done;
+}
+
+/// <summary>
+/// Renders one quantum to sends.
+/// 渲染
+/// </summary>
+/// <param name="frames">The frames.</param>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerSourceVoice::Render(uint32_t frames) noexcept {
+    const auto ch = this->channels;
+    const auto step = this->get_step();
+    // 需要的帧数: 最后一帧插值需要下一帧, 下次的历史帧
+    const auto last = uint32_t(m_dPosition + double(frames - 1) * step) + 2;
+    const auto next = uint32_t(m_dPosition + double(frames) * step) + 1;
+    const auto need = std::min(std::max(last, next), m_cScratch);
+    // 通知需要的字节数
+    if (m_pCallback) {
+        const auto queued = this->queued_frames();
+        const auto want = need > m_cReady ? need - m_cReady : 0;
+        const auto required = want > queued ? want - queued : 0;
+        m_pCallback->OnVoiceProcessingPassStart(required * this->wave.nBlockAlign);
+    }
+    // 读取数据
+    if (need > m_cReady) {
+        const auto ptr = m_pScratch + m_cReady * ch;
+        const auto got = this->pull(ptr, need - m_cReady);
+        std::memset(ptr + got * ch, 0, sizeof(float) * (need - m_cReady - got) * ch);
+        m_cReady = need;
+    }
+    // 线性插值重采样
+    auto pos = m_dPosition;
+    const auto out = this->mix;
+    for (uint32_t f = 0; f != frames; ++f) {
+        const auto index = uint32_t(pos);
+        const auto t = float(pos - double(index));
+        const auto a = m_pScratch + index * ch;
+        const auto b = a + ch;
+        for (uint32_t c = 0; c != ch; ++c) out[f * ch + c] = a[c] + (b[c] - a[c]) * t;
+        pos += step;
+    }
+    // 保留历史帧
+    const auto consumed = std::min(uint32_t(pos), m_cReady - 1);
+    std::memmove(m_pScratch, m_pScratch + consumed * ch, sizeof(float) * (m_cReady - consumed) * ch);
+    m_cReady -= consumed;
+    m_dPosition = pos - double(consumed);
+    // 输出
+    if (this->flags & XAUDIO2_VOICE_USEFILTER) this->RunFilter(out, frames);
+    this->MixToSends(out, frames);
+    if (m_pCallback) m_pCallback->OnVoiceProcessingPassEnd();
+}
+
+// ----------------------------------------------------------------------------
+// ------------------------------ Submix & Master -----------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Destroys the voice.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerSubmixVoice::DestroyVoice() noexcept {
+    this->engine->Unlink(*this);
+    mixer::destroy_object(this);
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALMixerSubmixVoice"/> class.
+/// </summary>
+/// <returns></returns>
+WrapAL::mixer::CALMixerSubmixVoice::~CALMixerSubmixVoice() noexcept {
+    this->ReleaseEffects();
+    std::free(m_pScratch);
+    std::free(this->mix);
+    m_pScratch = nullptr;
+    this->mix = nullptr;
+}
+
+/// <summary>
+/// Initializes the buffers, rate not higher than engine's.
+/// 初始化缓冲区
+/// </summary>
+/// <returns></returns>
+auto WrapAL::mixer::CALMixerSubmixVoice::Init() noexcept -> HRESULT {
+    const auto count = size_t(this->engine->GetQuantum()) * this->channels;
+    this->mix = reinterpret_cast<float*>(std::malloc(sizeof(float) * count));
+    m_pScratch = reinterpret_cast<float*>(std::malloc(sizeof(float) * (count + this->channels)));
+    if (!this->mix || !m_pScratch) return E_OUTOFMEMORY;
+    std::memset(this->mix, 0, sizeof(float) * count);
+    std::memset(m_pScratch, 0, sizeof(float) * this->channels);
+    return S_OK;
+}
+
+/// <summary>
+/// Runs effect chain, mixes this pass to sends, resampled to rate of output voices.
+/// 运行效果链后输出到目标, 采样率不同则线性插值重采样
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerSubmixVoice::Render() noexcept {
+    const auto in = this->frames;
+    this->RunEffects(in);
+    if (this->flags & XAUDIO2_VOICE_USEFILTER) this->RunFilter(this->mix, in);
+    const auto out_rate = this->OutputRate();
+    if (out_rate == this->rate) return this->MixToSends(this->mix, in);
+    const auto ch = this->channels;
+    const auto out = this->OutputFrames(in);
+    const auto step = double(this->rate) / double(out_rate);
+    // 历史帧之后接上本次混音
+    std::memcpy(m_pScratch + ch, this->mix, sizeof(float) * in * ch);
+    auto pos = m_dPosition;
+    for (uint32_t f = 0; f != out; ++f) {
+        const auto index = std::min(uint32_t(pos), in ? in - 1 : 0);
+        const auto t = float(std::min(pos - double(index), 1.0));
+        const auto a = m_pScratch + index * ch;
+        const auto b = in ? a + ch : a;
+        for (uint32_t c = 0; c != ch; ++c) this->mix[f * ch + c] = a[c] + (b[c] - a[c]) * t;
+        pos += step;
+    }
+    // 最后一帧作为历史帧, 周期帧数取整的误差留在位置中
+    std::memmove(m_pScratch, m_pScratch + in * ch, sizeof(float) * ch);
+    m_dPosition = std::min(std::max(pos - double(in), 0.0), 1.0);
+    this->MixToSends(this->mix, out);
+}
+
+/// <summary>
+/// Gets the channel mask.
+/// </summary>
+/// <param name="pChannelmask">The channel mask.</param>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerMasteringVoice::GetChannelMask(DWORD* pChannelmask) noexcept {
+    if (!pChannelmask) return E_INVALIDARG;
+    switch (this->channels)
+    {
+    case 1: *pChannelmask = 0x4; break;     // FC
+    case 2: *pChannelmask = 0x3; break;     // FL FR
+    case 4: *pChannelmask = 0x33; break;    // FL FR BL BR
+    case 6: *pChannelmask = 0x3F; break;    // FL FR FC LFE BL BR
+    case 8: *pChannelmask = 0x63F; break;   // 5.1 + SL SR
+    default: *pChannelmask = (1u << this->channels) - 1; break;
+    }
+    return S_OK;
+}
+
+/// <summary>
+/// Destroys the voice.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerMasteringVoice::DestroyVoice() noexcept {
+    this->engine->DestroyMaster();
+}
+
+// ----------------------------------------------------------------------------
+// ---------------------------------- Engine ----------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Creates the mixer engine.
+/// 创建混音引擎
+/// </summary>
+/// <param name="engine">The engine.</param>
+/// <param name="output">The output, null for offline mode.</param>
+/// <param name="latency">The latency.</param>
+/// <returns></returns>
+auto WrapAL::mixer::CALMixerEngine::Create(IXAudio2** engine, IALMixerOutput* output, const AudioLatency& latency) noexcept -> HRESULT {
+    assert(engine && "bad argument");
+    *engine = nullptr;
+    const auto ptr = reinterpret_cast<CALMixerEngine*>(std::malloc(sizeof(CALMixerEngine)));
+    if (!ptr) { WrapAL::SafeRelease(output); return E_OUTOFMEMORY; }
+    new(ptr) CALMixerEngine(output, latency);
+    *engine = ptr;
+    return S_OK;
+}
+
+/// <summary>
+/// Initializes a new instance of the <see cref="CALMixerEngine"/> class.
+/// </summary>
+/// <param name="output">The output.</param>
+/// <param name="latency">The latency.</param>
+WrapAL::mixer::CALMixerEngine::CALMixerEngine(IALMixerOutput* output, const AudioLatency& latency) noexcept
+    : m_pOutput(output), m_latency(latency), m_cRefCount(1), m_bRunning(true), m_bExit(false) {
+    m_headSource.prev = m_headSource.next = &m_headSource;
+    m_headSubmix.prev = m_headSubmix.next = &m_headSubmix;
+    std::memset(m_aCallback, 0, sizeof(m_aCallback));
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALMixerEngine"/> class.
+/// </summary>
+/// <returns></returns>
+WrapAL::mixer::CALMixerEngine::~CALMixerEngine() noexcept {
+    assert(!m_cSource && !m_cSubmix && "voices not destroyed");
+    if (m_pMaster) this->DestroyMaster();
+    WrapAL::SafeRelease(m_pOutput);
+}
+
+/// <summary>
+/// Releases this instance.
+/// </summary>
+/// <returns></returns>
+ULONG WrapAL::mixer::CALMixerEngine::Release() noexcept {
+    const auto count = --m_cRefCount;
+    if (!count) {
+        this->~CALMixerEngine();
+        std::free(this);
+    }
+    return count;
+}
+
+/// <summary>
+/// Registers the engine callback.
+/// </summary>
+/// <param name="pCallback">The callback.</param>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerEngine::RegisterForCallbacks(IXAudio2EngineCallback* pCallback) noexcept {
+    if (!pCallback) return E_INVALIDARG;
+    HRESULT hr = E_OUTOFMEMORY;
+    this->Lock();
+    if (m_cCallback < sizeof(m_aCallback) / sizeof(m_aCallback[0])) {
+        m_aCallback[m_cCallback++] = pCallback;
+        hr = S_OK;
+    }
+    this->Unlock();
+    return hr;
+}
+
+/// <summary>
+/// Unregisters the engine callback.
+/// </summary>
+/// <param name="pCallback">The callback.</param>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerEngine::UnregisterForCallbacks(IXAudio2EngineCallback* pCallback) noexcept {
+    this->Lock();
+    const auto end = m_aCallback + m_cCallback;
+    const auto itr = std::find(m_aCallback, end, pCallback);
+    if (itr != end) {
+        std::copy(itr + 1, end, itr);
+        --m_cCallback;
+    }
+    this->Unlock();
+}
+
+/// <summary>
+/// Creates the source voice.
+/// 创建源音
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerEngine::CreateSourceVoice(
+    IXAudio2SourceVoice** ppSourceVoice, const WAVEFORMATEX* pSourceFormat,
+    UINT32 Flags, float MaxFrequencyRatio, IXAudio2VoiceCallback* pCallback,
+    const XAUDIO2_VOICE_SENDS* pSendList, const XAUDIO2_EFFECT_CHAIN* pEffectChain) noexcept {
+    if (!ppSourceVoice || !pSourceFormat) return E_INVALIDARG;
+    *ppSourceVoice = nullptr;
+    const auto& wave = *pSourceFormat;
+    // 检查格式
+    const bool pcm = wave.wFormatTag == Wave_PCM && (wave.wBitsPerSample == 8 ||
+        wave.wBitsPerSample == 16 || wave.wBitsPerSample == 24 || wave.wBitsPerSample == 32);
+    const bool ieee = wave.wFormatTag == Wave_IEEEFloat && wave.wBitsPerSample == 32;
+    if (!pcm && !ieee) return E_INVALIDARG;
+    if (!wave.nChannels || wave.nChannels > MixerMaxChannels) return E_INVALIDARG;
+    if (wave.nBlockAlign != wave.nChannels * wave.wBitsPerSample / 8) return E_INVALIDARG;
+    if (wave.nSamplesPerSec < XAUDIO2_MIN_SAMPLE_RATE || wave.nSamplesPerSec > XAUDIO2_MAX_SAMPLE_RATE)
+        return E_INVALIDARG;
+    if (pEffectChain && pEffectChain->EffectCount) return E_NOTIMPL;
+    if (!m_pMaster) return XAUDIO2_E_INVALID_CALL;
+    // 频率比
+    if (Flags & XAUDIO2_VOICE_NOPITCH) MaxFrequencyRatio = 1.f;
+    MaxFrequencyRatio = std::max(XAUDIO2_MIN_FREQ_RATIO, std::min(MaxFrequencyRatio, XAUDIO2_MAX_FREQ_RATIO));
+    // 创建
+    auto voice = mixer::create_object<CALMixerSourceVoice>(this, wave, Flags, MaxFrequencyRatio, pCallback);
+    if (!voice) return E_OUTOFMEMORY;
+    HRESULT hr = voice->Init();
+    if (SUCCEEDED(hr)) hr = voice->SetOutputVoices(pSendList);
+    // 链接
+    if (SUCCEEDED(hr)) {
+        this->Lock();
+        this->link(m_headSource, *voice);
+        ++m_cSource;
+        this->Unlock();
+        *ppSourceVoice = voice;
+    }
+    else mixer::destroy_object(voice);
+    return hr;
+}
+
+/// <summary>
+/// Creates the submix voice.
+/// 创建子混音
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerEngine::CreateSubmixVoice(
+    IXAudio2SubmixVoice** ppSubmixVoice, UINT32 InputChannels,
+    UINT32 InputSampleRate, UINT32 Flags, UINT32 ProcessingStage,
+    const XAUDIO2_VOICE_SENDS* pSendList, const XAUDIO2_EFFECT_CHAIN* pEffectChain) noexcept {
+    if (!ppSubmixVoice) return E_INVALIDARG;
+    *ppSubmixVoice = nullptr;
+    if (!InputChannels || InputChannels > MixerMaxChannels) return E_INVALIDARG;
+    if (!m_pMaster) return XAUDIO2_E_INVALID_CALL;
+    // 只支持不高于引擎的采样率
+    if (InputSampleRate > m_uSampleRate) return E_NOTIMPL;
+    if (InputSampleRate && InputSampleRate < XAUDIO2_MIN_SAMPLE_RATE) return E_INVALIDARG;
+    auto voice = mixer::create_object<CALMixerSubmixVoice>(this);
+    if (!voice) return E_OUTOFMEMORY;
+    voice->channels = InputChannels;
+    voice->rate = InputSampleRate ? InputSampleRate : m_uSampleRate;
+    voice->stage = ProcessingStage;
+    voice->flags = Flags;
+    HRESULT hr = voice->Init();
+    if (SUCCEEDED(hr)) hr = voice->SetEffectChain(pEffectChain);
+    // 先链接, 以便设置输出
+    if (SUCCEEDED(hr)) hr = voice->SetOutputVoices(pSendList);
+    if (SUCCEEDED(hr)) {
+        this->Lock();
+        // 按阶段排序
+        auto node = m_headSubmix.next;
+        while (node != &m_headSubmix && static_cast<MixerVoiceData*>(node)->stage <= ProcessingStage)
+            node = node->next;
+        this->link(*node, *voice);
+        ++m_cSubmix;
+        this->Unlock();
+        *ppSubmixVoice = voice;
+    }
+    else mixer::destroy_object(voice);
+    return hr;
+}
+
+/// <summary>
+/// Creates the mastering voice and starts mixing thread.
+/// 创建主音
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerEngine::CreateMasteringVoice(
+    IXAudio2MasteringVoice** ppMasteringVoice, UINT32 InputChannels,
+    UINT32 InputSampleRate, UINT32 Flags, LPCWSTR szDeviceId,
+    const XAUDIO2_EFFECT_CHAIN* pEffectChain, AUDIO_STREAM_CATEGORY) noexcept {
+    if (!ppMasteringVoice) return E_INVALIDARG;
+    *ppMasteringVoice = nullptr;
+    if (m_pMaster) return XAUDIO2_E_INVALID_CALL;
+    uint32_t channels = InputChannels ? InputChannels : 2;
+    uint32_t rate = InputSampleRate ? InputSampleRate : MixerDefaultSampleRate;
+    if (channels > MixerMaxChannels) return E_INVALIDARG;
+    // 周期与延迟, 微秒转为帧
+    uint32_t period = rate / MixerQuantumPerSecond;
+    if (m_latency.period) period = std::max(uint32_t(uint64_t(rate) * m_latency.period / 1000000), uint32_t(MixerMinPeriod));
+    uint32_t latency = period * MixerOutputBufferCount;
+    if (m_latency.latency) latency = std::max(uint32_t(uint64_t(rate) * m_latency.latency / 1000000), period * 2);
+    // 打开设备
+    HRESULT hr = S_OK;
+    if (m_pOutput) hr = m_pOutput->Open(szDeviceId, channels, rate, period, latency);
+    auto voice = SUCCEEDED(hr) ? mixer::create_object<CALMixerMasteringVoice>(this) : nullptr;
+    if (SUCCEEDED(hr) && !voice) hr = E_OUTOFMEMORY;
+    // 申请缓冲区
+    if (SUCCEEDED(hr)) {
+        m_uSampleRate = rate;
+        m_cQuantum = period;
+        m_cLatency = m_pOutput ? latency : 0;
+        voice->channels = channels;
+        voice->rate = rate;
+        voice->flags = Flags;
+        const auto len = sizeof(float) * m_cQuantum * channels;
+        voice->mix = reinterpret_cast<float*>(std::malloc(len));
+        m_pOutBuffer = reinterpret_cast<float*>(std::malloc(len));
+        if (!voice->mix || !m_pOutBuffer) hr = E_OUTOFMEMORY;
+    }
+    if (SUCCEEDED(hr)) hr = voice->SetEffectChain(pEffectChain);
+    // 开始混音线程, 离线模式由 Pull 驱动
+    if (SUCCEEDED(hr)) {
+        m_pMaster = voice;
+        m_bExit = false;
+        m_cPending = 0;
+        if (m_pOutput) m_thread = std::thread(&CALMixerEngine::thread_proc, this);
+        *ppMasteringVoice = voice;
+    }
+    // 失败
+    else {
+        if (voice) mixer::destroy_object(voice);
+        std::free(m_pOutBuffer);
+        m_pOutBuffer = nullptr;
+        if (m_pOutput) m_pOutput->Close();
+    }
+    return hr;
+}
+
+/// <summary>
+/// Destroys the mastering voice, stops the mixing thread.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerEngine::DestroyMaster() noexcept {
+    assert(m_pMaster && "no mastering voice");
+    this->stop_thread();
+    if (m_pOutput) m_pOutput->Close();
+    mixer::destroy_object(m_pMaster);
+    m_pMaster = nullptr;
+    std::free(m_pOutBuffer);
+    m_pOutBuffer = nullptr;
+}
+
+/// <summary>
+/// Starts the engine.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::mixer::CALMixerEngine::StartEngine() noexcept {
+    this->Lock();
+    m_bRunning = true;
+    this->Unlock();
+    m_cv.notify_all();
+    return S_OK;
+}
+
+/// <summary>
+/// Stops the engine.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerEngine::StopEngine() noexcept {
+    this->Lock();
+    m_bRunning = false;
+    this->Unlock();
+}
+
+/// <summary>
+/// Gets the performance data.
+/// </summary>
+/// <param name="pPerfData">The perf data.</param>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerEngine::GetPerformanceData(XAUDIO2_PERFORMANCE_DATA* pPerfData) noexcept {
+    assert(pPerfData && "bad argument");
+    std::memset(pPerfData, 0, sizeof(*pPerfData));
+    const auto now = mixer::get_time_ns();
+    this->Lock();
+    // 以纳秒作为周期
+    pPerfData->AudioCyclesSinceLastQuery = m_cCycles;
+    pPerfData->TotalCyclesSinceLastQuery = m_uLastQuery ? now - m_uLastQuery : m_cCycles;
+    pPerfData->MinimumCyclesPerQuantum = m_cMaxCycles ? m_cMinCycles : 0;
+    pPerfData->MaximumCyclesPerQuantum = m_cMaxCycles;
+    pPerfData->CurrentLatencyInSamples = m_cLatency;
+    pPerfData->GlitchesSinceEngineStarted = m_cGlitches;
+    pPerfData->TotalSourceVoiceCount = m_cSource;
+    pPerfData->ActiveSubmixVoiceCount = m_cSubmix;
+    for (auto node = m_headSource.next; node != &m_headSource; node = node->next) {
+        if (static_cast<CALMixerSourceVoice*>(static_cast<MixerVoiceData*>(node))->IsRunning())
+            ++pPerfData->ActiveSourceVoiceCount;
+    }
+    pPerfData->ActiveMatrixMixCount = pPerfData->ActiveSourceVoiceCount + m_cSubmix;
+    pPerfData->ActiveResamplerCount = pPerfData->ActiveSourceVoiceCount;
+    m_uLastQuery = now;
+    m_cCycles = 0;
+    m_cMinCycles = ~uint32_t(0);
+    m_cMaxCycles = 0;
+    this->Unlock();
+}
+
+/// <summary>
+/// Finds the voice (submix or mastering) by interface.
+/// </summary>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+auto WrapAL::mixer::CALMixerEngine::FindVoice(IXAudio2Voice* voice) noexcept -> MixerVoiceData* {
+    if (!voice) return nullptr;
+    if (m_pMaster && m_pMaster->voice == voice) return m_pMaster;
+    for (auto node = m_headSubmix.next; node != &m_headSubmix; node = node->next) {
+        const auto data = static_cast<MixerVoiceData*>(node);
+        if (data->voice == voice) return data;
+    }
+    return nullptr;
+}
+
+/// <summary>
+/// Links the voice before the node.
+/// </summary>
+/// <param name="node">The node.</param>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerEngine::link(MixerNode& node, MixerVoiceData& voice) noexcept {
+    voice.prev = node.prev;
+    voice.next = &node;
+    node.prev->next = &voice;
+    node.prev = &voice;
+}
+
+/// <summary>
+/// Unlinks the voice, and removes sends to it.
+/// </summary>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerEngine::Unlink(MixerVoiceData& voice) noexcept {
+    this->Lock();
+    voice.prev->next = voice.next;
+    voice.next->prev = voice.prev;
+    voice.prev = voice.next = nullptr;
+    if (voice.kind == VoiceKind::Kind_Source) --m_cSource;
+    else --m_cSubmix;
+    // 移除到该音的输出
+    if (voice.kind == VoiceKind::Kind_Submix) {
+        for (auto head : { &m_headSource, &m_headSubmix }) {
+            for (auto node = head->next; node != head; node = node->next) {
+                const auto data = static_cast<MixerVoiceData*>(node);
+                const auto end = std::remove_if(data->sends, data->sends + data->send_count,
+                    [&voice](const MixerSend& s) noexcept { return s.target == &voice; });
+                data->send_count = uint32_t(end - data->sends);
+            }
+        }
+    }
+    this->Unlock();
+}
+
+/// <summary>
+/// Renders one quantum to the output.
+/// 渲染一个周期
+/// </summary>
+/// <param name="output">The output.</param>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerEngine::Render(float* output) noexcept {
+    const auto begin = mixer::get_time_ns();
+    const auto frames = m_cQuantum;
+    this->Lock();
+    const auto master = m_pMaster;
+    assert(master && "no mastering voice");
+    for (uint32_t i = 0; i != m_cCallback; ++i) m_aCallback[i]->OnProcessingPassStart();
+    // 清空混音缓冲区
+    const auto pass = m_cPass++;
+    master->frames = frames;
+    std::memset(master->mix, 0, sizeof(float) * frames * master->channels);
+    for (auto node = m_headSubmix.next; node != &m_headSubmix; node = node->next) {
+        const auto data = static_cast<MixerVoiceData*>(node);
+        // 低采样率: 按累计帧数取整, 不丢帧
+        const uint64_t scale = uint64_t(frames) * data->rate;
+        data->frames = uint32_t((pass + 1) * scale / m_uSampleRate - pass * scale / m_uSampleRate);
+        std::memset(data->mix, 0, sizeof(float) * data->frames * data->channels);
+    }
+    // 源音, 按输出的采样率渲染
+    for (auto node = m_headSource.next; node != &m_headSource; ) {
+        const auto voice = static_cast<CALMixerSourceVoice*>(static_cast<MixerVoiceData*>(node));
+        node = node->next;
+        voice->FireFlushed();
+        const auto count = voice->OutputFrames(frames);
+        if (voice->IsRunning() && count) voice->Render(count);
+    }
+    // 子混音, 已按阶段排序
+    for (auto node = m_headSubmix.next; node != &m_headSubmix; node = node->next) {
+        static_cast<CALMixerSubmixVoice*>(static_cast<MixerVoiceData*>(node))->Render();
+    }
+    // 主音, 效果链在音量前
+    master->RunEffects(frames);
+    const auto ch = master->channels;
+    float gain[MixerMaxChannels];
+    for (uint32_t c = 0; c != ch; ++c) gain[c] = master->volume * master->channel_volume[c];
+    for (uint32_t i = 0; i != frames * ch; ++i) output[i] = master->mix[i] * gain[i % ch];
+    for (uint32_t i = 0; i != m_cCallback; ++i) m_aCallback[i]->OnProcessingPassEnd();
+    // 统计
+    const auto cycles = uint32_t(mixer::get_time_ns() - begin);
+    m_cCycles += cycles;
+    m_cMinCycles = std::min(m_cMinCycles, cycles);
+    m_cMaxCycles = std::max(m_cMaxCycles, cycles);
+    // 渲染慢于实时: 输出设备可能断音
+    if (m_pOutput && uint64_t(cycles) * m_uSampleRate > uint64_t(frames) * 1000000000) ++m_cGlitches;
+    this->Unlock();
+}
+
+/// <summary>
+/// Pulls frames of master mix in offline mode.
+/// 离线模式读取
+/// </summary>
+/// <param name="data">The interleaved output.</param>
+/// <param name="frames">The frames.</param>
+/// <returns></returns>
+auto WrapAL::mixer::CALMixerEngine::Pull(float* data, uint32_t frames) noexcept -> HRESULT {
+    if (m_pOutput || !m_pMaster) return XAUDIO2_E_INVALID_CALL;
+    const auto ch = m_pMaster->channels;
+    while (frames) {
+        // 渲染下一个周期
+        if (!m_cPending) {
+            this->Render(m_pOutBuffer);
+            m_cPending = m_cQuantum;
+        }
+        const auto count = std::min(frames, m_cPending);
+        const auto src = m_pOutBuffer + (m_cQuantum - m_cPending) * ch;
+        std::memcpy(data, src, sizeof(float) * count * ch);
+        data += count * ch;
+        frames -= count;
+        m_cPending -= count;
+    }
+    return S_OK;
+}
+
+/// <summary>
+/// The mixing thread.
+/// 混音线程
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerEngine::thread_proc() noexcept {
+    while (!m_bExit) {
+        // 引擎停止
+        if (!m_bRunning) {
+            std::unique_lock<std::recursive_mutex> locker(m_mutex);
+            m_cv.wait(locker, [this]() noexcept { return m_bRunning || m_bExit; });
+            continue;
+        }
+        this->Render(m_pOutBuffer);
+        // 写入设备
+        const auto hr = m_pOutput->Write(m_pOutBuffer, m_cQuantum);
+        if (FAILED(hr)) {
+            this->Lock();
+            for (uint32_t i = 0; i != m_cCallback; ++i) m_aCallback[i]->OnCriticalError(hr);
+            m_bRunning = false;
+            this->Unlock();
+        }
+    }
+}
+
+/// <summary>
+/// Stops the mixing thread.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALMixerEngine::stop_thread() noexcept {
+    this->Lock();
+    m_bExit = true;
+    this->Unlock();
+    m_cv.notify_all();
+    if (m_thread.joinable()) m_thread.join();
+}
+
+// ----------------------------------------------------------------------------
+// ---------------------------------- Output ----------------------------------
+// ----------------------------------------------------------------------------
+
+// mixer namespace
+namespace WrapAL { namespace mixer {
+    // winmm.dll
+    struct WinMM {
+        // dll
+        HMODULE                                 dll = nullptr;
+        // waveOutGetNumDevs
+        decltype(&::waveOutGetNumDevs)          waveOutGetNumDevs = nullptr;
+        // waveOutGetDevCapsW
+        decltype(&::waveOutGetDevCapsW)         waveOutGetDevCapsW = nullptr;
+        // waveOutOpen
+        decltype(&::waveOutOpen)                waveOutOpen = nullptr;
+        // waveOutPrepareHeader
+        decltype(&::waveOutPrepareHeader)       waveOutPrepareHeader = nullptr;
+        // waveOutUnprepareHeader
+        decltype(&::waveOutUnprepareHeader)     waveOutUnprepareHeader = nullptr;
+        // waveOutWrite
+        decltype(&::waveOutWrite)               waveOutWrite = nullptr;
+        // waveOutReset
+        decltype(&::waveOutReset)               waveOutReset = nullptr;
+        // waveOutClose
+        decltype(&::waveOutClose)               waveOutClose = nullptr;
+        // load
+        bool Load() noexcept {
+            if (!dll && !(dll = ::LoadLibraryW(L"winmm.dll"))) return false;
+            mixer::load_func(waveOutGetNumDevs, dll, "waveOutGetNumDevs");
+            mixer::load_func(waveOutGetDevCapsW, dll, "waveOutGetDevCapsW");
+            mixer::load_func(waveOutOpen, dll, "waveOutOpen");
+            mixer::load_func(waveOutPrepareHeader, dll, "waveOutPrepareHeader");
+            mixer::load_func(waveOutUnprepareHeader, dll, "waveOutUnprepareHeader");
+            mixer::load_func(waveOutWrite, dll, "waveOutWrite");
+            mixer::load_func(waveOutReset, dll, "waveOutReset");
+            mixer::load_func(waveOutClose, dll, "waveOutClose");
+            return waveOutGetNumDevs && waveOutGetDevCapsW && waveOutOpen && waveOutPrepareHeader
+                && waveOutUnprepareHeader && waveOutWrite && waveOutReset && waveOutClose;
+        }
+        // free
+        void Free() noexcept { if (dll) ::FreeLibrary(dll); dll = nullptr; }
+    };
+    // waveOut output
+    class CALWaveOutput final : public IALMixerOutput {
+    public:
+        // add ref-count
+        auto AddRef() noexcept ->uint32_t override { return ++m_cRefCount; }
+        // release
+        auto Release() noexcept ->uint32_t override {
+            const auto count = --m_cRefCount;
+            if (!count) { this->~CALWaveOutput(); std::free(this); }
+            return count;
+        }
+        // open
+        auto Open(const wchar_t* id, uint32_t& channels, uint32_t& rate, uint32_t period, uint32_t& latency) noexcept ->ECode override;
+        // write
+        auto Write(const float* data, uint32_t frames) noexcept ->ECode override;
+        // close
+        void Close() noexcept override;
+        // dtor
+        ~CALWaveOutput() noexcept { this->Close(); m_winmm.Free(); }
+    private:
+        // winmm
+        WinMM                   m_winmm;
+        // device
+        HWAVEOUT                m_hWaveOut = nullptr;
+        // event for buffer done
+        HANDLE                  m_hEvent = nullptr;
+        // buffer data
+        float*                  m_pBuffer = nullptr;
+        // size of each buffer in byte
+        uint32_t                m_cbBuffer = 0;
+        // size of frame in byte
+        uint32_t                m_cbFrame = 0;
+        // index of next buffer
+        uint32_t                m_uIndex = 0;
+        // headers
+        WAVEHDR                 m_aHeader[MixerOutputBufferCount];
+        // queued to device
+        bool                    m_aQueued[MixerOutputBufferCount];
+        // ref-count
+        std::atomic<uint32_t>   m_cRefCount{ 1 };
+    };
+}}
+
+/// <summary>
+/// Opens the waveOut device.
+/// 打开 waveOut 设备
+/// </summary>
+/// <param name="id">The device index string, null for WAVE_MAPPER.</param>
+/// <param name="channels">The channels.</param>
+/// <param name="rate">The sample rate.</param>
+/// <param name="period">The period in frame.</param>
+/// <param name="latency">The latency in frame, fixed buffer count for waveOut.</param>
+/// <returns></returns>
+auto WrapAL::mixer::CALWaveOutput::Open(const wchar_t* id, uint32_t& channels, uint32_t& rate, uint32_t period, uint32_t& latency) noexcept -> ECode {
+    if (!m_winmm.Load()) return E_FAIL;
+    const UINT device = id ? UINT(std::wcstoul(id, nullptr, 10)) : WAVE_MAPPER;
+    if (!(m_hEvent = ::CreateEventW(nullptr, FALSE, FALSE, nullptr))) return E_FAIL;
+    // WAVEFORMATEX 只支持双声道以内
+    if (channels > 2) channels = 2;
+    ::WAVEFORMATEX format;
+    format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+    format.nChannels = WORD(channels);
+    format.nSamplesPerSec = rate;
+    format.wBitsPerSample = 32;
+    format.nBlockAlign = WORD(channels * sizeof(float));
+    format.nAvgBytesPerSec = rate * format.nBlockAlign;
+    format.cbSize = 0;
+    auto code = m_winmm.waveOutOpen(&m_hWaveOut, device, &format,
+        reinterpret_cast<DWORD_PTR>(m_hEvent), 0, CALLBACK_EVENT);
+    if (code != MMSYSERR_NOERROR) { m_hWaveOut = nullptr; this->Close(); return E_FAIL; }
+    // 申请缓冲区
+    m_cbFrame = format.nBlockAlign;
+    m_cbBuffer = period * m_cbFrame;
+    m_pBuffer = reinterpret_cast<float*>(std::malloc(m_cbBuffer * MixerOutputBufferCount));
+    if (!m_pBuffer) { this->Close(); return E_OUTOFMEMORY; }
+    std::memset(m_pBuffer, 0, m_cbBuffer * MixerOutputBufferCount);
+    for (uint32_t i = 0; i != MixerOutputBufferCount; ++i) {
+        auto& header = m_aHeader[i];
+        std::memset(&header, 0, sizeof(header));
+        header.lpData = reinterpret_cast<LPSTR>(m_pBuffer) + m_cbBuffer * i;
+        header.dwBufferLength = m_cbBuffer;
+        m_winmm.waveOutPrepareHeader(m_hWaveOut, &header, sizeof(header));
+        m_aQueued[i] = false;
+    }
+    m_uIndex = 0;
+    latency = period * MixerOutputBufferCount;
+    return S_OK;
+}
+
+/// <summary>
+/// Writes the frames, wait for the free buffer.
+/// 写入数据
+/// </summary>
+/// <param name="data">The data.</param>
+/// <param name="frames">The frames.</param>
+/// <returns></returns>
+auto WrapAL::mixer::CALWaveOutput::Write(const float* data, uint32_t frames) noexcept -> ECode {
+    auto& header = m_aHeader[m_uIndex];
+    // 等待播放完毕
+    while (m_aQueued[m_uIndex] && !(header.dwFlags & WHDR_DONE)) {
+        ::WaitForSingleObject(m_hEvent, INFINITE);
+    }
+    const auto bytes = std::min(m_cbBuffer, frames * m_cbFrame);
+    std::memcpy(header.lpData, data, bytes);
+    header.dwBufferLength = bytes;
+    m_aQueued[m_uIndex] = true;
+    const auto code = m_winmm.waveOutWrite(m_hWaveOut, &header, sizeof(header));
+    m_uIndex = (m_uIndex + 1) % MixerOutputBufferCount;
+    return code == MMSYSERR_NOERROR ? S_OK : XAUDIO2_E_DEVICE_INVALIDATED;
+}
+
+/// <summary>
+/// Closes the device.
+/// </summary>
+/// <returns></returns>
+void WrapAL::mixer::CALWaveOutput::Close() noexcept {
+    if (m_hWaveOut) {
+        m_winmm.waveOutReset(m_hWaveOut);
+        for (auto& header : m_aHeader) {
+            m_winmm.waveOutUnprepareHeader(m_hWaveOut, &header, sizeof(header));
+        }
+        m_winmm.waveOutClose(m_hWaveOut);
+        m_hWaveOut = nullptr;
+    }
+    if (m_hEvent) {
+        ::CloseHandle(m_hEvent);
+        m_hEvent = nullptr;
+    }
+    std::free(m_pBuffer);
+    m_pBuffer = nullptr;
+}
+
+/// <summary>
+/// Creates the default output, waveOut.
+/// 创建默认输出
+/// </summary>
+/// <returns></returns>
+auto WrapAL::mixer::CreateDefaultOutput() noexcept -> IALMixerOutput* {
+    return mixer::create_object<CALWaveOutput>();
+}
+
+/// <summary>
+/// Enums the devices of default output.
+/// 枚举默认输出设备
+/// </summary>
+/// <param name="devices">The devices.</param>
+/// <returns></returns>
+void WrapAL::mixer::EnumOutputDevices(MixerDeviceList& devices) noexcept {
+    devices.count = 0;
+    WinMM winmm;
+    if (winmm.Load()) {
+        const auto count = std::min(uint32_t(winmm.waveOutGetNumDevs()), uint32_t(DeviceMaxCount));
+        for (uint32_t i = 0; i != count; ++i) {
+            WAVEOUTCAPSW caps;
+            if (winmm.waveOutGetDevCapsW(i, &caps, sizeof(caps)) != MMSYSERR_NOERROR) continue;
+            const auto index = devices.count++;
+            std::wcsncpy(devices.name[index], caps.szPname, 31);
+            devices.name[index][31] = 0;
+            std::swprintf(devices.id[index], 8, L"%u", i);
+            devices.list[index].name = devices.name[index];
+            devices.list[index].id = devices.id[index];
+        }
+    }
+    winmm.Free();
+}
@@ -0,0 +1,532 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL software mixer, implements the XAudio2 interface that
+CALAudioSourceClipImpl and AudioSourceGroupImpl are written against,
+so the clip/group code does not know which backend is running.
+
+mixing is done in float, one quantum(AudioLatency::period, default
+1/MixerQuantumPerSecond sec.) each pass, on the mixer thread:
+    source voice -> [submix voice by stage] -> mastering voice -> output
+
+a submix may run at a lower rate than the engine: voices sending to it
+are resampled to its rate, and it is resampled to the rate of its
+output voices after mixing, like XAudio2.
+
+effect chain(XAPO, in-place only) of submix/mastering voice runs on
+the mix buffer at its input rate, before volume and sends.
+
+Windows only like the rest of WrapAL: the voices are the XAudio2 COM
+interfaces(HRESULT, GUID, Win32 types), and the engine/clip code that
+drives them includes Windows headers too.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for atomic
+#include <atomic>
+// for memset
+#include <cstring>
+// for thread
+#include <thread>
+// for recursive_mutex
+#include <mutex>
+// for condition_variable_any
+#include <condition_variable>
+// include the config
+#include "wrapalconf.h"
+// include the config
+#include "wrapal_common.h"
+// util
+#include "AudioUtil.h"
+// XAudio2 interface
+#include "p_XAudio2_8.h"
+// XAPO interface
+#include "p_XAPO.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // software mixer
+    namespace mixer {
+        // interface to implement
+        using namespace xaudio2_8;
+        // mixer engine
+        class CALMixerEngine;
+        // output device of mixer
+        struct WRAPAL_NOVTABLE IALMixerOutput : IALInterface {
+            // open the device, channels/rate/latency(in frame) may be adjusted by device
+            virtual auto Open(const wchar_t* id, uint32_t& channels, uint32_t& rate,
+                uint32_t period, uint32_t& latency) noexcept ->ECode = 0;
+            // write interleaved float frames, block until device could take more
+            virtual auto Write(const float* data, uint32_t frames) noexcept ->ECode = 0;
+            // close the device
+            virtual void Close() noexcept = 0;
+        };
+        // device list of mixer output
+        struct MixerDeviceList {
+            // list for IALConfigure::ChooseDevice
+            AudioDeviceInfo     list[DeviceMaxCount];
+            // name buffer
+            wchar_t             name[DeviceMaxCount][32];
+            // id buffer
+            wchar_t             id[DeviceMaxCount][8];
+            // count of device
+            uint32_t            count;
+        };
+        // create default output device, waveOut
+        auto CreateDefaultOutput() noexcept ->IALMixerOutput*;
+        // enum devices of default output
+        void EnumOutputDevices(MixerDeviceList& devices) noexcept;
+        // node for voice list
+        struct MixerNode {
+            // prev/next node
+            MixerNode*  prev, *next;
+        };
+        // kind of voice
+        enum class VoiceKind : uint8_t {
+            // IXAudio2SourceVoice
+            Kind_Source = 0,
+            // IXAudio2SubmixVoice
+            Kind_Submix,
+            // IXAudio2MasteringVoice
+            Kind_Master,
+        };
+        // voice data
+        struct MixerVoiceData;
+        // output send of voice
+        struct MixerSend {
+            // target voice
+            MixerVoiceData*     target;
+            // level matrix, [dst * source channels + src]
+            float               level[MixerMaxChannels * MixerMaxChannels];
+        };
+        // common data for all kinds of voice
+        struct MixerVoiceData : MixerNode {
+            // engine
+            CALMixerEngine*     engine = nullptr;
+            // interface of this voice
+            IXAudio2Voice*      voice = nullptr;
+            // mix buffer, quantum * channels
+            float*              mix = nullptr;
+            // kind of voice
+            VoiceKind           kind = VoiceKind::Kind_Source;
+            // input channels
+            uint32_t            channels = 0;
+            // input sample rate
+            uint32_t            rate = 0;
+            // processing stage for submix
+            uint32_t            stage = 0;
+            // frames of current pass at input rate, submix/master
+            uint32_t            frames = 0;
+            // flags while creating
+            uint32_t            flags = 0;
+            // count of sends
+            uint32_t            send_count = 0;
+            // volume
+            float               volume = 1.f;
+            // volume for each channel
+            float               channel_volume[MixerMaxChannels];
+            // count of effects
+            uint32_t            effect_count = 0;
+            // effect chain, in-place, locked for process
+            xapo::IXAPO*        effects[EffectChainMaxLength];
+            // effect enabled
+            bool                effect_enabled[EffectChainMaxLength];
+            // filter, XAUDIO2_VOICE_USEFILTER only
+            XAUDIO2_FILTER_PARAMETERS filter = { LowPassFilter, XAUDIO2_DEFAULT_FILTER_FREQUENCY, 1.f };
+            // state of filter each channel: low, band
+            float               filter_state[MixerMaxChannels][2];
+            // output sends
+            MixerSend           sends[MixerMaxSends];
+        public:
+            // set default level matrix for send
+            void DefaultMatrix(MixerSend& send) const noexcept;
+            // mix "data" to all sends with volume
+            void MixToSends(const float* data, uint32_t frames) const noexcept;
+            // input rate of output voices, all sends share the same rate
+            auto OutputRate() const noexcept ->uint32_t;
+            // frames of current pass at output rate
+            auto OutputFrames(uint32_t quantum) const noexcept { return send_count ? sends[0].target->frames : quantum; }
+            // run effect chain on "mix" in-place
+            void RunEffects(uint32_t frames) noexcept;
+            // unlock and release effect chain
+            void ReleaseEffects() noexcept;
+            // run filter on "data" in-place, state variable filter like XAudio2
+            void RunFilter(float* data, uint32_t frames) noexcept;
+        };
+        // common impl of IXAudio2Voice
+        struct MixerVoiceImpl {
+            // GetVoiceDetails
+            static void GetVoiceDetails(MixerVoiceData&, XAUDIO2_VOICE_DETAILS*) noexcept;
+            // SetOutputVoices
+            static auto SetOutputVoices(MixerVoiceData&, const XAUDIO2_VOICE_SENDS*) noexcept ->HRESULT;
+            // SetVolume
+            static auto SetVolume(MixerVoiceData&, float) noexcept ->HRESULT;
+            // GetVolume
+            static void GetVolume(MixerVoiceData&, float*) noexcept;
+            // SetChannelVolumes
+            static auto SetChannelVolumes(MixerVoiceData&, UINT32, const float*) noexcept ->HRESULT;
+            // GetChannelVolumes
+            static void GetChannelVolumes(MixerVoiceData&, UINT32, float*) noexcept;
+            // SetOutputMatrix
+            static auto SetOutputMatrix(MixerVoiceData&, IXAudio2Voice*, UINT32, UINT32, const float*) noexcept ->HRESULT;
+            // GetOutputMatrix
+            static void GetOutputMatrix(MixerVoiceData&, IXAudio2Voice*, UINT32, UINT32, float*) noexcept;
+            // SetEffectChain
+            static auto SetEffectChain(MixerVoiceData&, const XAUDIO2_EFFECT_CHAIN*) noexcept ->HRESULT;
+            // EnableEffect/DisableEffect
+            static auto EnableEffect(MixerVoiceData&, UINT32, bool) noexcept ->HRESULT;
+            // GetEffectState
+            static void GetEffectState(MixerVoiceData&, UINT32, BOOL*) noexcept;
+            // SetEffectParameters/GetEffectParameters
+            static auto EffectParameters(MixerVoiceData&, UINT32, void*, UINT32, bool set) noexcept ->HRESULT;
+            // SetFilterParameters
+            static auto SetFilterParameters(MixerVoiceData&, const XAUDIO2_FILTER_PARAMETERS*) noexcept ->HRESULT;
+            // GetFilterParameters
+            static void GetFilterParameters(MixerVoiceData&, XAUDIO2_FILTER_PARAMETERS*) noexcept;
+        };
+        // IXAudio2Voice for mixer
+        template<class Interface> class CALMixerVoice : public Interface, public MixerVoiceData {
+        public: // IXAudio2Voice
+            // GetVoiceDetails
+            void STDMETHODCALLTYPE GetVoiceDetails(XAUDIO2_VOICE_DETAILS* d) noexcept override { MixerVoiceImpl::GetVoiceDetails(*this, d); }
+            // SetOutputVoices
+            HRESULT STDMETHODCALLTYPE SetOutputVoices(const XAUDIO2_VOICE_SENDS* s) noexcept override { return MixerVoiceImpl::SetOutputVoices(*this, s); }
+            // SetEffectChain
+            HRESULT STDMETHODCALLTYPE SetEffectChain(const XAUDIO2_EFFECT_CHAIN* c) noexcept override { return MixerVoiceImpl::SetEffectChain(*this, c); }
+            // EnableEffect
+            HRESULT STDMETHODCALLTYPE EnableEffect(UINT32 i, UINT32) noexcept override { return MixerVoiceImpl::EnableEffect(*this, i, true); }
+            // DisableEffect
+            HRESULT STDMETHODCALLTYPE DisableEffect(UINT32 i, UINT32) noexcept override { return MixerVoiceImpl::EnableEffect(*this, i, false); }
+            // GetEffectState
+            void STDMETHODCALLTYPE GetEffectState(UINT32 i, BOOL* e) noexcept override { MixerVoiceImpl::GetEffectState(*this, i, e); }
+            // SetEffectParameters
+            HRESULT STDMETHODCALLTYPE SetEffectParameters(UINT32 i, const void* p, UINT32 s, UINT32) noexcept override {
+                return MixerVoiceImpl::EffectParameters(*this, i, const_cast<void*>(p), s, true);
+            }
+            // GetEffectParameters
+            HRESULT STDMETHODCALLTYPE GetEffectParameters(UINT32 i, void* p, UINT32 s) noexcept override {
+                return MixerVoiceImpl::EffectParameters(*this, i, p, s, false);
+            }
+            // SetFilterParameters
+            HRESULT STDMETHODCALLTYPE SetFilterParameters(const XAUDIO2_FILTER_PARAMETERS* p, UINT32) noexcept override { return MixerVoiceImpl::SetFilterParameters(*this, p); }
+            // GetFilterParameters
+            void STDMETHODCALLTYPE GetFilterParameters(XAUDIO2_FILTER_PARAMETERS* p) noexcept override { MixerVoiceImpl::GetFilterParameters(*this, p); }
+            // SetOutputFilterParameters
+            HRESULT STDMETHODCALLTYPE SetOutputFilterParameters(IXAudio2Voice*, const XAUDIO2_FILTER_PARAMETERS*, UINT32) noexcept override { return E_NOTIMPL; }
+            // GetOutputFilterParameters
+            void STDMETHODCALLTYPE GetOutputFilterParameters(IXAudio2Voice*, XAUDIO2_FILTER_PARAMETERS*) noexcept override { }
+            // SetVolume
+            HRESULT STDMETHODCALLTYPE SetVolume(float v, UINT32) noexcept override { return MixerVoiceImpl::SetVolume(*this, v); }
+            // GetVolume
+            void STDMETHODCALLTYPE GetVolume(float* v) noexcept override { MixerVoiceImpl::GetVolume(*this, v); }
+            // SetChannelVolumes
+            HRESULT STDMETHODCALLTYPE SetChannelVolumes(UINT32 c, const float* v, UINT32) noexcept override { return MixerVoiceImpl::SetChannelVolumes(*this, c, v); }
+            // GetChannelVolumes
+            void STDMETHODCALLTYPE GetChannelVolumes(UINT32 c, float* v) noexcept override { MixerVoiceImpl::GetChannelVolumes(*this, c, v); }
+            // SetOutputMatrix
+            HRESULT STDMETHODCALLTYPE SetOutputMatrix(IXAudio2Voice* d, UINT32 s, UINT32 c, const float* m, UINT32) noexcept override {
+                return MixerVoiceImpl::SetOutputMatrix(*this, d, s, c, m);
+            }
+            // GetOutputMatrix
+            void STDMETHODCALLTYPE GetOutputMatrix(IXAudio2Voice* d, UINT32 s, UINT32 c, float* m) noexcept override {
+                MixerVoiceImpl::GetOutputMatrix(*this, d, s, c, m);
+            }
+        public:
+            // ctor
+            CALMixerVoice(CALMixerEngine* eng, VoiceKind k) noexcept {
+                this->engine = eng; this->kind = k; this->voice = this;
+                for (auto& v : this->channel_volume) v = 1.f;
+                std::memset(this->filter_state, 0, sizeof(this->filter_state));
+            }
+        };
+        // queued buffer of source voice
+        struct MixerBuffer {
+            // XAudio2 buffer
+            XAUDIO2_BUFFER          buffer;
+            // play region in frame [begin, end)
+            uint32_t                begin, end;
+            // loop region in frame [loop_begin, loop_end)
+            uint32_t                loop_begin, loop_end;
+            // cursor in frame
+            uint32_t                cursor;
+            // loop count done
+            uint32_t                loop_done;
+            // OnBufferStart called
+            bool                    started;
+        };
+        // IXAudio2SourceVoice for mixer
+        class CALMixerSourceVoice final : public CALMixerVoice<IXAudio2SourceVoice> {
+            // super class
+            using Super = CALMixerVoice<IXAudio2SourceVoice>;
+        public: // IXAudio2SourceVoice
+            // Start
+            HRESULT STDMETHODCALLTYPE Start(UINT32 Flags, UINT32 OperationSet) noexcept override;
+            // Stop
+            HRESULT STDMETHODCALLTYPE Stop(UINT32 Flags, UINT32 OperationSet) noexcept override;
+            // SubmitSourceBuffer
+            HRESULT STDMETHODCALLTYPE SubmitSourceBuffer(const XAUDIO2_BUFFER* pBuffer, const XAUDIO2_BUFFER_WMA*) noexcept override;
+            // FlushSourceBuffers
+            HRESULT STDMETHODCALLTYPE FlushSourceBuffers() noexcept override;
+            // Discontinuity
+            HRESULT STDMETHODCALLTYPE Discontinuity() noexcept override { return S_OK; }
+            // ExitLoop
+            HRESULT STDMETHODCALLTYPE ExitLoop(UINT32 OperationSet) noexcept override;
+            // GetState
+            void STDMETHODCALLTYPE GetState(XAUDIO2_VOICE_STATE* pVoiceState, UINT32 Flags) noexcept override;
+            // SetFrequencyRatio
+            HRESULT STDMETHODCALLTYPE SetFrequencyRatio(float Ratio, UINT32 OperationSet) noexcept override;
+            // GetFrequencyRatio
+            void STDMETHODCALLTYPE GetFrequencyRatio(float* pRatio) noexcept override;
+            // SetSourceSampleRate
+            HRESULT STDMETHODCALLTYPE SetSourceSampleRate(UINT32 NewSourceSampleRate) noexcept override;
+            // DestroyVoice
+            void STDMETHODCALLTYPE DestroyVoice() noexcept override;
+        public:
+            // ctor
+            CALMixerSourceVoice(CALMixerEngine* eng, const WAVEFORMATEX& wave,
+                uint32_t flags, float max_ratio, IXAudio2VoiceCallback* cb) noexcept;
+            // dtor
+            ~CALMixerSourceVoice() noexcept;
+            // init scratch buffer
+            auto Init() noexcept ->HRESULT;
+            // is running
+            bool IsRunning() const noexcept { return m_bRunning; }
+            // render one quantum to sends
+            void Render(uint32_t frames) noexcept;
+            // fire callbacks of flushed buffers
+            void FireFlushed() noexcept;
+        private:
+            // source step of one output frame
+            auto get_step() const noexcept -> double;
+            // frames in queue can be read
+            auto queued_frames() const noexcept ->uint32_t;
+            // pull frames from queue, return count pulled
+            auto pull(float* data, uint32_t frames) noexcept ->uint32_t;
+            // convert frames to float
+            void convert(const uint8_t* src, float* dst, uint32_t frames) const noexcept;
+            // reset resampler
+            void reset_resampler() noexcept;
+        private:
+            // callback
+            IXAudio2VoiceCallback*  m_pCallback;
+            // resampler scratch: history frame + pending frames
+            float*                  m_pScratch = nullptr;
+            // capacity of scratch in frame
+            uint32_t                m_cScratch = 0;
+            // ready frames in scratch
+            uint32_t                m_cReady = 0;
+            // position in scratch
+            double                  m_dPosition = 0.0;
+            // samples played
+            UINT64                  m_cSamplesPlayed = 0;
+            // frequency ratio
+            float                   m_fRatio = 1.f;
+            // max frequency ratio
+            float                   m_fMaxRatio;
+            // head of queue
+            uint32_t                m_uHead = 0;
+            // count of queue
+            uint32_t                m_cQueued = 0;
+            // count of flushed
+            uint32_t                m_cFlushed = 0;
+            // running
+            bool                    m_bRunning = false;
+        public:
+            // wave format
+            WAVEFORMATEX            wave;
+        private:
+            // buffer queue
+            MixerBuffer             m_aQueue[XAUDIO2_MAX_QUEUED_BUFFERS];
+            // flushed buffer context
+            void*                   m_aFlushed[XAUDIO2_MAX_QUEUED_BUFFERS];
+        };
+        // IXAudio2SubmixVoice for mixer
+        class CALMixerSubmixVoice final : public CALMixerVoice<IXAudio2SubmixVoice> {
+            // super class
+            using Super = CALMixerVoice<IXAudio2SubmixVoice>;
+        public: // IXAudio2SubmixVoice
+            // DestroyVoice
+            void STDMETHODCALLTYPE DestroyVoice() noexcept override;
+        public:
+            // ctor
+            CALMixerSubmixVoice(CALMixerEngine* eng) noexcept : Super(eng, VoiceKind::Kind_Submix) {}
+            // dtor
+            ~CALMixerSubmixVoice() noexcept;
+            // init buffers
+            auto Init() noexcept ->HRESULT;
+            // mix this pass to sends, resampled if rate of output differs
+            void Render() noexcept;
+        private:
+            // resampler scratch: history frame + frames of this pass
+            float*                  m_pScratch = nullptr;
+            // position in scratch
+            double                  m_dPosition = 0.0;
+        };
+        // IXAudio2MasteringVoice for mixer
+        class CALMixerMasteringVoice final : public CALMixerVoice<IXAudio2MasteringVoice> {
+            // super class
+            using Super = CALMixerVoice<IXAudio2MasteringVoice>;
+        public: // IXAudio2MasteringVoice
+            // GetChannelMask
+            HRESULT STDMETHODCALLTYPE GetChannelMask(DWORD* pChannelmask) noexcept override;
+            // DestroyVoice
+            void STDMETHODCALLTYPE DestroyVoice() noexcept override;
+        public:
+            // ctor
+            CALMixerMasteringVoice(CALMixerEngine* eng) noexcept : Super(eng, VoiceKind::Kind_Master) {}
+            // dtor
+            ~CALMixerMasteringVoice() noexcept { this->ReleaseEffects(); std::free(this->mix); this->mix = nullptr; }
+        };
+        // IXAudio2 for mixer
+        class CALMixerEngine final : public IXAudio2 {
+        public: // IUnknown
+            // QueryInterface
+            HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppv) noexcept override { if (ppv) *ppv = nullptr; return E_NOINTERFACE; }
+            // AddRef
+            ULONG STDMETHODCALLTYPE AddRef() noexcept override { return ++m_cRefCount; }
+            // Release
+            ULONG STDMETHODCALLTYPE Release() noexcept override;
+        public: // IXAudio2
+            // RegisterForCallbacks
+            HRESULT STDMETHODCALLTYPE RegisterForCallbacks(IXAudio2EngineCallback* pCallback) noexcept override;
+            // UnregisterForCallbacks
+            void STDMETHODCALLTYPE UnregisterForCallbacks(IXAudio2EngineCallback* pCallback) noexcept override;
+            // CreateSourceVoice
+            HRESULT STDMETHODCALLTYPE CreateSourceVoice(IXAudio2SourceVoice** ppSourceVoice,
+                const WAVEFORMATEX* pSourceFormat, UINT32 Flags, float MaxFrequencyRatio,
+                IXAudio2VoiceCallback* pCallback, const XAUDIO2_VOICE_SENDS* pSendList,
+                const XAUDIO2_EFFECT_CHAIN* pEffectChain) noexcept override;
+            // CreateSubmixVoice
+            HRESULT STDMETHODCALLTYPE CreateSubmixVoice(IXAudio2SubmixVoice** ppSubmixVoice,
+                UINT32 InputChannels, UINT32 InputSampleRate, UINT32 Flags, UINT32 ProcessingStage,
+                const XAUDIO2_VOICE_SENDS* pSendList, const XAUDIO2_EFFECT_CHAIN* pEffectChain) noexcept override;
+            // CreateMasteringVoice
+            HRESULT STDMETHODCALLTYPE CreateMasteringVoice(IXAudio2MasteringVoice** ppMasteringVoice,
+                UINT32 InputChannels, UINT32 InputSampleRate, UINT32 Flags, LPCWSTR szDeviceId,
+                const XAUDIO2_EFFECT_CHAIN* pEffectChain, AUDIO_STREAM_CATEGORY StreamCategory) noexcept override;
+            // StartEngine
+            HRESULT STDMETHODCALLTYPE StartEngine() noexcept override;
+            // StopEngine
+            void STDMETHODCALLTYPE StopEngine() noexcept override;
+            // CommitChanges
+            HRESULT STDMETHODCALLTYPE CommitChanges(UINT32) noexcept override { return S_OK; }
+            // GetPerformanceData
+            void STDMETHODCALLTYPE GetPerformanceData(XAUDIO2_PERFORMANCE_DATA* pPerfData) noexcept override;
+            // SetDebugConfiguration
+            void STDMETHODCALLTYPE SetDebugConfiguration(const XAUDIO2_DEBUG_CONFIGURATION*, void*) noexcept override { }
+        public:
+            // create mixer engine with output(released by engine), null for offline mode
+            static auto Create(IXAudio2** engine, IALMixerOutput* output, const AudioLatency& latency) noexcept ->HRESULT;
+            // pull frames of master mix in offline mode
+            auto Pull(float* data, uint32_t frames) noexcept ->HRESULT;
+            // lock the engine
+            void Lock() noexcept { m_mutex.lock(); }
+            // unlock the engine
+            void Unlock() noexcept { m_mutex.unlock(); }
+            // get quantum in frame
+            auto GetQuantum() const noexcept { return m_cQuantum; }
+            // get sample rate of mastering voice
+            auto GetSampleRate() const noexcept { return m_uSampleRate; }
+            // get mastering voice
+            auto GetMaster() const noexcept { return m_pMaster; }
+            // find voice data by interface
+            auto FindVoice(IXAudio2Voice* voice) noexcept ->MixerVoiceData*;
+            // unlink voice
+            void Unlink(MixerVoiceData& voice) noexcept;
+            // destroy mastering voice
+            void DestroyMaster() noexcept;
+            // render one quantum to "output"
+            void Render(float* output) noexcept;
+        private:
+            // ctor
+            CALMixerEngine(IALMixerOutput* output, const AudioLatency& latency) noexcept;
+            // dtor
+            ~CALMixerEngine() noexcept;
+            // link voice to list
+            void link(MixerNode& head, MixerVoiceData& voice) noexcept;
+            // thread for mixing
+            void thread_proc() noexcept;
+            // stop mixing thread
+            void stop_thread() noexcept;
+        private:
+            // lock for voices
+            std::recursive_mutex        m_mutex;
+            // condition for running
+            std::condition_variable_any m_cv;
+            // mixing thread
+            std::thread                 m_thread;
+            // output device, null for offline mode
+            IALMixerOutput*             m_pOutput;
+            // mastering voice
+            CALMixerMasteringVoice*     m_pMaster = nullptr;
+            // output buffer, quantum * channels
+            float*                      m_pOutBuffer = nullptr;
+            // engine callbacks
+            IXAudio2EngineCallback*     m_aCallback[4];
+            // count of callbacks
+            uint32_t                    m_cCallback = 0;
+            // latency asked by configure
+            AudioLatency                m_latency;
+            // quantum in frame
+            uint32_t                    m_cQuantum = 0;
+            // latency of output in frame
+            uint32_t                    m_cLatency = 0;
+            // frames left in output buffer for offline mode
+            uint32_t                    m_cPending = 0;
+            // sample rate of mastering voice
+            uint32_t                    m_uSampleRate = 0;
+            // count of pass rendered
+            uint64_t                    m_cPass = 0;
+            // count of source voice
+            uint32_t                    m_cSource = 0;
+            // count of submix voice
+            uint32_t                    m_cSubmix = 0;
+            // ref-count
+            std::atomic<uint32_t>       m_cRefCount;
+            // engine started
+            std::atomic_bool            m_bRunning;
+            // exit thread
+            std::atomic_bool            m_bExit;
+            // time of last query in ns
+            uint64_t                    m_uLastQuery = 0;
+            // time in mixing since last query in ns
+            uint64_t                    m_cCycles = 0;
+            // min time of quantum since last query in ns
+            uint32_t                    m_cMinCycles = ~uint32_t(0);
+            // max time of quantum since last query in ns
+            uint32_t                    m_cMaxCycles = 0;
+            // count of quantum rendered slower than real time, output mode only
+            uint32_t                    m_cGlitches = 0;
+            // head of source voices
+            MixerNode                   m_headSource;
+            // head of submix voices, sorted by stage
+            MixerNode                   m_headSubmix;
+        };
+    }
+}
@@ -0,0 +1,1113 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "AudioOpenAL.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <chrono>
+#include <new>
+
+// OpenAL namespace
+namespace WrapAL { namespace openal {
+    // load function
+    template<typename T> static inline auto load_func(T& pointer, HMODULE dll, const char* name) noexcept {
+        pointer = reinterpret_cast<T>(::GetProcAddress(dll, name));
+        return !!pointer;
+    }
+    // create object by malloc
+    template<typename T, typename... Args> static inline auto create_object(Args&&... args) noexcept {
+        const auto ptr = reinterpret_cast<T*>(std::malloc(sizeof(T)));
+        if (ptr) new(ptr) T(std::forward<Args>(args)...);
+        return ptr;
+    }
+    // destroy object created by create_object
+    template<typename T> static inline auto destroy_object(T* ptr) noexcept {
+        ptr->~T();
+        std::free(ptr);
+    }
+    // convert samples to 16bit pcm
+    static void to_pcm16(const uint8_t* src, int16_t* dst, uint32_t count, const WAVEFORMATEX& wave) noexcept {
+        // 浮点
+        if (wave.wFormatTag == Wave_IEEEFloat) {
+            const auto input = reinterpret_cast<const float*>(src);
+            for (uint32_t i = 0; i != count; ++i) {
+                const auto value = std::max(-1.f, std::min(input[i], 1.f));
+                dst[i] = int16_t(value * 32767.f);
+            }
+            return;
+        }
+        switch (wave.wBitsPerSample)
+        {
+        case 8:
+            for (uint32_t i = 0; i != count; ++i) dst[i] = int16_t((int(src[i]) - 128) << 8);
+            break;
+        case 16:
+            std::memcpy(dst, src, sizeof(int16_t) * count);
+            break;
+        case 24:
+            // 取高16位
+            for (uint32_t i = 0; i != count; ++i) dst[i] = int16_t(src[i * 3 + 1] | (src[i * 3 + 2] << 8));
+            break;
+        case 32:
+            for (uint32_t i = 0; i != count; ++i) dst[i] = reinterpret_cast<const int16_t*>(src)[i * 2 + 1];
+            break;
+        }
+    }
+}}
+
+// ----------------------------------------------------------------------------
+// --------------------------------- OpenAL DLL -------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Loads the OpenAL dll, OpenAL32.dll or OpenAL Soft's soft_oal.dll.
+/// 载入 OpenAL
+/// </summary>
+/// <param name="al">The api table.</param>
+/// <returns>false if not found</returns>
+bool WrapAL::openal::LoadOpenAL(OpenAL& al) noexcept {
+    std::memset(&al, 0, sizeof(al));
+    if (!(al.dll = ::LoadLibraryW(L"OpenAL32.dll")) && !(al.dll = ::LoadLibraryW(L"soft_oal.dll")))
+        return false;
+    const auto dll = al.dll;
+    // 全部函数都必须存在
+    const bool ok = openal::load_func(al.alcOpenDevice, dll, "alcOpenDevice")
+        & openal::load_func(al.alcCloseDevice, dll, "alcCloseDevice")
+        & openal::load_func(al.alcCreateContext, dll, "alcCreateContext")
+        & openal::load_func(al.alcDestroyContext, dll, "alcDestroyContext")
+        & openal::load_func(al.alcMakeContextCurrent, dll, "alcMakeContextCurrent")
+        & openal::load_func(al.alcGetString, dll, "alcGetString")
+        & openal::load_func(al.alcIsExtensionPresent, dll, "alcIsExtensionPresent")
+        & openal::load_func(al.alcGetIntegerv, dll, "alcGetIntegerv")
+        & openal::load_func(al.alIsExtensionPresent, dll, "alIsExtensionPresent")
+        & openal::load_func(al.alGetError, dll, "alGetError")
+        & openal::load_func(al.alListenerf, dll, "alListenerf")
+        & openal::load_func(al.alGenSources, dll, "alGenSources")
+        & openal::load_func(al.alDeleteSources, dll, "alDeleteSources")
+        & openal::load_func(al.alSourcef, dll, "alSourcef")
+        & openal::load_func(al.alSource3f, dll, "alSource3f")
+        & openal::load_func(al.alSourcei, dll, "alSourcei")
+        & openal::load_func(al.alGetSourcei, dll, "alGetSourcei")
+        & openal::load_func(al.alSourcePlay, dll, "alSourcePlay")
+        & openal::load_func(al.alSourcePause, dll, "alSourcePause")
+        & openal::load_func(al.alSourceStop, dll, "alSourceStop")
+        & openal::load_func(al.alSourceQueueBuffers, dll, "alSourceQueueBuffers")
+        & openal::load_func(al.alSourceUnqueueBuffers, dll, "alSourceUnqueueBuffers")
+        & openal::load_func(al.alGenBuffers, dll, "alGenBuffers")
+        & openal::load_func(al.alDeleteBuffers, dll, "alDeleteBuffers")
+        & openal::load_func(al.alBufferData, dll, "alBufferData");
+    if (!ok) openal::FreeOpenAL(al);
+    return ok;
+}
+
+/// <summary>
+/// Frees the OpenAL dll.
+/// </summary>
+/// <param name="al">The api table.</param>
+/// <returns></returns>
+void WrapAL::openal::FreeOpenAL(OpenAL& al) noexcept {
+    if (al.dll) ::FreeLibrary(al.dll);
+    std::memset(&al, 0, sizeof(al));
+}
+
+/// <summary>
+/// Enumerates the output devices of OpenAL.
+/// 枚举 OpenAL 设备
+/// </summary>
+/// <param name="al">The api table.</param>
+/// <param name="devices">The devices.</param>
+/// <returns></returns>
+void WrapAL::openal::EnumOutputDevices(const OpenAL& al, ALDeviceList& devices) noexcept {
+    devices.count = 0;
+    // 优先枚举全部设备
+    const bool all = !!al.alcIsExtensionPresent(nullptr, "ALC_ENUMERATE_ALL_EXT");
+    auto name = al.alcGetString(nullptr, all ? ALC_ALL_DEVICES_SPECIFIER : ALC_DEVICE_SPECIFIER);
+    if (!name) return;
+    // 以双零结尾的 UTF-8 列表
+    while (*name && devices.count < DeviceMaxCount) {
+        const auto index = devices.count;
+        const auto buffer = devices.name[index];
+        const int len = sizeof(devices.name[0]) / sizeof(devices.name[0][0]);
+        if (::MultiByteToWideChar(CP_UTF8, 0, name, -1, buffer, len) > 0) {
+            devices.list[index].name = buffer;
+            devices.list[index].id = buffer;
+            ++devices.count;
+        }
+        name += std::strlen(name) + 1;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// -------------------------------- Voice Common ------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Sets the output voices, only the first send used.
+/// 设置输出链
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="list">The send list, null for mastering voice.</param>
+/// <returns></returns>
+auto WrapAL::openal::ALVoiceImpl::SetOutputVoices(ALVoiceData& data, const XAUDIO2_VOICE_SENDS* list) noexcept -> HRESULT {
+    // 主音不能输出
+    if (data.kind == VoiceKind::Kind_Master) return XAUDIO2_E_INVALID_CALL;
+    const auto engine = data.engine;
+    HRESULT hr = S_OK;
+    engine->Lock();
+    ALVoiceData* target = nullptr;
+    // 默认输出到主音
+    if (!list) target = engine->GetMaster();
+    // 指定输出, 没有输出则静音
+    else if (list->SendCount) {
+        target = engine->FindVoice(list->pSends[0].pOutputVoice);
+        // 只能输出到更后的阶段
+        if (!target || (target->kind == VoiceKind::Kind_Submix &&
+            data.kind == VoiceKind::Kind_Submix && target->stage <= data.stage)) {
+            hr = XAUDIO2_E_INVALID_CALL;
+        }
+    }
+    if (SUCCEEDED(hr) && !list && !target) hr = XAUDIO2_E_INVALID_CALL;
+    // 提交
+    if (SUCCEEDED(hr)) {
+        data.target = target;
+        if (data.kind == VoiceKind::Kind_Source) static_cast<CALOpenALSourceVoice&>(data).UpdateGain();
+        else engine->UpdateGains();
+    }
+    engine->Unlock();
+    return hr;
+}
+
+/// <summary>
+/// Sets the volume, scaled into AL source gain.
+/// </summary>
+/// <param name="data">The voice data.</param>
+/// <param name="volume">The volume.</param>
+/// <returns></returns>
+auto WrapAL::openal::ALVoiceImpl::SetVolume(ALVoiceData& data, float volume) noexcept -> HRESULT {
+    if (!(volume >= -XAUDIO2_MAX_VOLUME_LEVEL && volume <= XAUDIO2_MAX_VOLUME_LEVEL)) return E_INVALIDARG;
+    const auto engine = data.engine;
+    engine->Lock();
+    data.volume = volume;
+    switch (data.kind)
+    {
+    case VoiceKind::Kind_Source:
+        static_cast<CALOpenALSourceVoice&>(data).UpdateGain();
+        break;
+    case VoiceKind::Kind_Submix:
+        // 子混音只是增益集合
+        engine->UpdateGains();
+        break;
+    case VoiceKind::Kind_Master:
+        engine->AL().alListenerf(AL_GAIN, std::max(volume, 0.f));
+        break;
+    }
+    engine->Unlock();
+    return S_OK;
+}
+
+// ----------------------------------------------------------------------------
+// -------------------------------- Source Voice ------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Initializes a new instance of the <see cref="CALOpenALSourceVoice"/> class.
+/// </summary>
+/// <param name="eng">The engine.</param>
+/// <param name="wave">The wave format.</param>
+/// <param name="flags">The flags.</param>
+/// <param name="max_ratio">The maximum frequency ratio.</param>
+/// <param name="cb">The callback.</param>
+WrapAL::openal::CALOpenALSourceVoice::CALOpenALSourceVoice(CALOpenALEngine* eng,
+    const WAVEFORMATEX& wave, uint32_t flags, float max_ratio, IXAudio2VoiceCallback* cb) noexcept
+    : Super(eng, VoiceKind::Kind_Source), m_pCallback(cb), m_fMaxRatio(max_ratio), wave(wave) {
+    this->channels = wave.nChannels;
+    this->rate = wave.nSamplesPerSec;
+    this->flags = flags;
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALOpenALSourceVoice"/> class.
+/// </summary>
+/// <returns></returns>
+WrapAL::openal::CALOpenALSourceVoice::~CALOpenALSourceVoice() noexcept {
+    const auto& al = this->engine->AL();
+    if (m_uSource) {
+        al.alSourceStop(m_uSource);
+        al.alSourcei(m_uSource, AL_BUFFER, 0);
+        al.alDeleteSources(1, &m_uSource);
+        m_uSource = 0;
+    }
+    for (uint32_t i = 0; i != m_cQueued; ++i) {
+        al.alDeleteBuffers(1, &m_aQueue[(m_uHead + i) % XAUDIO2_MAX_QUEUED_BUFFERS].name);
+    }
+    m_cQueued = 0;
+}
+
+/// <summary>
+/// Creates the AL source and chooses the AL buffer format.
+/// 创建 AL 源
+/// </summary>
+/// <returns></returns>
+auto WrapAL::openal::CALOpenALSourceVoice::Init() noexcept -> HRESULT {
+    const auto& al = this->engine->AL();
+    const bool mc = this->engine->HasMultiChannel();
+    const bool f32 = this->engine->HasFloat32();
+    // 可用格式
+    ALenum format8 = 0, format16 = 0, format32 = 0;
+    switch (this->wave.nChannels)
+    {
+    case 1: format8 = AL_FORMAT_MONO8; format16 = AL_FORMAT_MONO16; format32 = f32 ? AL_FORMAT_MONO_FLOAT32 : 0; break;
+    case 2: format8 = AL_FORMAT_STEREO8; format16 = AL_FORMAT_STEREO16; format32 = f32 ? AL_FORMAT_STEREO_FLOAT32 : 0; break;
+    case 4: format16 = mc ? AL_FORMAT_QUAD16 : 0; format32 = mc && f32 ? AL_FORMAT_QUAD32 : 0; break;
+    case 6: format16 = mc ? AL_FORMAT_51CHN16 : 0; format32 = mc && f32 ? AL_FORMAT_51CHN32 : 0; break;
+    case 7: format16 = mc ? AL_FORMAT_61CHN16 : 0; format32 = mc && f32 ? AL_FORMAT_61CHN32 : 0; break;
+    case 8: format16 = mc ? AL_FORMAT_71CHN16 : 0; format32 = mc && f32 ? AL_FORMAT_71CHN32 : 0; break;
+    }
+    if (!format16) return E_NOTIMPL;
+    // 原生支持的直接上传, 否则转换为16位
+    const bool ieee = this->wave.wFormatTag == Wave_IEEEFloat;
+    const auto bits = this->wave.wBitsPerSample;
+    if (!ieee && bits == 8 && format8) m_alFormat = format8;
+    else if (!ieee && bits == 16) m_alFormat = format16;
+    else if (ieee && format32) m_alFormat = format32;
+    else { m_alFormat = format16; m_bConvert = true; }
+    // 创建源
+    al.alGetError();
+    al.alGenSources(1, &m_uSource);
+    if (al.alGetError() != AL_NO_ERROR) { m_uSource = 0; return E_FAIL; }
+    // 不作3D处理
+    al.alSourcei(m_uSource, AL_SOURCE_RELATIVE, AL_TRUE);
+    al.alSource3f(m_uSource, AL_POSITION, 0.f, 0.f, 0.f);
+    al.alSourcef(m_uSource, AL_ROLLOFF_FACTOR, 0.f);
+    return S_OK;
+}
+
+/// <summary>
+/// Uploads the buffer to a new AL buffer.
+/// 上传缓冲区
+/// </summary>
+/// <param name="data">The queued buffer.</param>
+/// <param name="skip">The frames skipped from PlayBegin.</param>
+/// <returns></returns>
+auto WrapAL::openal::CALOpenALSourceVoice::upload(ALQueuedBuffer& data, uint32_t skip) noexcept -> HRESULT {
+    const auto& al = this->engine->AL();
+    const auto& buffer = data.buffer;
+    const uint32_t align = this->wave.nBlockAlign;
+    const uint32_t total = buffer.AudioBytes / align;
+    const uint32_t begin = buffer.PlayBegin + skip;
+    const uint32_t end = buffer.PlayLength ? buffer.PlayBegin + buffer.PlayLength : total;
+    if (begin >= end) return XAUDIO2_E_INVALID_CALL;
+    const auto frames = end - begin;
+    const auto src = buffer.pAudioData + begin * align;
+    ALuint name = 0;
+    al.alGetError();
+    al.alGenBuffers(1, &name);
+    if (al.alGetError() != AL_NO_ERROR) return E_FAIL;
+    // 需要转换
+    if (m_bConvert) {
+        const auto count = frames * this->wave.nChannels;
+        const auto pcm = reinterpret_cast<int16_t*>(std::malloc(sizeof(int16_t) * count));
+        if (!pcm) { al.alDeleteBuffers(1, &name); return E_OUTOFMEMORY; }
+        openal::to_pcm16(src, pcm, count, this->wave);
+        al.alBufferData(name, m_alFormat, pcm, ALsizei(sizeof(int16_t) * count), ALsizei(this->rate));
+        std::free(pcm);
+    }
+    else al.alBufferData(name, m_alFormat, src, ALsizei(frames * align), ALsizei(this->rate));
+    if (al.alGetError() != AL_NO_ERROR) { al.alDeleteBuffers(1, &name); return E_FAIL; }
+    data.name = name;
+    data.frames = frames;
+    data.skip = skip;
+    return S_OK;
+}
+
+/// <summary>
+/// Queues pending buffers to AL source, buffers after an infinite
+/// looping one are kept until ExitLoop.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSourceVoice::queue_pending() noexcept {
+    const auto& al = this->engine->AL();
+    for (uint32_t i = 0; i != m_cQueued; ++i) {
+        auto& data = m_aQueue[(m_uHead + i) % XAUDIO2_MAX_QUEUED_BUFFERS];
+        if (!data.queued) {
+            al.alSourceQueueBuffers(m_uSource, 1, &data.name);
+            data.queued = true;
+        }
+        if (data.looping) {
+            // AL_LOOPING 循环整个队列, 只在队首时设置
+            if (!i && !m_bLooping) {
+                al.alSourcei(m_uSource, AL_LOOPING, AL_TRUE);
+                m_bLooping = true;
+                m_iLastOffset = 0;
+            }
+            break;
+        }
+    }
+}
+
+/// <summary>
+/// Pops the head buffer.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSourceVoice::pop_head() noexcept {
+    assert(m_cQueued && "queue empty");
+    m_uHead = (m_uHead + 1) % XAUDIO2_MAX_QUEUED_BUFFERS;
+    --m_cQueued;
+}
+
+/// <summary>
+/// Clears the AL source queue, all buffers go to flushed list.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSourceVoice::clear_all() noexcept {
+    const auto& al = this->engine->AL();
+    al.alSourceStop(m_uSource);
+    al.alSourcei(m_uSource, AL_BUFFER, 0);
+    if (m_bLooping) {
+        al.alSourcei(m_uSource, AL_LOOPING, AL_FALSE);
+        m_bLooping = false;
+    }
+    for (; m_cQueued; this->pop_head()) {
+        const auto& data = m_aQueue[m_uHead];
+        al.alDeleteBuffers(1, &data.name);
+        if (m_cFlushed < sizeof(m_aFlushed) / sizeof(m_aFlushed[0]))
+            m_aFlushed[m_cFlushed++] = data.buffer.pContext;
+    }
+    m_uHead = 0;
+    m_bPlayingAL = false;
+    m_iLastOffset = 0;
+}
+
+/// <summary>
+/// Position in head buffer.
+/// </summary>
+/// <returns></returns>
+auto WrapAL::openal::CALOpenALSourceVoice::head_position() noexcept -> uint32_t {
+    if (!m_bPlayingAL || !m_cQueued) return 0;
+    ALint offset = 0;
+    this->engine->AL().alGetSourcei(m_uSource, AL_SAMPLE_OFFSET, &offset);
+    const auto& head = m_aQueue[m_uHead];
+    // 偏移相对于仍在 AL 队列中的第一个缓冲区, 即队首
+    if (m_bLooping) return uint32_t(offset) % head.frames;
+    return std::min(uint32_t(offset), head.frames);
+}
+
+/// <summary>
+/// Plays the AL source if running and not playing.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSourceVoice::ensure_playing() noexcept {
+    if (!m_bRunning || m_bPlayingAL || !this->engine->IsRunning()) return;
+    if (!m_cQueued || !m_aQueue[m_uHead].queued) return;
+    // 未播放时 AL 队列中只有未播放的缓冲区
+    this->engine->AL().alSourcePlay(m_uSource);
+    m_bPlayingAL = true;
+    m_iLastOffset = 0;
+}
+
+/// <summary>
+/// Starts this voice.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALSourceVoice::Start(UINT32, UINT32) noexcept {
+    this->engine->Lock();
+    m_bRunning = true;
+    // 暂停中则继续
+    if (m_bPlayingAL) {
+        if (this->engine->IsRunning()) this->engine->AL().alSourcePlay(m_uSource);
+    }
+    else this->ensure_playing();
+    this->engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Stops this voice, pauses the AL source.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALSourceVoice::Stop(UINT32, UINT32) noexcept {
+    this->engine->Lock();
+    m_bRunning = false;
+    // AL 的 Stop 会重置位置, 使用 Pause
+    if (m_bPlayingAL) this->engine->AL().alSourcePause(m_uSource);
+    this->engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Suspends or resumes the AL source while engine stopped or started.
+/// </summary>
+/// <param name="suspend">if set to <c>true</c> [suspend].</param>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSourceVoice::Suspend(bool suspend) noexcept {
+    if (!m_bRunning) return;
+    const auto& al = this->engine->AL();
+    if (suspend) { if (m_bPlayingAL) al.alSourcePause(m_uSource); }
+    else if (m_bPlayingAL) al.alSourcePlay(m_uSource);
+    else this->ensure_playing();
+}
+
+/// <summary>
+/// Submits the source buffer.
+/// 提交缓冲区
+/// </summary>
+/// <param name="pBuffer">The buffer.</param>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALSourceVoice::SubmitSourceBuffer(const XAUDIO2_BUFFER* pBuffer, const XAUDIO2_BUFFER_WMA*) noexcept {
+    if (!pBuffer || !pBuffer->pAudioData) return E_INVALIDARG;
+    const auto& buffer = *pBuffer;
+    const uint32_t total = buffer.AudioBytes / this->wave.nBlockAlign;
+    const uint32_t begin = buffer.PlayBegin;
+    const uint32_t end = buffer.PlayLength ? buffer.PlayBegin + buffer.PlayLength : total;
+    // 检查范围
+    if (begin >= end || end > total) return XAUDIO2_E_INVALID_CALL;
+    if (buffer.LoopCount) {
+        // 只支持整个播放区域无限循环
+        if (buffer.LoopCount != XAUDIO2_LOOP_INFINITE) return E_NOTIMPL;
+        const auto loop_end = buffer.LoopLength ? buffer.LoopBegin + buffer.LoopLength : end;
+        if (buffer.LoopBegin != begin || loop_end != end) return E_NOTIMPL;
+    }
+    ALQueuedBuffer data;
+    std::memset(&data, 0, sizeof(data));
+    data.buffer = buffer;
+    data.looping = buffer.LoopCount == XAUDIO2_LOOP_INFINITE;
+    // 入队
+    HRESULT hr = XAUDIO2_E_INVALID_CALL;
+    this->engine->Lock();
+    if (m_cQueued < XAUDIO2_MAX_QUEUED_BUFFERS) hr = this->upload(data, 0);
+    if (SUCCEEDED(hr)) {
+        m_aQueue[(m_uHead + m_cQueued) % XAUDIO2_MAX_QUEUED_BUFFERS] = data;
+        ++m_cQueued;
+        this->queue_pending();
+        this->ensure_playing();
+    }
+    this->engine->Unlock();
+    return hr;
+}
+
+/// <summary>
+/// Flushes the source buffers, callbacks fired in next poll.
+/// 清空缓冲区
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALSourceVoice::FlushSourceBuffers() noexcept {
+    const auto& al = this->engine->AL();
+    const auto capacity = uint32_t(sizeof(m_aFlushed) / sizeof(m_aFlushed[0]));
+    this->engine->Lock();
+    // 运行中则保留正在播放的缓冲区
+    const bool keep = m_bRunning && m_bPlayingAL && m_cQueued && m_aQueue[m_uHead].started;
+    if (!keep) this->clear_all();
+    else if (m_cQueued > 1) {
+        // 循环中的队首后面的缓冲区不在 AL 队列中
+        if (!m_aQueue[m_uHead].looping) {
+            // 播放中的 AL 队列不能移除, 停止后从当前位置重建
+            ALint offset = 0;
+            al.alGetSourcei(m_uSource, AL_SAMPLE_OFFSET, &offset);
+            al.alSourceStop(m_uSource);
+            al.alSourcei(m_uSource, AL_BUFFER, 0);
+            uint32_t pos = uint32_t(offset);
+            // 已经播放完毕但尚未回收的
+            while (m_cQueued > 1 && !m_aQueue[m_uHead].looping && pos >= m_aQueue[m_uHead].frames) {
+                const auto& data = m_aQueue[m_uHead];
+                pos -= data.frames;
+                m_cSamplesPlayed += data.frames;
+                al.alDeleteBuffers(1, &data.name);
+                if (m_cFlushed < capacity) m_aFlushed[m_cFlushed++] = data.buffer.pContext;
+                this->pop_head();
+            }
+            auto& head = m_aQueue[m_uHead];
+            head.queued = false;
+            // 从当前位置重新上传, 循环缓冲区从头开始
+            if (!head.looping && pos && pos < head.frames) {
+                const auto old = head.name;
+                if (SUCCEEDED(this->upload(head, head.skip + pos))) {
+                    al.alDeleteBuffers(1, &old);
+                    m_cSamplesPlayed += pos;
+                }
+            }
+            m_bPlayingAL = false;
+        }
+        // 移除其余的
+        for (uint32_t i = 1; i < m_cQueued; ++i) {
+            const auto& data = m_aQueue[(m_uHead + i) % XAUDIO2_MAX_QUEUED_BUFFERS];
+            al.alDeleteBuffers(1, &data.name);
+            if (m_cFlushed < capacity) m_aFlushed[m_cFlushed++] = data.buffer.pContext;
+        }
+        m_cQueued = 1;
+        this->queue_pending();
+        this->ensure_playing();
+    }
+    this->engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Exits the loop of current buffer.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALSourceVoice::ExitLoop(UINT32) noexcept {
+    this->engine->Lock();
+    for (uint32_t i = 0; i != m_cQueued; ++i) {
+        auto& data = m_aQueue[(m_uHead + i) % XAUDIO2_MAX_QUEUED_BUFFERS];
+        if (data.looping) {
+            data.looping = false;
+            // 播放完本次即结束
+            if (!i && m_bLooping) {
+                this->engine->AL().alSourcei(m_uSource, AL_LOOPING, AL_FALSE);
+                m_bLooping = false;
+            }
+            break;
+        }
+    }
+    this->queue_pending();
+    this->engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Gets the state.
+/// </summary>
+/// <param name="pVoiceState">State of the voice.</param>
+/// <param name="Flags">The flags.</param>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSourceVoice::GetState(XAUDIO2_VOICE_STATE* pVoiceState, UINT32 Flags) noexcept {
+    assert(pVoiceState && "bad argument");
+    this->engine->Lock();
+    pVoiceState->pCurrentBufferContext = m_cQueued ? m_aQueue[m_uHead].buffer.pContext : nullptr;
+    pVoiceState->BuffersQueued = m_cQueued;
+    if (!(Flags & XAUDIO2_VOICE_NOSAMPLESPLAYED))
+        pVoiceState->SamplesPlayed = m_cSamplesPlayed + this->head_position();
+    this->engine->Unlock();
+}
+
+/// <summary>
+/// Sets the frequency ratio, as AL_PITCH.
+/// </summary>
+/// <param name="Ratio">The ratio.</param>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALSourceVoice::SetFrequencyRatio(float Ratio, UINT32) noexcept {
+    if (this->flags & XAUDIO2_VOICE_NOPITCH) return XAUDIO2_E_INVALID_CALL;
+    m_fRatio = std::max(XAUDIO2_MIN_FREQ_RATIO, std::min(Ratio, m_fMaxRatio));
+    this->engine->Lock();
+    this->engine->AL().alSourcef(m_uSource, AL_PITCH, m_fRatio);
+    this->engine->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Sets the source sample rate, only while no buffer queued.
+/// </summary>
+/// <param name="NewSourceSampleRate">The new source sample rate.</param>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALSourceVoice::SetSourceSampleRate(UINT32 NewSourceSampleRate) noexcept {
+    if (NewSourceSampleRate < XAUDIO2_MIN_SAMPLE_RATE || NewSourceSampleRate > XAUDIO2_MAX_SAMPLE_RATE)
+        return E_INVALIDARG;
+    HRESULT hr = XAUDIO2_E_INVALID_CALL;
+    this->engine->Lock();
+    if (!m_cQueued) {
+        this->wave.nSamplesPerSec = NewSourceSampleRate;
+        this->wave.nAvgBytesPerSec = NewSourceSampleRate * this->wave.nBlockAlign;
+        this->rate = NewSourceSampleRate;
+        hr = S_OK;
+    }
+    this->engine->Unlock();
+    return hr;
+}
+
+/// <summary>
+/// Updates the AL gain from voice chain.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSourceVoice::UpdateGain() noexcept {
+    this->engine->AL().alSourcef(m_uSource, AL_GAIN, std::max(this->ChainGain(), 0.f));
+}
+
+/// <summary>
+/// Polls the AL source, fires the callbacks.
+/// 轮询 AL 源
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSourceVoice::Poll() noexcept {
+    const auto& al = this->engine->AL();
+    const auto cb = m_pCallback;
+    // 回调中可能继续刷新
+    for (uint32_t i = 0; i < m_cFlushed; ++i) {
+        if (cb) cb->OnBufferEnd(m_aFlushed[i]);
+    }
+    m_cFlushed = 0;
+    // 回收播放完毕的缓冲区
+    if (m_bPlayingAL) {
+        ALint state = AL_PLAYING, processed = 0;
+        al.alGetSourcei(m_uSource, AL_SOURCE_STATE, &state);
+        al.alGetSourcei(m_uSource, AL_BUFFERS_PROCESSED, &processed);
+        // 播放完毕
+        if (state == AL_STOPPED) {
+            processed = 0;
+            for (uint32_t i = 0; i != m_cQueued; ++i) {
+                if (m_aQueue[(m_uHead + i) % XAUDIO2_MAX_QUEUED_BUFFERS].queued) ++processed;
+            }
+            m_bPlayingAL = false;
+        }
+        // 无限循环的轮回
+        else if (m_bLooping && m_cQueued) {
+            ALint offset = 0;
+            al.alGetSourcei(m_uSource, AL_SAMPLE_OFFSET, &offset);
+            if (offset < m_iLastOffset) {
+                m_cSamplesPlayed += m_aQueue[m_uHead].frames;
+                if (cb) cb->OnLoopEnd(m_aQueue[m_uHead].buffer.pContext);
+            }
+            m_iLastOffset = offset;
+        }
+        for (; processed > 0 && m_cQueued && m_aQueue[m_uHead].queued; --processed) {
+            auto& data = m_aQueue[m_uHead];
+            const auto context = data.buffer.pContext;
+            const auto eos = !!(data.buffer.Flags & XAUDIO2_END_OF_STREAM);
+            if (!data.started && cb) cb->OnBufferStart(context);
+            ALuint name = 0;
+            al.alSourceUnqueueBuffers(m_uSource, 1, &name);
+            al.alDeleteBuffers(1, &data.name);
+            m_cSamplesPlayed += data.frames;
+            m_iLastOffset = 0;
+            this->pop_head();
+            if (cb) cb->OnBufferEnd(context);
+            // 流结束
+            if (eos) {
+                m_cSamplesPlayed = 0;
+                if (cb) cb->OnStreamEnd();
+            }
+        }
+        // 播放完毕后清空 AL 队列
+        if (!m_bPlayingAL) al.alSourcei(m_uSource, AL_BUFFER, 0);
+    }
+    // 新的队首
+    this->queue_pending();
+    if (!m_bRunning) return;
+    if (m_bPlayingAL && m_cQueued && !m_aQueue[m_uHead].started) {
+        m_aQueue[m_uHead].started = true;
+        if (cb) cb->OnBufferStart(m_aQueue[m_uHead].buffer.pContext);
+    }
+    // 剩余不足时请求数据
+    if (cb) {
+        UINT32 required = 0;
+        if (!m_cQueued || !m_aQueue[m_uHead].looping) {
+            uint64_t left = 0;
+            for (uint32_t i = 0; i != m_cQueued; ++i)
+                left += m_aQueue[(m_uHead + i) % XAUDIO2_MAX_QUEUED_BUFFERS].frames;
+            left -= this->head_position();
+            const uint64_t threshold = uint64_t(this->rate) * OpenALRefillThreshold / 1000;
+            if (left < threshold) required = UINT32((threshold - left) * this->wave.nBlockAlign);
+        }
+        cb->OnVoiceProcessingPassStart(required);
+    }
+    // 饥饿后重新播放
+    this->ensure_playing();
+    if (cb) cb->OnVoiceProcessingPassEnd();
+}
+
+/// <summary>
+/// Destroys the voice.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSourceVoice::DestroyVoice() noexcept {
+    this->engine->Unlink(*this);
+    openal::destroy_object(this);
+}
+
+// ----------------------------------------------------------------------------
+// ------------------------------ Submix / Master -----------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Destroys the voice.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALSubmixVoice::DestroyVoice() noexcept {
+    this->engine->Unlink(*this);
+    openal::destroy_object(this);
+}
+
+/// <summary>
+/// Destroys the voice, closes the device.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALMasteringVoice::DestroyVoice() noexcept {
+    this->engine->DestroyMaster();
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------- Engine ---------------------------------
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// Creates the OpenAL engine.
+/// 创建 OpenAL 引擎
+/// </summary>
+/// <param name="engine">The engine.</param>
+/// <returns></returns>
+auto WrapAL::openal::CALOpenALEngine::Create(IXAudio2** engine) noexcept -> HRESULT {
+    assert(engine && "bad argument");
+    *engine = nullptr;
+    const auto ptr = reinterpret_cast<CALOpenALEngine*>(std::malloc(sizeof(CALOpenALEngine)));
+    if (!ptr) return E_OUTOFMEMORY;
+    new(ptr) CALOpenALEngine();
+    // 载入 OpenAL
+    if (!openal::LoadOpenAL(ptr->m_al)) {
+        ptr->Release();
+        return E_FAIL;
+    }
+    *engine = ptr;
+    return S_OK;
+}
+
+/// <summary>
+/// Initializes a new instance of the <see cref="CALOpenALEngine"/> class.
+/// </summary>
+WrapAL::openal::CALOpenALEngine::CALOpenALEngine() noexcept
+    : m_cRefCount(1), m_bRunning(true), m_bExit(false) {
+    std::memset(&m_al, 0, sizeof(m_al));
+    m_headSource.prev = m_headSource.next = &m_headSource;
+    m_headSubmix.prev = m_headSubmix.next = &m_headSubmix;
+    std::memset(m_aCallback, 0, sizeof(m_aCallback));
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALOpenALEngine"/> class.
+/// </summary>
+/// <returns></returns>
+WrapAL::openal::CALOpenALEngine::~CALOpenALEngine() noexcept {
+    assert(!m_cSource && !m_cSubmix && "voices not destroyed");
+    if (m_pMaster) this->DestroyMaster();
+    openal::FreeOpenAL(m_al);
+}
+
+/// <summary>
+/// Releases this instance.
+/// </summary>
+/// <returns></returns>
+ULONG WrapAL::openal::CALOpenALEngine::Release() noexcept {
+    const auto count = --m_cRefCount;
+    if (!count) {
+        this->~CALOpenALEngine();
+        std::free(this);
+    }
+    return count;
+}
+
+/// <summary>
+/// Registers the engine callback.
+/// </summary>
+/// <param name="pCallback">The callback.</param>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALEngine::RegisterForCallbacks(IXAudio2EngineCallback* pCallback) noexcept {
+    if (!pCallback) return E_INVALIDARG;
+    HRESULT hr = E_OUTOFMEMORY;
+    this->Lock();
+    if (m_cCallback < sizeof(m_aCallback) / sizeof(m_aCallback[0])) {
+        m_aCallback[m_cCallback++] = pCallback;
+        hr = S_OK;
+    }
+    this->Unlock();
+    return hr;
+}
+
+/// <summary>
+/// Unregisters the engine callback.
+/// </summary>
+/// <param name="pCallback">The callback.</param>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALEngine::UnregisterForCallbacks(IXAudio2EngineCallback* pCallback) noexcept {
+    this->Lock();
+    const auto end = m_aCallback + m_cCallback;
+    const auto itr = std::find(m_aCallback, end, pCallback);
+    if (itr != end) {
+        std::copy(itr + 1, end, itr);
+        --m_cCallback;
+    }
+    this->Unlock();
+}
+
+/// <summary>
+/// Creates the source voice.
+/// 创建源音
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALEngine::CreateSourceVoice(
+    IXAudio2SourceVoice** ppSourceVoice, const WAVEFORMATEX* pSourceFormat,
+    UINT32 Flags, float MaxFrequencyRatio, IXAudio2VoiceCallback* pCallback,
+    const XAUDIO2_VOICE_SENDS* pSendList, const XAUDIO2_EFFECT_CHAIN* pEffectChain) noexcept {
+    if (!ppSourceVoice || !pSourceFormat) return E_INVALIDARG;
+    *ppSourceVoice = nullptr;
+    const auto& wave = *pSourceFormat;
+    // 检查格式
+    const bool pcm = wave.wFormatTag == Wave_PCM && (wave.wBitsPerSample == 8 ||
+        wave.wBitsPerSample == 16 || wave.wBitsPerSample == 24 || wave.wBitsPerSample == 32);
+    const bool ieee = wave.wFormatTag == Wave_IEEEFloat && wave.wBitsPerSample == 32;
+    if (!pcm && !ieee) return E_INVALIDARG;
+    if (!wave.nChannels || wave.nChannels > XAUDIO2_MAX_AUDIO_CHANNELS) return E_INVALIDARG;
+    if (wave.nBlockAlign != wave.nChannels * wave.wBitsPerSample / 8) return E_INVALIDARG;
+    if (wave.nSamplesPerSec < XAUDIO2_MIN_SAMPLE_RATE || wave.nSamplesPerSec > XAUDIO2_MAX_SAMPLE_RATE)
+        return E_INVALIDARG;
+    if (pEffectChain && pEffectChain->EffectCount) return E_NOTIMPL;
+    if (!m_pMaster) return XAUDIO2_E_INVALID_CALL;
+    // 频率比
+    if (Flags & XAUDIO2_VOICE_NOPITCH) MaxFrequencyRatio = 1.f;
+    MaxFrequencyRatio = std::max(XAUDIO2_MIN_FREQ_RATIO, std::min(MaxFrequencyRatio, XAUDIO2_MAX_FREQ_RATIO));
+    // 创建
+    auto voice = openal::create_object<CALOpenALSourceVoice>(this, wave, Flags, MaxFrequencyRatio, pCallback);
+    if (!voice) return E_OUTOFMEMORY;
+    HRESULT hr = voice->Init();
+    if (SUCCEEDED(hr)) hr = voice->SetOutputVoices(pSendList);
+    // 链接
+    if (SUCCEEDED(hr)) {
+        this->Lock();
+        this->link(m_headSource, *voice);
+        ++m_cSource;
+        this->Unlock();
+        *ppSourceVoice = voice;
+    }
+    else openal::destroy_object(voice);
+    return hr;
+}
+
+/// <summary>
+/// Creates the submix voice, a gain set of sources.
+/// 创建子混音
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALEngine::CreateSubmixVoice(
+    IXAudio2SubmixVoice** ppSubmixVoice, UINT32 InputChannels,
+    UINT32 InputSampleRate, UINT32 Flags, UINT32 ProcessingStage,
+    const XAUDIO2_VOICE_SENDS* pSendList, const XAUDIO2_EFFECT_CHAIN* pEffectChain) noexcept {
+    if (!ppSubmixVoice) return E_INVALIDARG;
+    *ppSubmixVoice = nullptr;
+    if (!InputChannels || InputChannels > XAUDIO2_MAX_AUDIO_CHANNELS) return E_INVALIDARG;
+    if (pEffectChain && pEffectChain->EffectCount) return E_NOTIMPL;
+    if (!m_pMaster) return XAUDIO2_E_INVALID_CALL;
+    auto voice = openal::create_object<CALOpenALSubmixVoice>(this);
+    if (!voice) return E_OUTOFMEMORY;
+    voice->channels = InputChannels;
+    voice->rate = InputSampleRate ? InputSampleRate : m_pMaster->rate;
+    voice->stage = ProcessingStage;
+    voice->flags = Flags;
+    const HRESULT hr = voice->SetOutputVoices(pSendList);
+    if (SUCCEEDED(hr)) {
+        this->Lock();
+        this->link(m_headSubmix, *voice);
+        ++m_cSubmix;
+        this->Unlock();
+        *ppSubmixVoice = voice;
+    }
+    else openal::destroy_object(voice);
+    return hr;
+}
+
+/// <summary>
+/// Creates the mastering voice, opens the device and starts polling thread.
+/// 创建主音
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALEngine::CreateMasteringVoice(
+    IXAudio2MasteringVoice** ppMasteringVoice, UINT32 InputChannels,
+    UINT32 InputSampleRate, UINT32 Flags, LPCWSTR szDeviceId,
+    const XAUDIO2_EFFECT_CHAIN* pEffectChain, AUDIO_STREAM_CATEGORY) noexcept {
+    if (!ppMasteringVoice) return E_INVALIDARG;
+    *ppMasteringVoice = nullptr;
+    if (m_pMaster) return XAUDIO2_E_INVALID_CALL;
+    if (pEffectChain && pEffectChain->EffectCount) return E_NOTIMPL;
+    HRESULT hr = S_OK;
+    // 设备名称为 UTF-8
+    char name[sizeof(ALDeviceList::name[0]) / sizeof(wchar_t) * 4];
+    const char* device = nullptr;
+    if (szDeviceId && *szDeviceId) {
+        if (::WideCharToMultiByte(CP_UTF8, 0, szDeviceId, -1, name, sizeof(name), nullptr, nullptr) > 0)
+            device = name;
+        else hr = E_INVALIDARG;
+    }
+    // 打开设备
+    if (SUCCEEDED(hr) && !(m_pDevice = m_al.alcOpenDevice(device))) hr = XAUDIO2_E_DEVICE_INVALIDATED;
+    // 创建上下文
+    if (SUCCEEDED(hr)) {
+        const ALCint attr[] = { ALC_FREQUENCY, ALCint(InputSampleRate), 0 };
+        m_pContext = m_al.alcCreateContext(m_pDevice, InputSampleRate ? attr : nullptr);
+        if (!m_pContext || !m_al.alcMakeContextCurrent(m_pContext)) hr = E_FAIL;
+    }
+    auto voice = SUCCEEDED(hr) ? openal::create_object<CALOpenALMasteringVoice>(this) : nullptr;
+    if (SUCCEEDED(hr) && !voice) hr = E_OUTOFMEMORY;
+    // 开始轮询线程
+    if (SUCCEEDED(hr)) {
+        m_bFloat32 = !!m_al.alIsExtensionPresent("AL_EXT_FLOAT32");
+        m_bMultiChannel = !!m_al.alIsExtensionPresent("AL_EXT_MCFORMATS");
+        ALCint rate = 0;
+        m_al.alcGetIntegerv(m_pDevice, ALC_FREQUENCY, 1, &rate);
+        voice->channels = InputChannels ? InputChannels : 2;
+        voice->rate = rate > 0 ? uint32_t(rate) : (InputSampleRate ? InputSampleRate : MixerDefaultSampleRate);
+        voice->flags = Flags;
+        m_pMaster = voice;
+        m_bExit = false;
+        m_thread = std::thread(&CALOpenALEngine::thread_proc, this);
+        *ppMasteringVoice = voice;
+    }
+    // 失败
+    else {
+        if (m_pContext) {
+            m_al.alcMakeContextCurrent(nullptr);
+            m_al.alcDestroyContext(m_pContext);
+            m_pContext = nullptr;
+        }
+        if (m_pDevice) {
+            m_al.alcCloseDevice(m_pDevice);
+            m_pDevice = nullptr;
+        }
+    }
+    return hr;
+}
+
+/// <summary>
+/// Destroys the mastering voice, stops the polling thread and closes the device.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALEngine::DestroyMaster() noexcept {
+    assert(m_pMaster && "no mastering voice");
+    m_bExit = true;
+    if (m_thread.joinable()) m_thread.join();
+    openal::destroy_object(m_pMaster);
+    m_pMaster = nullptr;
+    m_al.alcMakeContextCurrent(nullptr);
+    if (m_pContext) m_al.alcDestroyContext(m_pContext);
+    if (m_pDevice) m_al.alcCloseDevice(m_pDevice);
+    m_pContext = nullptr;
+    m_pDevice = nullptr;
+}
+
+/// <summary>
+/// Starts the engine, resumes running sources.
+/// </summary>
+/// <returns></returns>
+HRESULT WrapAL::openal::CALOpenALEngine::StartEngine() noexcept {
+    this->Lock();
+    if (!m_bRunning) {
+        m_bRunning = true;
+        for (auto node = m_headSource.next; node != &m_headSource; node = node->next)
+            static_cast<CALOpenALSourceVoice*>(node)->Suspend(false);
+    }
+    this->Unlock();
+    return S_OK;
+}
+
+/// <summary>
+/// Stops the engine, pauses all sources.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALEngine::StopEngine() noexcept {
+    this->Lock();
+    if (m_bRunning) {
+        m_bRunning = false;
+        for (auto node = m_headSource.next; node != &m_headSource; node = node->next)
+            static_cast<CALOpenALSourceVoice*>(node)->Suspend(true);
+    }
+    this->Unlock();
+}
+
+/// <summary>
+/// Gets the performance data.
+/// </summary>
+/// <param name="pPerfData">The perf data.</param>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALEngine::GetPerformanceData(XAUDIO2_PERFORMANCE_DATA* pPerfData) noexcept {
+    assert(pPerfData && "bad argument");
+    std::memset(pPerfData, 0, sizeof(*pPerfData));
+    this->Lock();
+    // 混音在 OpenAL 内部, 只统计数量
+    pPerfData->TotalSourceVoiceCount = m_cSource;
+    pPerfData->ActiveSubmixVoiceCount = m_cSubmix;
+    for (auto node = m_headSource.next; node != &m_headSource; node = node->next) {
+        if (static_cast<CALOpenALSourceVoice*>(node)->IsRunning())
+            ++pPerfData->ActiveSourceVoiceCount;
+    }
+    if (m_pMaster) pPerfData->CurrentLatencyInSamples = m_pMaster->rate * OpenALPollInterval / 1000;
+    this->Unlock();
+}
+
+/// <summary>
+/// Finds the voice (submix or mastering) by interface.
+/// </summary>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+auto WrapAL::openal::CALOpenALEngine::FindVoice(IXAudio2Voice* voice) noexcept -> ALVoiceData* {
+    if (!voice) return nullptr;
+    if (m_pMaster && m_pMaster->voice == voice) return m_pMaster;
+    for (auto node = m_headSubmix.next; node != &m_headSubmix; node = node->next) {
+        if (node->voice == voice) return node;
+    }
+    return nullptr;
+}
+
+/// <summary>
+/// Updates the gain of all sources.
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALEngine::UpdateGains() noexcept {
+    this->Lock();
+    for (auto node = m_headSource.next; node != &m_headSource; node = node->next)
+        static_cast<CALOpenALSourceVoice*>(node)->UpdateGain();
+    this->Unlock();
+}
+
+/// <summary>
+/// Links the voice before the node.
+/// </summary>
+/// <param name="node">The node.</param>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALEngine::link(ALVoiceData& node, ALVoiceData& voice) noexcept {
+    voice.prev = node.prev;
+    voice.next = &node;
+    node.prev->next = &voice;
+    node.prev = &voice;
+}
+
+/// <summary>
+/// Unlinks the voice, and removes sends to it.
+/// </summary>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALEngine::Unlink(ALVoiceData& voice) noexcept {
+    this->Lock();
+    voice.prev->next = voice.next;
+    voice.next->prev = voice.prev;
+    voice.prev = voice.next = nullptr;
+    if (voice.kind == VoiceKind::Kind_Source) --m_cSource;
+    else --m_cSubmix;
+    // 移除到该音的输出
+    if (voice.kind == VoiceKind::Kind_Submix) {
+        for (auto head : { &m_headSource, &m_headSubmix }) {
+            for (auto node = head->next; node != head; node = node->next) {
+                if (node->target == &voice) node->target = nullptr;
+            }
+        }
+        this->UpdateGains();
+    }
+    this->Unlock();
+}
+
+/// <summary>
+/// The polling thread, OpenAL has no callback.
+/// 轮询线程
+/// </summary>
+/// <returns></returns>
+void WrapAL::openal::CALOpenALEngine::thread_proc() noexcept {
+    while (!m_bExit) {
+        if (m_bRunning) {
+            this->Lock();
+            for (uint32_t i = 0; i != m_cCallback; ++i) m_aCallback[i]->OnProcessingPassStart();
+            for (auto node = m_headSource.next; node != &m_headSource; ) {
+                const auto voice = static_cast<CALOpenALSourceVoice*>(node);
+                node = node->next;
+                voice->Poll();
+            }
+            for (uint32_t i = 0; i != m_cCallback; ++i) m_aCallback[i]->OnProcessingPassEnd();
+            this->Unlock();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(OpenALPollInterval));
+    }
+}
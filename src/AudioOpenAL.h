@@ -0,0 +1,420 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL OpenAL backend, implements the XAudio2 interface like the software
+mixer, on top of OpenAL(OpenAL Soft) loaded at runtime:
+    source voice    -> AL source with queued AL buffers
+    submix voice    -> gain set, volume scaled into member sources
+    mastering voice -> ALC device/context, volume as listener gain
+
+OpenAL has no callbacks, a thread polls each source every
+OpenALPollInterval ms and fires the IXAudio2VoiceCallback methods.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for atomic
+#include <atomic>
+// for thread
+#include <thread>
+// for recursive_mutex
+#include <mutex>
+// include the config
+#include "wrapalconf.h"
+// include the config
+#include "wrapal_common.h"
+// util
+#include "AudioUtil.h"
+// XAudio2 interface
+#include "p_XAudio2_8.h"
+// OpenAL API
+#include "p_OpenAL.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // OpenAL backend
+    namespace openal {
+        // interface to implement
+        using namespace xaudio2_8;
+        // OpenAL engine
+        class CALOpenALEngine;
+        // device list of OpenAL
+        struct ALDeviceList {
+            // list for IALConfigure::ChooseDevice
+            AudioDeviceInfo     list[DeviceMaxCount];
+            // name buffer, also used as id
+            wchar_t             name[DeviceMaxCount][128];
+            // count of device
+            uint32_t            count;
+        };
+        // load OpenAL dll, return false if not found
+        bool LoadOpenAL(OpenAL& al) noexcept;
+        // free OpenAL dll
+        void FreeOpenAL(OpenAL& al) noexcept;
+        // enum output devices
+        void EnumOutputDevices(const OpenAL& al, ALDeviceList& devices) noexcept;
+        // kind of voice
+        enum class VoiceKind : uint8_t {
+            // IXAudio2SourceVoice
+            Kind_Source = 0,
+            // IXAudio2SubmixVoice
+            Kind_Submix,
+            // IXAudio2MasteringVoice
+            Kind_Master,
+        };
+        // common data for all kinds of voice
+        struct ALVoiceData {
+            // prev/next in engine list
+            ALVoiceData*        prev = nullptr, *next = nullptr;
+            // engine
+            CALOpenALEngine*    engine = nullptr;
+            // interface of this voice
+            IXAudio2Voice*      voice = nullptr;
+            // output target, only the first send used
+            ALVoiceData*        target = nullptr;
+            // kind of voice
+            VoiceKind           kind = VoiceKind::Kind_Source;
+            // input channels
+            uint32_t            channels = 0;
+            // input sample rate
+            uint32_t            rate = 0;
+            // processing stage for submix
+            uint32_t            stage = 0;
+            // flags while creating
+            uint32_t            flags = 0;
+            // volume
+            float               volume = 1.f;
+        public:
+            // gain of voice chain, without mastering voice
+            auto ChainGain() const noexcept {
+                float gain = this->volume;
+                auto itr = this->target;
+                for (; itr && itr->kind != VoiceKind::Kind_Master; itr = itr->target) gain *= itr->volume;
+                // not routed to mastering voice
+                return itr ? gain : 0.f;
+            }
+        };
+        // common impl of IXAudio2Voice
+        struct ALVoiceImpl {
+            // SetOutputVoices
+            static auto SetOutputVoices(ALVoiceData&, const XAUDIO2_VOICE_SENDS*) noexcept ->HRESULT;
+            // SetVolume
+            static auto SetVolume(ALVoiceData&, float) noexcept ->HRESULT;
+        };
+        // IXAudio2Voice for OpenAL
+        template<class Interface> class CALOpenALVoice : public Interface, public ALVoiceData {
+        public: // IXAudio2Voice
+            // GetVoiceDetails
+            void STDMETHODCALLTYPE GetVoiceDetails(XAUDIO2_VOICE_DETAILS* d) noexcept override {
+                d->CreationFlags = d->ActiveFlags = this->flags;
+                d->InputChannels = this->channels; d->InputSampleRate = this->rate;
+            }
+            // SetOutputVoices
+            HRESULT STDMETHODCALLTYPE SetOutputVoices(const XAUDIO2_VOICE_SENDS* s) noexcept override { return ALVoiceImpl::SetOutputVoices(*this, s); }
+            // SetEffectChain
+            HRESULT STDMETHODCALLTYPE SetEffectChain(const XAUDIO2_EFFECT_CHAIN*) noexcept override { return E_NOTIMPL; }
+            // EnableEffect
+            HRESULT STDMETHODCALLTYPE EnableEffect(UINT32, UINT32) noexcept override { return E_NOTIMPL; }
+            // DisableEffect
+            HRESULT STDMETHODCALLTYPE DisableEffect(UINT32, UINT32) noexcept override { return E_NOTIMPL; }
+            // GetEffectState
+            void STDMETHODCALLTYPE GetEffectState(UINT32, BOOL* e) noexcept override { if (e) *e = 0; }
+            // SetEffectParameters
+            HRESULT STDMETHODCALLTYPE SetEffectParameters(UINT32, const void*, UINT32, UINT32) noexcept override { return E_NOTIMPL; }
+            // GetEffectParameters
+            HRESULT STDMETHODCALLTYPE GetEffectParameters(UINT32, void*, UINT32) noexcept override { return E_NOTIMPL; }
+            // SetFilterParameters
+            HRESULT STDMETHODCALLTYPE SetFilterParameters(const XAUDIO2_FILTER_PARAMETERS*, UINT32) noexcept override { return E_NOTIMPL; }
+            // GetFilterParameters
+            void STDMETHODCALLTYPE GetFilterParameters(XAUDIO2_FILTER_PARAMETERS*) noexcept override { }
+            // SetOutputFilterParameters
+            HRESULT STDMETHODCALLTYPE SetOutputFilterParameters(IXAudio2Voice*, const XAUDIO2_FILTER_PARAMETERS*, UINT32) noexcept override { return E_NOTIMPL; }
+            // GetOutputFilterParameters
+            void STDMETHODCALLTYPE GetOutputFilterParameters(IXAudio2Voice*, XAUDIO2_FILTER_PARAMETERS*) noexcept override { }
+            // SetVolume
+            HRESULT STDMETHODCALLTYPE SetVolume(float v, UINT32) noexcept override { return ALVoiceImpl::SetVolume(*this, v); }
+            // GetVolume
+            void STDMETHODCALLTYPE GetVolume(float* v) noexcept override { *v = this->volume; }
+            // SetChannelVolumes
+            HRESULT STDMETHODCALLTYPE SetChannelVolumes(UINT32, const float*, UINT32) noexcept override { return E_NOTIMPL; }
+            // GetChannelVolumes
+            void STDMETHODCALLTYPE GetChannelVolumes(UINT32 c, float* v) noexcept override { for (UINT32 i = 0; i != c; ++i) v[i] = 1.f; }
+            // SetOutputMatrix
+            HRESULT STDMETHODCALLTYPE SetOutputMatrix(IXAudio2Voice*, UINT32, UINT32, const float*, UINT32) noexcept override { return E_NOTIMPL; }
+            // GetOutputMatrix
+            void STDMETHODCALLTYPE GetOutputMatrix(IXAudio2Voice*, UINT32, UINT32, float*) noexcept override { }
+        public:
+            // ctor
+            CALOpenALVoice(CALOpenALEngine* eng, VoiceKind k) noexcept {
+                this->engine = eng; this->kind = k; this->voice = this;
+            }
+        };
+        // queued buffer of source voice
+        struct ALQueuedBuffer {
+            // XAudio2 buffer
+            XAUDIO2_BUFFER          buffer;
+            // AL buffer name
+            ALuint                  name;
+            // frames in AL buffer
+            uint32_t                frames;
+            // frames skipped from PlayBegin
+            uint32_t                skip;
+            // OnBufferStart called
+            bool                    started;
+            // queued to AL source
+            bool                    queued;
+            // loop infinitely
+            bool                    looping;
+        };
+        // IXAudio2SourceVoice for OpenAL
+        class CALOpenALSourceVoice final : public CALOpenALVoice<IXAudio2SourceVoice> {
+            // super class
+            using Super = CALOpenALVoice<IXAudio2SourceVoice>;
+        public: // IXAudio2SourceVoice
+            // Start
+            HRESULT STDMETHODCALLTYPE Start(UINT32 Flags, UINT32 OperationSet) noexcept override;
+            // Stop
+            HRESULT STDMETHODCALLTYPE Stop(UINT32 Flags, UINT32 OperationSet) noexcept override;
+            // SubmitSourceBuffer
+            HRESULT STDMETHODCALLTYPE SubmitSourceBuffer(const XAUDIO2_BUFFER* pBuffer, const XAUDIO2_BUFFER_WMA*) noexcept override;
+            // FlushSourceBuffers
+            HRESULT STDMETHODCALLTYPE FlushSourceBuffers() noexcept override;
+            // Discontinuity
+            HRESULT STDMETHODCALLTYPE Discontinuity() noexcept override { return S_OK; }
+            // ExitLoop
+            HRESULT STDMETHODCALLTYPE ExitLoop(UINT32 OperationSet) noexcept override;
+            // GetState
+            void STDMETHODCALLTYPE GetState(XAUDIO2_VOICE_STATE* pVoiceState, UINT32 Flags) noexcept override;
+            // SetFrequencyRatio
+            HRESULT STDMETHODCALLTYPE SetFrequencyRatio(float Ratio, UINT32 OperationSet) noexcept override;
+            // GetFrequencyRatio
+            void STDMETHODCALLTYPE GetFrequencyRatio(float* pRatio) noexcept override { *pRatio = m_fRatio; }
+            // SetSourceSampleRate
+            HRESULT STDMETHODCALLTYPE SetSourceSampleRate(UINT32 NewSourceSampleRate) noexcept override;
+            // DestroyVoice
+            void STDMETHODCALLTYPE DestroyVoice() noexcept override;
+        public:
+            // ctor
+            CALOpenALSourceVoice(CALOpenALEngine* eng, const WAVEFORMATEX& wave,
+                uint32_t flags, float max_ratio, IXAudio2VoiceCallback* cb) noexcept;
+            // dtor
+            ~CALOpenALSourceVoice() noexcept;
+            // create AL source, choose AL format
+            auto Init() noexcept ->HRESULT;
+            // poll the AL source, fire callbacks
+            void Poll() noexcept;
+            // update AL gain
+            void UpdateGain() noexcept;
+            // suspend/resume AL source while engine stopped/started
+            void Suspend(bool suspend) noexcept;
+            // is running
+            bool IsRunning() const noexcept { return m_bRunning; }
+        private:
+            // upload buffer to a new AL buffer, skip frames from PlayBegin
+            auto upload(ALQueuedBuffer& data, uint32_t skip) noexcept ->HRESULT;
+            // queue pending buffers to AL source, until looping one
+            void queue_pending() noexcept;
+            // pop the head buffer
+            void pop_head() noexcept;
+            // clear AL source queue, all buffers go to flushed
+            void clear_all() noexcept;
+            // position in head buffer
+            auto head_position() noexcept ->uint32_t;
+            // ensure AL source playing if needed
+            void ensure_playing() noexcept;
+        private:
+            // callback
+            IXAudio2VoiceCallback*  m_pCallback;
+            // AL source
+            ALuint                  m_uSource = 0;
+            // AL format
+            ALenum                  m_alFormat = 0;
+            // convert to 16bit pcm before upload
+            bool                    m_bConvert = false;
+            // running(XAudio2 side)
+            bool                    m_bRunning = false;
+            // AL source played and not ran out
+            bool                    m_bPlayingAL = false;
+            // AL_LOOPING set
+            bool                    m_bLooping = false;
+            // last sample offset for looping
+            ALint                   m_iLastOffset = 0;
+            // frequency ratio
+            float                   m_fRatio = 1.f;
+            // max frequency ratio
+            float                   m_fMaxRatio;
+            // samples played
+            UINT64                  m_cSamplesPlayed = 0;
+            // head of queue
+            uint32_t                m_uHead = 0;
+            // count of queue
+            uint32_t                m_cQueued = 0;
+            // count of flushed
+            uint32_t                m_cFlushed = 0;
+        public:
+            // wave format
+            WAVEFORMATEX            wave;
+        private:
+            // buffer queue
+            ALQueuedBuffer          m_aQueue[XAUDIO2_MAX_QUEUED_BUFFERS];
+            // flushed buffer context
+            void*                   m_aFlushed[XAUDIO2_MAX_QUEUED_BUFFERS * 2];
+        };
+        // IXAudio2SubmixVoice for OpenAL, gain set of sources
+        class CALOpenALSubmixVoice final : public CALOpenALVoice<IXAudio2SubmixVoice> {
+            // super class
+            using Super = CALOpenALVoice<IXAudio2SubmixVoice>;
+        public: // IXAudio2SubmixVoice
+            // DestroyVoice
+            void STDMETHODCALLTYPE DestroyVoice() noexcept override;
+        public:
+            // ctor
+            CALOpenALSubmixVoice(CALOpenALEngine* eng) noexcept : Super(eng, VoiceKind::Kind_Submix) {}
+        };
+        // IXAudio2MasteringVoice for OpenAL
+        class CALOpenALMasteringVoice final : public CALOpenALVoice<IXAudio2MasteringVoice> {
+            // super class
+            using Super = CALOpenALVoice<IXAudio2MasteringVoice>;
+        public: // IXAudio2MasteringVoice
+            // GetChannelMask
+            HRESULT STDMETHODCALLTYPE GetChannelMask(DWORD* pChannelmask) noexcept override { *pChannelmask = 0x3; return S_OK; }
+            // DestroyVoice
+            void STDMETHODCALLTYPE DestroyVoice() noexcept override;
+        public:
+            // ctor
+            CALOpenALMasteringVoice(CALOpenALEngine* eng) noexcept : Super(eng, VoiceKind::Kind_Master) {}
+        };
+        // IXAudio2 for OpenAL
+        class CALOpenALEngine final : public IXAudio2 {
+        public: // IUnknown
+            // QueryInterface
+            HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppv) noexcept override { if (ppv) *ppv = nullptr; return E_NOINTERFACE; }
+            // AddRef
+            ULONG STDMETHODCALLTYPE AddRef() noexcept override { return ++m_cRefCount; }
+            // Release
+            ULONG STDMETHODCALLTYPE Release() noexcept override;
+        public: // IXAudio2
+            // RegisterForCallbacks
+            HRESULT STDMETHODCALLTYPE RegisterForCallbacks(IXAudio2EngineCallback* pCallback) noexcept override;
+            // UnregisterForCallbacks
+            void STDMETHODCALLTYPE UnregisterForCallbacks(IXAudio2EngineCallback* pCallback) noexcept override;
+            // CreateSourceVoice
+            HRESULT STDMETHODCALLTYPE CreateSourceVoice(IXAudio2SourceVoice** ppSourceVoice,
+                const WAVEFORMATEX* pSourceFormat, UINT32 Flags, float MaxFrequencyRatio,
+                IXAudio2VoiceCallback* pCallback, const XAUDIO2_VOICE_SENDS* pSendList,
+                const XAUDIO2_EFFECT_CHAIN* pEffectChain) noexcept override;
+            // CreateSubmixVoice
+            HRESULT STDMETHODCALLTYPE CreateSubmixVoice(IXAudio2SubmixVoice** ppSubmixVoice,
+                UINT32 InputChannels, UINT32 InputSampleRate, UINT32 Flags, UINT32 ProcessingStage,
+                const XAUDIO2_VOICE_SENDS* pSendList, const XAUDIO2_EFFECT_CHAIN* pEffectChain) noexcept override;
+            // CreateMasteringVoice
+            HRESULT STDMETHODCALLTYPE CreateMasteringVoice(IXAudio2MasteringVoice** ppMasteringVoice,
+                UINT32 InputChannels, UINT32 InputSampleRate, UINT32 Flags, LPCWSTR szDeviceId,
+                const XAUDIO2_EFFECT_CHAIN* pEffectChain, AUDIO_STREAM_CATEGORY StreamCategory) noexcept override;
+            // StartEngine
+            HRESULT STDMETHODCALLTYPE StartEngine() noexcept override;
+            // StopEngine
+            void STDMETHODCALLTYPE StopEngine() noexcept override;
+            // CommitChanges
+            HRESULT STDMETHODCALLTYPE CommitChanges(UINT32) noexcept override { return S_OK; }
+            // GetPerformanceData
+            void STDMETHODCALLTYPE GetPerformanceData(XAUDIO2_PERFORMANCE_DATA* pPerfData) noexcept override;
+            // SetDebugConfiguration
+            void STDMETHODCALLTYPE SetDebugConfiguration(const XAUDIO2_DEBUG_CONFIGURATION*, void*) noexcept override { }
+        public:
+            // create OpenAL engine, load OpenAL dll
+            static auto Create(IXAudio2** engine) noexcept ->HRESULT;
+            // get OpenAL api
+            auto AL() const noexcept -> const OpenAL& { return m_al; }
+            // lock the engine
+            void Lock() noexcept { m_mutex.lock(); }
+            // unlock the engine
+            void Unlock() noexcept { m_mutex.unlock(); }
+            // engine started
+            bool IsRunning() const noexcept { return m_bRunning; }
+            // has AL_EXT_FLOAT32
+            bool HasFloat32() const noexcept { return m_bFloat32; }
+            // has AL_EXT_MCFORMATS
+            bool HasMultiChannel() const noexcept { return m_bMultiChannel; }
+            // get mastering voice
+            auto GetMaster() const noexcept { return m_pMaster; }
+            // find voice data by interface
+            auto FindVoice(IXAudio2Voice* voice) noexcept ->ALVoiceData*;
+            // update gain of all sources
+            void UpdateGains() noexcept;
+            // unlink voice
+            void Unlink(ALVoiceData& voice) noexcept;
+            // destroy mastering voice
+            void DestroyMaster() noexcept;
+        private:
+            // ctor
+            CALOpenALEngine() noexcept;
+            // dtor
+            ~CALOpenALEngine() noexcept;
+            // link voice to list
+            void link(ALVoiceData& head, ALVoiceData& voice) noexcept;
+            // thread for polling
+            void thread_proc() noexcept;
+        private:
+            // lock for voices
+            std::recursive_mutex        m_mutex;
+            // polling thread
+            std::thread                 m_thread;
+            // OpenAL api
+            OpenAL                      m_al;
+            // ALC device
+            ALCdevice*                  m_pDevice = nullptr;
+            // ALC context
+            ALCcontext*                 m_pContext = nullptr;
+            // mastering voice
+            CALOpenALMasteringVoice*    m_pMaster = nullptr;
+            // engine callbacks
+            IXAudio2EngineCallback*     m_aCallback[4];
+            // count of callbacks
+            uint32_t                    m_cCallback = 0;
+            // count of source voice
+            uint32_t                    m_cSource = 0;
+            // count of submix voice
+            uint32_t                    m_cSubmix = 0;
+            // ref-count
+            std::atomic<uint32_t>       m_cRefCount;
+            // engine started
+            std::atomic_bool            m_bRunning;
+            // exit thread
+            std::atomic_bool            m_bExit;
+            // has AL_EXT_FLOAT32
+            bool                        m_bFloat32 = false;
+            // has AL_EXT_MCFORMATS
+            bool                        m_bMultiChannel = false;
+            // head of source voices
+            ALVoiceData                 m_headSource;
+            // head of submix voices
+            ALVoiceData                 m_headSubmix;
+        };
+    }
+}
@@ -0,0 +1,166 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "AudioPerf.h"
+#include <algorithm>
+#include <cmath>
+
+// wrapal namespace
+namespace WrapAL {
+    // counters of decoding of a format
+    struct PerfDecode {
+        // count of calls
+        std::atomic<uint64_t>   calls{ 0 };
+        // time in microsecond
+        std::atomic<uint64_t>   time{ 0 };
+        // bytes decoded
+        std::atomic<uint64_t>   bytes{ 0 };
+    };
+    // all counters
+    struct PerfData {
+        // count of passes
+        std::atomic<uint64_t>   passes{ 0 };
+        // total time of passes in microsecond
+        std::atomic<uint64_t>   pass_time{ 0 };
+        // min time of pass
+        std::atomic<uint32_t>   pass_min{ ~uint32_t(0) };
+        // max time of pass
+        std::atomic<uint32_t>   pass_max{ 0 };
+        // histogram of pass time
+        std::atomic<uint32_t>   pass_bucket[CALPerfCounters::PERF_BUCKETS];
+        // decoding of formats
+        PerfDecode              decode[CALPerfCounters::FORMAT_COUNT];
+        // bytes read from files
+        std::atomic<uint64_t>   read{ 0 };
+        // streaming underruns
+        std::atomic<uint64_t>   underruns{ 0 };
+        // memory of clip buffers
+        std::atomic<int64_t>    clip_memory{ 0 };
+    };
+    // counters of process
+    static PerfData s_perf;
+    // bucket of pass time, quarter octaves
+    static inline auto perf_bucket(uint32_t us) noexcept -> uint32_t {
+        const auto index = uint32_t(std::log2(float(us) + 1.f) * 4.f);
+        return std::min(index, uint32_t(CALPerfCounters::PERF_BUCKETS) - 1);
+    }
+    // upper bound of bucket in microsecond
+    static inline auto perf_bound(uint32_t index) noexcept -> float {
+        return std::exp2(float(index + 1) * 0.25f) - 1.f;
+    }
+    // relaxed
+    static constexpr auto relaxed = std::memory_order_relaxed;
+}
+
+/// <summary>
+/// Resets all counters, memory of clip buffers kept.
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALPerfCounters::Reset() noexcept {
+    auto& p = s_perf;
+    p.passes.store(0, relaxed);
+    p.pass_time.store(0, relaxed);
+    p.pass_min.store(~uint32_t(0), relaxed);
+    p.pass_max.store(0, relaxed);
+    for (auto& bucket : p.pass_bucket) bucket.store(0, relaxed);
+    for (auto& decode : p.decode) {
+        decode.calls.store(0, relaxed);
+        decode.time.store(0, relaxed);
+        decode.bytes.store(0, relaxed);
+    }
+    p.read.store(0, relaxed);
+    p.underruns.store(0, relaxed);
+}
+
+/// <summary>
+/// Adds time of processing pass, in audio thread.
+/// 音频线程: 只有累加与比较交换
+/// </summary>
+/// <param name="us">The time in microsecond.</param>
+/// <returns></returns>
+void WrapAL::CALPerfCounters::AddPass(uint32_t us) noexcept {
+    auto& p = s_perf;
+    p.passes.fetch_add(1, relaxed);
+    p.pass_time.fetch_add(us, relaxed);
+    p.pass_bucket[WrapAL::perf_bucket(us)].fetch_add(1, relaxed);
+    // 单一写者, 比较后写入即可
+    if (us < p.pass_min.load(relaxed)) p.pass_min.store(us, relaxed);
+    if (us > p.pass_max.load(relaxed)) p.pass_max.store(us, relaxed);
+}
+
+/// <summary>
+/// Adds decoding of stream in format.
+/// </summary>
+/// <param name="format">The format.</param>
+/// <param name="bytes">The bytes decoded.</param>
+/// <param name="us">The time in microsecond.</param>
+/// <returns></returns>
+void WrapAL::CALPerfCounters::AddDecode(EncodingFormat format, uint32_t bytes, uint32_t us) noexcept {
+    const auto index = std::min(uint32_t(format), uint32_t(FORMAT_COUNT) - 1);
+    auto& decode = s_perf.decode[index];
+    decode.calls.fetch_add(1, relaxed);
+    decode.time.fetch_add(us, relaxed);
+    decode.bytes.fetch_add(bytes, relaxed);
+}
+
+/// <summary>
+/// Adds bytes read from file.
+/// </summary>
+/// <param name="bytes">The bytes.</param>
+/// <returns></returns>
+void WrapAL::CALPerfCounters::AddRead(uint32_t bytes) noexcept {
+    s_perf.read.fetch_add(bytes, relaxed);
+}
+
+/// <summary>
+/// Adds streaming underrun.
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALPerfCounters::AddUnderrun() noexcept {
+    s_perf.underruns.fetch_add(1, relaxed);
+}
+
+/// <summary>
+/// Adds memory of clip buffers.
+/// </summary>
+/// <param name="bytes">The bytes, negative for freed.</param>
+/// <returns></returns>
+void WrapAL::CALPerfCounters::AddClipMemory(int64_t bytes) noexcept {
+    s_perf.clip_memory.fetch_add(bytes, relaxed);
+}
+
+/// <summary>
+/// Gets the counters, voice counts and glitches not filled.
+/// 读取计数器: 各计数分别读取, 不是同一时刻的快照
+/// </summary>
+/// <param name="data">The data.</param>
+/// <returns></returns>
+void WrapAL::CALPerfCounters::Get(AudioPerformanceData& data) noexcept {
+    const auto& p = s_perf;
+    const auto passes = p.passes.load(relaxed);
+    data.passes = passes;
+    data.callback_min = passes ? float(p.pass_min.load(relaxed)) : 0.f;
+    data.callback_max = float(p.pass_max.load(relaxed));
+    data.callback_avg = passes ? float(double(p.pass_time.load(relaxed)) / double(passes)) : 0.f;
+    // 直方图: 第一个累计达到 99% 的区间上界
+    uint64_t total = 0, count[PERF_BUCKETS];
+    for (uint32_t i = 0; i != PERF_BUCKETS; ++i) total += count[i] = p.pass_bucket[i].load(relaxed);
+    data.callback_p99 = 0.f;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i != PERF_BUCKETS && total; ++i) {
+        sum += count[i];
+        if (sum * 100 < total * 99) continue;
+        data.callback_p99 = std::min(WrapAL::perf_bound(i), data.callback_max);
+        break;
+    }
+    data.bytes_decoded = 0;
+    for (uint32_t i = 0; i != FORMAT_COUNT; ++i) {
+        auto& decode = data.decode[i];
+        decode.calls = p.decode[i].calls.load(relaxed);
+        decode.time = p.decode[i].time.load(relaxed);
+        decode.bytes = p.decode[i].bytes.load(relaxed);
+        data.bytes_decoded += decode.bytes;
+    }
+    data.bytes_read = p.read.load(relaxed);
+    data.underruns = p.underruns.load(relaxed);
+    data.clip_memory = uint64_t(std::max(p.clip_memory.load(relaxed), int64_t(0)));
+}
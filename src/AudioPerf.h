@@ -0,0 +1,77 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL performance counters, cumulative and lock-free, cheap enough to keep:
+    audio thread  -> processing pass time -> total/min/max + histogram(p99)
+    streams       -> decode time/bytes of each format, bytes read from files
+    clips         -> streaming underruns, memory of buffers
+
+all counters are relaxed atomics, only added by writers; the histogram has
+PERF_BUCKETS quarter-octave buckets from 1us, p99 is the upper bound of the
+bucket that reaches 99% of passes.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for atomic
+#include <atomic>
+// for steady_clock
+#include <chrono>
+// include the config
+#include "wrapalconf.h"
+// include the common
+#include "wrapal_common.h"
+
+// wrapal namespace
+namespace WrapAL {
+    // now in microsecond
+    static inline auto now_us() noexcept -> int64_t {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+    // performance counters, all static
+    class CALPerfCounters {
+    public:
+        // count of buckets of pass time, count of encoding formats
+        enum : uint32_t { PERF_BUCKETS = 64, FORMAT_COUNT = uint32_t(EncodingFormat::Format_UserDefined) + 1 };
+    public:
+        // reset all counters
+        static void Reset() noexcept;
+        // add time of processing pass in microsecond, audio thread
+        static void AddPass(uint32_t us) noexcept;
+        // add decoding of stream in format
+        static void AddDecode(EncodingFormat format, uint32_t bytes, uint32_t us) noexcept;
+        // add bytes read from file
+        static void AddRead(uint32_t bytes) noexcept;
+        // add streaming underrun
+        static void AddUnderrun() noexcept;
+        // add memory of clip buffers in byte, negative for freed
+        static void AddClipMemory(int64_t bytes) noexcept;
+        // get counters, voice counts and glitches not filled
+        static void Get(AudioPerformanceData& data) noexcept;
+    };
+}
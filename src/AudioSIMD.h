@@ -0,0 +1,186 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL SIMD helper, 4 float lanes for DSP and 3D calculation:
+    SSE if the target has it, plain floats otherwise
+
+lanes are channels, filters or emitters(SoA), masks are lanes with all
+bits set, used by select.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for memcpy
+#include <cstring>
+// for sqrt
+#include <cmath>
+// for min/max
+#include <algorithm>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#include <xmmintrin.h>
+#define WRAPAL_SIMD_SSE
+#endif
+
+
+// wrapal namespace
+namespace WrapAL {
+    // SIMD helper
+    namespace simd {
+        // 4 floats in a register
+        struct f4 {
+#ifdef WRAPAL_SIMD_SSE
+            // register
+            __m128 v;
+            // load unaligned
+            static auto load(const float* p) noexcept { return f4{ _mm_loadu_ps(p) }; }
+            // broadcast
+            static auto set(float x) noexcept { return f4{ _mm_set1_ps(x) }; }
+            // store unaligned
+            void store(float* p) const noexcept { _mm_storeu_ps(p, v); }
+            // add
+            friend auto operator +(f4 a, f4 b) noexcept { return f4{ _mm_add_ps(a.v, b.v) }; }
+            // sub
+            friend auto operator -(f4 a, f4 b) noexcept { return f4{ _mm_sub_ps(a.v, b.v) }; }
+            // mul
+            friend auto operator *(f4 a, f4 b) noexcept { return f4{ _mm_mul_ps(a.v, b.v) }; }
+            // div
+            friend auto operator /(f4 a, f4 b) noexcept { return f4{ _mm_div_ps(a.v, b.v) }; }
+            // bitwise and of masks
+            friend auto operator &(f4 a, f4 b) noexcept { return f4{ _mm_and_ps(a.v, b.v) }; }
+            // bitwise or of masks
+            friend auto operator |(f4 a, f4 b) noexcept { return f4{ _mm_or_ps(a.v, b.v) }; }
+            // min of lanes
+            static auto min(f4 a, f4 b) noexcept { return f4{ _mm_min_ps(a.v, b.v) }; }
+            // max of lanes
+            static auto max(f4 a, f4 b) noexcept { return f4{ _mm_max_ps(a.v, b.v) }; }
+            // mask of a < b
+            static auto lt(f4 a, f4 b) noexcept { return f4{ _mm_cmplt_ps(a.v, b.v) }; }
+            // mask of a <= b
+            static auto le(f4 a, f4 b) noexcept { return f4{ _mm_cmple_ps(a.v, b.v) }; }
+            // mask ? a : b
+            static auto select(f4 mask, f4 a, f4 b) noexcept {
+                return f4{ _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+            }
+            // square root
+            auto sqrt() const noexcept { return f4{ _mm_sqrt_ps(v) }; }
+            // absolute value
+            auto abs() const noexcept { return f4{ _mm_andnot_ps(_mm_set1_ps(-0.f), v) }; }
+            // sign bit only
+            auto sign() const noexcept { return f4{ _mm_and_ps(_mm_set1_ps(-0.f), v) }; }
+            // xor sign bit with "s"
+            auto flip(f4 s) const noexcept { return f4{ _mm_xor_ps(v, s.v) }; }
+            // any lane of mask set
+            bool any() const noexcept { return _mm_movemask_ps(v) != 0; }
+            // sum of lanes
+            auto sum() const noexcept {
+                const auto s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+                return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+            }
+            // max lane
+            auto hmax() const noexcept {
+                const auto s = _mm_max_ps(v, _mm_movehl_ps(v, v));
+                return _mm_cvtss_f32(_mm_max_ss(s, _mm_shuffle_ps(s, s, 1)));
+            }
+#else
+            // lanes
+            float v[4];
+            // load unaligned
+            static auto load(const float* p) noexcept { f4 r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+            // broadcast
+            static auto set(float x) noexcept { return f4{ { x, x, x, x } }; }
+            // store unaligned
+            void store(float* p) const noexcept { std::memcpy(p, v, sizeof(v)); }
+            // add
+            friend auto operator +(f4 a, f4 b) noexcept { for (int i = 0; i != 4; ++i) a.v[i] += b.v[i]; return a; }
+            // sub
+            friend auto operator -(f4 a, f4 b) noexcept { for (int i = 0; i != 4; ++i) a.v[i] -= b.v[i]; return a; }
+            // mul
+            friend auto operator *(f4 a, f4 b) noexcept { for (int i = 0; i != 4; ++i) a.v[i] *= b.v[i]; return a; }
+            // div
+            friend auto operator /(f4 a, f4 b) noexcept { for (int i = 0; i != 4; ++i) a.v[i] /= b.v[i]; return a; }
+            // bitwise and of masks
+            friend auto operator &(f4 a, f4 b) noexcept { return bits(a, b, [](uint32_t x, uint32_t y) { return x & y; }); }
+            // bitwise or of masks
+            friend auto operator |(f4 a, f4 b) noexcept { return bits(a, b, [](uint32_t x, uint32_t y) { return x | y; }); }
+            // min of lanes
+            static auto min(f4 a, f4 b) noexcept { for (int i = 0; i != 4; ++i) a.v[i] = b.v[i] < a.v[i] ? b.v[i] : a.v[i]; return a; }
+            // max of lanes
+            static auto max(f4 a, f4 b) noexcept { for (int i = 0; i != 4; ++i) a.v[i] = b.v[i] > a.v[i] ? b.v[i] : a.v[i]; return a; }
+            // mask of a < b
+            static auto lt(f4 a, f4 b) noexcept { for (int i = 0; i != 4; ++i) a.v[i] = mask(a.v[i] < b.v[i]); return a; }
+            // mask of a <= b
+            static auto le(f4 a, f4 b) noexcept { for (int i = 0; i != 4; ++i) a.v[i] = mask(a.v[i] <= b.v[i]); return a; }
+            // mask ? a : b
+            static auto select(f4 m, f4 a, f4 b) noexcept {
+                return bits(m, a, [](uint32_t x, uint32_t y) { return x & y; })
+                    | bits(m, b, [](uint32_t x, uint32_t y) { return ~x & y; });
+            }
+            // square root
+            auto sqrt() const noexcept { f4 r; for (int i = 0; i != 4; ++i) r.v[i] = std::sqrt(v[i]); return r; }
+            // absolute value
+            auto abs() const noexcept { f4 r; for (int i = 0; i != 4; ++i) r.v[i] = std::fabs(v[i]); return r; }
+            // sign bit only
+            auto sign() const noexcept { return bits(*this, set(-0.f), [](uint32_t x, uint32_t y) { return x & y; }); }
+            // xor sign bit with "s"
+            auto flip(f4 s) const noexcept { return bits(*this, s, [](uint32_t x, uint32_t y) { return x ^ y; }); }
+            // any lane of mask set
+            bool any() const noexcept {
+                uint32_t u[4]; std::memcpy(u, v, sizeof(u));
+                return !!((u[0] | u[1] | u[2] | u[3]) & 0x80000000u);
+            }
+            // sum of lanes
+            auto sum() const noexcept { return v[0] + v[1] + v[2] + v[3]; }
+            // max lane
+            auto hmax() const noexcept { return std::max(std::max(v[0], v[1]), std::max(v[2], v[3])); }
+        private:
+            // lane of mask
+            static float mask(bool b) noexcept { float f; const uint32_t u = b ? ~0u : 0u; std::memcpy(&f, &u, sizeof(f)); return f; }
+            // bitwise operation on lanes
+            template<typename T> static f4 bits(f4 a, f4 b, T op) noexcept {
+                uint32_t x[4], y[4]; std::memcpy(x, a.v, sizeof(x)); std::memcpy(y, b.v, sizeof(y));
+                for (int i = 0; i != 4; ++i) x[i] = op(x[i], y[i]);
+                std::memcpy(a.v, x, sizeof(x)); return a;
+            }
+#endif
+        };
+        // load "n" lanes, others zero
+        static inline auto load_lanes(const float* p, uint32_t n) noexcept {
+            if (n == 4) return f4::load(p);
+            float tmp[4] = { 0.f };
+            std::memcpy(tmp, p, sizeof(float) * n);
+            return f4::load(tmp);
+        }
+        // store "n" lanes
+        static inline void store_lanes(f4 x, float* p, uint32_t n) noexcept {
+            if (n == 4) return x.store(p);
+            float tmp[4];
+            x.store(tmp);
+            std::memcpy(p, tmp, sizeof(float) * n);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <cstdlib>
+#include <cassert>
+#include <new>
+#include <thread>
+#include "AudioSlotMap.h"
+
+// generation bits in handle
+enum : uint32_t { ClipSlotGenerationBits = sizeof(WrapAL::ALHandle) * 8 - WrapAL::ClipSlotIndexBits };
+// generation mask
+static constexpr uint32_t GenerationMask = ClipSlotGenerationBits >= 32 ?
+    ~uint32_t(0) : (1u << (ClipSlotGenerationBits & 31)) - 1;
+
+/// <summary>
+/// Initializes a new instance of the <see cref="CALClipSlotMap"/> class.
+/// </summary>
+WrapAL::CALClipSlotMap::CALClipSlotMap() noexcept {
+    for (auto& chunk : m_apChunk) chunk.store(nullptr, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="CALClipSlotMap"/> class.
+/// </summary>
+WrapAL::CALClipSlotMap::~CALClipSlotMap() noexcept {
+    assert(!m_cLive && "clip leaked");
+    for (auto& chunk : m_apChunk) {
+        if (const auto slots = chunk.load(std::memory_order_relaxed)) {
+            for (uint32_t i = 0; i != ClipSlotChunkSize; ++i) slots[i].~Slot();
+            std::free(slots);
+        }
+    }
+}
+
+/// <summary>
+/// Gets the slot.
+/// </summary>
+/// <param name="index">The index.</param>
+/// <returns>null if chunk not allocated</returns>
+auto WrapAL::CALClipSlotMap::get_slot(uint32_t index) const noexcept -> Slot* {
+    const auto chunk = m_apChunk[index / ClipSlotChunkSize].load(std::memory_order_acquire);
+    return chunk ? chunk + (index & (ClipSlotChunkSize - 1)) : nullptr;
+}
+
+/// <summary>
+/// Inserts the specified clip.
+/// 插入片段, 获取句柄
+/// </summary>
+/// <param name="clip">The clip.</param>
+/// <returns>ALInvalidHandle if full or OOM</returns>
+auto WrapAL::CALClipSlotMap::Insert(CALAudioSourceClipImpl& clip) noexcept -> ALHandle {
+    std::lock_guard<std::mutex> locker(m_mutex);
+    uint32_t index = m_uFreeList;
+    Slot* slot = nullptr;
+    // 复用空闲槽
+    if (index != ClipSlotMaxCount) {
+        slot = this->get_slot(index);
+        m_uFreeList = slot->next_free;
+    }
+    // 新的槽
+    else {
+        if (m_cSlot == ClipSlotMaxCount) return ALInvalidHandle;
+        index = m_cSlot;
+        auto& chunk = m_apChunk[index / ClipSlotChunkSize];
+        // 申请新的块, 块一旦申请不再移动
+        if (!chunk.load(std::memory_order_relaxed)) {
+            const auto slots = reinterpret_cast<Slot*>(std::malloc(sizeof(Slot) * ClipSlotChunkSize));
+            if (!slots) return ALInvalidHandle;
+            for (uint32_t i = 0; i != ClipSlotChunkSize; ++i) {
+                const auto s = new (slots + i) Slot;
+                s->clip.store(nullptr, std::memory_order_relaxed);
+                s->generation.store(1, std::memory_order_relaxed);
+                s->readers.store(0, std::memory_order_relaxed);
+                s->next_free = ClipSlotMaxCount;
+            }
+            chunk.store(slots, std::memory_order_release);
+        }
+        slot = this->get_slot(index);
+        ++m_cSlot;
+    }
+    ++m_cLive;
+    slot->clip.store(&clip, std::memory_order_release);
+    return make_handle(index, slot->generation.load(std::memory_order_relaxed));
+}
+
+/// <summary>
+/// Removes the clip by handle.
+/// 移除片段, 旧句柄失效
+/// </summary>
+/// <param name="handle">The handle.</param>
+/// <returns></returns>
+void WrapAL::CALClipSlotMap::Remove(ALHandle handle) noexcept {
+    if (handle == ALInvalidHandle) return;
+    const auto index = static_cast<uint32_t>(handle & IndexMask);
+    const auto gen = static_cast<uint32_t>(handle >> ClipSlotIndexBits);
+    std::lock_guard<std::mutex> locker(m_mutex);
+    const auto slot = this->get_slot(index);
+    assert(slot && slot->generation.load(std::memory_order_relaxed) == gen);
+    if (!slot || slot->generation.load(std::memory_order_relaxed) != gen) return;
+    // 世代增加, 跳过0
+    auto next = (gen + 1) & GenerationMask;
+    if (!next) next = 1;
+    slot->generation.store(next);
+    slot->clip.store(nullptr, std::memory_order_release);
+    // 等待正在查找的线程, 之后片段可以释放
+    while (slot->readers.load()) std::this_thread::yield();
+    slot->next_free = m_uFreeList;
+    m_uFreeList = index;
+    --m_cLive;
+}
+
+/// <summary>
+/// Finds the clip by handle, under the lock which removing runs under.
+/// 查找片段, 过期句柄返回null
+/// </summary>
+/// <param name="handle">The handle.</param>
+/// <returns></returns>
+auto WrapAL::CALClipSlotMap::Find(ALHandle handle) const noexcept -> CALAudioSourceClipImpl* {
+    const auto index = static_cast<uint32_t>(handle & IndexMask);
+    const auto gen = static_cast<uint32_t>(handle >> ClipSlotIndexBits);
+    const auto slot = this->get_slot(index);
+    if (!slot) return nullptr;
+    const auto clip = slot->clip.load(std::memory_order_acquire);
+    // 读取指针后再检查世代
+    return slot->generation.load(std::memory_order_acquire) == gen ? clip : nullptr;
+}
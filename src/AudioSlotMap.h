@@ -0,0 +1,128 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL clip handle table, ALHandle of clip is not a pointer:
+    handle = generation << ClipSlotIndexBits | index
+
+slot array is chunked, chunk never moved once allocated, so finding
+is lock-free. a slot's generation increases when clip destroyed, then
+stale handles find nothing.
+
+a finding thread pins the slot while it adds the reference, removing
+waits for pins to leave, so a clip found is never freed under it.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for atomic
+#include <atomic>
+// for mutex
+#include <mutex>
+// include the config
+#include "wrapalconf.h"
+// include the common
+#include "wrapal_common.h"
+
+
+// wrapal namespace
+namespace WrapAL {
+    // Audio Source Clip implement
+    class CALAudioSourceClipImpl;
+    // generational slot map for clip handles
+    class CALClipSlotMap {
+        // slot of map
+        struct Slot {
+            // clip in slot, null if free
+            std::atomic<CALAudioSourceClipImpl*>    clip;
+            // generation, never 0
+            std::atomic<uint32_t>                   generation;
+            // threads finding in slot, removing waits for 0
+            std::atomic<uint32_t>                   readers;
+            // next free slot, under lock
+            uint32_t                                next_free;
+        };
+        // chunk count
+        enum : uint32_t { ChunkCount = ClipSlotMaxCount / ClipSlotChunkSize };
+        // index mask
+        enum : uint32_t { IndexMask = (1u << ClipSlotIndexBits) - 1 };
+        // check
+        static_assert(ClipSlotMaxCount == (1u << ClipSlotIndexBits), "bad max count");
+        static_assert((ClipSlotChunkSize & (ClipSlotChunkSize - 1)) == 0, "bad chunk size");
+    public:
+        // ctor
+        CALClipSlotMap() noexcept;
+        // dtor
+        ~CALClipSlotMap() noexcept;
+        // insert clip, return ALInvalidHandle if full or OOM
+        auto Insert(CALAudioSourceClipImpl& clip) noexcept ->ALHandle;
+        // remove clip by handle, bump generation, wait for finding threads
+        void Remove(ALHandle handle) noexcept;
+        // find clip by handle, null if stale, under the lock which removing runs under
+        auto Find(ALHandle handle) const noexcept ->CALAudioSourceClipImpl*;
+        // find clip by handle in any thread and call add_ref(clip) while pinned, null if stale or add_ref failed
+        template<typename T> auto Acquire(ALHandle handle, T add_ref) const noexcept ->CALAudioSourceClipImpl* {
+            const auto slot = this->get_slot(static_cast<uint32_t>(handle & IndexMask));
+            if (!slot) return nullptr;
+            // 钉住槽, 移除时等待
+            slot->readers.fetch_add(1);
+            auto clip = slot->clip.load(std::memory_order_acquire);
+            // 读取指针后再检查世代, 槽可能已经复用
+            if (clip && (slot->generation.load() != static_cast<uint32_t>(handle >> ClipSlotIndexBits) || !add_ref(*clip)))
+                clip = nullptr;
+            slot->readers.fetch_sub(1, std::memory_order_release);
+            return clip;
+        }
+        // count of live clips
+        auto Count() const noexcept { return m_cLive; }
+        // call for each live clip under lock, don't insert/remove in call
+        template<typename T> void ForEach(T call) noexcept {
+            std::lock_guard<std::mutex> locker(m_mutex);
+            for (uint32_t i = 0; i != m_cSlot; ++i) {
+                const auto clip = this->get_slot(i)->clip.load(std::memory_order_relaxed);
+                if (clip) call(*clip);
+            }
+        }
+    private:
+        // get slot, null if chunk not allocated
+        auto get_slot(uint32_t index) const noexcept ->Slot*;
+        // make handle
+        static auto make_handle(uint32_t index, uint32_t gen) noexcept {
+            return (static_cast<ALHandle>(gen) << ClipSlotIndexBits) | index;
+        }
+    private:
+        // chunks of slots
+        std::atomic<Slot*>      m_apChunk[ChunkCount];
+        // locker for insert/remove
+        std::mutex              m_mutex;
+        // first free slot, ClipSlotMaxCount for nothing
+        uint32_t                m_uFreeList = ClipSlotMaxCount;
+        // slot count ever used
+        uint32_t                m_cSlot = 0;
+        // count of live clips
+        uint32_t                m_cLive = 0;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,274 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <cassert>
+#include <mutex>
+#include "AudioSmallAlloc.h"
+
+// wrapal namespace
+namespace WrapAL {
+    // slab header, at head of SmallSlabSize-aligned memory
+    struct alignas(16) SmallSlab {
+        // prev slab in partial list
+        SmallSlab*      prev;
+        // next slab in partial list
+        SmallSlab*      next;
+        // first free object
+        void*           free;
+        // count of objects out of this slab
+        uint32_t        used;
+        // count of objects
+        uint32_t        capacity;
+        // size class index
+        uint32_t        index;
+    };
+    // size class, shared by threads
+    struct SmallClass {
+        // lock for this class
+        std::mutex      mutex;
+        // slabs with free objects
+        SmallSlab*      partial = nullptr;
+        // a free slab kept for reuse
+        SmallSlab*      empty = nullptr;
+        // count of slabs
+        uint32_t        slabs = 0;
+        // count of objects out of slabs
+        uint32_t        objects = 0;
+        // count of refills
+        uint32_t        refills = 0;
+    };
+    // thread cache of size classes
+    struct SmallCache {
+        // dtor, flush all
+        ~SmallCache() noexcept;
+        // free list of each class
+        void*           head[CALSmallAllocator::CLASS_COUNT] = {};
+        // count of each class
+        uint32_t        count[CALSmallAllocator::CLASS_COUNT] = {};
+    };
+    // next object in free list
+    static inline auto small_next(void* obj) noexcept -> void*& {
+        return *reinterpret_cast<void**>(obj);
+    }
+    // slab of object
+    static inline auto small_slab(void* obj) noexcept -> SmallSlab* {
+        const auto addr = reinterpret_cast<uintptr_t>(obj);
+        return reinterpret_cast<SmallSlab*>(addr & ~uintptr_t(SmallSlabSize - 1));
+    }
+    // classes
+    static SmallClass s_classes[CALSmallAllocator::CLASS_COUNT];
+    // cache of this thread
+    static thread_local SmallCache t_cache;
+    // cache of this thread destroyed, trivial so valid during thread exit
+    static thread_local bool t_cache_dead = false;
+    // check
+    static_assert(CALSmallAllocator::CLASS_COUNT == CALSmallAllocator::ClassIndex(SmallSpaceThreshold) + 1, "bad class count");
+    static_assert((SmallSlabSize & (SmallSlabSize - 1)) == 0, "slab size must be power of 2");
+    static_assert(SmallCacheLength >= 2, "cache too small");
+}
+
+/// <summary>
+/// Creates new slab for size class, under lock
+/// 为尺寸类创建新的板, 锁内调用
+/// </summary>
+/// <param name="index">The class index.</param>
+/// <returns>null if out of memory</returns>
+static auto small_new_slab(uint32_t index) noexcept -> WrapAL::SmallSlab* {
+    using namespace WrapAL;
+    // VirtualAlloc按分配粒度(64KB)对齐
+    const auto ptr = ::VirtualAlloc(nullptr, SmallSlabSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!ptr) return nullptr;
+    assert(small_slab(ptr) == ptr && "slab not aligned");
+    const auto slab = reinterpret_cast<SmallSlab*>(ptr);
+    const auto size = CALSmallAllocator::ClassSize(index);
+    const auto capacity = uint32_t(SmallSlabSize - sizeof(SmallSlab)) / size;
+    slab->prev = nullptr;
+    slab->next = nullptr;
+    slab->used = 0;
+    slab->capacity = capacity;
+    slab->index = index;
+    // 串起空闲链表
+    auto obj = reinterpret_cast<char*>(slab + 1);
+    slab->free = obj;
+    for (uint32_t i = 1; i != capacity; ++i, obj += size) small_next(obj) = obj + size;
+    small_next(obj) = nullptr;
+    ++s_classes[index].slabs;
+    return slab;
+}
+
+/// <summary>
+/// Refills the thread cache from slabs.
+/// 从板补充线程缓存
+/// </summary>
+/// <param name="cache">The cache.</param>
+/// <param name="index">The class index.</param>
+/// <returns></returns>
+static void small_refill(WrapAL::SmallCache& cache, uint32_t index) noexcept {
+    using namespace WrapAL;
+    auto& sc = s_classes[index];
+    std::lock_guard<std::mutex> locker(sc.mutex);
+    uint32_t moved = 0;
+    while (moved < SmallCacheLength / 2) {
+        auto slab = sc.partial;
+        if (!slab) {
+            // 优先使用保留的空板
+            if ((slab = sc.empty)) sc.empty = nullptr;
+            else if (!(slab = small_new_slab(index))) break;
+            sc.partial = slab;
+        }
+        // 从板中取出对象
+        while (slab->free && moved < SmallCacheLength / 2) {
+            const auto obj = slab->free;
+            slab->free = small_next(obj);
+            small_next(obj) = cache.head[index];
+            cache.head[index] = obj;
+            ++slab->used;
+            ++moved;
+        }
+        // 用完了, 移出链表
+        if (!slab->free) {
+            sc.partial = slab->next;
+            if (slab->next) slab->next->prev = nullptr;
+            slab->next = nullptr;
+        }
+    }
+    cache.count[index] += moved;
+    sc.objects += moved;
+    if (moved) ++sc.refills;
+}
+
+/// <summary>
+/// Puts object back to its slab, under lock of class.
+/// 将对象归还到板, 锁内调用
+/// </summary>
+/// <param name="sc">The class.</param>
+/// <param name="index">The class index.</param>
+/// <param name="obj">The object.</param>
+/// <returns></returns>
+static void small_put(WrapAL::SmallClass& sc, uint32_t index, void* obj) noexcept {
+    using namespace WrapAL;
+    const auto slab = small_slab(obj);
+    assert(slab->index == index && "object freed to bad class");
+    // 满板重新加入链表
+    if (!slab->free) {
+        slab->prev = nullptr;
+        slab->next = sc.partial;
+        if (sc.partial) sc.partial->prev = slab;
+        sc.partial = slab;
+    }
+    small_next(obj) = slab->free;
+    slab->free = obj;
+    if (--slab->used) return;
+    // 空板: 移出链表, 保留一个, 其余释放
+    if (slab->prev) slab->prev->next = slab->next;
+    else sc.partial = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->prev = slab->next = nullptr;
+    if (!sc.empty) { sc.empty = slab; return; }
+    --sc.slabs;
+    ::VirtualFree(slab, 0, MEM_RELEASE);
+}
+
+/// <summary>
+/// Flushes objects of thread cache to slabs.
+/// 将线程缓存的对象归还到板
+/// </summary>
+/// <param name="cache">The cache.</param>
+/// <param name="index">The class index.</param>
+/// <param name="count">The count to flush.</param>
+/// <returns></returns>
+static void small_flush(WrapAL::SmallCache& cache, uint32_t index, uint32_t count) noexcept {
+    using namespace WrapAL;
+    auto& sc = s_classes[index];
+    std::lock_guard<std::mutex> locker(sc.mutex);
+    assert(count <= cache.count[index]);
+    cache.count[index] -= count;
+    sc.objects -= count;
+    while (count--) {
+        const auto obj = cache.head[index];
+        cache.head[index] = small_next(obj);
+        small_put(sc, index, obj);
+    }
+}
+
+/// <summary>
+/// Finalizes an instance of the <see cref="SmallCache"/> class.
+/// 线程退出, 归还所有对象
+/// </summary>
+WrapAL::SmallCache::~SmallCache() noexcept {
+    // 之后的释放直接归还到板
+    t_cache_dead = true;
+    for (uint32_t i = 0; i != CALSmallAllocator::CLASS_COUNT; ++i) {
+        if (count[i]) small_flush(*this, i, count[i]);
+    }
+}
+
+/// <summary>
+/// Allocs a small space.
+/// 申请小空间
+/// </summary>
+/// <param name="length">The length.</param>
+/// <returns>null if out of memory</returns>
+auto WrapAL::CALSmallAllocator::Alloc(size_t length) noexcept -> void* {
+    assert(length <= SmallSpaceThreshold && "too large for small allocator");
+    if (length > SmallSpaceThreshold) return nullptr;
+    const auto index = ClassIndex(length);
+    auto& cache = t_cache;
+    if (!cache.head[index]) small_refill(cache, index);
+    const auto obj = cache.head[index];
+    if (!obj) return nullptr;
+    cache.head[index] = small_next(obj);
+    --cache.count[index];
+    return obj;
+}
+
+/// <summary>
+/// Frees the space alloced via "Alloc".
+/// 释放小空间
+/// </summary>
+/// <param name="address">The address.</param>
+/// <returns></returns>
+void WrapAL::CALSmallAllocator::Free(void* address) noexcept {
+    if (!address) return;
+    const auto index = small_slab(address)->index;
+    assert(index < CLASS_COUNT && "not alloced via small allocator");
+    // 线程缓存已经析构: 静态对象或线程退出后释放
+    if (t_cache_dead) {
+        auto& sc = s_classes[index];
+        std::lock_guard<std::mutex> locker(sc.mutex);
+        --sc.objects;
+        small_put(sc, index, address);
+        return;
+    }
+    auto& cache = t_cache;
+    small_next(address) = cache.head[index];
+    cache.head[index] = address;
+    // 缓存满了, 归还一半
+    if (++cache.count[index] >= SmallCacheLength) {
+        small_flush(cache, index, SmallCacheLength / 2);
+    }
+}
+
+/// <summary>
+/// Gets the statistics.
+/// 获取统计数据
+/// </summary>
+/// <param name="stats">The stats.</param>
+/// <returns></returns>
+void WrapAL::CALSmallAllocator::GetStats(SmallAllocStats& stats) noexcept {
+    stats.slab_size = SmallSlabSize;
+    stats.slabs = 0;
+    stats.reserved = 0;
+    stats.used = 0;
+    for (uint32_t i = 0; i != CLASS_COUNT; ++i) {
+        auto& sc = s_classes[i];
+        auto& out = stats.classes[i];
+        std::lock_guard<std::mutex> locker(sc.mutex);
+        out.size = ClassSize(i);
+        out.slabs = sc.slabs;
+        out.objects = sc.objects;
+        out.refills = sc.refills;
+        stats.slabs += sc.slabs;
+        stats.used += size_t(sc.objects) * out.size;
+    }
+    stats.reserved = size_t(stats.slabs) * SmallSlabSize;
+}
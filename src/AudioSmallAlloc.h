@@ -0,0 +1,72 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL small allocator, default impl of IALConfigure::SmallAlloc/SmallFree:
+    SmallAlloc -> thread cache of class -> (batch) slab lists of class -> new slab
+
+size classes step 16-byte up to 128, step 32-byte up to SmallSpaceThreshold.
+slabs are SmallSlabSize-byte and aligned to it(allocation granularity of
+VirtualAlloc), so SmallFree finds the slab header and the class via address.
+a thread caches up to SmallCacheLength objects each class, moves half of them
+from/to slabs under lock of the class, flushes all when the thread exits;
+objects freed after that go back to slabs directly under the lock.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for size_t
+#include <cstddef>
+// include the config
+#include "wrapalconf.h"
+// include the util
+#include "AudioUtil.h"
+
+// wrapal namespace
+namespace WrapAL {
+    // small allocator, all static
+    class CALSmallAllocator {
+    public:
+        // count of size classes
+        enum : uint32_t { CLASS_COUNT = SmallAllocStats::CLASS_COUNT };
+        // get size class index of length
+        static constexpr auto ClassIndex(size_t length) noexcept ->uint32_t {
+            if (length <= 128) return length ? uint32_t(length - 1) / 16 : 0;
+            return uint32_t(length - 129) / 32 + 8;
+        }
+        // get object size of size class
+        static constexpr auto ClassSize(uint32_t index) noexcept ->uint32_t {
+            return index < 8 ? (index + 1) * 16 : (index - 8 + 1) * 32 + 128;
+        }
+    public:
+        // alloc a small space less than SmallSpaceThreshold
+        static auto Alloc(size_t length) noexcept ->void*;
+        // free space that alloced via "Alloc"
+        static void Free(void* address) noexcept;
+        // get statistics
+        static void GetStats(SmallAllocStats& stats) noexcept;
+    };
+}
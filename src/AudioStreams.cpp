@@ -2,6 +2,8 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <Windows.h>
 #include "AudioEngine.h"
+#include "AudioSmallAlloc.h"
+#include "AudioPerf.h"
 #include <cassert>
 #include <cwchar>
 #include <new>
@@ -129,7 +131,12 @@ namespace WrapAL {
         // seek stream in byte, return false if out of range
         virtual auto Seek(int32_t off, Move method) noexcept ->uint32_t override;
         // read stream, return byte count read
-        virtual auto ReadNext(uint32_t l, void* b) noexcept ->uint32_t override { return m_pFileStream->ReadNext(l, b); }
+        virtual auto ReadNext(uint32_t l, void* b) noexcept ->uint32_t override {
+            const auto start = WrapAL::now_us();
+            const auto read = m_pFileStream->ReadNext(l, b);
+            CALPerfCounters::AddDecode(EncodingFormat::Format_Wave, read, uint32_t(WrapAL::now_us() - start));
+            return read;
+        }
     private:
         // zero postion offset
         int32_t             m_zeroPosOffset = 0;
@@ -472,6 +479,7 @@ auto WrapAL::CALOggAudioStream::ReadNext(uint32_t len, void* buf) noexcept -> ui
     const auto oldbuf = reinterpret_cast<char*>(buf);
     const auto oldlen = size_t(len);
 #endif
+    const auto start = WrapAL::now_us();
     uint32_t read = 0;
     // 循环读取数据
     while (len) {
@@ -495,6 +503,7 @@ auto WrapAL::CALOggAudioStream::ReadNext(uint32_t len, void* buf) noexcept -> ui
             read += code;
         }
     }
+    CALPerfCounters::AddDecode(EncodingFormat::Format_OggVorbis, read, uint32_t(WrapAL::now_us() - start));
     return read;
 }
 
@@ -644,6 +653,7 @@ auto WrapAL::CALMp3AudioStream::Seek(int32_t off, Move method) noexcept -> uint3
 /// <param name="buf">The buf.</param>
 /// <returns></returns>
 auto WrapAL::CALMp3AudioStream::ReadNext(uint32_t len, void* buf) noexcept -> uint32_t {
+    const auto start = WrapAL::now_us();
     size_t real_size = 0;
     if (auto i = Mpg123::mpg123_read(m_hMpg123, reinterpret_cast<unsigned char*>(buf), len, &real_size)) {
         if (i == MPG123_ERR || i > 0) {
@@ -653,6 +663,7 @@ auto WrapAL::CALMp3AudioStream::ReadNext(uint32_t len, void* buf) noexcept -> ui
 #endif
         }
     }
+    CALPerfCounters::AddDecode(EncodingFormat::Format_Mpg123, uint32_t(real_size), uint32_t(WrapAL::now_us() - start));
     return uint32_t(real_size);
 }
 
@@ -760,7 +771,7 @@ void WrapAL::CALDefConfigure::OutputError(const wchar_t* err) noexcept {
 /// <param name="length">The length.</param>
 /// <returns></returns>
 void*WrapAL::CALDefConfigure::SmallAlloc(size_t length) noexcept {
-    return std::malloc(length);
+    return CALSmallAllocator::Alloc(length);
 }
 
 /// <summary>
@@ -769,7 +780,17 @@ void*WrapAL::CALDefConfigure::SmallAlloc(size_t length) noexcept {
 /// <param name="ptr">The PTR.</param>
 /// <returns></returns>
 void WrapAL::CALDefConfigure::SmallFree(void* ptr) noexcept {
-    std::free(ptr);
+    CALSmallAllocator::Free(ptr);
+}
+
+/// <summary>
+/// Gets the statistics of small allocator.
+/// 获取小空间分配器统计数据
+/// </summary>
+/// <param name="stats">The stats.</param>
+/// <returns></returns>
+void WrapAL::CALDefConfigure::GetSmallAllocStats(SmallAllocStats& stats) noexcept {
+    CALSmallAllocator::GetStats(stats);
 }
 
 #endif
@@ -848,6 +869,7 @@ namespace WrapAL {
             if (this->OK()) {
                 DWORD read = 0;
                 ::ReadFile(m_hFile, buf, len, &read, nullptr);
+                CALPerfCounters::AddRead(read);
                 m_cOffset += read;
                 if (m_cOffset > m_cLength) {
                     m_cOffset = m_cLength;
@@ -0,0 +1,296 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <cstdlib>
+#include <cassert>
+#include <thread>
+#include <new>
+#include "AudioVoicePool.h"
+
+/// <summary>
+/// Detaches the owner, waits for callbacks running.
+/// 解除所有者, 等待正在执行的回调
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALPooledVoice::Detach() noexcept {
+    m_pOwner.store(nullptr);
+    while (m_cBusy.load()) std::this_thread::yield();
+}
+
+/// <summary>
+/// Retires the memory of owner, flushed buffers may still read it.
+/// 接管所有者的内存, 声音重用或摧毁时释放
+/// </summary>
+/// <param name="data">The data.</param>
+/// <returns>false if full</returns>
+bool WrapAL::CALPooledVoice::Retire(void* data) noexcept {
+    for (auto& block : this->retired) {
+        if (block) continue;
+        block = data;
+        return true;
+    }
+    return false;
+}
+
+/// <summary>
+/// Frees the retired memory.
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALPooledVoice::FreeRetired() noexcept {
+    for (auto& block : this->retired) {
+        std::free(block);
+        block = nullptr;
+    }
+}
+
+/// <summary>
+/// Creates new voice.
+/// </summary>
+/// <param name="wave">The wave format.</param>
+/// <param name="flags">The flags of voice creation.</param>
+/// <returns>null if failed</returns>
+auto WrapAL::CALVoicePool::create(const WAVEFORMATEX& wave, uint32_t flags) noexcept -> CALPooledVoice* {
+    assert(m_pEngine && "call Init first");
+    const auto ptr = std::malloc(sizeof(CALPooledVoice));
+    if (!ptr) return nullptr;
+    const auto pooled = new (ptr) CALPooledVoice;
+    pooled->key = VoiceFormatKey::Make(wave, flags);
+    const auto hr = m_pEngine->CreateSourceVoice(
+        &pooled->voice,
+        &wave,
+        flags, XAUDIO2_DEFAULT_FREQ_RATIO,
+        pooled, nullptr, nullptr
+    );
+    if (FAILED(hr)) {
+        pooled->~CALPooledVoice();
+        std::free(ptr);
+        return nullptr;
+    }
+    return pooled;
+}
+
+/// <summary>
+/// Destroys the voice.
+/// </summary>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+void WrapAL::CALVoicePool::destroy(CALPooledVoice& voice) noexcept {
+    // 同步摧毁, 之后不再读取数据
+    if (voice.voice) voice.voice->DestroyVoice();
+    voice.FreeRetired();
+    voice.~CALPooledVoice();
+    std::free(&voice);
+}
+
+/// <summary>
+/// Finds or adds the bucket of format, under lock.
+/// </summary>
+/// <param name="key">The key.</param>
+/// <returns>null if full</returns>
+auto WrapAL::CALVoicePool::bucket(const VoiceFormatKey& key) noexcept -> Bucket* {
+    for (uint32_t i = 0; i != m_cBucket; ++i) {
+        if (m_aBucket[i].key == key) return m_aBucket + i;
+    }
+    if (m_cBucket == VoicePoolFormatCount) return nullptr;
+    auto& bucket = m_aBucket[m_cBucket++];
+    bucket.key = key;
+    bucket.head = bucket.tail = nullptr;
+    bucket.count = 0;
+    bucket.capacity = VoicePoolLength;
+    return &bucket;
+}
+
+/// <summary>
+/// Pushes the free voice to bucket, under lock.
+/// </summary>
+/// <param name="bucket">The bucket.</param>
+/// <param name="voice">The voice.</param>
+/// <returns>false if full</returns>
+bool WrapAL::CALVoicePool::push(Bucket& bucket, CALPooledVoice& voice) noexcept {
+    if (bucket.count >= bucket.capacity) return false;
+    voice.next = nullptr;
+    if (bucket.tail) bucket.tail->next = &voice;
+    else bucket.head = &voice;
+    bucket.tail = &voice;
+    ++bucket.count;
+    return true;
+}
+
+/// <summary>
+/// Acquires a voice for owner, creates new one if no free voice.
+/// 获取声音, 没有可用的则创建
+/// </summary>
+/// <param name="wave">The wave format.</param>
+/// <param name="flags">The flags of voice creation.</param>
+/// <param name="owner">The owner.</param>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+auto WrapAL::CALVoicePool::Acquire(const WAVEFORMATEX& wave, uint32_t flags,
+    IXAudio2VoiceCallback& owner, CALPooledVoice*& voice) noexcept -> HRESULT {
+    const auto key = VoiceFormatKey::Make(wave, flags);
+    voice = nullptr;
+    m_mutex.lock();
+    if (const auto bucket = this->bucket(key)) {
+        const auto head = bucket->head;
+        // 最旧的一个已经过了两次处理
+        if (head && m_uPass.load() - head->pass >= VoicePoolDelayPass) {
+            bucket->head = head->next;
+            if (!bucket->head) bucket->tail = nullptr;
+            --bucket->count;
+            voice = head;
+        }
+    }
+    m_mutex.unlock();
+    // 刷新的缓冲区已经结束
+    if (voice) voice->FreeRetired();
+    // 创建新的
+    if (!voice) voice = this->create(wave, flags);
+    if (!voice) return E_OUTOFMEMORY;
+    voice->next = nullptr;
+    voice->Attach(owner);
+    return S_OK;
+}
+
+/// <summary>
+/// Recycles the voice, owner will never be called after this.
+/// 回收声音, 之后不再调用所有者, 不能在音频线程调用
+/// </summary>
+/// <param name="voice">The voice.</param>
+/// <returns></returns>
+void WrapAL::CALVoicePool::Recycle(CALPooledVoice& voice) noexcept {
+    voice.Detach();
+    const auto source = voice.voice;
+    // 重置状态
+    source->Stop(0);
+    source->FlushSourceBuffers();
+    source->SetVolume(1.f);
+    source->SetFrequencyRatio(1.f);
+    source->SetOutputVoices(nullptr);
+    if (voice.key.flags & XAUDIO2_VOICE_USEFILTER) {
+        const XAUDIO2_FILTER_PARAMETERS filter = { LowPassFilter, XAUDIO2_DEFAULT_FILTER_FREQUENCY, 1.f };
+        source->SetFilterParameters(&filter);
+    }
+    voice.pass = m_uPass.load();
+    m_mutex.lock();
+    const auto bucket = this->bucket(voice.key);
+    const auto ok = bucket && this->push(*bucket, voice);
+    m_mutex.unlock();
+    // 满了就摧毁
+    if (!ok) CALVoicePool::destroy(voice);
+}
+
+/// <summary>
+/// Retires the memory read by flushed buffers of recycled voice, freed after delay.
+/// 没有声音可以接管的内存, 延迟释放
+/// </summary>
+/// <param name="data">The data.</param>
+/// <returns></returns>
+void WrapAL::CALVoicePool::Retire(void* data) noexcept {
+    if (!data) return;
+    const auto node = reinterpret_cast<RetiredMemory*>(std::malloc(sizeof(RetiredMemory)));
+    // 内存不足: 宁可泄漏也不能提前释放
+    if (!node) return;
+    node->next = nullptr;
+    node->data = data;
+    node->pass = m_uPass.load();
+    m_mutex.lock();
+    if (m_pRetiredTail) m_pRetiredTail->next = node;
+    else m_pRetired = node;
+    m_pRetiredTail = node;
+    m_mutex.unlock();
+}
+
+/// <summary>
+/// Frees the retired memory after delay, of free voices and retired list.
+/// 释放已过延迟的内存
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALVoicePool::Collect() noexcept {
+    const auto pass = m_uPass.load();
+    RetiredMemory* list = nullptr;
+    m_mutex.lock();
+    // 空闲声音: 从旧到新
+    for (uint32_t i = 0; i != m_cBucket; ++i) {
+        for (auto voice = m_aBucket[i].head; voice; voice = voice->next) {
+            if (pass - voice->pass < VoicePoolDelayPass) break;
+            voice->FreeRetired();
+        }
+    }
+    // 链表: 从旧到新
+    auto last = &list;
+    while (m_pRetired && pass - m_pRetired->pass >= VoicePoolDelayPass) {
+        *last = m_pRetired;
+        last = &m_pRetired->next;
+        m_pRetired = m_pRetired->next;
+    }
+    *last = nullptr;
+    if (!m_pRetired) m_pRetiredTail = nullptr;
+    m_mutex.unlock();
+    // 锁外释放
+    while (list) {
+        const auto next = list->next;
+        std::free(list->data);
+        std::free(list);
+        list = next;
+    }
+}
+
+/// <summary>
+/// Creates voices in advance, raises capacity of this format if less.
+/// 预先创建声音
+/// </summary>
+/// <param name="wave">The wave format.</param>
+/// <param name="flags">The flags of voice creation.</param>
+/// <param name="count">The count.</param>
+/// <returns></returns>
+auto WrapAL::CALVoicePool::Prewarm(const WAVEFORMATEX& wave, uint32_t flags, uint32_t count) noexcept -> HRESULT {
+    const auto key = VoiceFormatKey::Make(wave, flags);
+    uint32_t now = 0;
+    m_mutex.lock();
+    const auto bucket = this->bucket(key);
+    if (bucket) {
+        if (bucket->capacity < count) bucket->capacity = count;
+        now = bucket->count;
+    }
+    m_mutex.unlock();
+    if (!bucket) return E_OUTOFMEMORY;
+    // 锁外创建
+    for (; now < count; ++now) {
+        const auto voice = this->create(wave, flags);
+        if (!voice) return E_OUTOFMEMORY;
+        // 新建的可以立即使用
+        voice->pass = m_uPass.load() - VoicePoolDelayPass;
+        m_mutex.lock();
+        const auto ok = this->push(*bucket, *voice);
+        m_mutex.unlock();
+        if (!ok) { CALVoicePool::destroy(*voice); break; }
+    }
+    return S_OK;
+}
+
+/// <summary>
+/// Destroys all free voices.
+/// 摧毁所有空闲声音
+/// </summary>
+/// <returns></returns>
+void WrapAL::CALVoicePool::Clear() noexcept {
+    m_mutex.lock();
+    for (uint32_t i = 0; i != m_cBucket; ++i) {
+        auto voice = m_aBucket[i].head;
+        while (voice) {
+            const auto next = voice->next;
+            CALVoicePool::destroy(*voice);
+            voice = next;
+        }
+    }
+    // 引擎已经停止
+    while (m_pRetired) {
+        const auto next = m_pRetired->next;
+        std::free(m_pRetired->data);
+        std::free(m_pRetired);
+        m_pRetired = next;
+    }
+    m_pRetiredTail = nullptr;
+    m_cBucket = 0;
+    m_pEngine = nullptr;
+    m_mutex.unlock();
+}
@@ -0,0 +1,228 @@
+﻿#pragma once
+/**
+* Copyright (c) 2014-2015 dustpg   mailto:dustpg@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person
+* obtaining a copy of this software and associated documentation
+* files (the "Software"), to deal in the Software without
+* restriction, including without limitation the rights to use,
+* copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following
+* conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+* OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+* HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+WrapAL voice pool, source voices recycled across clips:
+    CreateClip -> acquire voice of same format <- recycle <- clip destroyed
+
+XAudio2 binds the callback to a voice when created, so pooled voice calls
+the clip that owns it now. a recycled voice is reused after 2 processing
+passes at least, callbacks of flushed buffers are fired in next pass.
+
+Stop and FlushSourceBuffers are asynchronous, flushed buffers may still be
+read in current pass. memory of destroyed clip is retired to the voice (or
+to the pool if no voice) and freed after the same delay.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for assert
+#include <cassert>
+// for atomic
+#include <atomic>
+// for mutex
+#include <mutex>
+// include the config
+#include "wrapalconf.h"
+// include the config
+#include "wrapal_common.h"
+
+// XAudio
+#ifdef WRAPAL_XAUDIO2_7_SUPPORT
+#include "p_XAudio2_7.h"
+namespace WrapAL { using namespace xaudio2_7; }
+#else
+#include "p_XAudio2_8.h"
+namespace WrapAL { using namespace xaudio2_8; }
+#endif
+
+
+// wrapal namespace
+namespace WrapAL {
+    // key of voice pool
+    struct VoiceFormatKey {
+        // sample rate
+        uint32_t        sample_rate;
+        // format tag
+        uint16_t        format_tag;
+        // channels
+        uint16_t        channels;
+        // block align
+        uint16_t        block_align;
+        // flags of voice creation, XAUDIO2_VOICE_USEFILTER
+        uint16_t        flags;
+        // make key from wave format
+        static auto Make(const WAVEFORMATEX& wave, uint32_t flags) noexcept {
+            return VoiceFormatKey{
+                wave.nSamplesPerSec, wave.wFormatTag,
+                wave.nChannels, wave.nBlockAlign, uint16_t(flags)
+            };
+        }
+        // equal
+        bool operator==(const VoiceFormatKey& k) const noexcept {
+            return sample_rate == k.sample_rate && format_tag == k.format_tag
+                && channels == k.channels && block_align == k.block_align
+                && flags == k.flags;
+        }
+    };
+    // memory retired without voice, freed after delay
+    struct RetiredMemory {
+        // next in retired list
+        RetiredMemory*  next;
+        // memory block
+        void*           data;
+        // pass count when retired
+        uint32_t        pass;
+    };
+    // pooled source voice, calls callback of owner
+    class CALPooledVoice final : public IXAudio2VoiceCallback {
+    public:
+        // count of memory blocks retired by owner, audio data and ring
+        static constexpr uint32_t RetiredCount = 2;
+    public: // impl for callback
+        // Called just before this voice's processing pass begins.
+        void STDMETHODCALLTYPE OnVoiceProcessingPassStart(UINT32 SamplesRequired) noexcept override {
+            this->forward([=](IXAudio2VoiceCallback& o) { o.OnVoiceProcessingPassStart(SamplesRequired); });
+        }
+        // Called just after this voice's processing pass ends.
+        void STDMETHODCALLTYPE OnVoiceProcessingPassEnd() noexcept override {
+            this->forward([](IXAudio2VoiceCallback& o) { o.OnVoiceProcessingPassEnd(); });
+        }
+        // Called when this voice has just finished playing a buffer stream
+        void STDMETHODCALLTYPE OnStreamEnd() noexcept override {
+            this->forward([](IXAudio2VoiceCallback& o) { o.OnStreamEnd(); });
+        }
+        // Called when this voice is about to start processing a new buffer.
+        void STDMETHODCALLTYPE OnBufferStart(void * pBufferContext) noexcept override {
+            this->forward([=](IXAudio2VoiceCallback& o) { o.OnBufferStart(pBufferContext); });
+        }
+        // Called when this voice has just finished processing a buffer.
+        void STDMETHODCALLTYPE OnBufferEnd(void * pBufferContext) noexcept override {
+            this->forward([=](IXAudio2VoiceCallback& o) { o.OnBufferEnd(pBufferContext); });
+        }
+        // Called when this voice has just reached the end position of a loop.
+        void STDMETHODCALLTYPE OnLoopEnd(void * pBufferContext) noexcept override {
+            this->forward([=](IXAudio2VoiceCallback& o) { o.OnLoopEnd(pBufferContext); });
+        }
+        // Called in the event of a critical error during voice processing.
+        void STDMETHODCALLTYPE OnVoiceError(void * pBufferContext, HRESULT Error) noexcept override {
+            this->forward([=](IXAudio2VoiceCallback& o) { o.OnVoiceError(pBufferContext, Error); });
+        }
+    public:
+        // attach owner
+        void Attach(IXAudio2VoiceCallback& owner) noexcept { m_pOwner.store(&owner); }
+        // detach owner, wait for callback running
+        void Detach() noexcept;
+        // retire memory of owner, read by flushed buffers, false if full
+        bool Retire(void* data) noexcept;
+        // free retired memory
+        void FreeRetired() noexcept;
+    private:
+        // call owner
+        template<typename T> void forward(T call) noexcept {
+            ++m_cBusy;
+            if (const auto owner = m_pOwner.load()) call(*owner);
+            --m_cBusy;
+        }
+    public:
+        // source voice
+        IXAudio2SourceVoice*                    voice = nullptr;
+        // next in free list
+        CALPooledVoice*                         next = nullptr;
+        // pass count when recycled
+        uint32_t                                pass = 0;
+        // key of format
+        VoiceFormatKey                          key;
+        // memory retired by last owner
+        void*                                   retired[RetiredCount] = { };
+    private:
+        // owner now
+        std::atomic<IXAudio2VoiceCallback*>     m_pOwner{ nullptr };
+        // count of callbacks running
+        std::atomic<uint32_t>                   m_cBusy{ 0 };
+    };
+    // source voice pool keyed by format
+    class CALVoicePool {
+        // bucket of same format
+        struct Bucket {
+            // key of format
+            VoiceFormatKey      key;
+            // first free voice, oldest
+            CALPooledVoice*     head;
+            // last free voice
+            CALPooledVoice*     tail;
+            // count of free voices
+            uint32_t            count;
+            // max count of free voices
+            uint32_t            capacity;
+        };
+    public:
+        // ctor
+        CALVoicePool() noexcept = default;
+        // dtor
+        ~CALVoicePool() noexcept { assert(!m_pEngine && "call Clear first"); }
+        // set engine
+        void Init(IXAudio2* engine) noexcept { m_pEngine = engine; }
+        // destroy all free voices
+        void Clear() noexcept;
+        // a processing pass started, audio thread
+        void OnPass() noexcept { ++m_uPass; }
+        // acquire a voice created with flags for owner
+        auto Acquire(const WAVEFORMATEX& wave, uint32_t flags, IXAudio2VoiceCallback& owner, CALPooledVoice*& voice) noexcept ->HRESULT;
+        // recycle the voice, owner will never be called
+        void Recycle(CALPooledVoice& voice) noexcept;
+        // retire memory read by flushed buffers of recycled voice, freed after delay
+        void Retire(void* data) noexcept;
+        // free retired memory after delay
+        void Collect() noexcept;
+        // create voices in advance, raise capacity of this format if less
+        auto Prewarm(const WAVEFORMATEX& wave, uint32_t flags, uint32_t count) noexcept ->HRESULT;
+    private:
+        // create new voice
+        auto create(const WAVEFORMATEX& wave, uint32_t flags) noexcept ->CALPooledVoice*;
+        // destroy voice
+        static void destroy(CALPooledVoice& voice) noexcept;
+        // find or add bucket, under lock
+        auto bucket(const VoiceFormatKey& key) noexcept ->Bucket*;
+        // push free voice to bucket, under lock
+        bool push(Bucket& bucket, CALPooledVoice& voice) noexcept;
+    private:
+        // xaudio2 engine
+        IXAudio2*               m_pEngine = nullptr;
+        // lock for buckets
+        std::mutex              m_mutex;
+        // processing pass count
+        std::atomic<uint32_t>   m_uPass{ 0 };
+        // memory retired without voice, oldest first
+        RetiredMemory*          m_pRetired = nullptr;
+        // last retired memory
+        RetiredMemory*          m_pRetiredTail = nullptr;
+        // count of buckets
+        uint32_t                m_cBucket = 0;
+        // buckets
+        Bucket                  m_aBucket[VoicePoolFormatCount];
+    };
+}
\ No newline at end of file
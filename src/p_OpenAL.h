@@ -0,0 +1,126 @@
+﻿#pragma once
+// private header, OpenAL 1.1 API subset loaded at runtime
+#include <cstdint>
+
+namespace WrapAL {
+    namespace openal {
+        // ALC device
+        struct ALCdevice;
+        // ALC context
+        struct ALCcontext;
+        // AL types
+        using ALboolean = char;
+        using ALchar = char;
+        using ALint = int;
+        using ALuint = unsigned int;
+        using ALsizei = int;
+        using ALenum = int;
+        using ALfloat = float;
+        using ALCboolean = char;
+        using ALCchar = char;
+        using ALCint = int;
+        using ALCsizei = int;
+        using ALCenum = int;
+        // AL constants
+        enum : ALenum {
+            AL_NONE = 0,
+            AL_FALSE = 0,
+            AL_TRUE = 1,
+            AL_NO_ERROR = 0,
+            AL_SOURCE_RELATIVE = 0x202,
+            AL_PITCH = 0x1003,
+            AL_POSITION = 0x1004,
+            AL_LOOPING = 0x1007,
+            AL_BUFFER = 0x1009,
+            AL_GAIN = 0x100A,
+            AL_SOURCE_STATE = 0x1010,
+            AL_INITIAL = 0x1011,
+            AL_PLAYING = 0x1012,
+            AL_PAUSED = 0x1013,
+            AL_STOPPED = 0x1014,
+            AL_BUFFERS_QUEUED = 0x1015,
+            AL_BUFFERS_PROCESSED = 0x1016,
+            AL_ROLLOFF_FACTOR = 0x1021,
+            AL_SAMPLE_OFFSET = 0x1025,
+            AL_FORMAT_MONO8 = 0x1100,
+            AL_FORMAT_MONO16 = 0x1101,
+            AL_FORMAT_STEREO8 = 0x1102,
+            AL_FORMAT_STEREO16 = 0x1103,
+            // AL_EXT_MCFORMATS
+            AL_FORMAT_QUAD16 = 0x1205,
+            AL_FORMAT_QUAD32 = 0x1206,
+            AL_FORMAT_51CHN16 = 0x120B,
+            AL_FORMAT_51CHN32 = 0x120C,
+            AL_FORMAT_61CHN16 = 0x120E,
+            AL_FORMAT_61CHN32 = 0x120F,
+            AL_FORMAT_71CHN16 = 0x1211,
+            AL_FORMAT_71CHN32 = 0x1212,
+            // AL_EXT_FLOAT32
+            AL_FORMAT_MONO_FLOAT32 = 0x10010,
+            AL_FORMAT_STEREO_FLOAT32 = 0x10011,
+        };
+        // ALC constants
+        enum : ALCenum {
+            ALC_DEFAULT_DEVICE_SPECIFIER = 0x1004,
+            ALC_DEVICE_SPECIFIER = 0x1005,
+            ALC_FREQUENCY = 0x1007,
+            ALC_DEFAULT_ALL_DEVICES_SPECIFIER = 0x1012,
+            ALC_ALL_DEVICES_SPECIFIER = 0x1013,
+        };
+        // OpenAL dll
+        struct OpenAL {
+            // dll handle
+            HMODULE dll;
+            // alcOpenDevice
+            ALCdevice* (__cdecl* alcOpenDevice)(const ALCchar*);
+            // alcCloseDevice
+            ALCboolean (__cdecl* alcCloseDevice)(ALCdevice*);
+            // alcCreateContext
+            ALCcontext* (__cdecl* alcCreateContext)(ALCdevice*, const ALCint*);
+            // alcDestroyContext
+            void (__cdecl* alcDestroyContext)(ALCcontext*);
+            // alcMakeContextCurrent
+            ALCboolean (__cdecl* alcMakeContextCurrent)(ALCcontext*);
+            // alcGetString
+            const ALCchar* (__cdecl* alcGetString)(ALCdevice*, ALCenum);
+            // alcIsExtensionPresent
+            ALCboolean (__cdecl* alcIsExtensionPresent)(ALCdevice*, const ALCchar*);
+            // alcGetIntegerv
+            void (__cdecl* alcGetIntegerv)(ALCdevice*, ALCenum, ALCsizei, ALCint*);
+            // alIsExtensionPresent
+            ALboolean (__cdecl* alIsExtensionPresent)(const ALchar*);
+            // alGetError
+            ALenum (__cdecl* alGetError)();
+            // alListenerf
+            void (__cdecl* alListenerf)(ALenum, ALfloat);
+            // alGenSources
+            void (__cdecl* alGenSources)(ALsizei, ALuint*);
+            // alDeleteSources
+            void (__cdecl* alDeleteSources)(ALsizei, const ALuint*);
+            // alSourcef
+            void (__cdecl* alSourcef)(ALuint, ALenum, ALfloat);
+            // alSource3f
+            void (__cdecl* alSource3f)(ALuint, ALenum, ALfloat, ALfloat, ALfloat);
+            // alSourcei
+            void (__cdecl* alSourcei)(ALuint, ALenum, ALint);
+            // alGetSourcei
+            void (__cdecl* alGetSourcei)(ALuint, ALenum, ALint*);
+            // alSourcePlay
+            void (__cdecl* alSourcePlay)(ALuint);
+            // alSourcePause
+            void (__cdecl* alSourcePause)(ALuint);
+            // alSourceStop
+            void (__cdecl* alSourceStop)(ALuint);
+            // alSourceQueueBuffers
+            void (__cdecl* alSourceQueueBuffers)(ALuint, ALsizei, const ALuint*);
+            // alSourceUnqueueBuffers
+            void (__cdecl* alSourceUnqueueBuffers)(ALuint, ALsizei, ALuint*);
+            // alGenBuffers
+            void (__cdecl* alGenBuffers)(ALsizei, ALuint*);
+            // alDeleteBuffers
+            void (__cdecl* alDeleteBuffers)(ALsizei, const ALuint*);
+            // alBufferData
+            void (__cdecl* alBufferData)(ALuint, ALenum, const void*, ALsizei, ALsizei);
+        };
+    }
+}
@@ -0,0 +1,97 @@
+﻿#pragma once
+// private header
+#include "p_XAudio2_base.h"
+
+namespace WrapAL {
+    // XAPO: audio processing object of XAudio2 effect chain
+    namespace xapo {
+        // interface list
+        struct IXAPO;
+        struct IXAPOParameters;
+        // IID_IXAPO
+        static const GUID IID_IXAPO = { 0xA410B984, 0x9839, 0x4819, { 0xA0, 0xBE, 0x28, 0x56, 0xAE, 0x6B, 0x3A, 0xDB } };
+        // IID_IXAPOParameters
+        static const GUID IID_IXAPOParameters = { 0x26D95C66, 0x80F2, 0x499A, { 0xAD, 0x54, 0x5A, 0xE7, 0xF0, 0x1C, 0x6D, 0x98 } };
+        // IID_IXAPO of dxsdk 2010jun, XAudio2_7.dll
+        static const GUID IID_IXAPO_2_7 = { 0xA90BC001, 0xE897, 0xE897, { 0x55, 0xE4, 0x9E, 0x47, 0x00, 0x00, 0x00, 0x00 } };
+        // IID_IXAPOParameters of dxsdk 2010jun, XAudio2_7.dll
+        static const GUID IID_IXAPOParameters_2_7 = { 0xA90BC001, 0xE897, 0xE897, { 0x55, 0xE4, 0x9E, 0x47, 0x00, 0x00, 0x00, 0x01 } };
+        // constant list
+        enum : uint32_t {
+            XAPO_MIN_CHANNELS = 1,
+            XAPO_MAX_CHANNELS = 64,
+            XAPO_MIN_FRAMERATE = 1000,
+            XAPO_MAX_FRAMERATE = 200000,
+            XAPO_REGISTRATION_STRING_LENGTH = 256,
+
+            XAPO_FLAG_CHANNELS_MUST_MATCH = 0x00000001,
+            XAPO_FLAG_FRAMERATE_MUST_MATCH = 0x00000002,
+            XAPO_FLAG_BITSPERSAMPLE_MUST_MATCH = 0x00000004,
+            XAPO_FLAG_BUFFERCOUNT_MUST_MATCH = 0x00000008,
+            XAPO_FLAG_INPLACE_SUPPORTED = 0x00000010,
+            XAPO_FLAG_INPLACE_REQUIRED = 0x00000020,
+
+            XAPO_E_FORMAT_UNSUPPORTED = 0x88970001,     // Requested audio format unsupported.
+        };
+#pragma pack(push, 1)
+        // Used in IXAPO::GetRegistrationProperties, allocated with CoTaskMemAlloc
+        struct XAPO_REGISTRATION_PROPERTIES {
+            CLSID clsid;
+            wchar_t FriendlyName[XAPO_REGISTRATION_STRING_LENGTH];
+            wchar_t CopyrightInfo[XAPO_REGISTRATION_STRING_LENGTH];
+            UINT32 MajorVersion;
+            UINT32 MinorVersion;
+            UINT32 Flags;
+            UINT32 MinInputBufferCount;
+            UINT32 MaxInputBufferCount;
+            UINT32 MinOutputBufferCount;
+            UINT32 MaxOutputBufferCount;
+        };
+        // Used in IXAPO::LockForProcess
+        struct XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS {
+            const WAVEFORMATEX* pFormat;
+            UINT32 MaxFrameCount;
+        };
+        // Used in XAPO_PROCESS_BUFFER_PARAMETERS
+        enum XAPO_BUFFER_FLAGS {
+            XAPO_BUFFER_SILENT,                 // silent data should be assumed, buffer memory may be uninitialized
+            XAPO_BUFFER_VALID,                  // arbitrary data should be assumed (may or may not be silent frames)
+        };
+        // Used in IXAPO::Process
+        struct XAPO_PROCESS_BUFFER_PARAMETERS {
+            void* pBuffer;
+            XAPO_BUFFER_FLAGS BufferFlags;
+            UINT32 ValidFrameCount;
+        };
+#pragma pack(pop)
+        // IXAPO
+        interface IXAPO : IUnknown {
+            STDMETHOD(GetRegistrationProperties) (XAPO_REGISTRATION_PROPERTIES** ppRegistrationProperties) PURE;
+            STDMETHOD(IsInputFormatSupported) (const WAVEFORMATEX* pOutputFormat,
+                const WAVEFORMATEX* pRequestedInputFormat,
+                WAVEFORMATEX** ppSupportedInputFormat) PURE;
+            STDMETHOD(IsOutputFormatSupported) (const WAVEFORMATEX* pInputFormat,
+                const WAVEFORMATEX* pRequestedOutputFormat,
+                WAVEFORMATEX** ppSupportedOutputFormat) PURE;
+            STDMETHOD(Initialize) (const void* pData, UINT32 DataByteSize) PURE;
+            STDMETHOD_(void, Reset) () PURE;
+            STDMETHOD(LockForProcess) (UINT32 InputLockedParameterCount,
+                const XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS* pInputLockedParameters,
+                UINT32 OutputLockedParameterCount,
+                const XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS* pOutputLockedParameters) PURE;
+            STDMETHOD_(void, UnlockForProcess) () PURE;
+            STDMETHOD_(void, Process) (UINT32 InputProcessParameterCount,
+                const XAPO_PROCESS_BUFFER_PARAMETERS* pInputProcessParameters,
+                UINT32 OutputProcessParameterCount,
+                XAPO_PROCESS_BUFFER_PARAMETERS* pOutputProcessParameters,
+                BOOL IsEnabled) PURE;
+            STDMETHOD_(UINT32, CalcInputFrames) (UINT32 OutputFrameCount) PURE;
+            STDMETHOD_(UINT32, CalcOutputFrames) (UINT32 InputFrameCount) PURE;
+        };
+        // IXAPOParameters
+        interface IXAPOParameters : IUnknown {
+            STDMETHOD_(void, SetParameters) (const void* pParameters, UINT32 ParameterByteSize) PURE;
+            STDMETHOD_(void, GetParameters) (void* pParameters, UINT32 ParameterByteSize) PURE;
+        };
+    }
+}
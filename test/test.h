@@ -0,0 +1,55 @@
+﻿#pragma once
+/*
+WrapAL tests, a minimal harness without dependency:
+    WRAPAL_TEST(name) { WRAPAL_CHECK(expr); }
+
+tests are registered by static objects and run in order of registering
+in each file, test.exe returns the count of failed tests.
+*/
+
+// for [u]intXX_t
+#include <cstdint>
+// for std::fabs
+#include <cmath>
+
+
+// wrapal test namespace
+namespace WrapALTest {
+    // test case, linked by registering
+    struct TestCase {
+        // name of test
+        const char*     name;
+        // test function
+        void          (*call)() noexcept;
+        // next test
+        TestCase*       next;
+        // failed checks of running
+        uint32_t        failed;
+    };
+    // register test case, return true
+    bool Register(TestCase& test) noexcept;
+    // check failed in running test
+    void Fail(const char* file, int line, const char* expr) noexcept;
+    // run all tests, return count of failed tests
+    auto RunAll() noexcept ->uint32_t;
+}
+
+// define a test
+#define WRAPAL_TEST(name) \
+    static void wrapal_test_##name() noexcept; \
+    static WrapALTest::TestCase wrapal_case_##name = { #name, wrapal_test_##name, nullptr, 0 }; \
+    static const bool wrapal_reg_##name = WrapALTest::Register(wrapal_case_##name); \
+    static void wrapal_test_##name() noexcept
+
+// check expression, test goes on if failed
+#define WRAPAL_CHECK(expr) \
+    do { if (!(expr)) WrapALTest::Fail(__FILE__, __LINE__, #expr); } while (0)
+
+// check floats near each other
+#define WRAPAL_CHECK_NEAR(a, b, eps) \
+    do { if (!(std::fabs(double(a) - double(b)) <= double(eps))) \
+        WrapALTest::Fail(__FILE__, __LINE__, #a " ~ " #b); } while (0)
+
+// check expression, return from test if failed
+#define WRAPAL_REQUIRE(expr) \
+    do { if (!(expr)) { WrapALTest::Fail(__FILE__, __LINE__, #expr); return; } } while (0)
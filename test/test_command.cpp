@@ -0,0 +1,90 @@
+﻿#include <memory>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "AudioCommand.h"
+
+using WrapAL::AudioCommand;
+using WrapAL::CALCommandQueue;
+
+// make command with time as payload
+static auto make_command(uint64_t time) noexcept {
+    AudioCommand command;
+    command.clip = nullptr;
+    command.command = WrapAL::Command_PlayAt;
+    command.time = time;
+    return command;
+}
+
+// empty queue pops nothing
+WRAPAL_TEST(command_empty) {
+    std::unique_ptr<CALCommandQueue> queue(new CALCommandQueue);
+    AudioCommand command;
+    WRAPAL_CHECK(!queue->Pop(command));
+    WRAPAL_CHECK(queue->Push(make_command(1)));
+    WRAPAL_CHECK(queue->Pop(command));
+    WRAPAL_CHECK(!queue->Pop(command));
+}
+
+// first in first out, over the end of cells many times
+WRAPAL_TEST(command_fifo) {
+    std::unique_ptr<CALCommandQueue> queue(new CALCommandQueue);
+    AudioCommand command;
+    uint64_t pushed = 0, popped = 0, bad = 0;
+    for (uint32_t round = 0; round != 7; ++round) {
+        // 每轮数量不同, 位置错开
+        const uint32_t count = WrapAL::CommandQueueLength / 3 + round * 17;
+        for (uint32_t i = 0; i != count; ++i) bad += !queue->Push(make_command(pushed++));
+        while (queue->Pop(command)) {
+            bad += command.time != popped++;
+            bad += command.command != WrapAL::Command_PlayAt;
+        }
+    }
+    WRAPAL_CHECK(bad == 0);
+    WRAPAL_CHECK(pushed == popped);
+}
+
+// bounded: push fails when full until popped
+WRAPAL_TEST(command_full) {
+    std::unique_ptr<CALCommandQueue> queue(new CALCommandQueue);
+    AudioCommand command;
+    uint32_t pushed = 0;
+    for (uint32_t i = 0; i != WrapAL::CommandQueueLength; ++i) pushed += queue->Push(make_command(i));
+    WRAPAL_CHECK(pushed == WrapAL::CommandQueueLength);
+    WRAPAL_CHECK(!queue->Push(make_command(0)));
+    WRAPAL_CHECK(queue->Pop(command) && command.time == 0);
+    WRAPAL_CHECK(queue->Push(make_command(WrapAL::CommandQueueLength)));
+    WRAPAL_CHECK(!queue->Push(make_command(0)));
+    uint64_t next = 1, bad = 0;
+    while (queue->Pop(command)) bad += command.time != next++;
+    WRAPAL_CHECK(bad == 0);
+    WRAPAL_CHECK(next == WrapAL::CommandQueueLength + 1);
+}
+
+// producers in threads, order kept for each producer
+WRAPAL_TEST(command_multi_producer) {
+    enum : uint32_t { PRODUCER = 4, COUNT = 100000 };
+    std::unique_ptr<CALCommandQueue> queue(new CALCommandQueue);
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p != PRODUCER; ++p) {
+        producers.emplace_back([&queue, p]() noexcept {
+            // 满了就重试, 引擎中则在调用线程直接执行
+            for (uint32_t i = 0; i != COUNT; ++i)
+                while (!queue->Push(make_command(uint64_t(p) << 32 | i))) std::this_thread::yield();
+        });
+    }
+    uint32_t next[PRODUCER] = { 0 };
+    uint32_t popped = 0, bad = 0;
+    AudioCommand command;
+    while (popped != PRODUCER * COUNT) {
+        if (!queue->Pop(command)) { std::this_thread::yield(); continue; }
+        const auto p = uint32_t(command.time >> 32);
+        const auto i = uint32_t(command.time);
+        if (p >= PRODUCER || i != next[p]) ++bad;
+        else ++next[p];
+        ++popped;
+    }
+    for (auto& thread : producers) thread.join();
+    WRAPAL_CHECK(bad == 0);
+    WRAPAL_CHECK(!queue->Pop(command));
+}
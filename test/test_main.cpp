@@ -0,0 +1,61 @@
+﻿#include <cstdio>
+#include "test.h"
+
+// wrapal test namespace
+namespace WrapALTest {
+    // first test
+    static TestCase* s_first = nullptr;
+    // last test
+    static TestCase* s_last = nullptr;
+    // running test
+    static TestCase* s_running = nullptr;
+}
+
+/// <summary>
+/// Registers the test case, appended to the list.
+/// </summary>
+/// <param name="test">The test.</param>
+/// <returns>true</returns>
+bool WrapALTest::Register(TestCase& test) noexcept {
+    (s_last ? s_last->next : s_first) = &test;
+    s_last = &test;
+    return true;
+}
+
+/// <summary>
+/// Reports failed check of running test.
+/// </summary>
+/// <param name="file">The file.</param>
+/// <param name="line">The line.</param>
+/// <param name="expr">The expression.</param>
+/// <returns></returns>
+void WrapALTest::Fail(const char* file, int line, const char* expr) noexcept {
+    if (s_running) ++s_running->failed;
+    std::printf("    %s(%d): check failed: %s\n", file, line, expr);
+}
+
+/// <summary>
+/// Runs all tests.
+/// </summary>
+/// <returns>count of failed tests</returns>
+auto WrapALTest::RunAll() noexcept -> uint32_t {
+    uint32_t count = 0, failed = 0;
+    for (auto test = s_first; test; test = test->next) {
+        std::printf("[ RUN  ] %s\n", test->name);
+        s_running = test;
+        test->call();
+        s_running = nullptr;
+        std::printf(test->failed ? "[ FAIL ] %s\n" : "[  OK  ] %s\n", test->name);
+        if (test->failed) ++failed;
+        ++count;
+    }
+    std::printf("%u tests, %u failed\n", count, failed);
+    return failed;
+}
+
+// App Entrance
+int main() {
+    // 断言失败前的输出不丢失
+    std::setvbuf(stdout, nullptr, _IONBF, 0);
+    return int(WrapALTest::RunAll());
+}
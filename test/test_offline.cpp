@@ -0,0 +1,594 @@
+﻿#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "test.h"
+#include "AudioEngine.h"
+#include "AudioHandle.h"
+
+/*
+offline tests: engine initialized with Level_Offline in each test, the
+master mix pulled by RenderOffline, so the engine clock is exactly the
+count of frames rendered.
+*/
+
+// configure for offline render
+class COfflineConfigure final : public WrapAL::CALDefConfigure {
+public:
+    // no device, pulled by RenderOffline
+    auto ChooseAPILevel() noexcept ->WrapAL::APILevel override { return WrapAL::APILevel::Level_Offline; }
+};
+
+// engine in offline mode within scope
+class COfflineEngine {
+public:
+    // ctor
+    COfflineEngine() noexcept {
+        ok = WrapALAudioEngine.Initialize(&m_config) >= 0;
+        if (ok) format = WrapALAudioEngine.GetOutputFormat();
+    }
+    // dtor
+    ~COfflineEngine() noexcept { if (ok) WrapALAudioEngine.Uninitialize(); }
+    // render frames, return interleaved output of them
+    auto Render(uint32_t frames) noexcept -> const std::vector<float>& {
+        output.resize(size_t(frames) * format.nChannels);
+        if (WrapALAudioEngine.RenderOffline(output.data(), frames) < 0) output.clear();
+        rendered += frames;
+        return output;
+    }
+    // peak of channel in output, from frame
+    auto Peak(uint32_t channel, uint32_t from = 0) const noexcept {
+        float peak = 0.f;
+        for (size_t i = size_t(from) * format.nChannels + channel; i < output.size(); i += format.nChannels)
+            peak = std::max(peak, std::fabs(output[i]));
+        return peak;
+    }
+    // first frame not silent in output, frames of output if none
+    auto FirstSound() const noexcept {
+        size_t i = 0;
+        while (i != output.size() && output[i] == 0.f) ++i;
+        return uint32_t(i / format.nChannels);
+    }
+    // frames of output before the silence at the end
+    auto SoundEnd() const noexcept {
+        size_t i = output.size();
+        while (i && output[i - 1] == 0.f) --i;
+        return uint32_t((i + format.nChannels - 1) / format.nChannels);
+    }
+    // seconds of frames
+    auto Seconds(uint64_t frames) const noexcept { return float(double(frames) / double(format.nSamplesPerSec)); }
+public:
+    // initialized
+    bool                    ok = false;
+    // format of master mix
+    WrapAL::AudioFormat     format;
+    // frames rendered, engine clock
+    uint64_t                rendered = 0;
+    // output of last rendering
+    std::vector<float>      output;
+private:
+    // configure
+    COfflineConfigure       m_config;
+};
+
+// create mono clip at master rate, frames from call(index), return handle
+template<typename T>
+static auto make_clip(uint32_t frames, T call, WrapAL::AudioClipFlag flags = WrapAL::Flag_None, const char* group = "Test") noexcept {
+    auto format = WrapALAudioEngine.GetOutputFormat();
+    format.nChannels = 1;
+    format.nBlockAlign = sizeof(float);
+    std::vector<float> data(frames);
+    for (uint32_t i = 0; i != frames; ++i) data[i] = call(i);
+    const auto buffer = reinterpret_cast<const uint8_t*>(data.data());
+    return WrapALAudioEngine.CreateClip(format, buffer, sizeof(float) * frames, flags, group);
+}
+
+// audio stream of mono float frames in memory
+class CFrameStream final : public WrapAL::XALAudioStream {
+public:
+    // ctor
+    CFrameStream(const WrapAL::AudioFormat& format, std::vector<float>&& data) noexcept
+        : XALAudioStream(nullptr), m_data(std::move(data)) {
+        m_audioFormat = format;
+        m_cTotalSize = uint32_t(m_data.size() * sizeof(float));
+    }
+    // add ref-count
+    auto AddRef() noexcept -> uint32_t override { return ++m_cRef; }
+    // release this
+    auto Release() noexcept -> uint32_t override {
+        const auto count = --m_cRef;
+        if (!count) delete this;
+        return count;
+    }
+    // seek stream in byte
+    auto Seek(int32_t off, Move method) noexcept -> uint32_t override {
+        const int64_t base = method == Move_Begin ? 0 : method == Move_Current ? m_uPos : m_cTotalSize;
+        m_uPos = uint32_t(std::min(std::max(base + off, int64_t(0)), int64_t(m_cTotalSize)));
+        return m_uPos;
+    }
+    // read stream
+    auto ReadNext(uint32_t len, void* buf) noexcept -> uint32_t override {
+        len = std::min(len, m_cTotalSize - m_uPos);
+        std::memcpy(buf, reinterpret_cast<const uint8_t*>(m_data.data()) + m_uPos, len);
+        m_uPos += len;
+        return len;
+    }
+    // no error
+    auto GetLastErrorInfo(wchar_t[]) noexcept -> bool override { return false; }
+private:
+    // frames
+    std::vector<float>      m_data;
+    // position in byte
+    uint32_t                m_uPos = 0;
+    // ref-count
+    uint32_t                m_cRef = 1;
+};
+
+// create mono streaming clip at master rate, frames from call(index), return handle
+template<typename T>
+static auto make_stream_clip(uint32_t frames, T call, WrapAL::AudioClipFlag flags = WrapAL::Flag_None) noexcept {
+    auto format = WrapALAudioEngine.GetOutputFormat();
+    format.nChannels = 1;
+    format.nBlockAlign = sizeof(float);
+    std::vector<float> data(frames);
+    for (uint32_t i = 0; i != frames; ++i) data[i] = call(i);
+    const auto stream = new CFrameStream(format, std::move(data));
+    const auto flag = WrapAL::AudioClipFlag(flags | WrapAL::Flag_StreamingReading);
+    const auto handle = WrapALAudioEngine.CreateClip(stream, flag, "Test");
+    stream->Release();
+    return handle;
+}
+
+// constant 1
+static float dc(uint32_t) noexcept { return 1.f; }
+
+// master mix pulled in any count of frames, continuous over passes
+WRAPAL_TEST(offline_render_pull) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    engine.Render(rate / 10);
+    WRAPAL_CHECK(engine.output.size() == size_t(rate / 10) * engine.format.nChannels);
+    WRAPAL_CHECK(engine.Peak(0) == 0.f && engine.Peak(1) == 0.f);
+    // 斜坡, 每帧加 1/rate
+    const auto ramp = [rate](uint32_t i) noexcept { return float(i + 1) / float(rate); };
+    WrapAL::CALAudioSourceClip clip(make_clip(rate, ramp));
+    WRAPAL_REQUIRE(clip);
+    clip.Play();
+    // 帧数不是周期的整数倍
+    std::vector<float> left;
+    const uint32_t chunks[] = { 1, 7, 479, 480, 481, 1000, 3 };
+    for (auto frames : chunks) {
+        const auto& output = engine.Render(frames);
+        WRAPAL_REQUIRE(output.size() == size_t(frames) * engine.format.nChannels);
+        for (uint32_t i = 0; i != frames; ++i) left.push_back(output[size_t(i) * engine.format.nChannels]);
+    }
+    size_t first = 0;
+    while (first != left.size() && left[first] == 0.f) ++first;
+    WRAPAL_REQUIRE(first + 2 < left.size());
+    // 相邻帧之差不变, 没有丢帧或重复帧
+    const auto step = left[first + 1] - left[first];
+    WRAPAL_CHECK(step > 0.f);
+    uint32_t bad = 0;
+    for (auto i = first + 1; i != left.size(); ++i)
+        bad += std::fabs(left[i] - left[i - 1] - step) > step * 1e-2f;
+    WRAPAL_CHECK(bad == 0);
+}
+
+// PlayAt is heard on the exact sample, inside a pass
+WRAPAL_TEST(offline_play_at_sample) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    const uint32_t offsets[] = { 0, 1, 37, 211, 479 };
+    for (auto offset : offsets) {
+        WrapAL::CALAudioSourceClip clip(make_clip(rate, dc));
+        WRAPAL_REQUIRE(clip);
+        engine.Render(rate / 10);
+        WRAPAL_CHECK(engine.Peak(0) == 0.f);
+        // 之后的第2~3个周期
+        const auto start = engine.rendered;
+        const auto time = start + rate / 50 + offset;
+        WRAPAL_CHECK(clip.PlayAt(time));
+        engine.Render(rate / 10);
+        WRAPAL_CHECK(start + engine.FirstSound() == time);
+        WRAPAL_CHECK(engine.Peak(0) > 0.5f);
+        clip.Stop();
+        engine.Render(rate / 10);
+    }
+}
+
+// lead-in of PlayAt is kept by Seek queued before or after it
+WRAPAL_TEST(offline_play_at_seek) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    WrapAL::CALAudioSourceClip clip(make_clip(rate, dc));
+    WRAPAL_REQUIRE(clip);
+    for (uint32_t i = 0; i != 2; ++i) {
+        engine.Render(rate / 10);
+        const auto start = engine.rendered;
+        const auto time = start + rate / 50 + 211;
+        // 同一周期执行, 定位在前或在后
+        if (i == 0) WRAPAL_CHECK(clip.Seek(0.5f));
+        WRAPAL_CHECK(clip.PlayAt(time));
+        if (i == 1) WRAPAL_CHECK(clip.Seek(0.5f));
+        engine.Render(rate / 10);
+        WRAPAL_CHECK(start + engine.FirstSound() == time);
+        clip.Stop();
+    }
+}
+
+// StopAt is heard on the exact sample, inside a pass, then rewinds
+WRAPAL_TEST(offline_stop_at_sample) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    const uint32_t offsets[] = { 0, 1, 37, 211, 479 };
+    for (uint32_t streaming = 0; streaming != 2; ++streaming) {
+        for (auto offset : offsets) {
+            WrapAL::CALAudioSourceClip clip(streaming ? make_stream_clip(rate, dc) : make_clip(rate, dc));
+            WRAPAL_REQUIRE(clip);
+            clip.Play();
+            engine.Render(rate / 10);
+            WRAPAL_CHECK(engine.Peak(0) > 0.5f);
+            // 之后的第2~3个周期
+            const auto start = engine.rendered;
+            const auto time = start + rate / 50 + offset;
+            WRAPAL_CHECK(clip.StopAt(time));
+            engine.Render(rate / 10);
+            WRAPAL_CHECK(start + engine.SoundEnd() == time);
+            WRAPAL_CHECK(clip.Tell() == 0.f);
+            // 截断后照常再次播放
+            clip.Play();
+            engine.Render(rate / 2);
+            WRAPAL_CHECK(engine.FirstSound() == 0);
+            WRAPAL_CHECK(engine.SoundEnd() == rate / 2);
+            WRAPAL_CHECK(clip.Underruns() == 0);
+        }
+    }
+}
+
+// position of virtual clip keeps advancing with the engine clock, and
+// continues when it owns a voice again
+WRAPAL_TEST(offline_virtual_position) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    // 两个周期的误差
+    const float eps = engine.Seconds(rate / 50);
+    WrapAL::CALAudioSourceClip a(make_clip(rate * 4, dc, WrapAL::Flag_LoopInfinite));
+    WrapAL::CALAudioSourceClip b(make_clip(rate * 4, dc, WrapAL::Flag_LoopInfinite));
+    WRAPAL_REQUIRE(a && b);
+    WrapALAudioEngine.GetGroup("").VoiceBudget(1);
+    a.Priority(200);
+    b.Priority(100);
+    a.Play();
+    b.Play();
+    engine.Render(rate / 100);
+    const auto start = engine.rendered;
+    WrapALAudioEngine.Update();
+    WRAPAL_CHECK(!a.IsVirtual());
+    WRAPAL_CHECK(b.IsVirtual());
+    // 虚拟时位置按引擎时钟推进, 不按真实时间
+    engine.Render(rate / 2);
+    WrapALAudioEngine.Update();
+    WRAPAL_CHECK_NEAR(a.Tell(), engine.Seconds(engine.rendered - start), eps);
+    WRAPAL_CHECK_NEAR(b.Tell(), engine.Seconds(engine.rendered - start), eps);
+    // 交换: b 得到声音, a 虚拟化
+    b.Priority(255);
+    WrapALAudioEngine.Update();
+    WRAPAL_CHECK(a.IsVirtual());
+    WRAPAL_CHECK(!b.IsVirtual());
+    engine.Render(rate / 4);
+    WRAPAL_CHECK(engine.Peak(0) > 0.5f);
+    WrapALAudioEngine.Update();
+    WRAPAL_CHECK_NEAR(a.Tell(), engine.Seconds(engine.rendered - start), eps);
+    WRAPAL_CHECK_NEAR(b.Tell(), engine.Seconds(engine.rendered - start), eps);
+    // 再次交换
+    a.Priority(255);
+    b.Priority(0);
+    WrapALAudioEngine.Update();
+    WRAPAL_CHECK(!a.IsVirtual());
+    WRAPAL_CHECK(b.IsVirtual());
+    engine.Render(rate / 4);
+    WrapALAudioEngine.Update();
+    WRAPAL_CHECK_NEAR(a.Tell(), engine.Seconds(engine.rendered - start), eps);
+    WRAPAL_CHECK_NEAR(b.Tell(), engine.Seconds(engine.rendered - start), eps);
+}
+
+// fade follows the engine clock, from the volume queued before it
+WRAPAL_TEST(offline_fade_clock) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    WrapAL::CALAudioSourceClip clip(make_clip(rate, dc, WrapAL::Flag_LoopInfinite));
+    WRAPAL_REQUIRE(clip);
+    clip.Play();
+    engine.Render(rate / 10);
+    const auto dry = engine.Peak(0);
+    WRAPAL_CHECK(dry > 0.5f);
+    // 音量命令尚未执行, 渐变从 0 开始
+    clip.Volume(0.f);
+    WRAPAL_CHECK(clip.FadeTo(1.f, 0.2f));
+    engine.Render(rate / 100);
+    WrapALAudioEngine.Update();
+    WRAPAL_CHECK(engine.Peak(0) < dry * 0.2f);
+    // 一半时间
+    while (engine.rendered < rate / 10 + rate / 10) {
+        engine.Render(rate / 100);
+        WrapALAudioEngine.Update();
+    }
+    engine.Render(rate / 100);
+    WRAPAL_CHECK_NEAR(engine.Peak(0), dry * 0.5f, dry * 0.1f);
+    // 渲染完成即渐变完成, 与真实时间无关
+    while (engine.rendered < rate / 10 + rate / 5 + rate / 50) {
+        engine.Render(rate / 100);
+        WrapALAudioEngine.Update();
+    }
+    engine.Render(rate / 100);
+    WRAPAL_CHECK_NEAR(engine.Peak(0), dry, 1e-4f);
+}
+
+// handle released by user is stale, while a queued command still holds the clip
+WRAPAL_TEST(offline_release_handle) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    const auto handle = make_clip(rate, dc);
+    WRAPAL_REQUIRE(handle != WrapAL::ALInvalidHandle);
+    {
+        WrapAL::CALAudioSourceClip clip(handle);
+        WrapAL::CALAudioSourceClip copy(clip);
+        WRAPAL_CHECK(clip.Play());
+    }
+    // 再次释放无效, 命令执行时片段仍然存在
+    WrapAL::CALAudioSourceClip stale(handle);
+    WRAPAL_CHECK(!stale.Play());
+    WRAPAL_CHECK(stale.Duration() == 0.f);
+    stale.Dispose();
+    engine.Render(rate / 10);
+    WRAPAL_CHECK(engine.Peak(0) > 0.5f);
+    WrapALAudioEngine.Update();
+}
+
+// used group name with other parent or format fails, top-level returned
+WRAPAL_TEST(offline_group_conflict) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto top = [](const WrapAL::CALAudioSourceGroup& group) noexcept {
+        return !std::strcmp(group.Name(), "TOPLEVEL");
+    };
+    const auto parent = WrapALAudioEngine.CreateGroup("Parent");
+    const auto child = WrapALAudioEngine.CreateGroup("Child", parent, 1, 24000);
+    WRAPAL_REQUIRE(!top(parent) && !top(child));
+    // 同样的上级与格式: 已有的组别
+    WRAPAL_CHECK(!std::strcmp(WrapALAudioEngine.CreateGroup("Child", parent).Name(), "Child"));
+    WRAPAL_CHECK(!std::strcmp(WrapALAudioEngine.CreateGroup("Child", parent, 1, 24000).Name(), "Child"));
+    WRAPAL_CHECK(top(WrapALAudioEngine.CreateGroup("Child")));
+    WRAPAL_CHECK(top(WrapALAudioEngine.CreateGroup("Child", parent, 2, 24000)));
+    WRAPAL_CHECK(top(WrapALAudioEngine.CreateGroup("Child", parent, 1, 48000)));
+    // 片段按名称使用任意层级的组别
+    WrapAL::CALAudioSourceClip clip(make_clip(480, dc, WrapAL::Flag_None, "Child"));
+    WRAPAL_REQUIRE(clip);
+    WRAPAL_CHECK(!std::strcmp(clip.GetGroup().Name(), "Child"));
+    // 太深了
+    auto group = child;
+    char name[] = "Deep0";
+    uint32_t depth = 2;
+    for (; depth != WrapAL::GroupMaxDepth + 1; ++depth) {
+        name[4] = char('A' + depth);
+        const auto next = WrapALAudioEngine.CreateGroup(name, group);
+        if (top(next)) break;
+        group = next;
+    }
+    WRAPAL_CHECK(depth == WrapAL::GroupMaxDepth);
+}
+
+// streaming clip plays from the new position after seeking or resizing
+// buffers while playing, no slot of old position submitted
+WRAPAL_TEST(offline_streaming_seek) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    const auto ch = engine.format.nChannels;
+    // 斜坡, 值是帧序号
+    const auto ramp = [rate](uint32_t i) noexcept { return float(i) / float(rate * 2); };
+    WrapAL::CALAudioSourceClip clip(make_stream_clip(rate * 2, ramp));
+    WRAPAL_REQUIRE(clip);
+    clip.Play();
+    engine.Render(rate / 10);
+    const auto first = engine.FirstSound();
+    WRAPAL_REQUIRE(first + 2 < rate / 10);
+    // 帧序号: 除以每帧的增量
+    const auto step = engine.output[size_t(first + 1) * ch] - engine.output[size_t(first) * ch];
+    WRAPAL_REQUIRE(step > 0.f);
+    const auto frame = [&engine, ch, step](uint32_t i) noexcept {
+        return double(engine.output[size_t(i) * ch]) / double(step);
+    };
+    // 输出连续, 从 at 开始
+    const auto continuous = [&engine, &frame](double at) noexcept {
+        if (std::fabs(frame(0) - at) > 1.5) return false;
+        for (uint32_t i = 1; i != engine.output.size() / engine.format.nChannels; ++i)
+            if (std::fabs(frame(i) - frame(i - 1) - 1.0) > 0.05) return false;
+        return true;
+    };
+    auto last = frame(rate / 10 - 1);
+    engine.Render(rate / 10);
+    WRAPAL_CHECK(continuous(last + 1.0));
+    // 播放中跳转
+    clip.Seek(1.f);
+    engine.Render(rate / 10);
+    WRAPAL_CHECK(continuous(double(rate)));
+    // 播放中调整缓冲区, 保留位置
+    last = frame(rate / 10 - 1);
+    WRAPAL_CHECK(clip.SetStreamingBuffer(8 * 1024, 5));
+    engine.Render(rate / 10);
+    WRAPAL_CHECK(continuous(last + 1.0));
+    WRAPAL_CHECK(clip.Underruns() == 0);
+}
+
+// clip failed to create is released, no handle returned
+WRAPAL_TEST(offline_create_failed) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    // 采样率太低, 无法创建源音
+    auto format = engine.format;
+    format.nSamplesPerSec = 500;
+    format.nChannels = 1;
+    format.nBlockAlign = sizeof(float);
+    const float data[480] = { };
+    const auto buffer = reinterpret_cast<const uint8_t*>(data);
+    const WrapAL::AudioClipFlag flags[] = { WrapAL::Flag_None, WrapAL::Flag_AutoDestroyEOP };
+    for (auto flag : flags) {
+        const auto handle = WrapALAudioEngine.CreateClip(format, buffer, sizeof(data), flag, "Test");
+        WRAPAL_CHECK(handle == WrapAL::ALInvalidHandle);
+        const auto stream = new CFrameStream(format, std::vector<float>(480));
+        const auto streaming = WrapAL::AudioClipFlag(flag | WrapAL::Flag_StreamingReading);
+        WRAPAL_CHECK(WrapALAudioEngine.CreateClip(stream, streaming, "Test") == WrapAL::ALInvalidHandle);
+        stream->Release();
+    }
+    // 片段都已摧毁
+    engine.Render(480);
+    WrapALAudioEngine.Update();
+    WrapAL::AudioPerformanceData perf;
+    WrapALAudioEngine.GetPerformanceData(perf);
+    WRAPAL_CHECK(perf.clip_memory == 0);
+}
+
+// limiter of master keeps peaks under the ceiling
+WRAPAL_TEST(offline_effect_limiter) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    WrapAL::CALAudioSourceClip clip(make_clip(rate, dc, WrapAL::Flag_LoopInfinite));
+    WRAPAL_REQUIRE(clip);
+    clip.Play();
+    engine.Render(rate / 10);
+    const auto dry = engine.Peak(0);
+    WRAPAL_CHECK(dry > 0.5f);
+    // -12dB
+    const WrapAL::EffectType chain[] = { WrapAL::EffectType::Effect_Limiter };
+    const auto master = WrapALAudioEngine.GetGroup("");
+    WRAPAL_REQUIRE(master.SetEffectChain(chain) >= 0);
+    WRAPAL_CHECK(master.SetEffect(0, WrapAL::EffectLimiter{ -12.f, 50.f }));
+    engine.Render(rate / 100);
+    engine.Render(rate / 2);
+    const float ceiling = std::pow(10.f, -12.f / 20.f);
+    WRAPAL_CHECK(engine.Peak(0) <= ceiling + 1e-4f);
+    WRAPAL_CHECK(engine.Peak(1) <= ceiling + 1e-4f);
+    WRAPAL_CHECK(engine.Peak(0, rate / 4) > ceiling * 0.5f);
+    // 旁路
+    WRAPAL_CHECK(master.EnableEffect(0, false));
+    engine.Render(rate / 100);
+    engine.Render(rate / 10);
+    WRAPAL_CHECK_NEAR(engine.Peak(0), dry, 1e-4f);
+}
+
+// reverb of group leaves a tail after the clip ended, dry group not
+WRAPAL_TEST(offline_effect_reverb) {
+    COfflineEngine engine;
+    WRAPAL_REQUIRE(engine.ok);
+    const auto rate = engine.format.nSamplesPerSec;
+    const auto burst = [rate](uint32_t i) noexcept { return i < rate / 100 ? 1.f : 0.f; };
+    const WrapAL::EffectType chain[] = { WrapAL::EffectType::Effect_Reverb };
+    const auto wet = WrapALAudioEngine.CreateGroup("Wet");
+    WRAPAL_REQUIRE(wet.SetEffectChain(chain) >= 0);
+    WRAPAL_CHECK(wet.SetEffect(0, WrapAL::EffectReverb{ 0.8f, 0.3f, 1.f, 0.5f, 1.f }));
+    const char* groups[] = { "Dry", "Wet" };
+    float tail[2];
+    for (int i = 0; i != 2; ++i) {
+        WrapAL::CALAudioSourceClip clip(make_clip(rate / 10, burst, WrapAL::Flag_None, groups[i]));
+        WRAPAL_REQUIRE(clip);
+        clip.Play();
+        engine.Render(rate / 2);
+        WRAPAL_CHECK(engine.Peak(0) > 0.1f);
+        // 片段结束后
+        tail[i] = engine.Peak(0, rate / 5);
+    }
+    WRAPAL_CHECK(tail[0] == 0.f);
+    WRAPAL_CHECK(tail[1] > 1e-3f);
+}
+
+// HRTF set in memory
+class CMemoryStream final : public WrapAL::IALStream {
+public:
+    // ctor
+    CMemoryStream(std::vector<uint8_t>&& data) noexcept : m_data(std::move(data)) {}
+    // add ref-count, on stack
+    auto AddRef() noexcept ->uint32_t override { return 2; }
+    // release, on stack
+    auto Release() noexcept ->uint32_t override { return 1; }
+    // seek stream in byte
+    auto Seek(int32_t off, Move method) noexcept ->uint32_t override {
+        int64_t pos = off;
+        if (method == Move_Current) pos += m_pos;
+        else if (method == Move_End) pos += int64_t(m_data.size());
+        m_pos = uint32_t(std::min(std::max(pos, int64_t(0)), int64_t(m_data.size())));
+        return m_pos;
+    }
+    // read stream
+    auto ReadNext(uint32_t len, void* buf) noexcept ->uint32_t override {
+        len = std::min(len, uint32_t(m_data.size()) - m_pos);
+        std::memcpy(buf, m_data.data() + m_pos, len);
+        m_pos += len;
+        return len;
+    }
+    // get total size
+    auto GetSizeInByte() noexcept ->uint32_t override { return uint32_t(m_data.size()); }
+private:
+    // data
+    std::vector<uint8_t>    m_data;
+    // position
+    uint32_t                m_pos = 0;
+};
+
+// make HRTF set of one measurement, impulse of one ear
+static auto make_hrtf(uint32_t rate, uint32_t ear) noexcept {
+    enum : uint32_t { TAPS = 32 };
+    std::vector<uint8_t> data;
+    const auto put = [&data](const void* ptr, size_t len) noexcept {
+        data.insert(data.end(), reinterpret_cast<const uint8_t*>(ptr), reinterpret_cast<const uint8_t*>(ptr) + len);
+    };
+    const uint32_t header[] = { 1, rate, 1, 2, TAPS };
+    put("WHRF", 4);
+    put(header, sizeof(header));
+    const float position[] = { 0.f, 0.f, 1.f };
+    put(position, sizeof(position));
+    float ir[2][TAPS] = { };
+    ir[ear][0] = 1.f;
+    put(ir, sizeof(ir));
+    return CMemoryStream(std::move(data));
+}
+
+// binaural clip output through the impulse responses only
+WRAPAL_TEST(offline_hrtf_output) {
+    for (uint32_t ear = 0; ear != 2; ++ear) {
+        COfflineEngine engine;
+        WRAPAL_REQUIRE(engine.ok);
+        WRAPAL_REQUIRE(engine.format.nChannels == 2);
+        const auto rate = engine.format.nSamplesPerSec;
+        auto stream = make_hrtf(rate, ear);
+        WRAPAL_REQUIRE(WrapALAudioEngine.SetHRTF(&stream, 8) >= 0);
+        const WrapAL::AudioListener3D listener = { { 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, 0.f } };
+        WrapALAudioEngine.SetListener(listener);
+        const auto handle = make_clip(rate, dc, WrapAL::AudioClipFlag(WrapAL::Flag_LoopInfinite | WrapAL::Flag_3D));
+        WrapAL::CALAudioSourceClip clip(handle);
+        WRAPAL_REQUIRE(clip);
+        clip.Play();
+        engine.Render(rate / 100);
+        // 正前方
+        const WrapAL::ALHandle handles[] = { handle };
+        const float x[] = { 0.f }, y[] = { 0.f }, z[] = { 1.f };
+        WrapAL::AudioEmitters3D emitters = { };
+        emitters.clips = handles;
+        emitters.position_x = x; emitters.position_y = y; emitters.position_z = z;
+        emitters.count = 1;
+        WRAPAL_CHECK(WrapALAudioEngine.Update3D(emitters) == 1);
+        engine.Render(rate / 100);
+        engine.Render(rate / 5);
+        // 延迟一个分块之后
+        const auto from = uint32_t(WrapAL::BinauralBlock) * 2;
+        WRAPAL_CHECK(engine.Peak(ear, from) > 0.1f);
+        WRAPAL_CHECK(engine.Peak(1 - ear, from) < 1e-4f);
+    }
+}
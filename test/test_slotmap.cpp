@@ -0,0 +1,141 @@
+﻿#include <atomic>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "AudioSlotMap.h"
+
+using WrapAL::ALHandle;
+using WrapAL::CALClipSlotMap;
+using WrapAL::CALAudioSourceClipImpl;
+
+// clips are never touched by slot map, addresses only
+static char s_clips[WrapAL::ClipSlotChunkSize * 2 + 1];
+
+// get fake clip
+static auto fake_clip(uint32_t i) noexcept -> CALAudioSourceClipImpl& {
+    return *reinterpret_cast<CALAudioSourceClipImpl*>(s_clips + i);
+}
+
+// index part of handle
+static auto index_of(ALHandle handle) noexcept {
+    return uint32_t(handle & (WrapAL::ClipSlotMaxCount - 1));
+}
+
+// insert, find and remove
+WRAPAL_TEST(slotmap_insert_find_remove) {
+    CALClipSlotMap map;
+    const auto a = map.Insert(fake_clip(0));
+    const auto b = map.Insert(fake_clip(1));
+    WRAPAL_CHECK(a != WrapAL::ALInvalidHandle && b != WrapAL::ALInvalidHandle);
+    WRAPAL_CHECK(a != b);
+    WRAPAL_CHECK(map.Count() == 2);
+    WRAPAL_CHECK(map.Find(a) == &fake_clip(0));
+    WRAPAL_CHECK(map.Find(b) == &fake_clip(1));
+    map.Remove(a);
+    WRAPAL_CHECK(map.Count() == 1);
+    WRAPAL_CHECK(map.Find(a) == nullptr);
+    WRAPAL_CHECK(map.Find(b) == &fake_clip(1));
+    map.Remove(b);
+    WRAPAL_CHECK(map.Count() == 0);
+    WRAPAL_CHECK(map.Find(WrapAL::ALInvalidHandle) == nullptr);
+}
+
+// freed slot reused with new generation, old handle stale
+WRAPAL_TEST(slotmap_stale_handle) {
+    CALClipSlotMap map;
+    const auto a = map.Insert(fake_clip(0));
+    map.Remove(a);
+    const auto b = map.Insert(fake_clip(1));
+    WRAPAL_CHECK(index_of(a) == index_of(b));
+    WRAPAL_CHECK(a != b);
+    WRAPAL_CHECK(map.Find(a) == nullptr);
+    WRAPAL_CHECK(map.Find(b) == &fake_clip(1));
+    // 多次复用
+    auto last = b;
+    for (uint32_t i = 0; i != 100; ++i) {
+        map.Remove(last);
+        const auto next = map.Insert(fake_clip(2));
+        WRAPAL_CHECK(index_of(next) == index_of(a));
+        WRAPAL_CHECK(map.Find(last) == nullptr);
+        last = next;
+    }
+    WRAPAL_CHECK(map.Find(last) == &fake_clip(2));
+    map.Remove(last);
+}
+
+// acquire calls add_ref on live clip only, null if add_ref failed
+WRAPAL_TEST(slotmap_acquire) {
+    CALClipSlotMap map;
+    const auto a = map.Insert(fake_clip(0));
+    uint32_t calls = 0;
+    const auto add_ref = [&calls](CALAudioSourceClipImpl& clip) noexcept { ++calls; return &clip == &fake_clip(0); };
+    WRAPAL_CHECK(map.Acquire(a, add_ref) == &fake_clip(0));
+    WRAPAL_CHECK(calls == 1);
+    map.Remove(a);
+    const auto b = map.Insert(fake_clip(1));
+    // 过期句柄不调用
+    WRAPAL_CHECK(map.Acquire(a, add_ref) == nullptr);
+    WRAPAL_CHECK(calls == 1);
+    WRAPAL_CHECK(map.Acquire(b, add_ref) == nullptr);
+    WRAPAL_CHECK(calls == 2);
+    map.Remove(b);
+}
+
+// stale handle never acquires the clip reusing its slot in other thread
+WRAPAL_TEST(slotmap_acquire_threads) {
+    CALClipSlotMap map;
+    const auto a = map.Insert(fake_clip(0));
+    map.Remove(a);
+    std::atomic<bool> done{ false };
+    std::atomic<uint32_t> wrong{ 0 };
+    std::thread finder([&]() noexcept {
+        const auto add_ref = [](CALAudioSourceClipImpl&) noexcept { return true; };
+        while (!done.load()) wrong += map.Acquire(a, add_ref) != nullptr;
+    });
+    for (uint32_t i = 0; i != 10000; ++i) map.Remove(map.Insert(fake_clip(1 + (i & 1))));
+    done = true;
+    finder.join();
+    WRAPAL_CHECK(wrong == 0);
+    WRAPAL_CHECK(map.Count() == 0);
+}
+
+// slots over chunks, handles in unallocated chunks find nothing
+WRAPAL_TEST(slotmap_chunks) {
+    CALClipSlotMap map;
+    constexpr uint32_t count = sizeof(s_clips);
+    std::vector<ALHandle> handles(count);
+    WRAPAL_CHECK(map.Find(WrapAL::ClipSlotChunkSize * 4 + (ALHandle(1) << WrapAL::ClipSlotIndexBits)) == nullptr);
+    for (uint32_t i = 0; i != count; ++i) handles[i] = map.Insert(fake_clip(i));
+    WRAPAL_CHECK(map.Count() == count);
+    uint32_t found = 0;
+    for (uint32_t i = 0; i != count; ++i) found += map.Find(handles[i]) == &fake_clip(i);
+    WRAPAL_CHECK(found == count);
+    // 移除一半, 遍历只访问存活的
+    for (uint32_t i = 0; i < count; i += 2) map.Remove(handles[i]);
+    uint32_t visited = 0, odd = 0;
+    map.ForEach([&](CALAudioSourceClipImpl& clip) noexcept {
+        ++visited;
+        odd += (reinterpret_cast<char*>(&clip) - s_clips) & 1;
+    });
+    WRAPAL_CHECK(visited == count / 2);
+    WRAPAL_CHECK(odd == visited);
+    for (uint32_t i = 1; i < count; i += 2) map.Remove(handles[i]);
+    WRAPAL_CHECK(map.Count() == 0);
+}
+
+// insert fails when all slots used
+WRAPAL_TEST(slotmap_full) {
+    CALClipSlotMap map;
+    std::vector<ALHandle> handles(WrapAL::ClipSlotMaxCount);
+    uint32_t inserted = 0;
+    for (auto& handle : handles) inserted += (handle = map.Insert(fake_clip(0))) != WrapAL::ALInvalidHandle;
+    WRAPAL_CHECK(inserted == WrapAL::ClipSlotMaxCount);
+    WRAPAL_CHECK(map.Insert(fake_clip(1)) == WrapAL::ALInvalidHandle);
+    // 释放一个后可再插入
+    map.Remove(handles[7]);
+    handles[7] = map.Insert(fake_clip(1));
+    WRAPAL_CHECK(handles[7] != WrapAL::ALInvalidHandle);
+    WRAPAL_CHECK(map.Find(handles[7]) == &fake_clip(1));
+    for (auto handle : handles) if (handle != WrapAL::ALInvalidHandle) map.Remove(handle);
+    WRAPAL_CHECK(map.Count() == 0);
+}
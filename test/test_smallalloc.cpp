@@ -0,0 +1,44 @@
+﻿#include <thread>
+#include "test.h"
+#include "AudioSmallAlloc.h"
+
+using WrapAL::CALSmallAllocator;
+
+// objects out of slabs of class
+static auto objects_of(uint32_t index) noexcept {
+    WrapAL::SmallAllocStats stats;
+    CALSmallAllocator::GetStats(stats);
+    return stats.classes[index].objects;
+}
+
+// objects return to slabs when the thread exits
+WRAPAL_TEST(smallalloc_thread_exit) {
+    const auto index = CALSmallAllocator::ClassIndex(48);
+    const auto before = objects_of(index);
+    std::thread([]() noexcept {
+        void* objs[100];
+        for (auto& obj : objs) obj = CALSmallAllocator::Alloc(48);
+        for (auto obj : objs) CALSmallAllocator::Free(obj);
+    }).join();
+    WRAPAL_CHECK(objects_of(index) == before);
+}
+
+// thread_local object destroyed after the thread cache, frees into it
+struct LateFree {
+    // dtor, after thread cache destroyed
+    ~LateFree() noexcept { CALSmallAllocator::Free(obj); }
+    // object to free
+    void*   obj = nullptr;
+};
+
+// object freed after thread cache destroyed goes back to slab
+WRAPAL_TEST(smallalloc_free_after_cache) {
+    const auto index = CALSmallAllocator::ClassIndex(80);
+    const auto before = objects_of(index);
+    std::thread([]() noexcept {
+        // 先构造, 后析构
+        static thread_local LateFree late;
+        late.obj = CALSmallAllocator::Alloc(80);
+    }).join();
+    WRAPAL_CHECK(objects_of(index) == before);
+}